@@ -0,0 +1,68 @@
+package main
+
+/*  Streams binary display commands to a UFO - meant for testing purposes only.
+	Shows a chase running around both rings, every frame is one POST /api with a ufocommand packet:
+		go run commandsender.go <ufo address> [frames per second]
+	Reports the frames sent and the frames rejected by the UFO once per second.
+*/
+
+import (
+	"bytes"
+	"log"
+	"net/http"
+	"os"
+	"strconv"
+	"time"
+	"ufocommand"
+)
+
+func main() {
+	if len(os.Args) < 2 {
+		log.Fatalln("usage: commandsender <ufo address> [frames per second]")
+	}
+	url := "http://" + os.Args[1] + "/api"
+	fps := 20
+	if len(os.Args) > 2 {
+		var err error
+		if fps, err = strconv.Atoi(os.Args[2]); err != nil || fps <= 0 {
+			log.Fatalln("invalid frames per second:", os.Args[2])
+		}
+	}
+
+	client := &http.Client{Timeout: 2 * time.Second}
+	packet := ufocommand.NewPacket()
+	var top, bottom [ufocommand.RingLeds]uint32
+	sent, rejected := 0, 0
+	report := time.Now()
+
+	ticker := time.NewTicker(time.Second / time.Duration(fps))
+	for frame := 0; ; frame++ {
+		<-ticker.C
+		for i := range top {
+			top[i] = 0x000010
+			bottom[i] = 0x100000
+		}
+		top[frame%ufocommand.RingLeds] = 0x00ff00
+		bottom[(ufocommand.RingLeds-1)-frame%ufocommand.RingLeds] = 0xff8000
+
+		packet.Reset()
+		data, err := packet.Frame(ufocommand.Top, &top).Frame(ufocommand.Bottom, &bottom).Logo(byte(frame/ufocommand.RingLeds%ufocommand.LogoLeds), 0xffffff).Bytes()
+		if err != nil {
+			log.Fatalln(err)
+		}
+		resp, err := client.Post(url, "application/octet-stream", bytes.NewReader(data))
+		if err != nil {
+			log.Println(err)
+			continue
+		}
+		resp.Body.Close()
+		sent++
+		if resp.StatusCode != http.StatusOK {
+			rejected++
+		}
+		if time.Since(report) >= time.Second {
+			log.Printf("%d frames sent, %d rejected", sent, rejected)
+			report = time.Now()
+		}
+	}
+}
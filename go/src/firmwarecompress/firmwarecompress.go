@@ -0,0 +1,106 @@
+package main
+
+/*  Compresses firmware images (or delta updates) for the UFO on the host:
+		go run firmwarecompress.go compress <image> <compressed image>
+		go run firmwarecompress.go decompress <compressed image> <image>
+		go run firmwarecompress.go verify <image> [rounds]
+	verify compresses the image and decompresses it in chunks of random size - like the UFO receives
+	them - and compares the result, then checks that a corrupted image is refused.
+*/
+
+import (
+	"bytes"
+	"io/ioutil"
+	"log"
+	"math/rand"
+	"os"
+	"strconv"
+	"time"
+	"ufoz"
+)
+
+func readFile(name string) []byte {
+	data, err := ioutil.ReadFile(name)
+	if err != nil {
+		log.Fatalln(err)
+	}
+	return data
+}
+
+// decompresses in chunks of 1 .. maxChunk bytes
+func decompressChunked(compressed []byte, maxChunk int) ([]byte, error) {
+	decoder := ufoz.NewDecoder()
+	for len(compressed) > 0 {
+		n := 1 + rand.Intn(maxChunk)
+		if n > len(compressed) {
+			n = len(compressed)
+		}
+		if _, err := decoder.Write(compressed[:n]); err != nil {
+			return nil, err
+		}
+		compressed = compressed[n:]
+	}
+	return decoder.Close()
+}
+
+func main() {
+	if len(os.Args) < 3 {
+		log.Fatalln("usage: firmwarecompress compress <image> <compressed> | decompress <compressed> <image> | verify <image> [rounds]")
+	}
+	switch os.Args[1] {
+	case "compress":
+		if len(os.Args) < 4 {
+			log.Fatalln("usage: firmwarecompress compress <image> <compressed>")
+		}
+		image := readFile(os.Args[2])
+		compressed := ufoz.Compress(image)
+		if err := ioutil.WriteFile(os.Args[3], compressed, 0644); err != nil {
+			log.Fatalln(err)
+		}
+		log.Printf("compressed: %d bytes, image: %d bytes (%.1f%%)", len(compressed), len(image), 100*float64(len(compressed))/float64(len(image)))
+	case "decompress":
+		if len(os.Args) < 4 {
+			log.Fatalln("usage: firmwarecompress decompress <compressed> <image>")
+		}
+		image, err := ufoz.Decompress(readFile(os.Args[2]))
+		if err != nil {
+			log.Fatalln(err)
+		}
+		if err = ioutil.WriteFile(os.Args[3], image, 0644); err != nil {
+			log.Fatalln(err)
+		}
+		log.Printf("image: %d bytes", len(image))
+	case "verify":
+		rounds := 100
+		if len(os.Args) > 3 {
+			rounds, _ = strconv.Atoi(os.Args[3])
+		}
+		rand.Seed(time.Now().UnixNano())
+		image := readFile(os.Args[2])
+		compressed := ufoz.Compress(image)
+		for round := 0; round < rounds; round++ {
+			// small chunks split every token, large ones resemble the receive buffer
+			maxChunk := 1 + rand.Intn(16)
+			if round%2 == 1 {
+				maxChunk = 1 + rand.Intn(16384)
+			}
+			result, err := decompressChunked(compressed, maxChunk)
+			if err != nil {
+				log.Fatalln("FAILED:", err)
+			}
+			if !bytes.Equal(result, image) {
+				log.Fatalln("FAILED: decompressed image differs")
+			}
+		}
+		if len(compressed) > ufoz.HeaderLength {
+			corrupted := append([]byte{}, compressed...)
+			corrupted[ufoz.HeaderLength+(len(corrupted)-ufoz.HeaderLength)/2] ^= 0x01
+			if _, err := ufoz.Decompress(corrupted); err == nil {
+				log.Fatalln("FAILED: corrupted image accepted")
+			}
+		}
+		log.Printf("OK - %d rounds, compressed: %d bytes, image: %d bytes (%.1f%%)", rounds, len(compressed), len(image), 100*float64(len(compressed))/float64(len(image)))
+	default:
+		log.Fatalln("unknown command:", os.Args[1])
+	}
+}
@@ -0,0 +1,76 @@
+package main
+
+/*  Creates and checks delta updates of the UFO firmware on the host:
+		go run firmwarediff.go diff <old image> <new image> <patch>
+		go run firmwarediff.go apply <old image> <patch> <new image>
+		go run firmwarediff.go verify <old image> <new image>
+	verify creates the patch, applies it and compares the result with the new image - run it for a pair of
+	releases before serving their patch with firmwareserver.
+*/
+
+import (
+	"bytes"
+	"io/ioutil"
+	"log"
+	"os"
+	"ufodiff"
+)
+
+func readFile(name string) []byte {
+	data, err := ioutil.ReadFile(name)
+	if err != nil {
+		log.Fatalln(err)
+	}
+	return data
+}
+
+func main() {
+	if len(os.Args) < 4 {
+		log.Fatalln("usage: firmwarediff diff <old> <new> <patch> | apply <old> <patch> <new> | verify <old> <new>")
+	}
+	switch os.Args[1] {
+	case "diff":
+		if len(os.Args) < 5 {
+			log.Fatalln("usage: firmwarediff diff <old> <new> <patch>")
+		}
+		newImage := readFile(os.Args[3])
+		patch := ufodiff.Diff(readFile(os.Args[2]), newImage)
+		if err := ioutil.WriteFile(os.Args[4], patch, 0644); err != nil {
+			log.Fatalln(err)
+		}
+		log.Printf("patch: %d bytes, image: %d bytes (%.1f%%)", len(patch), len(newImage), 100*float64(len(patch))/float64(len(newImage)))
+	case "apply":
+		if len(os.Args) < 5 {
+			log.Fatalln("usage: firmwarediff apply <old> <patch> <new>")
+		}
+		newImage, err := ufodiff.Apply(readFile(os.Args[2]), readFile(os.Args[3]))
+		if err != nil {
+			log.Fatalln(err)
+		}
+		if err = ioutil.WriteFile(os.Args[4], newImage, 0644); err != nil {
+			log.Fatalln(err)
+		}
+		log.Printf("new image: %d bytes", len(newImage))
+	case "verify":
+		oldImage, newImage := readFile(os.Args[2]), readFile(os.Args[3])
+		patch := ufodiff.Diff(oldImage, newImage)
+		result, err := ufodiff.Apply(oldImage, patch)
+		if err != nil {
+			log.Fatalln("FAILED:", err)
+		}
+		if !bytes.Equal(result, newImage) {
+			log.Fatalln("FAILED: patched image differs")
+		}
+		// a patch for another image has to be refused
+		if len(oldImage) > 0 {
+			other := append([]byte{}, oldImage...)
+			other[len(other)/2] ^= 0xff
+			if _, err = ufodiff.Apply(other, patch); err == nil {
+				log.Fatalln("FAILED: patch applied to another image")
+			}
+		}
+		log.Printf("OK - patch: %d bytes, image: %d bytes (%.1f%%)", len(patch), len(newImage), 100*float64(len(patch))/float64(len(newImage)))
+	default:
+		log.Fatalln("unknown command:", os.Args[1])
+	}
+}
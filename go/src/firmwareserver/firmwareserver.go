@@ -2,16 +2,98 @@ package main
 
 /*  This firmware server is meant for testing purposes only. 
 	For production use generate proper certificates 
+		go run firmwareserver.go http|https [firmware file] [directory of previous images]
+	The firmware file defaults to the build output of the repository. Every download logs its duration,
+	compare it with the "ota" statistics of /checkfirmware on the UFO.
+	The UFO sends the SHA256 of its running image in X-Ufo-Image-Sha256. If the directory of previous images
+	holds that image, a delta update (see go/src/ufodiff) is served instead of the full image.
+	A UFO that sends "X-Ufo-Accept: ufoz" gets image or delta compressed (see go/src/ufoz), if that is smaller.
+	Range requests are answered with 206 and the ETag is the SHA256 of the served data, so the UFO can continue
+	an interrupted update (test/host test_Ota cuts downloads at random bytes and checks that).
 */
 
 import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/hex"
 	"fmt"
 	"io/ioutil"
 	"log"
 	"net/http"
 	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"time"
+	"ufodiff"
+	"ufoz"
 )
 
+var firmwareFile = "../../../build/ufo-esp32.bin"
+var previousDir = ""
+
+var (
+	cacheMutex sync.Mutex
+	patches    = map[string][]byte{} // old image hash + new image hash
+	compressed = map[string][]byte{} // hash of the uncompressed data
+)
+
+// returns nil if compression does not make the data smaller
+func findCompressed(data []byte) []byte {
+	sum := sha256.Sum256(data)
+	key := hex.EncodeToString(sum[:])
+	cacheMutex.Lock()
+	defer cacheMutex.Unlock()
+	if result, ok := compressed[key]; ok {
+		return result
+	}
+	result := ufoz.Compress(data)
+	log.Printf("compressed: %d bytes, uncompressed: %d bytes", len(result), len(data))
+	if len(result) >= len(data) {
+		result = nil
+	}
+	compressed[key] = result
+	return result
+}
+
+// returns nil if the image is unknown or the patch would not be smaller than the image
+func findPatch(imageHash string, firmware []byte) []byte {
+	imageHash = strings.ToLower(imageHash)
+	if previousDir == "" || len(imageHash) != 2*sha256.Size {
+		return nil
+	}
+	firmwareSum := sha256.Sum256(firmware)
+	key := imageHash + hex.EncodeToString(firmwareSum[:])
+	cacheMutex.Lock()
+	defer cacheMutex.Unlock()
+	if patch, ok := patches[key]; ok {
+		return patch
+	}
+	files, err := filepath.Glob(filepath.Join(previousDir, "*.bin"))
+	if err != nil {
+		log.Println(err)
+		return nil
+	}
+	for _, name := range files {
+		image, err := ioutil.ReadFile(name)
+		if err != nil {
+			continue
+		}
+		sum := sha256.Sum256(image)
+		if hex.EncodeToString(sum[:]) != imageHash {
+			continue
+		}
+		patch := ufodiff.Diff(image, firmware)
+		log.Printf("patch against %s: %d bytes, image: %d bytes", name, len(patch), len(firmware))
+		if len(patch) >= len(firmware) {
+			patch = nil
+		}
+		patches[key] = patch
+		return patch
+	}
+	return nil
+}
+
 func rootHandler(w http.ResponseWriter, r *http.Request) {
 	log.Println("serving User-Agent: ", r.Header.Get("User-Agent"))
 	w.Header().Set("Content-Type", "text/html")
@@ -24,17 +106,49 @@ func rootHandler(w http.ResponseWriter, r *http.Request) {
 
 func firmwareHandler(w http.ResponseWriter, r *http.Request) {
 	log.Println("serving User-Agent: ", r.Header.Get("User-Agent"))
+	data, err := ioutil.ReadFile(firmwareFile)
+	if err != nil {
+		log.Println(err)
+		http.Error(w, "firmware not found", http.StatusNotFound)
+		return
+	}
 	w.Header().Set("Content-Type", "application/octet-stream")
 	w.Header().Set("Content-Disposition", "attachment;filename=firmware.bin")
-	//data, err := ioutil.ReadFile("C:/Users/bernd/Documents/GitHub/esp32gong/build/esp32gong.bin")
-	data, err := ioutil.ReadFile("C:/Users/bernd/Documents/GitHub/ufo-esp32/build/ufo-esp32.bin")
-	if err != nil {
-		panic(err)
+	if patch := findPatch(r.Header.Get("X-Ufo-Image-Sha256"), data); patch != nil {
+		log.Println("serving delta update")
+		data = patch
+		w.Header().Set("Content-Type", "application/x-ufo-diff")
+		w.Header().Set("Content-Disposition", "attachment;filename=firmware.diff")
 	}
-	w.Header().Set("Content-Length", fmt.Sprint(len(data)))
-	log.Println("Content-Length: ", fmt.Sprint(len(data)))
-	w.WriteHeader(http.StatusOK)
-	fmt.Fprint(w, string(data))
+	if strings.Contains(r.Header.Get("X-Ufo-Accept"), "ufoz") {
+		if result := findCompressed(data); result != nil {
+			log.Println("serving compressed")
+			data = result
+			w.Header().Set("Content-Type", "application/x-ufoz")
+		}
+	}
+	// the hash identifies the data, so a UFO can continue an interrupted download with a range request
+	sum := sha256.Sum256(data)
+	w.Header().Set("ETag", "\""+hex.EncodeToString(sum[:])+"\"")
+	log.Println("Content-Length: ", len(data), "Range: ", r.Header.Get("Range"))
+	cw := &countingWriter{ResponseWriter: w}
+	start := time.Now()
+	http.ServeContent(cw, r, "firmware.bin", time.Time{}, bytes.NewReader(data))
+	elapsed := time.Since(start)
+	// the UFO reads the response as fast as it flashes it, so this is close to the end-to-end update time
+	log.Printf("sent %d bytes in %v (%.1f kB/s)", cw.written, elapsed, float64(cw.written)/1024/elapsed.Seconds())
+}
+
+// counts the body, a range request sends only a part of the data
+type countingWriter struct {
+	http.ResponseWriter
+	written int64
+}
+
+func (cw *countingWriter) Write(p []byte) (int, error) {
+	n, err := cw.ResponseWriter.Write(p)
+	cw.written += int64(n)
+	return n, err
 }
 
 func main() {
@@ -43,6 +157,13 @@ func main() {
 		log.Println("Please specify commandline option: http | https")
 		return
 	}
+	if len(os.Args) > 2 {
+		firmwareFile = os.Args[2]
+	}
+	if len(os.Args) > 3 {
+		previousDir = os.Args[3]
+	}
+	log.Println("serving firmware: ", firmwareFile)
 	
 	if os.Args[1] == "https" {
 		log.Println("server runs at: https://localhost:9999")
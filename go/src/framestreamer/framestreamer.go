@@ -0,0 +1,156 @@
+package main
+
+/*  Load generator for the UDP frame stream of a UFO - meant for testing purposes only.
+	Sends a chase running around both rings as full frames (see main/FrameStreamServer.h of the firmware):
+		go run framestreamer.go <ufo address> [frames per second] [seconds]
+	Reports the achieved send rate and the jitter of the send interval. Before and after the run the
+	counters of /info are read, so the frames accepted, dropped and shown by the UFO are reported as well.
+*/
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"log"
+	"math"
+	"net"
+	"net/http"
+	"os"
+	"strconv"
+	"time"
+)
+
+const (
+	ringLeds  = 15
+	logoLeds  = 4
+	frameSize = 8 + 3*(2*ringLeds+logoLeds)
+)
+
+type ufoInfo struct {
+	StreamPort     string `json:"streamport"`
+	StreamFrames   string `json:"streamframes"`
+	StreamLate     string `json:"streamlate"`
+	StreamInvalid  string `json:"streaminvalid"`
+	StreamReplaced string `json:"streamreplaced"`
+	StreamShown    string `json:"streamshown"`
+}
+
+func readInfo(address string) (map[string]uint64, error) {
+	client := &http.Client{Timeout: 2 * time.Second}
+	resp, err := client.Get("http://" + address + "/info")
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	var info ufoInfo
+	if err = json.NewDecoder(resp.Body).Decode(&info); err != nil {
+		return nil, err
+	}
+	counters := make(map[string]uint64)
+	for name, value := range map[string]string{"port": info.StreamPort, "accepted": info.StreamFrames, "late": info.StreamLate,
+		"invalid": info.StreamInvalid, "replaced": info.StreamReplaced, "shown": info.StreamShown} {
+		counters[name], _ = strconv.ParseUint(value, 10, 32)
+	}
+	return counters, nil
+}
+
+func setLed(frame []byte, index int, color uint32) {
+	frame[8+3*index] = byte(color >> 16)
+	frame[8+3*index+1] = byte(color >> 8)
+	frame[8+3*index+2] = byte(color)
+}
+
+func main() {
+	if len(os.Args) < 2 {
+		log.Fatalln("usage: framestreamer <ufo address> [frames per second] [seconds]")
+	}
+	address := os.Args[1]
+	fps, seconds := 50, 10
+	var err error
+	if len(os.Args) > 2 {
+		if fps, err = strconv.Atoi(os.Args[2]); err != nil || fps <= 0 {
+			log.Fatalln("invalid frames per second:", os.Args[2])
+		}
+	}
+	if len(os.Args) > 3 {
+		if seconds, err = strconv.Atoi(os.Args[3]); err != nil || seconds <= 0 {
+			log.Fatalln("invalid seconds:", os.Args[3])
+		}
+	}
+
+	port := uint64(7777)
+	before, err := readInfo(address)
+	if err != nil {
+		log.Println("no /info, UFO counters are not reported:", err)
+	} else if before["port"] != 0 {
+		port = before["port"]
+	}
+	conn, err := net.Dial("udp", net.JoinHostPort(address, strconv.FormatUint(port, 10)))
+	if err != nil {
+		log.Fatalln(err)
+	}
+	defer conn.Close()
+
+	frame := make([]byte, frameSize)
+	frame[0], frame[1], frame[2] = 'U', 'F', 1
+	total := fps * seconds
+	intervals := make([]float64, 0, total)
+	start := time.Now()
+	last := start
+
+	ticker := time.NewTicker(time.Second / time.Duration(fps))
+	for i := 0; i < total; i++ {
+		<-ticker.C
+		binary.LittleEndian.PutUint32(frame[4:], uint32(i+1))
+		for led := 0; led < ringLeds; led++ {
+			setLed(frame, led, 0x000010)
+			setLed(frame, ringLeds+led, 0x100000)
+		}
+		setLed(frame, i%ringLeds, 0x00ff00)
+		setLed(frame, ringLeds+(ringLeds-1)-i%ringLeds, 0xff8000)
+		for led := 0; led < logoLeds; led++ {
+			setLed(frame, 2*ringLeds+led, 0)
+		}
+		setLed(frame, 2*ringLeds+i/ringLeds%logoLeds, 0xffffff)
+
+		if _, err = conn.Write(frame); err != nil {
+			log.Println(err)
+		}
+		now := time.Now()
+		if i > 0 {
+			intervals = append(intervals, now.Sub(last).Seconds()*1000)
+		}
+		last = now
+	}
+	ticker.Stop()
+	elapsed := time.Since(start).Seconds()
+
+	var sum, max float64
+	for _, interval := range intervals {
+		sum += interval
+		if interval > max {
+			max = interval
+		}
+	}
+	mean := sum / float64(len(intervals))
+	var variance float64
+	for _, interval := range intervals {
+		variance += (interval - mean) * (interval - mean)
+	}
+	stddev := math.Sqrt(variance / float64(len(intervals)))
+	log.Printf("sent %d frames in %.2fs: %.1f fps, interval mean %.2fms stddev %.2fms max %.2fms",
+		total, elapsed, float64(total)/elapsed, mean, stddev, max)
+
+	if before == nil {
+		return
+	}
+	// the display task takes the last frame up to a few ms later
+	time.Sleep(100 * time.Millisecond)
+	after, err := readInfo(address)
+	if err != nil {
+		log.Fatalln(err)
+	}
+	diff := func(name string) uint64 { return after[name] - before[name] }
+	log.Printf("ufo: %d accepted (%.1f fps), %d shown (%.1f fps), %d late, %d invalid, %d replaced before shown",
+		diff("accepted"), float64(diff("accepted"))/elapsed, diff("shown"), float64(diff("shown"))/elapsed,
+		diff("late"), diff("invalid"), diff("replaced"))
+}
@@ -0,0 +1,56 @@
+package main
+
+/*  Stand-in for a monitoring collector - meant for testing purposes only.
+	Accepts the batches of the HTTP exporter (set the collector URL to http://<this machine>:8090/monitoring)
+	and logs their size and number of actions.
+*/
+
+import (
+	"encoding/json"
+	"io/ioutil"
+	"log"
+	"net/http"
+	"os"
+)
+
+type batch struct {
+	Timestamp string `json:"timestamp"`
+	Device    struct {
+		ID string `json:"id"`
+	} `json:"device"`
+	Actions []json.RawMessage `json:"actions"`
+}
+
+func monitoringHandler(w http.ResponseWriter, r *http.Request) {
+	if r.Method != http.MethodPost {
+		w.WriteHeader(http.StatusMethodNotAllowed)
+		return
+	}
+	data, err := ioutil.ReadAll(r.Body)
+	if err != nil {
+		w.WriteHeader(http.StatusBadRequest)
+		return
+	}
+	contentType := r.Header.Get("Content-Type")
+	if contentType == "application/json" {
+		var b batch
+		if err := json.Unmarshal(data, &b); err != nil {
+			log.Println("invalid JSON batch:", err)
+			w.WriteHeader(http.StatusBadRequest)
+			return
+		}
+		log.Printf("%s: %d bytes, %d actions", b.Device.ID, len(data), len(b.Actions))
+		if len(os.Args) > 1 && os.Args[1] == "verbose" {
+			log.Println(string(data))
+		}
+	} else {
+		log.Printf("%s batch: %d bytes", contentType, len(data))
+	}
+	w.WriteHeader(http.StatusNoContent)
+}
+
+func main() {
+	log.Println("collector runs at: http://localhost:8090/monitoring")
+	http.HandleFunc("/monitoring", monitoringHandler)
+	log.Fatal(http.ListenAndServe(":8090", nil))
+}
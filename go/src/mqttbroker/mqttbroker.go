@@ -0,0 +1,236 @@
+package main
+
+/*  Minimal MQTT 3.1.1 broker stand-in - meant for testing purposes only.
+	Accepts UFO connections (plain or TLS with the self signed test certificate of the firmware server),
+	logs the monitoring batches they publish and forwards every line typed on stdin as display command:
+		top=0|5|ff0000&bottom_bg=0000ff           goes to all UFOs
+		@ufo-1a2b3c top_init&top_whirl=220        goes to the given UFO only
+	For TLS build the firmware with CONFIG_UFO_MQTT_VERIFY_SERVER disabled and CONFIG_UFO_MQTT_HOST set to this machine.
+*/
+
+import (
+	"bufio"
+	"crypto/tls"
+	"encoding/binary"
+	"errors"
+	"io"
+	"log"
+	"net"
+	"os"
+	"strings"
+	"sync"
+)
+
+const commandTopic = "/dynatraceufo/command/"
+
+type client struct {
+	id     string
+	conn   net.Conn
+	mutex  sync.Mutex
+	topics []string
+}
+
+var clients = make(map[*client]bool)
+var clientsMutex sync.Mutex
+
+func readPacket(r *bufio.Reader) (byte, []byte, error) {
+	header, err := r.ReadByte()
+	if err != nil {
+		return 0, nil, err
+	}
+	length := 0
+	for shift := uint(0); ; shift += 7 {
+		if shift > 21 {
+			return 0, nil, errors.New("malformed remaining length")
+		}
+		b, err := r.ReadByte()
+		if err != nil {
+			return 0, nil, err
+		}
+		length |= int(b&0x7f) << shift
+		if b&0x80 == 0 {
+			break
+		}
+	}
+	body := make([]byte, length)
+	_, err = io.ReadFull(r, body)
+	return header, body, err
+}
+
+func (c *client) write(header byte, body []byte) error {
+	packet := []byte{header}
+	length := len(body)
+	for {
+		b := byte(length & 0x7f)
+		length >>= 7
+		if length > 0 {
+			b |= 0x80
+		}
+		packet = append(packet, b)
+		if length == 0 {
+			break
+		}
+	}
+	packet = append(packet, body...)
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	_, err := c.conn.Write(packet)
+	return err
+}
+
+func readString(body []byte) (string, []byte) {
+	if len(body) < 2 {
+		return "", nil
+	}
+	l := int(binary.BigEndian.Uint16(body))
+	if len(body) < 2+l {
+		return "", nil
+	}
+	return string(body[2 : 2+l]), body[2+l:]
+}
+
+func appendString(b []byte, s string) []byte {
+	b = append(b, byte(len(s)>>8), byte(len(s)))
+	return append(b, s...)
+}
+
+func (c *client) publish(topic string, payload string) error {
+	return c.write(0x30, append(appendString(nil, topic), payload...))
+}
+
+func serve(conn net.Conn) {
+	c := &client{conn: conn}
+	defer func() {
+		clientsMutex.Lock()
+		delete(clients, c)
+		clientsMutex.Unlock()
+		conn.Close()
+		log.Println(c.id, "disconnected")
+	}()
+
+	r := bufio.NewReader(conn)
+	for {
+		header, body, err := readPacket(r)
+		if err != nil {
+			return
+		}
+		switch header >> 4 {
+		case 1: // CONNECT
+			_, rest := readString(body) // protocol name
+			if len(rest) < 4 {
+				return
+			}
+			c.id, _ = readString(rest[4:])
+			log.Println(c.id, "connected from", conn.RemoteAddr())
+			c.write(0x20, []byte{0, 0})
+			clientsMutex.Lock()
+			clients[c] = true
+			clientsMutex.Unlock()
+		case 3: // PUBLISH
+			qos := (header >> 1) & 3
+			topic, rest := readString(body)
+			if qos > 0 && len(rest) >= 2 {
+				c.write(0x40, rest[:2])
+				rest = rest[2:]
+			}
+			log.Printf("%s published %d bytes to %s", c.id, len(rest), topic)
+		case 8: // SUBSCRIBE
+			if len(body) < 2 {
+				return
+			}
+			ack := []byte{body[0], body[1]}
+			rest := body[2:]
+			for len(rest) > 2 {
+				var topic string
+				topic, rest = readString(rest)
+				if len(rest) < 1 {
+					break
+				}
+				rest = rest[1:]
+				c.mutex.Lock()
+				c.topics = append(c.topics, topic)
+				c.mutex.Unlock()
+				ack = append(ack, 0)
+				log.Println(c.id, "subscribed to", topic)
+			}
+			c.write(0x90, ack)
+		case 12: // PINGREQ
+			c.write(0xd0, nil)
+		case 14: // DISCONNECT
+			return
+		}
+	}
+}
+
+func dispatch(line string) {
+	target := ""
+	if strings.HasPrefix(line, "@") {
+		parts := strings.SplitN(line[1:], " ", 2)
+		if len(parts) < 2 {
+			return
+		}
+		target, line = parts[0], parts[1]
+	}
+	clientsMutex.Lock()
+	defer clientsMutex.Unlock()
+	for c := range clients {
+		if target != "" && c.id != target {
+			continue
+		}
+		c.mutex.Lock()
+		topics := append([]string(nil), c.topics...)
+		c.mutex.Unlock()
+		for _, topic := range topics {
+			if strings.HasPrefix(topic, commandTopic) {
+				if err := c.publish(topic, line); err != nil {
+					log.Println(c.id, err)
+				} else {
+					log.Println("sent", len(line), "bytes to", topic)
+				}
+			}
+		}
+	}
+}
+
+func main() {
+
+	if len(os.Args) < 2 {
+		log.Println("Please specify commandline option: tcp | tls")
+		return
+	}
+
+	var listener net.Listener
+	var err error
+	if os.Args[1] == "tls" {
+		var cert tls.Certificate
+		cert, err = tls.LoadX509KeyPair("../firmwareserver/server.crt", "../firmwareserver/server.key")
+		if err != nil {
+			log.Fatal(err)
+		}
+		listener, err = tls.Listen("tcp", ":8883", &tls.Config{Certificates: []tls.Certificate{cert}})
+		log.Println("broker runs at: mqtts://localhost:8883")
+	} else {
+		listener, err = net.Listen("tcp", ":1883")
+		log.Println("broker runs at: mqtt://localhost:1883")
+	}
+	if err != nil {
+		log.Fatal(err)
+	}
+
+	go func() {
+		for {
+			conn, err := listener.Accept()
+			if err != nil {
+				log.Fatal(err)
+			}
+			go serve(conn)
+		}
+	}()
+
+	scanner := bufio.NewScanner(os.Stdin)
+	for scanner.Scan() {
+		if line := strings.TrimSpace(scanner.Text()); line != "" {
+			dispatch(line)
+		}
+	}
+}
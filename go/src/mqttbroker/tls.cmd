@@ -0,0 +1,2 @@
+SET GOPATH=%userprofile%\Documents\GitHub\ufo-esp32\go
+go run mqttbroker.go tls
@@ -0,0 +1,157 @@
+package ufocommand
+
+/*  Encoder for the binary display commands of the UFO (see main/DisplayCommand.h of the firmware).
+	A packet is applied completely or - if any instruction is invalid - not at all. Send it as body of
+	POST /api (Content-Type application/octet-stream) or publish it to /dynatraceufo/command/<ufo id>.
+*/
+
+import (
+	"errors"
+)
+
+const (
+	magic   = 0xDC
+	version = 1
+
+	opInit       = 0x01
+	opLeds       = 0x02
+	opBackground = 0x03
+	opWhirl      = 0x04
+	opMorph      = 0x05
+	opLogo       = 0x06
+	opLogoReset  = 0x07
+	opFrame      = 0x08
+
+	// RingLeds is the number of LEDs of a ring
+	RingLeds = 15
+	// LogoLeds is the number of LEDs of the logo
+	LogoLeds = 4
+	// MaxPacket is the largest packet accepted via HTTP, MQTT commands are limited to 512 bytes
+	MaxPacket = 1024
+)
+
+// Ring selects one of the two LED rings
+type Ring byte
+
+const (
+	Top    Ring = 0
+	Bottom Ring = 1
+)
+
+// Packet collects instructions, the zero value is not usable - use NewPacket
+type Packet struct {
+	data []byte
+}
+
+// NewPacket returns an empty packet
+func NewPacket() *Packet {
+	return &Packet{data: []byte{magic, version}}
+}
+
+func rgb(color uint32) (byte, byte, byte) {
+	return byte(color >> 16), byte(color >> 8), byte(color)
+}
+
+// Reset drops all instructions and keeps the buffer
+func (p *Packet) Reset() {
+	p.data = p.data[:2]
+}
+
+// Init turns all LEDs of the ring off and stops its animations
+func (p *Packet) Init(ring Ring) *Packet {
+	p.data = append(p.data, opInit, byte(ring))
+	return p
+}
+
+// Leds sets count LEDs starting at pos to color (0xRRGGBB)
+func (p *Packet) Leds(ring Ring, pos, count byte, color uint32) *Packet {
+	r, g, b := rgb(color)
+	p.data = append(p.data, opLeds, byte(ring), pos, count, r, g, b)
+	return p
+}
+
+// Background sets the color of the LEDs that are not set
+func (p *Packet) Background(ring Ring, color uint32) *Packet {
+	r, g, b := rgb(color)
+	p.data = append(p.data, opBackground, byte(ring), r, g, b)
+	return p
+}
+
+// Whirl rotates the ring, speed 0 stops it
+func (p *Packet) Whirl(ring Ring, speed byte, clockwise bool) *Packet {
+	var cw byte
+	if clockwise {
+		cw = 1
+	}
+	p.data = append(p.data, opWhirl, byte(ring), speed, cw)
+	return p
+}
+
+// Morph fades from the LED colors to the background and back, speed is 1..10
+func (p *Packet) Morph(ring Ring, period uint16, speed byte) *Packet {
+	p.data = append(p.data, opMorph, byte(ring), byte(period), byte(period>>8), speed)
+	return p
+}
+
+// Logo sets one of the four logo LEDs
+func (p *Packet) Logo(led byte, color uint32) *Packet {
+	r, g, b := rgb(color)
+	p.data = append(p.data, opLogo, led, r, g, b)
+	return p
+}
+
+// LogoReset restores the Dynatrace colors of the logo
+func (p *Packet) LogoReset() *Packet {
+	p.data = append(p.data, opLogoReset)
+	return p
+}
+
+// Frame sets all LEDs of the ring at once
+func (p *Packet) Frame(ring Ring, colors *[RingLeds]uint32) *Packet {
+	p.data = append(p.data, opFrame, byte(ring))
+	for _, color := range colors {
+		r, g, b := rgb(color)
+		p.data = append(p.data, r, g, b)
+	}
+	return p
+}
+
+// Bytes returns the encoded packet, it is valid until the next change of the packet
+func (p *Packet) Bytes() ([]byte, error) {
+	if len(p.data) > MaxPacket {
+		return nil, errors.New("packet exceeds the maximum size")
+	}
+	for i := 2; i < len(p.data); {
+		switch p.data[i] {
+		case opLogo:
+			if p.data[i+1] >= LogoLeds {
+				return nil, errors.New("logo LED out of range")
+			}
+		case opLogoReset:
+		default:
+			if Ring(p.data[i+1]) > Bottom {
+				return nil, errors.New("invalid ring")
+			}
+		}
+		i += instructionLength(p.data[i])
+	}
+	return p.data, nil
+}
+
+func instructionLength(op byte) int {
+	switch op {
+	case opInit:
+		return 2
+	case opLeds:
+		return 7
+	case opBackground, opMorph, opLogo:
+		return 5
+	case opWhirl:
+		return 4
+	case opLogoReset:
+		return 1
+	case opFrame:
+		return 2 + 3*RingLeds
+	}
+	return 0
+}
@@ -0,0 +1,131 @@
+package ufocommand
+
+/*  The packets of the encoder are kept in test/host/ufocommand_packets.txt, next to the /api call that shows
+	the same on the UFO. The host test test_DisplayCommand of the firmware validates and executes every packet
+	and compares the display with the compiled /api call:
+		GOPATH=<repo>/go GO111MODULE=off go test ufocommand [-update]
+*/
+
+import (
+	"bufio"
+	"encoding/hex"
+	"flag"
+	"fmt"
+	"os"
+	"strings"
+	"testing"
+)
+
+const packetFile = "../../../test/host/ufocommand_packets.txt"
+
+var update = flag.Bool("update", false, "rewrite "+packetFile)
+
+type packetCase struct {
+	api    string
+	encode func(p *Packet)
+}
+
+func rainbow() *[RingLeds]uint32 {
+	var colors [RingLeds]uint32
+	for i := range colors {
+		colors[i] = uint32(i*17)<<16 | uint32(255-i*17)<<8 | uint32(i*3)
+	}
+	return &colors
+}
+
+func frameApi(ring string, colors *[RingLeds]uint32) string {
+	var leds []string
+	for i, color := range colors {
+		leds = append(leds, fmt.Sprintf("%d|1|%06x", i, color))
+	}
+	return ring + "=" + strings.Join(leds, "|")
+}
+
+var cases = []packetCase{
+	{"/api?top_init&top=0|15|ff0000&top_morph=80|8&bottom_init&bottom=0|15|ff0000&bottom_morph=80|8&logo=ff0000|ff0000|ff0000|ff0000",
+		func(p *Packet) {
+			p.Init(Top).Leds(Top, 0, 15, 0xff0000).Morph(Top, 80, 8)
+			p.Init(Bottom).Leds(Bottom, 0, 15, 0xff0000).Morph(Bottom, 80, 8)
+			for led := byte(0); led < LogoLeds; led++ {
+				p.Logo(led, 0xff0000)
+			}
+		}},
+	{"/api?top_init&top=0|1|ff0000&top_bg=00ff00&top_whirl=240|ccw&bottom_init&bottom=0|1|00ff00&bottom_bg=ff0000&bottom_whirl=190",
+		func(p *Packet) {
+			p.Init(Top).Leds(Top, 0, 1, 0xff0000).Background(Top, 0x00ff00).Whirl(Top, 240, false)
+			p.Init(Bottom).Leds(Bottom, 0, 1, 0x00ff00).Background(Bottom, 0xff0000).Whirl(Bottom, 190, true)
+		}},
+	{"/api?top_morph=1000|5&bottom_morph=65535|10&logo_reset",
+		func(p *Packet) {
+			p.Morph(Top, 1000, 5).Morph(Bottom, 65535, 10).LogoReset()
+		}},
+	{"/api?top_init&" + frameApi("top", rainbow()) + "&bottom_init&" + frameApi("bottom", rainbow()),
+		func(p *Packet) {
+			p.Init(Top).Frame(Top, rainbow()).Init(Bottom).Frame(Bottom, rainbow())
+		}},
+	{"/api?",
+		func(p *Packet) {}},
+}
+
+func encode(t *testing.T) []string {
+	var lines []string
+	p := NewPacket()
+	for _, c := range cases {
+		p.Reset()
+		c.encode(p)
+		data, err := p.Bytes()
+		if err != nil {
+			t.Fatalf("%s: %v", c.api, err)
+		}
+		lines = append(lines, c.api+"\t"+hex.EncodeToString(data))
+	}
+	return lines
+}
+
+func TestPacketsMatchTheFirmwareTestVectors(t *testing.T) {
+	lines := encode(t)
+	if *update {
+		content := "# written by go/src/ufocommand/ufocommand_test.go -update, checked by test_DisplayCommand\n" + strings.Join(lines, "\n") + "\n"
+		if err := os.WriteFile(packetFile, []byte(content), 0644); err != nil {
+			t.Fatal(err)
+		}
+		return
+	}
+	f, err := os.Open(packetFile)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer f.Close()
+	var stored []string
+	scanner := bufio.NewScanner(f)
+	scanner.Buffer(nil, 64*1024)
+	for scanner.Scan() {
+		if line := scanner.Text(); line != "" && !strings.HasPrefix(line, "#") {
+			stored = append(stored, line)
+		}
+	}
+	if len(stored) != len(lines) {
+		t.Fatalf("%d packets stored, %d encoded - run with -update", len(stored), len(lines))
+	}
+	for i := range lines {
+		if stored[i] != lines[i] {
+			t.Errorf("packet %d differs:\nstored  %s\nencoded %s", i, stored[i], lines[i])
+		}
+	}
+}
+
+func TestInvalidInstructionsAreRefused(t *testing.T) {
+	if _, err := NewPacket().Init(Ring(2)).Bytes(); err == nil {
+		t.Error("ring 2 accepted")
+	}
+	if _, err := NewPacket().Logo(LogoLeds, 0xffffff).Bytes(); err == nil {
+		t.Error("logo LED 4 accepted")
+	}
+	p := NewPacket()
+	for i := 0; i < MaxPacket/7+1; i++ {
+		p.Leds(Top, 0, 1, 0)
+	}
+	if _, err := p.Bytes(); err == nil {
+		t.Error("oversized packet accepted")
+	}
+}
@@ -0,0 +1,150 @@
+package ufodiff
+
+/*  Delta updates for the UFO firmware (see main/FirmwarePatch.h of the firmware).
+	A patch rebuilds the new image from pieces of the old image (copy) and new bytes (insert). It only
+	applies to the exact old image, the header carries the length and SHA256 of both images.
+*/
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/binary"
+	"errors"
+	"index/suffixarray"
+)
+
+const (
+	// Magic starts every patch
+	Magic = "UFODIFF1"
+	// HeaderLength covers magic, old length, old SHA256, new length and new SHA256
+	HeaderLength = len(Magic) + 4 + sha256.Size + 4 + sha256.Size
+
+	opCopy   = 0x01
+	opInsert = 0x02
+
+	// a copy takes 9 bytes, shorter matches are inserted
+	minMatch = 16
+	// occurrences of a prefix compared per position
+	maxCandidates = 16
+)
+
+func appendU32(data []byte, value uint32) []byte {
+	return append(data, byte(value), byte(value>>8), byte(value>>16), byte(value>>24))
+}
+
+func appendInsert(patch []byte, data []byte) []byte {
+	if len(data) == 0 {
+		return patch
+	}
+	patch = append(patch, opInsert)
+	patch = appendU32(patch, uint32(len(data)))
+	return append(patch, data...)
+}
+
+func matchLength(a, b []byte) int {
+	i := 0
+	for i < len(a) && i < len(b) && a[i] == b[i] {
+		i++
+	}
+	return i
+}
+
+// Diff returns the patch that turns oldImage into newImage
+func Diff(oldImage, newImage []byte) []byte {
+	oldSum := sha256.Sum256(oldImage)
+	newSum := sha256.Sum256(newImage)
+	patch := make([]byte, 0, HeaderLength+len(newImage)/4)
+	patch = append(patch, Magic...)
+	patch = appendU32(patch, uint32(len(oldImage)))
+	patch = append(patch, oldSum[:]...)
+	patch = appendU32(patch, uint32(len(newImage)))
+	patch = append(patch, newSum[:]...)
+
+	index := suffixarray.New(oldImage)
+	literal := 0 // start of the new bytes not covered by a copy yet
+	next := 0    // old offset behind the last copy
+	for i := 0; i < len(newImage); {
+		offset, length := 0, 0
+		// code that just got a few bytes changed (e.g. an address) continues where the last copy ended
+		if aligned := next + (i - literal); aligned < len(oldImage) {
+			if l := matchLength(oldImage[aligned:], newImage[i:]); l >= minMatch {
+				offset, length = aligned, l
+			}
+		}
+		if length == 0 && i+minMatch <= len(newImage) {
+			for _, candidate := range index.Lookup(newImage[i:i+minMatch], maxCandidates) {
+				if l := matchLength(oldImage[candidate:], newImage[i:]); l > length {
+					offset, length = candidate, l
+				}
+			}
+		}
+		if length < minMatch {
+			i++
+			continue
+		}
+		patch = appendInsert(patch, newImage[literal:i])
+		patch = append(patch, opCopy)
+		patch = appendU32(patch, uint32(offset))
+		patch = appendU32(patch, uint32(length))
+		i += length
+		literal = i
+		next = offset + length
+	}
+	return appendInsert(patch, newImage[literal:])
+}
+
+// Apply rebuilds the new image the way the UFO does and verifies its hash
+func Apply(oldImage, patch []byte) ([]byte, error) {
+	if len(patch) < HeaderLength || string(patch[:len(Magic)]) != Magic {
+		return nil, errors.New("no patch")
+	}
+	pos := len(Magic)
+	oldSum := sha256.Sum256(oldImage)
+	if binary.LittleEndian.Uint32(patch[pos:]) != uint32(len(oldImage)) || !bytes.Equal(patch[pos+4:pos+4+sha256.Size], oldSum[:]) {
+		return nil, errors.New("patch is made for another image")
+	}
+	pos += 4 + sha256.Size
+	newLength := int(binary.LittleEndian.Uint32(patch[pos:]))
+	newSum := patch[pos+4 : pos+4+sha256.Size]
+	pos += 4 + sha256.Size
+
+	newImage := make([]byte, 0, newLength)
+	for pos < len(patch) {
+		op := patch[pos]
+		pos++
+		switch op {
+		case opCopy:
+			if pos+8 > len(patch) {
+				return nil, errors.New("patch incomplete")
+			}
+			offset := int(binary.LittleEndian.Uint32(patch[pos:]))
+			length := int(binary.LittleEndian.Uint32(patch[pos+4:]))
+			pos += 8
+			if offset > len(oldImage) || length > len(oldImage)-offset {
+				return nil, errors.New("copy exceeds the old image")
+			}
+			newImage = append(newImage, oldImage[offset:offset+length]...)
+		case opInsert:
+			if pos+4 > len(patch) {
+				return nil, errors.New("patch incomplete")
+			}
+			length := int(binary.LittleEndian.Uint32(patch[pos:]))
+			pos += 4
+			if length > len(patch)-pos {
+				return nil, errors.New("patch incomplete")
+			}
+			newImage = append(newImage, patch[pos:pos+length]...)
+			pos += length
+		default:
+			return nil, errors.New("invalid instruction")
+		}
+		if len(newImage) > newLength {
+			return nil, errors.New("patch exceeds the new image")
+		}
+	}
+	sum := sha256.Sum256(newImage)
+	if len(newImage) != newLength || !bytes.Equal(sum[:], newSum) {
+		return nil, errors.New("hash of the new image does not match")
+	}
+	return newImage, nil
+}
@@ -0,0 +1,199 @@
+package ufoz
+
+/*  Compressed firmware images for the UFO (see main/FirmwareDecompressor.h of the firmware).
+	LZSS with a 4kB window, so the UFO decompresses while it receives without buffering the image.
+	A flag byte announces the next eight tokens (LSB first): a set bit is a literal byte, a cleared bit
+	a match of two bytes - little endian, distance - 1 in the upper 12 bits, length - 3 in the lower 4 bits.
+*/
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/binary"
+	"errors"
+)
+
+const (
+	// Magic starts every compressed image
+	Magic = "UFOZ"
+	// HeaderLength covers magic, version, window bits, length bits, reserved, length and SHA256
+	HeaderLength = len(Magic) + 4 + 4 + sha256.Size
+
+	version    = 1
+	windowBits = 12
+	lengthBits = 4
+	windowSize = 1 << windowBits
+	minMatch   = 3
+	maxMatch   = minMatch + (1 << lengthBits) - 1
+
+	hashSize = 1 << 14
+	// positions of the hash chain compared per byte
+	maxChain = 256
+)
+
+func hash3(data []byte) int {
+	return int((uint32(data[0])<<10 ^ uint32(data[1])<<5 ^ uint32(data[2])) & (hashSize - 1))
+}
+
+// Compress returns the compressed image
+func Compress(data []byte) []byte {
+	sum := sha256.Sum256(data)
+	out := make([]byte, 0, HeaderLength+len(data)*9/8+1)
+	out = append(out, Magic...)
+	out = append(out, version, windowBits, lengthBits, 0)
+	out = append(out, byte(len(data)), byte(len(data)>>8), byte(len(data)>>16), byte(len(data)>>24))
+	out = append(out, sum[:]...)
+
+	head := make([]int, hashSize)
+	for i := range head {
+		head[i] = -1
+	}
+	prev := make([]int, len(data))
+	insert := func(pos int) {
+		if pos+minMatch <= len(data) {
+			h := hash3(data[pos:])
+			prev[pos] = head[h]
+			head[h] = pos
+		}
+	}
+
+	flagPos, flagBit := 0, uint(8)
+	for i := 0; i < len(data); {
+		if flagBit == 8 {
+			flagPos = len(out)
+			out = append(out, 0)
+			flagBit = 0
+		}
+		distance, length := 0, 0
+		if i+minMatch <= len(data) {
+			limit := len(data) - i
+			if limit > maxMatch {
+				limit = maxMatch
+			}
+			for candidate, n := head[hash3(data[i:])], 0; candidate >= 0 && i-candidate <= windowSize && n < maxChain; candidate, n = prev[candidate], n+1 {
+				l := 0
+				for l < limit && data[candidate+l] == data[i+l] {
+					l++
+				}
+				if l > length {
+					distance, length = i-candidate, l
+					if l == limit {
+						break
+					}
+				}
+			}
+		}
+		if length >= minMatch {
+			token := uint16(distance-1)<<lengthBits | uint16(length-minMatch)
+			out = append(out, byte(token), byte(token>>8))
+			for end := i + length; i < end; i++ {
+				insert(i)
+			}
+		} else {
+			out[flagPos] |= 1 << flagBit
+			out = append(out, data[i])
+			insert(i)
+			i++
+		}
+		flagBit++
+	}
+	return out
+}
+
+// IsCompressed checks for the magic
+func IsCompressed(data []byte) bool {
+	return bytes.HasPrefix(data, []byte(Magic))
+}
+
+// Decoder decompresses in chunks of any size, the way the UFO does
+type Decoder struct {
+	header    []byte
+	length    int
+	sum       []byte
+	out       []byte
+	flags     byte
+	flagsLeft int
+	matchLow  int // first byte of a match token, -1 if none pending
+}
+
+// NewDecoder returns a Decoder for one compressed image
+func NewDecoder() *Decoder {
+	return &Decoder{matchLow: -1}
+}
+
+// Write takes the next chunk of the compressed image
+func (d *Decoder) Write(chunk []byte) (int, error) {
+	n := len(chunk)
+	if len(d.header) < HeaderLength {
+		missing := HeaderLength - len(d.header)
+		if missing > len(chunk) {
+			missing = len(chunk)
+		}
+		d.header = append(d.header, chunk[:missing]...)
+		chunk = chunk[missing:]
+		if len(d.header) < HeaderLength {
+			return n, nil
+		}
+		if !IsCompressed(d.header) {
+			return 0, errors.New("not compressed")
+		}
+		if d.header[4] != version || d.header[5] != windowBits || d.header[6] != lengthBits {
+			return 0, errors.New("unsupported compression")
+		}
+		d.length = int(binary.LittleEndian.Uint32(d.header[8:]))
+		d.sum = d.header[12:HeaderLength]
+		d.out = make([]byte, 0, d.length)
+	}
+	for _, b := range chunk {
+		switch {
+		case d.matchLow >= 0:
+			token := d.matchLow | int(b)<<8
+			d.matchLow = -1
+			distance := token>>lengthBits + 1
+			length := token&(1<<lengthBits-1) + minMatch
+			if distance > len(d.out) {
+				return 0, errors.New("match before the start")
+			}
+			for ; length > 0; length-- {
+				d.out = append(d.out, d.out[len(d.out)-distance])
+			}
+		case d.flagsLeft == 0:
+			d.flags = b
+			d.flagsLeft = 8
+			continue
+		case d.flags&1 != 0:
+			d.out = append(d.out, b)
+			d.flags >>= 1
+			d.flagsLeft--
+		default:
+			d.matchLow = int(b)
+			d.flags >>= 1
+			d.flagsLeft--
+		}
+		if len(d.out) > d.length {
+			return 0, errors.New("data exceeds the length")
+		}
+	}
+	return n, nil
+}
+
+// Close verifies length and hash and returns the decompressed image
+func (d *Decoder) Close() ([]byte, error) {
+	if len(d.header) < HeaderLength || d.matchLow >= 0 || len(d.out) != d.length {
+		return nil, errors.New("compressed data incomplete")
+	}
+	sum := sha256.Sum256(d.out)
+	if !bytes.Equal(sum[:], d.sum) {
+		return nil, errors.New("hash of the decompressed data does not match")
+	}
+	return d.out, nil
+}
+
+// Decompress returns the image of compressed data
+func Decompress(data []byte) ([]byte, error) {
+	d := NewDecoder()
+	if _, err := d.Write(data); err != nil {
+		return nil, err
+	}
+	return d.Close()
+}
@@ -0,0 +1,71 @@
+package main
+
+/*  Stand-in for the Dynatrace problem notification (custom integration) - meant for testing purposes only.
+	Opens a problem on the UFO, waits and resolves it again, also checks that a wrong token gets rejected.
+	This is a manual check against a real UFO (watch the rings), the request parsing itself is covered
+	by the host tests in test/host.
+*/
+
+import (
+	"bytes"
+	"fmt"
+	"log"
+	"net/http"
+	"os"
+	"time"
+)
+
+func notify(ufo string, token string, pid string, state string, impact string, severity string) int {
+	payload := fmt.Sprintf("{\"PID\":\"%s\",\"ProblemID\":\"%s\",\"State\":\"%s\",\"ProblemImpact\":\"%s\",\"ProblemSeverity\":\"%s\"}",
+		pid, pid, state, impact, severity)
+	url := fmt.Sprintf("http://%s/dynatracewebhook", ufo)
+	req, err := http.NewRequest("POST", url, bytes.NewBufferString(payload))
+	if err != nil {
+		log.Fatal(err)
+	}
+	req.Header.Set("Content-Type", "application/json")
+	req.Header.Set("Authorization", "Bearer "+token)
+	resp, err := http.DefaultClient.Do(req)
+	if err != nil {
+		log.Fatal(err)
+	}
+	resp.Body.Close()
+	log.Println(state, pid, "->", resp.StatusCode)
+	return resp.StatusCode
+}
+
+func main() {
+
+	if len(os.Args) < 3 {
+		log.Println("Please specify commandline options: <ufo address> <webhook token>")
+		return
+	}
+	ufo := os.Args[1]
+	token := os.Args[2]
+
+	failed := false
+	if notify(ufo, token+"x", "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") != http.StatusUnauthorized {
+		log.Println("FAILED: wrong token was accepted")
+		failed = true
+	}
+	if notify(ufo, token, "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") != http.StatusOK {
+		failed = true
+	}
+	if notify(ufo, token, "-1000_2", "OPEN", "INFRASTRUCTURE", "RESOURCE_CONTENTION") != http.StatusOK {
+		failed = true
+	}
+	time.Sleep(5 * time.Second)
+	if notify(ufo, token, "-1000_1", "RESOLVED", "APPLICATION", "AVAILABILITY") != http.StatusOK {
+		failed = true
+	}
+	time.Sleep(5 * time.Second)
+	if notify(ufo, token, "-1000_2", "RESOLVED", "INFRASTRUCTURE", "RESOURCE_CONTENTION") != http.StatusOK {
+		failed = true
+	}
+
+	if failed {
+		log.Println("FAILED")
+		os.Exit(1)
+	}
+	log.Println("OK")
+}
@@ -9,9 +9,26 @@
 #include <esp_log.h>
 #include <cJSON.h>
 #include "AWSIntegration.h"
+#include "DynamicRequestHandler.h"
+#include "DisplayCommand.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_UFO_MQTT_HOST
+#define UFO_MQTT_HOST CONFIG_UFO_MQTT_HOST
+#define UFO_MQTT_PORT CONFIG_UFO_MQTT_PORT
+#else
+#define UFO_MQTT_HOST "a3l8rpjg868svp.iot.us-east-1.amazonaws.com"
+#define UFO_MQTT_PORT AWS_IOT_MQTT_PORT
+#endif
+#ifdef CONFIG_UFO_MQTT_VERIFY_SERVER
+#define UFO_MQTT_VERIFY_SERVER true
+#else
+#define UFO_MQTT_VERIFY_SERVER false
+#endif
 
-#define AWS_IOT_MQTT_HOST              "a3l8rpjg868svp.iot.us-east-1.amazonaws.com"
 #define AWS_IOT_MQTT_TX_BUF_LEN 4096
+#define AWS_RECONNECT_YIELDS 20	// while reconnecting, Publish gives up after that many yields (100ms each, with 100ms pauses without the lock)
+#define AWS_COMMAND_YIELD_MS 200	// how long the command loop waits for incoming messages per round
 
 
 static const char* LOGTAG = "AWS";
@@ -25,10 +42,9 @@ void task_function_aws(void *pvParameter)
 
 void iot_subscribe_callback_handler(AWS_IoT_Client *pClient, char *topicName, uint16_t topicNameLen,
 									IoT_Publish_Message_Params *params, void *pData) {
-	IOT_UNUSED(pData);
 	IOT_UNUSED(pClient);
-	ESP_LOGI(LOGTAG, "Message received");
-	ESP_LOGD(LOGTAG, "%s: %s", topicName, (char*)params->payload);
+	ESP_LOGD(LOGTAG, "%.*s: %u bytes", topicNameLen, topicName, params->payloadLen);
+	((AWSIntegration*)pData)->HandleCommand((const char*)params->payload, params->payloadLen);
 }
 
 void disconnectCallbackHandler(AWS_IoT_Client *pClient, void *data) {
@@ -56,6 +72,7 @@ void disconnectCallbackHandler(AWS_IoT_Client *pClient, void *data) {
 
 AWSIntegration::AWSIntegration() {
 	ESP_LOGI(LOGTAG, "Start");
+	mhClientLock = xSemaphoreCreateMutex();
 }
 
 AWSIntegration::~AWSIntegration() {
@@ -93,18 +110,23 @@ bool AWSIntegration::Connect() {
     while (!mConnected) {
         if (mpUfo->GetWifi().IsConnected()) {
 			ESP_LOGI(LOGTAG, "Init");
-			char HostAddress[255] = AWS_IOT_MQTT_HOST;	
+			// the client keeps the pointer for reconnecting, so the host is stored in a member
+			memset(mHostAddress, 0, sizeof(mHostAddress));
+			if (mpConfig->msMqttHost.length())
+				strncpy(mHostAddress, mpConfig->msMqttHost.c_str(), sizeof(mHostAddress) - 1);
+			else
+				strncpy(mHostAddress, UFO_MQTT_HOST, sizeof(mHostAddress) - 1);
 			mqttInitParams = iotClientInitParamsDefault;
 
 			mqttInitParams.enableAutoReconnect = false; // We enable this later below
-			mqttInitParams.pHostURL = HostAddress;
-			mqttInitParams.port = AWS_IOT_MQTT_PORT;
+			mqttInitParams.pHostURL = mHostAddress;
+			mqttInitParams.port = mpConfig->muMqttPort ? mpConfig->muMqttPort : UFO_MQTT_PORT;
 			mqttInitParams.pRootCALocation = rootCA;
 			mqttInitParams.pDeviceCertLocation = deviceCert;
 			mqttInitParams.pDevicePrivateKeyLocation = devicePrivateKey;
 			mqttInitParams.mqttCommandTimeout_ms = 20000;
 			mqttInitParams.tlsHandshakeTimeout_ms = 5000;
-			mqttInitParams.isSSLHostnameVerify = true;
+			mqttInitParams.isSSLHostnameVerify = UFO_MQTT_VERIFY_SERVER;
 			mqttInitParams.disconnectHandler = disconnectCallbackHandler;
 			mqttInitParams.disconnectHandlerData = NULL;
 
@@ -127,7 +149,10 @@ bool AWSIntegration::Connect() {
 	connectParams.clientIDLen = mpUfo->GetId().length();
 	connectParams.isWillMsgPresent = false;
 
-	ESP_LOGI(LOGTAG, "Connecting to %s", AWS_IOT_MQTT_HOST);
+	msCommandTopic = "/dynatraceufo/command/";
+	msCommandTopic += mpUfo->GetId();
+
+	ESP_LOGI(LOGTAG, "Connecting to %s:%u", mHostAddress, mqttInitParams.port);
     IoT_Error_t rc = aws_iot_mqtt_connect(&client, &connectParams);
     if (rc) {
         ESP_LOGE(LOGTAG, "AWS Connect Error: %i", rc);
@@ -146,47 +171,59 @@ bool AWSIntegration::Run() {
 		ESP_LOGE(LOGTAG, "Unable to set Auto Reconnect to true - %d", rc);
 		return false;
 	}
-/*
-	String topic("/dynatraceufo/");
-	topic.printf("%s", AWS_IOT_MQTT_CLIENT_ID);
-	ESP_LOGI(LOGTAG, "Subscribing to %s", topic.c_str());
-	rc = aws_iot_mqtt_subscribe(&client, topic.c_str(), topic.length(), QOS1, iot_subscribe_callback_handler, NULL);
+
+	// the topic string has to stay alive, the client keeps a pointer to it for resubscribing after a reconnect
+	ESP_LOGI(LOGTAG, "Subscribing to %s", msCommandTopic.c_str());
+	rc = aws_iot_mqtt_subscribe(&client, msCommandTopic.c_str(), msCommandTopic.length(), QOS1, iot_subscribe_callback_handler, this);
 	if(SUCCESS != rc) {
 		ESP_LOGE(LOGTAG, "Error subscribing : %d ", rc);
 		return false;
 	}
 	ESP_LOGI(LOGTAG, "subscription successful");
-*/
+
+	// commands are dispatched to iot_subscribe_callback_handler from within the yield
 	mActive = true;
 	while (mActive) {
-//		String payload("message from ");
-//		payload.printf("%s", mpUfo->GetId().c_str());
-//		Publish("/dynatraceufo/ufohub", 20, &payload);
-		vTaskDelay(10000 / portTICK_PERIOD_MS);
+		xSemaphoreTake(mhClientLock, portMAX_DELAY);
+		rc = aws_iot_mqtt_yield(&client, AWS_COMMAND_YIELD_MS);
+		xSemaphoreGive(mhClientLock);
+		if (NETWORK_ATTEMPTING_RECONNECT == rc)
+			vTaskDelay(100 / portTICK_PERIOD_MS);
+		else
+			vTaskDelay(1); // lets a waiting Publish take the client
 	}
 	
 	return mActive;
 }
 
-bool AWSIntegration::Publish(const char* pTopic, short pTopicLength, String* pPayload) {
+bool AWSIntegration::Publish(const char* pTopic, short pTopicLength, const char* pPayload, size_t uPayloadLength) {
 
 	IoT_Publish_Message_Params params;
 	IoT_Error_t rc = FAILURE;
 	
 	params.qos = QOS0;
-	params.payload = (void *) pPayload->c_str();
-	params.payloadLen = pPayload->length();
+	params.payload = (void *) pPayload;
+	params.payloadLen = uPayloadLength;
 	params.isRetained = 0;
 
-	//Max time the yield function will wait for read messages
-	rc = aws_iot_mqtt_yield(&client, 100);
-	while (NETWORK_ATTEMPTING_RECONNECT == rc) {
+	// the command loop yields on the same client, the SDK doesn't allow concurrent reads
+	// while reconnecting, the lock is released between the yields, so the command loop is not starved
+	for (__uint8_t u=0 ; ; u++) {
+		xSemaphoreTake(mhClientLock, portMAX_DELAY);
+		//Max time the yield function will wait for read messages
 		rc = aws_iot_mqtt_yield(&client, 100);
+		if (NETWORK_ATTEMPTING_RECONNECT != rc)
+			break;
+		xSemaphoreGive(mhClientLock);
+		if (u >= AWS_RECONNECT_YIELDS) {
+			ESP_LOGW(LOGTAG, "still reconnecting, %s not published", pTopic);
+			return false;
+		}
+		vTaskDelay(100 / portTICK_PERIOD_MS);
 	}
 
-	params.payloadLen = pPayload->length();
-
 	rc = aws_iot_mqtt_publish(&client, pTopic, pTopicLength, &params);
+	xSemaphoreGive(mhClientLock);
 
 	if (rc == MQTT_REQUEST_TIMEOUT_ERROR) {
 		ESP_LOGW(LOGTAG, "QOS1 publish ack not received.");
@@ -196,11 +233,42 @@ bool AWSIntegration::Publish(const char* pTopic, short pTopicLength, String* pPa
 	if(SUCCESS != rc) {
 		ESP_LOGE(LOGTAG, "An error occurred in Publish: %i", rc);
 	} else {
-		ESP_LOGI(LOGTAG, "successfully published to %s", pTopic);
+		muPublished++;
+		muBytesCopied += pTopicLength + uPayloadLength;
+		ESP_LOGI(LOGTAG, "successfully published %u bytes to %s", uPayloadLength, pTopic);
+	}
+
+	return (SUCCESS == rc);
+
+}
+
+// payload is the query part of an /api call ("top=0|5|ff0000&logo=..."), a leading "/api?" is accepted as well,
+// or a binary display command packet
+void AWSIntegration::HandleCommand(const char* pPayload, size_t uLength) {
+	if (!uLength || (uLength > AWS_IOT_MQTT_RX_BUF_LEN)) {
+		muCommandsRejected++;
+		return;
+	}
+	DynatraceAction* dtCommand = mpUfo->dt.enterAction("Handle MQTT Command");
+
+	if (DisplayCommand::IsPacket(pPayload, uLength)) {
+		DynamicRequestHandler requestHandler(mpUfo, &mpUfo->GetDisplayLevel1(), &mpUfo->GetDisplayLevel2());
+		if (requestHandler.ApplyApiPacket((const __uint8_t*)pPayload, uLength))
+			muCommands++;
+		else
+			muCommandsRejected++;
+		mpUfo->dt.leaveAction(dtCommand);
+		return;
 	}
 
-	return rc;	
+	std::list<TParam> params;
+	mCommandParser.ParseQuery(pPayload, uLength, params);
+	DynamicRequestHandler requestHandler(mpUfo, &mpUfo->GetDisplayLevel1(), &mpUfo->GetDisplayLevel2());
+	requestHandler.ApplyApiParams(params);
+	muCommands++;
 
+	mpUfo->dt.leaveAction(dtCommand);
+	ESP_LOGI(LOGTAG, "command applied, %u bytes", uLength);
 }
 
 void AWSIntegration::Shutdown() {
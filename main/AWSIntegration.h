@@ -4,6 +4,8 @@
 #include <aws_iot_mqtt_client_interface.h>
 #include "Config.h"
 #include "String.h"
+#include "UrlParser.h"
+#include "freertos/semphr.h"
 
 class Ufo;
 class AWSIntegration {
@@ -18,7 +20,16 @@ public:
     bool Connect();
     void Shutdown();
     bool Run();
-    bool Publish(const char* pTopic, short pTopicLenth, String* pPayload);
+    // the payload is copied into the TX buffer of the MQTT client, that's the only copy on the way out
+    bool Publish(const char* pTopic, short pTopicLenth, const char* pPayload, size_t uPayloadLength);
+
+    // applies a display command received on /dynatraceufo/command/<ufo id>, same syntax as the /api query
+    void HandleCommand(const char* pPayload, size_t uLength);
+
+    __uint32_t GetPublished() { return muPublished; }
+    __uint32_t GetBytesCopied() { return muBytesCopied; }
+    __uint32_t GetCommands() { return muCommands; }
+    __uint32_t GetCommandsRejected() { return muCommandsRejected; }
 
     bool mInitialized = false;
     bool mConnected = false;
@@ -32,6 +43,16 @@ private:
     AWS_IoT_Client client;
 	IoT_Client_Init_Params mqttInitParams;
 	IoT_Client_Connect_Params connectParams;
+    char mHostAddress[255];
+    SemaphoreHandle_t mhClientLock;
+
+    String msCommandTopic;
+    UrlParser mCommandParser;
+
+    __uint32_t muPublished = 0;
+    __uint32_t muBytesCopied = 0;
+    __uint32_t muCommands = 0;
+    __uint32_t muCommandsRejected = 0;
 };
 
 #endif
\ No newline at end of file
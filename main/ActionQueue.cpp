@@ -0,0 +1,72 @@
+#include "ActionQueue.h"
+
+#define ACTIONQUEUE_MASK	(ACTIONQUEUE_SIZE - 1)
+
+//------------------------------------------------------------------
+// Every cell carries a sequence number telling whether it is free for the producer at position pos (== pos)
+// or filled for the consumer at position pos (== pos + 1). Producers and consumers claim their position with a CAS,
+// so neither side ever waits on a lock.
+
+ActionQueue::ActionQueue() {
+	for (__uint32_t u=0 ; u<ACTIONQUEUE_SIZE ; u++){
+		mCells[u].uSequence = u;
+		mCells[u].pAction = NULL;
+	}
+	muEnqueuePos = 0;
+	muDequeuePos = 0;
+	muDropped = 0;
+}
+
+ActionQueue::~ActionQueue() {
+}
+
+bool ActionQueue::Push(DynatraceAction* pAction){
+	TCell* pCell;
+	__uint32_t uPos = __atomic_load_n(&muEnqueuePos, __ATOMIC_RELAXED);
+
+	while (true){
+		pCell = &mCells[uPos & ACTIONQUEUE_MASK];
+		__uint32_t uSequence = __atomic_load_n(&pCell->uSequence, __ATOMIC_ACQUIRE);
+		__int32_t iDiff = (__int32_t)(uSequence - uPos);
+		if (!iDiff){
+			if (__atomic_compare_exchange_n(&muEnqueuePos, &uPos, uPos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (iDiff < 0){ //full
+			__atomic_add_fetch(&muDropped, 1, __ATOMIC_RELAXED);
+			return false;
+		}
+		else
+			uPos = __atomic_load_n(&muEnqueuePos, __ATOMIC_RELAXED);
+	}
+	pCell->pAction = pAction;
+	__atomic_store_n(&pCell->uSequence, uPos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool ActionQueue::Pop(DynatraceAction*& rpAction){
+	TCell* pCell;
+	__uint32_t uPos = __atomic_load_n(&muDequeuePos, __ATOMIC_RELAXED);
+
+	while (true){
+		pCell = &mCells[uPos & ACTIONQUEUE_MASK];
+		__uint32_t uSequence = __atomic_load_n(&pCell->uSequence, __ATOMIC_ACQUIRE);
+		__int32_t iDiff = (__int32_t)(uSequence - (uPos + 1));
+		if (!iDiff){
+			if (__atomic_compare_exchange_n(&muDequeuePos, &uPos, uPos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (iDiff < 0) //empty
+			return false;
+		else
+			uPos = __atomic_load_n(&muDequeuePos, __ATOMIC_RELAXED);
+	}
+	rpAction = pCell->pAction;
+	__atomic_store_n(&pCell->uSequence, uPos + ACTIONQUEUE_SIZE, __ATOMIC_RELEASE);
+	return true;
+}
+
+__uint32_t ActionQueue::GetCount(){
+	__uint32_t uDequeuePos = __atomic_load_n(&muDequeuePos, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&muEnqueuePos, __ATOMIC_ACQUIRE) - uDequeuePos;
+}
@@ -0,0 +1,38 @@
+#ifndef MAIN_ACTIONQUEUE_H_
+#define MAIN_ACTIONQUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+#define ACTIONQUEUE_SIZE	128		// has to be a power of 2
+
+class DynatraceAction;
+
+/*
+ * Bounded lock-free queue of actions (sequence numbered ring buffer, safe for multiple producers and consumers).
+ * Push and Pop never block - Push fails (and counts the drop) when the queue is full, Pop fails when it is empty.
+ */
+class ActionQueue {
+public:
+	ActionQueue();
+	virtual ~ActionQueue();
+
+	bool Push(DynatraceAction* pAction);
+	bool Pop(DynatraceAction*& rpAction);
+
+	// approximate number of queued actions, exact only when there is no concurrent Push/Pop
+	__uint32_t GetCount();
+	__uint32_t GetDropped() { return __atomic_load_n(&muDropped, __ATOMIC_RELAXED); };
+
+private:
+	typedef struct{
+		__uint32_t uSequence;
+		DynatraceAction* pAction;
+	} TCell;
+
+	TCell mCells[ACTIONQUEUE_SIZE];
+	__uint32_t muEnqueuePos;
+	__uint32_t muDequeuePos;
+	__uint32_t muDropped;
+};
+
+#endif /* MAIN_ACTIONQUEUE_H_ */
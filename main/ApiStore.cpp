@@ -2,92 +2,163 @@
 #include <freertos/FreeRTOS.h>
 #include <esp_log.h>
 
-#define MAX_APIS 20
+#define NVS_ENTRY_SIZE		32		// NVS stores everything in 32 byte entries
+#define API_NO_SLOT			0xff
+
+static const char* LOGTAG = "APISTORE";
+
+static const char* DEFAULT_APIS[] = {
+	"/api?logo=ff0000|00ff00|0000ff|ff00cc",
+	"/api?logo_reset",
+	"/api?top_init&top=0|15|00ff00&top_morph=1000|5&bottom_init&bottom=0|15|00ff00&bottom_morph=1000|5",
+	"/api?top_init&top=0|15|ff0000&top_morph=80|8&bottom_init&bottom=0|15|ff0000&bottom_morph=80|8",
+	"/api?top_init&bottom_init",
+	"/api?top_init&top=0|1|ff0000&top_bg=00ff00&top_whirl=240|ccw&bottom_init&bottom=0|1|00ff00&bottom_bg=ff0000&bottom_whirl=190",
+	"/api?top_init&top=0|15|ff0000&top_morph=80|8&bottom_init&bottom=0|15|ff0000&bottom_morph=80|8&logo=ff0000|ff0000|ff0000|ff0000",
+	"/api?top_init&top=0|15|ff0000&bottom_init&bottom=0|15|00ff00"
+};
+
+#if API_MAX_PRESETS >= API_NO_SLOT
+#error "API_MAX_PRESETS has to be below 255"
+#endif
+
+static void GetSlotKey(char* sKey, __uint8_t uSlot){
+	sprintf(sKey, "Api%u", uSlot);
+}
+
+static __uint32_t EntryBytes(size_t uDataLen){
+	return NVS_ENTRY_SIZE + ((uDataLen + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE) * NVS_ENTRY_SIZE;
+}
 
 ApiStore::ApiStore() {
+	muCount = 0;
+	mbStored = false;
+	mpSceneLock = NULL;
+	muWrites = 0;
+	muLastWriteBytes = 0;
+	muWriteBytesTotal = 0;
 }
 
 ApiStore::~ApiStore() {
 }
 
-void ApiStore::Init(){
+void ApiStore::Init(CriticalSection* pSceneLock){
+	mpSceneLock = pSceneLock;
 
 	if (!ReadApis()){
-		mApis.push_back("/api?logo=ff0000|00ff00|0000ff|ff00cc");
-		mApis.push_back("/api?logo_reset");
-		mApis.push_back("/api?top_init&top=0|15|00ff00&top_morph=1000|5&bottom_init&bottom=0|15|00ff00&bottom_morph=1000|5");
-		mApis.push_back("/api?top_init&top=0|15|ff0000&top_morph=80|8&bottom_init&bottom=0|15|ff0000&bottom_morph=80|8");
-		mApis.push_back("/api?top_init&bottom_init");
-		mApis.push_back("/api?top_init&top=0|1|ff0000&top_bg=00ff00&top_whirl=240|ccw&bottom_init&bottom=0|1|00ff00&bottom_bg=ff0000&bottom_whirl=190");
-		mApis.push_back("/api?top_init&top=0|15|ff0000&top_morph=80|8&bottom_init&bottom=0|15|ff0000&bottom_morph=80|8&logo=ff0000|ff0000|ff0000|ff0000");
-		mApis.push_back("/api?top_init&top=0|15|ff0000&bottom_init&bottom=0|15|00ff00");
+		muCount = 0;
+		for (__uint8_t u=0 ; (u < sizeof(DEFAULT_APIS)/sizeof(DEFAULT_APIS[0])) && (u < API_MAX_PRESETS) ; u++){
+			SetSlot(u, DEFAULT_APIS[u]);
+			mOrder[muCount++] = u;
+		}
+		mbStored = false;
 	}
 }
 
 bool ApiStore::SetApi(__uint8_t uId, const char* sApi){
-	ESP_LOGD("APISTORE", "SetApi(%d, %s)", uId, sApi);
+	ESP_LOGD(LOGTAG, "SetApi(%d, %s)", uId, sApi ? sApi : "");
 
-	if (uId > MAX_APIS)
+	if (!sApi)
+		return false;
+	if (uId >= API_MAX_PRESETS)
 		return false;
-	if (uId > mApis.size())
+	if (uId > muCount)
 		return false;
 
-	if (uId == mApis.size()){
-		mApis.push_back(sApi);
-	}
-	else{
-		__uint8_t u = 0;
-		std::list<String>::iterator it = mApis.begin();
-		while (it != mApis.end()){
-			if (u == uId){
-				(*it) = sApi;
-				break;
-			}
-			u++;
-			it++;
-		}
+	if (uId < muCount){
+		SetSlot(mOrder[uId], sApi);
+		nvs_handle h;
+		if (!Open(h))
+			return false;
+		return Close(h, mbStored ? WriteSlot(h, mOrder[uId]) : WriteAll(h));
 	}
-	return WriteApis();
+
+	// first slot that is not in use
+	bool bUsed[API_MAX_PRESETS] = { false };
+	for (__uint8_t u=0 ; u<muCount ; u++)
+		bUsed[mOrder[u]] = true;
+	__uint8_t uSlot = 0;
+	while (bUsed[uSlot])
+		uSlot++;
+	SetSlot(uSlot, sApi);
+	Lock();
+	mOrder[muCount++] = uSlot;
+	Unlock();
+
+	nvs_handle h;
+	if (!Open(h))
+		return false;
+	if (!mbStored)
+		return Close(h, WriteAll(h));
+	// the slot first, a crash in between leaves an unreferenced slot that is overwritten later
+	if (!WriteSlot(h, uSlot))
+		return Close(h, false);
+	return Close(h, WriteOrder(h));
 }
 
 bool ApiStore::DeleteApi(__uint8_t uId){
-	ESP_LOGD("APISTORE", "DeleteApi(%d)", uId);
+	ESP_LOGD(LOGTAG, "DeleteApi(%d)", uId);
 
-	if (uId >= mApis.size())
+	if (uId >= muCount)
 		return false;
 
-	__uint8_t u = 0;
-	std::list<String>::iterator it = mApis.begin();
-	while (it != mApis.end()){
-		if (u == uId){
-			mApis.erase(it);
-			break;
-		}
-		u++;
-		it++;
+	DisplayCommand program;
+	Lock();
+	__uint8_t uSlot = mOrder[uId];
+	memmove(&mOrder[uId], &mOrder[uId + 1], muCount - uId - 1);
+	muCount--;
+	mApis[uSlot] = "";
+	mPrograms[uSlot].Swap(program);	// freed when leaving, outside of the lock
+	Unlock();
+
+	nvs_handle h;
+	if (!Open(h))
+		return false;
+	if (!muCount){
+		// like before: without any preset the built-in ones are back after the next restart
+		muLastWriteBytes = 0;
+		mbStored = false;
+		return Close(h, nvs_erase_all(h) == ESP_OK);
 	}
-	return WriteApis();
+	if (!mbStored)
+		return Close(h, WriteAll(h));
+	// the order first, the slot is not referenced anymore then
+	if (!WriteOrder(h))
+		return Close(h, false);
+	char sKey[8];
+	GetSlotKey(sKey, uSlot);
+	nvs_erase_key(h, sKey);
+	return Close(h, true);
 }
 
 
 void ApiStore::GetApisJson(String& rsBody){
 
 	rsBody = "{\"apis\":[";
-	std::list<String>::iterator it = mApis.begin();
-	while (it != mApis.end()){
-
+	Lock();
+	for (__uint8_t u=0 ; u<muCount ; u++){
+		if (u)
+			rsBody += ",";
 		rsBody += "\"";
-		rsBody += (*it);
+		rsBody += mApis[mOrder[u]];
 		rsBody += "\"";
-		it++;
-		if (it != mApis.end())
-			rsBody += ",";
 	}
+	Unlock();
 	rsBody += "]}";
 }
 
 //------------------------------------------------------------------------------------------
 
+// compiled aside, the display may execute the current program meanwhile
+void ApiStore::SetSlot(__uint8_t uSlot, const char* sApi){
+	DisplayCommand program;
+	program.Compile(sApi);
+	Lock();
+	mApis[uSlot] = sApi;
+	mPrograms[uSlot].Swap(program);
+	Unlock();
+}
+
 bool ApiStore::ReadApis(){
 	nvs_handle h;
 	__uint32_t uLen = 0;
@@ -96,77 +167,168 @@ bool ApiStore::ReadApis(){
 	if (nvs_open("Api", NVS_READONLY, &h) != ESP_OK)
 		return false;
 
+	ret = nvs_get_blob(h, "Order", NULL, &uLen);
+	if (ret == ESP_ERR_NVS_NOT_FOUND){
+		bool bOk = ReadLegacy(h);
+		nvs_close(h);
+		if (!bOk)
+			return false;
+		// move the presets into their slots, the old blob goes afterwards
+		ESP_LOGI(LOGTAG, "migrating %u presets", muCount);
+		if (Open(h) && Close(h, WriteAll(h)) && Open(h)){
+			nvs_erase_key(h, "Apis");
+			Close(h, true);
+		}
+		return true;
+	}
+	if ((ret != ESP_OK) || !uLen){
+		ESP_LOGD(LOGTAG, "nvs_get_blob returned ERROR %x", ret);
+		return nvs_close(h), false;
+	}
+
+	// stored with a higher CONFIG_UFO_MAX_API_PRESETS: the first presets are kept, the stored ones are left alone
+	__uint8_t* pStored = (__uint8_t*)malloc(uLen);
+	if (!pStored)
+		return nvs_close(h), false;
+	ret = nvs_get_blob(h, "Order", pStored, &uLen);
+	if (ret != ESP_OK){
+		ESP_LOGD(LOGTAG, "nvs_get_blob returned ERROR %x", ret);
+		free(pStored);
+		return nvs_close(h), false;
+	}
+	if (uLen > API_MAX_PRESETS){
+		ESP_LOGW(LOGTAG, "%u presets stored, using the first %u", uLen, API_MAX_PRESETS);
+		uLen = API_MAX_PRESETS;
+	}
+
+	// slots beyond API_MAX_PRESETS move into free ones
+	bool bUsed[API_MAX_PRESETS] = { false };
+	for (__uint32_t u=0 ; u<uLen ; u++){
+		if (pStored[u] < API_MAX_PRESETS)
+			bUsed[pStored[u]] = true;
+	}
+	bool bMoved = false;
+	muCount = 0;
+	for (__uint32_t u=0 ; u<uLen ; u++){
+		char sKey[8];
+		GetSlotKey(sKey, pStored[u]);
+		__uint32_t uStrLen = 0;
+		if ((nvs_get_str(h, sKey, NULL, &uStrLen) != ESP_OK) || !uStrLen){
+			ESP_LOGE(LOGTAG, "slot %u missing", pStored[u]);
+			continue;
+		}
+		char* sBuf = (char*)malloc(uStrLen);
+		if (!sBuf){
+			free(pStored);
+			return nvs_close(h), false;
+		}
+		if (nvs_get_str(h, sKey, sBuf, &uStrLen) == ESP_OK){
+			__uint8_t uSlot = pStored[u];
+			if (uSlot >= API_MAX_PRESETS){
+				uSlot = 0;
+				while (bUsed[uSlot])
+					uSlot++;
+				bUsed[uSlot] = true;
+				bMoved = true;
+			}
+			SetSlot(uSlot, sBuf);
+			mOrder[muCount++] = uSlot;
+		}
+		free(sBuf);
+	}
+	free(pStored);
+	nvs_close(h);
+	mbStored = true;
+	if (bMoved){
+		ESP_LOGI(LOGTAG, "moving presets into the first %u slots", API_MAX_PRESETS);
+		if (Open(h))
+			Close(h, WriteAll(h));
+	}
+	return muCount > 0;
+}
+
+// all presets in one blob, separated by 0x00 - written by older firmware versions
+bool ApiStore::ReadLegacy(nvs_handle h){
+	__uint32_t uLen = 0;
+	esp_err_t ret;
+
 	ret = nvs_get_blob(h, "Apis", NULL, &uLen);
 	if ((ret != ESP_OK) || !uLen){
-		ESP_LOGD("APISTORE", "nvs_get_blob (first) returned ERROR %x", ret);
-		nvs_close(h);
+		ESP_LOGD(LOGTAG, "nvs_get_blob (first) returned ERROR %x", ret);
 		return false;
 	}
 	char* sBuf = (char*)malloc(uLen + 1);
 	if (!sBuf)
-		return nvs_close(h), false;
+		return false;
 	ret = nvs_get_blob(h, "Apis", sBuf, &uLen);
 	if (ret != ESP_OK){
-		ESP_LOGD("APISTORE", "nvs_get_blob returned ERROR %x", ret);
+		ESP_LOGD(LOGTAG, "nvs_get_blob returned ERROR %x", ret);
 		free(sBuf);
-		nvs_close(h);
 		return false;
 	}
 	sBuf[uLen] = 0x00;
-	mApis.clear();
 
-	mApis.push_back(sBuf);
-	bool bZeroFound = false;
-	for (__uint32_t u=0 ; u<uLen ; u++){
-		if (bZeroFound){
-			mApis.push_back(sBuf + u);
-			bZeroFound = false;
-		}
-		else{
-			if (!sBuf[u])
-				bZeroFound = true;
+	muCount = 0;
+	__uint32_t uStart = 0;
+	for (__uint32_t u=0 ; (u<=uLen) && (muCount < API_MAX_PRESETS) ; u++){
+		if (!sBuf[u]){
+			if ((u < uLen) || (u > uStart)){
+				SetSlot(muCount, sBuf + uStart);
+				mOrder[muCount] = muCount;
+				muCount++;
+			}
+			uStart = u + 1;
 		}
 	}
-	free (sBuf);
-	nvs_close(h);
-	return true;
+	free(sBuf);
+	return muCount > 0;
 }
 
-bool ApiStore::WriteApis(){
-	nvs_handle h;
-	esp_err_t ret;
-
-	if (nvs_open("Api", NVS_READWRITE, &h) != ESP_OK)
+bool ApiStore::WriteSlot(nvs_handle h, __uint8_t uSlot){
+	char sKey[8];
+	GetSlotKey(sKey, uSlot);
+	esp_err_t ret = nvs_set_str(h, sKey, mApis[uSlot].c_str());
+	if (ret != ESP_OK){
+		ESP_LOGE(LOGTAG, "<%s> -> %x", sKey, ret);
 		return false;
-
-	if (!mApis.size()){
-		ret = nvs_erase_all(h);
-		nvs_close(h);
-		return ret == ESP_OK;
 	}
+	muLastWriteBytes += EntryBytes(mApis[uSlot].length() + 1);
+	return true;
+}
 
-	__uint16_t uSize = 0;
-	std::list<String>::iterator it = mApis.begin();
-	while (it != mApis.end()){
-		uSize += (*it).length() + 1;
-		it++;
+bool ApiStore::WriteOrder(nvs_handle h){
+	esp_err_t ret = nvs_set_blob(h, "Order", mOrder, muCount);
+	if (ret != ESP_OK){
+		ESP_LOGE(LOGTAG, "<Order> -> %x", ret);
+		return false;
 	}
-	char* sBuf = (char*)malloc(uSize);
-	if (!sBuf)
-		return nvs_close(h), false;
-	__uint16_t uPos = 0;
-	it = mApis.begin();
-	while (it != mApis.end()){
-		strcpy(sBuf + uPos, (*it).c_str());
-		uPos += (*it).length();
-		sBuf[uPos++] = 0x00;
-		it++;
-	}
-	ret = nvs_set_blob(h, "Apis", sBuf, uSize);
-	free(sBuf);
-	nvs_close(h);
-	return ret == ESP_OK;
+	muLastWriteBytes += EntryBytes(muCount);
+	return true;
 }
 
+// the first edit after the built-in presets (or the migration) stores all of them
+bool ApiStore::WriteAll(nvs_handle h){
+	for (__uint8_t u=0 ; u<muCount ; u++){
+		if (!WriteSlot(h, mOrder[u]))
+			return false;
+	}
+	if (!WriteOrder(h))
+		return false;
+	mbStored = true;
+	return true;
+}
 
+bool ApiStore::Open(nvs_handle& h){
+	muLastWriteBytes = 0;
+	return nvs_open("Api", NVS_READWRITE, &h) == ESP_OK;
+}
 
+bool ApiStore::Close(nvs_handle h, bool bOk){
+	if (bOk)
+		bOk = (nvs_commit(h) == ESP_OK);
+	nvs_close(h);
+	muWrites++;
+	muWriteBytesTotal += muLastWriteBytes;
+	ESP_LOGD(LOGTAG, "%u bytes written", muLastWriteBytes);
+	return bOk;
+}
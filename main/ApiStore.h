@@ -10,27 +10,66 @@
 
 #include "nvs.h"
 #include "String.h"
-#include <list>
+#include "DisplayCommand.h"
+#include "CriticalSection.h"
+#include "sdkconfig.h"
 
+#ifdef CONFIG_UFO_MAX_API_PRESETS
+#define API_MAX_PRESETS CONFIG_UFO_MAX_API_PRESETS
+#else
+#define API_MAX_PRESETS 40
+#endif
+
+/*
+ * Every preset lives in its own NVS key ("Api<slot>"), the "Order" blob lists the slots in display order.
+ * An edit writes the one changed slot, adding or deleting a preset also rewrites the (max. API_MAX_PRESETS bytes) order.
+ * Every preset is compiled into a DisplayCommand when it is loaded or saved, so /api?preset=<n> does not parse anything.
+ */
 class ApiStore {
 public:
 	ApiStore();
 	virtual ~ApiStore();
 
-	void Init();
+	// the programs are replaced under the scene lock, they are executed under it
+	void Init(CriticalSection* pSceneLock);
 
 	bool SetApi(__uint8_t uId, const char* sApi);
 	bool DeleteApi(__uint8_t uId);
+	String* GetApi(__uint8_t uId) { return (uId < muCount) ? &mApis[mOrder[uId]] : NULL; };
+	// valid while the scene lock is held
+	DisplayCommand* GetProgram(__uint8_t uId) { return (uId < muCount) ? &mPrograms[mOrder[uId]] : NULL; };
+	__uint8_t GetCount() { return muCount; };
 
 	void GetApisJson(String& rsBody);
 
+	// NVS entry bytes (32 per entry) written by the edits
+	__uint32_t GetWrites() { return muWrites; };
+	__uint32_t GetLastWriteBytes() { return muLastWriteBytes; };
+	__uint32_t GetWriteBytesTotal() { return muWriteBytesTotal; };
+
 private:
+	void SetSlot(__uint8_t uSlot, const char* sApi);
 	bool ReadApis();
-	bool WriteApis();
+	bool ReadLegacy(nvs_handle h);
+	bool WriteSlot(nvs_handle h, __uint8_t uSlot);
+	bool WriteOrder(nvs_handle h);
+	bool WriteAll(nvs_handle h);
+	bool Open(nvs_handle& h);
+	bool Close(nvs_handle h, bool bOk);
+	void Lock()		{ if (mpSceneLock) mpSceneLock->Enter(0); };
+	void Unlock()	{ if (mpSceneLock) mpSceneLock->Leave(); };
 
 private:
-	std::list<String> mApis;
+	String mApis[API_MAX_PRESETS];		// by slot
+	DisplayCommand mPrograms[API_MAX_PRESETS];
+	__uint8_t mOrder[API_MAX_PRESETS];	// slot of the n-th preset
+	__uint8_t muCount;
+	bool mbStored;						// false while the built-in presets are used
+	CriticalSection* mpSceneLock;
 
+	__uint32_t muWrites;
+	__uint32_t muLastWriteBytes;
+	__uint32_t muWriteBytesTotal;
 };
 
 #endif /* MAIN_APISTORE_H_ */
@@ -1,33 +1,91 @@
 #include <freertos/FreeRTOS.h>
 #include "Config.h"
+#include "PayloadWriter.h"
 #include "nvs_flash.h"
+#include "LatencyHistogram.h"
 #include <esp_log.h>
 
 
 #define WIFI_SSID CONFIG_WIFI_SSID
 #define WIFI_PASS CONFIG_WIFI_PASSWORD
 
+#define NVS_ENTRY_SIZE		32		// NVS stores everything in 32 byte entries
+#define BIGSTRING_CHUNK		1900
+#define BIGSTRING_CHUNKS	6
 
-Config::Config() {
-	mbAPMode = true;
-	msAPSsid = "UFO";
-	msHostname = "UFO";
+#define BLOB_KEY			"Settings"
+#define BLOB_FORMAT			1
+#define BLOB_HEADER			8		// "UFC", format, version (u32)
+
+static const char* LOGTAG = "Config";
 
-	msSTASsid = WIFI_SSID;
-	msSTAPass = WIFI_PASS;
+static const char* DT_ENV_KEYS[] = { "DTEnvId", "DTEnvId2", "DTEnvId3" };
+static const char* DT_TOKEN_KEYS[] = { "DTApiToken", "DTApiToken2", "DTApiToken3" };
 
-	mbWebServerUseSsl = false;
-	muWebServerPort = 0;
+#if DT_MAX_ENVIRONMENTS > 3
+#error "add the keys of the additional environments"
+#endif
 
-	mbDTEnabled = false;
-	mbDTMonitoring = false;
+static LatencyHistogram latencyWrite("ufo_config_write_seconds", "Saving the configuration to NVS");
 
-	muLastSTAIpAddress = 0;
+
+Config::Config() {
+	muFieldCount = 0;
+	mpBlob = NULL;
+	muBlobLen = 0;
+	mhLock = xSemaphoreCreateMutex();
+	muVersion = 0;
+	muWrites = 0;
+	muWritesSkipped = 0;
+	muLastWriteKeys = 0;
+	muLastWriteBytes = 0;
+	muWriteBytesTotal = 0;
+
+	// key, member, default, max. length
+	DeclareBool("APMode", mbAPMode, true);
+	DeclareString("APSsid", msAPSsid, "UFO", 32);
+	DeclareString("APPass", msAPPass, "", 64);
+	DeclareU32("STAIpAddress", muLastSTAIpAddress, 0);
+	DeclareString("STASsid", msSTASsid, WIFI_SSID, 32);
+	DeclareString("STAPass", msSTAPass, WIFI_PASS, 64);
+	DeclareString("STAENTUser", msSTAENTUser, "", 64);
+	DeclareBigString("STAENTCA", msSTAENTCA);
+	DeclareString("hostname", msHostname, "UFO", 32);
+
+	DeclareBool("DTEnabled", mbDTEnabled, false);
+	for (__uint8_t i=0 ; i<DT_MAX_ENVIRONMENTS ; i++){
+		DeclareString(DT_ENV_KEYS[i], msDTEnvIdOrUrl[i], "", 100);
+		DeclareString(DT_TOKEN_KEYS[i], msDTApiToken[i], "", 100);
+	}
+	DeclareI32("DTInterval", miDTInterval, 60);
+	DeclareBool("DTDetails", mbDTProblemDetails, false);
+	DeclareString("DTWebhookToken", msDTWebhookToken, "", 64);
+
+	DeclareBool("DTMonitoring", mbDTMonitoring, false);
+	DeclareBool("DTMonCbor", mbDTMonitoringCbor, false);
+	DeclareBool("DTMonPubIp", mbDTPublicIpLookup, true);
+	DeclareU8("DTMonExporter", muDTMonitoringExporter, 0);
+	DeclareString("DTMonUrl", msDTMonitoringUrl, "", 128);
+	DeclareString("MqttHost", msMqttHost, "", 64);
+	DeclareU16("MqttPort", muMqttPort, 0);
+
+	DeclareBool("SrvSSLEnabled", mbWebServerUseSsl, false);
+	DeclareU16("SrvListenPort", muWebServerPort, 0);
+	DeclareBigString("SrvCert", msWebServerCert);
+
+	DeclareString("UfoId", msUfoId, "", 32);
+	DeclareString("UfoName", msUfoName, "", 32);
+	DeclareString("Organization", msOrganization, "", 64);
+	DeclareString("Department", msDepartment, "", 64);
+	DeclareString("Location", msLocation, "", 64);
 }
 
 Config::~Config() {
+	free(mpBlob);
+	vSemaphoreDelete(mhLock);
 }
 
+// startup reads the settings blob only, the big strings follow on first use
 bool Config::Read(){
 	nvs_handle h;
 
@@ -35,182 +93,498 @@ bool Config::Read(){
 		return false;
 	if (nvs_open("Ufo Config", NVS_READONLY, &h) != ESP_OK)
 		return false;
-	ReadBool(h, "APMode", mbAPMode);
-	ReadString(h, "APSsid", msAPSsid);
-	ReadString(h, "APPass", msAPPass);
-	nvs_get_u32(h, "STAIpAddress", &muLastSTAIpAddress);
-	ReadString(h, "STASsid", msSTASsid);
-	ReadString(h, "STAPass", msSTAPass);
-	ReadString(h, "STAENTUser", msSTAENTUser);
-	ReadBigString(h, "STAENTCA", msSTAENTCA);
-	ReadString(h, "hostname", msHostname);
-	ReadBool(h, "DTEnabled", mbDTEnabled);
-	ReadString(h, "DTEnvId", msDTEnvIdOrUrl);
-	ReadString(h, "DTApiToken", msDTApiToken);
-	ReadInt(h, "DTInterval", miDTInterval);
-	ReadBool(h, "DTMonitoring", mbDTMonitoring);
-	ReadBool(h, "SrvSSLEnabled", mbWebServerUseSsl);
-	nvs_get_u16(h, "SrvListenPort", &muWebServerPort);
-	ReadString(h, "SrvCert", msWebServerCert);
-	ReadString(h, "UfoId", msUfoId);
-	ReadString(h, "UfoName", msUfoName);
-	ReadString(h, "Organization", msOrganization);
-	ReadString(h, "Department", msDepartment);
-	ReadString(h, "Location", msLocation);
 
+	__uint8_t* pBlob = (__uint8_t*)malloc(CONFIG_BLOB_MAX);
+	if (!pBlob)
+		return nvs_close(h), false;
+	__uint32_t uLen = CONFIG_BLOB_MAX;
+	esp_err_t err = nvs_get_blob(h, BLOB_KEY, pBlob, &uLen);
+	if (err == ESP_OK){
+		bool bOk = Decode(pBlob, uLen);
+		free(pBlob);
+		nvs_close(h);
+		return bOk;
+	}
+	free(pBlob);
+	if (err != ESP_ERR_NVS_NOT_FOUND){
+		ESP_LOGE(LOGTAG, "settings not readable: %d", err);
+		return nvs_close(h), false;
+	}
+
+	// stored by an older firmware with one key per field - moved into the blob once
+	ESP_LOGI(LOGTAG, "migrating settings");
+	ReadLegacy(h);
 	nvs_close(h);
+	if (!Write())
+		return false;
+	if (nvs_open("Ufo Config", NVS_READWRITE, &h) == ESP_OK){
+		EraseLegacy(h);
+		nvs_commit(h);
+		nvs_close(h);
+	}
 	return true;
 }
 
-
 bool Config::Write()
 {
-	nvs_handle h;
+	xSemaphoreTake(mhLock, portMAX_DELAY);
+	bool bOk = Save();
+	xSemaphoreGive(mhLock);
+	return bOk;
+}
+
+// big strings are written first, the blob with the new version last - a committed version means everything before it is stored
+// the blob also keeps length and hash of every big string, a save torn between the chunks and the blob is found on reading
+// changes are found by comparing with what is stored, reading is cheap compared to writing
+bool Config::Save()
+{
+	__uint64_t uStart = LatencyHistogram::Start();
+	muLastWriteKeys = 0;
+	muLastWriteBytes = 0;
 
+	nvs_handle h;
 	if (nvs_flash_init() != ESP_OK)
 		return false;
 	if (nvs_open("Ufo Config", NVS_READWRITE, &h) != ESP_OK)
 		return false;
-	nvs_erase_all(h); //otherwise I need double the space
 
-	if (!WriteBool(h, "APMode", mbAPMode))
-		return nvs_close(h), false;
-	if (!WriteString(h, "APSsid", msAPSsid))
-		return nvs_close(h), false;
-	if (!WriteString(h, "APPass", msAPPass))
-		return nvs_close(h), false;
-	if (!WriteString(h, "STASsid", msSTASsid))
-		return nvs_close(h), false;
-	if (!WriteString(h, "STAPass", msSTAPass))
-		return nvs_close(h), false;
-	if (!WriteString(h, "hostname", msHostname))
-		return nvs_close(h), false;
-	if (!WriteString(h, "STAENTUser", msSTAENTUser))
-		return nvs_close(h), false;
-	if (!WriteBigString(h, "STAENTCA", msSTAENTCA))
-		return nvs_close(h), false;
-	if (nvs_set_u32(h, "STAIpAddress", muLastSTAIpAddress) != ESP_OK)
-		return nvs_close(h), false;
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		TConfigField& rField = mFields[u];
+		if ((rField.uType != CONFIG_TYPE_BIGSTRING) || rField.bLoaded || rField.bDigest)
+			continue;
+		// stored by an older firmware or never read, the digest is taken from what is stored
+		String sStored;
+		ReadBigString(h, rField, sStored);
+		Digest(sStored, rField.uDigestLen, rField.uDigestHash);
+		rField.bDigest = true;
+	}
 
-	if (!WriteBool(h, "DTEnabled", mbDTEnabled))
-		return nvs_close(h), false;
-	if (!WriteString(h, "DTEnvId", msDTEnvIdOrUrl))
-		return nvs_close(h), false;
-	if (!WriteString(h, "DTApiToken", msDTApiToken))
-		return nvs_close(h), false;
-	if (!WriteInt(h, "DTInterval", miDTInterval))
+	PayloadWriter writer;
+	if (!Encode(writer))
 		return nvs_close(h), false;
 
-	if (!WriteBool(h, "DTMonitoring", mbDTMonitoring))
-		return nvs_close(h), false;
+	bool bBigWritten = false;
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		TConfigField& rField = mFields[u];
+		if ((rField.uType != CONFIG_TYPE_BIGSTRING) || !rField.bLoaded)
+			continue;	// a big string that never got loaded can't have changed
+		String& rsValue = *(String*)rField.pValue;
+		String sStored;
+		ReadBigString(h, rField, sStored);
+		if (sStored == rsValue)
+			continue;
+		if (!WriteBigString(h, rField.sKey, rsValue))
+			return nvs_close(h), false;
+		bBigWritten = true;
+	}
 
-	if (!WriteBool(h, "SrvSSLEnabled", mbWebServerUseSsl))	
-		return nvs_close(h), false;
-	if (nvs_set_u16(h, "SrvListenPort", muWebServerPort) != ESP_OK)
-		return nvs_close(h), false;
-	if (!WriteString(h, "SrvCert", msWebServerCert))
-		return nvs_close(h), false;
+	if (!bBigWritten && !BlobChanged(writer)){
+		nvs_close(h);
+		muWritesSkipped++;
+		ESP_LOGI(LOGTAG, "nothing changed, not written");
+		return true;
+	}
 
-	if (!WriteString(h, "UfoId", msUfoId))
-		return nvs_close(h), false;
-	if (!WriteString(h, "UfoName", msUfoName))
-		return nvs_close(h), false;
-	if (!WriteString(h, "Organization", msOrganization))
-		return nvs_close(h), false;
-	if (!WriteString(h, "Department", msDepartment))
+	__uint32_t uVersion = muVersion + 1;
+	char* pHeader = (char*)writer.GetData();
+	pHeader[4] = uVersion;
+	pHeader[5] = uVersion >> 8;
+	pHeader[6] = uVersion >> 16;
+	pHeader[7] = uVersion >> 24;
+	esp_err_t err = nvs_set_blob(h, BLOB_KEY, writer.GetData(), writer.GetLength());
+	if (err != ESP_OK){
+		ESP_LOGE(LOGTAG, "settings not written: %d", err);
 		return nvs_close(h), false;
-	if (!WriteString(h, "Location", msLocation))
+	}
+	CountWrite(writer.GetLength());
+	muVersion = uVersion;
+	if (nvs_commit(h) != ESP_OK){
+		KeepBlob(NULL, 0);		// don't know what's in flash anymore, next time everything is written
 		return nvs_close(h), false;
-
-	nvs_commit(h);
+	}
 	nvs_close(h);
+	KeepBlob((const __uint8_t*)writer.GetData() + BLOB_HEADER, writer.GetLength() - BLOB_HEADER);
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		TConfigField& rField = mFields[u];
+		if ((rField.uType == CONFIG_TYPE_BIGSTRING) && rField.bLoaded){
+			Digest(*(String*)rField.pValue, rField.uDigestLen, rField.uDigestHash);
+			rField.bDigest = true;
+		}
+	}
+
+	muWrites++;
+	muWriteBytesTotal += muLastWriteBytes;
+	latencyWrite.RecordSince(uStart);
+	ESP_LOGI(LOGTAG, "version %u: %u keys, %u bytes written in %u us", muVersion, muLastWriteKeys, muLastWriteBytes, (__uint32_t)(LatencyHistogram::Start() - uStart));
 	return true;
 }
 
+bool Config::BlobChanged(PayloadWriter& rWriter){
+	return !mpBlob || (rWriter.GetLength() - BLOB_HEADER != muBlobLen) || memcmp(rWriter.GetData() + BLOB_HEADER, mpBlob, muBlobLen);
+}
+
+// without memory for the copy the blob counts as unknown, it is written on every save then
+void Config::KeepBlob(const __uint8_t* pFields, size_t uLen){
+	free(mpBlob);
+	mpBlob = pFields ? (__uint8_t*)malloc(uLen ? uLen : 1) : NULL;
+	muBlobLen = mpBlob ? uLen : 0;
+	if (mpBlob)
+		memcpy(mpBlob, pFields, uLen);
+}
+
 //------------------------------------------------------------------------------------
 
-bool Config::ReadString(nvs_handle h, const char* sKey, String& rsValue){
-	char* sBuf = NULL;
-	__uint32_t u = 0;
+Config::TConfigField* Config::Declare(const char* sKey, __uint8_t uType, void* pValue){
+	if (muFieldCount >= CONFIG_MAX_FIELDS){
+		ESP_LOGE(LOGTAG, "too many fields, %s is not stored", sKey);
+		return NULL;
+	}
+	TConfigField* pField = &mFields[muFieldCount++];
+	pField->sKey = sKey;
+	pField->uType = uType;
+	pField->bLoaded = false;
+	pField->bDigest = false;
+	pField->uMaxLen = 0;
+	pField->uDigestLen = 0;
+	pField->uDigestHash = 0;
+	pField->pValue = pValue;
+	return pField;
+}
+
+void Config::DeclareBool(const char* sKey, bool& rbValue, bool bDefault){
+	rbValue = bDefault;
+	Declare(sKey, CONFIG_TYPE_BOOL, &rbValue);
+}
+
+void Config::DeclareU8(const char* sKey, __uint8_t& ruValue, __uint8_t uDefault){
+	ruValue = uDefault;
+	Declare(sKey, CONFIG_TYPE_U8, &ruValue);
+}
+
+void Config::DeclareU16(const char* sKey, __uint16_t& ruValue, __uint16_t uDefault){
+	ruValue = uDefault;
+	Declare(sKey, CONFIG_TYPE_U16, &ruValue);
+}
+
+void Config::DeclareU32(const char* sKey, __uint32_t& ruValue, __uint32_t uDefault){
+	ruValue = uDefault;
+	Declare(sKey, CONFIG_TYPE_U32, &ruValue);
+}
+
+void Config::DeclareI32(const char* sKey, int& riValue, int iDefault){
+	riValue = iDefault;
+	Declare(sKey, CONFIG_TYPE_I32, &riValue);
+}
+
+void Config::DeclareString(const char* sKey, String& rsValue, const char* sDefault, __uint16_t uMaxLen){
+	rsValue = sDefault;
+	TConfigField* pField = Declare(sKey, CONFIG_TYPE_STRING, &rsValue);
+	if (pField)
+		pField->uMaxLen = uMaxLen;
+}
 
-	nvs_get_str(h, sKey, NULL, &u);
-	if (!u)
+void Config::DeclareBigString(const char* sKey, String& rsValue){
+	TConfigField* pField = Declare(sKey, CONFIG_TYPE_BIGSTRING, &rsValue);
+	if (pField)
+		pField->uMaxLen = BIGSTRING_CHUNK * BIGSTRING_CHUNKS;
+}
+
+/*
+ * Blob: "UFC", format, version (u32 LE), then per field: key length, key, type, value length (u16 LE), value.
+ * Fields are matched by key and type, so fields can be added or removed without breaking stored settings.
+ * Big strings are stored with their own keys, the blob keeps their length (u16) and hash (u32) only.
+ */
+bool Config::Encode(PayloadWriter& rWriter){
+	rWriter.Reserve(CONFIG_BLOB_MAX);
+	rWriter.Append("UFC");
+	rWriter.Append((char)BLOB_FORMAT);
+	rWriter.Append("\0\0\0\0", 4);	// version, set when written
+
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		TConfigField& rField = mFields[u];
+		const char* pValue;
+		size_t uLen;
+		__uint8_t uValue;
+		__uint8_t digest[6];
+		__uint16_t uDigestLen;
+		__uint32_t uDigestHash;
+		switch (rField.uType){
+			case CONFIG_TYPE_BIGSTRING:
+				if (rField.bLoaded){
+					String& rsValue = *(String*)rField.pValue;
+					if (rsValue.length() > rField.uMaxLen){
+						ESP_LOGW(LOGTAG, "%s truncated to %u characters", rField.sKey, rField.uMaxLen);
+						rsValue.remove(rField.uMaxLen);
+					}
+					Digest(rsValue, uDigestLen, uDigestHash);
+				}
+				else if (rField.bDigest){
+					uDigestLen = rField.uDigestLen;
+					uDigestHash = rField.uDigestHash;
+				}
+				else
+					continue;
+				memcpy(&digest[0], &uDigestLen, 2);
+				memcpy(&digest[2], &uDigestHash, 4);
+				pValue = (const char*)digest;
+				uLen = sizeof(digest);
+				break;
+			case CONFIG_TYPE_BOOL:
+				uValue = *(bool*)rField.pValue ? 1 : 0;
+				pValue = (const char*)&uValue;
+				uLen = 1;
+				break;
+			case CONFIG_TYPE_U8:
+				pValue = (const char*)rField.pValue;
+				uLen = 1;
+				break;
+			case CONFIG_TYPE_U16:
+				pValue = (const char*)rField.pValue;
+				uLen = 2;
+				break;
+			case CONFIG_TYPE_U32:
+			case CONFIG_TYPE_I32:
+				pValue = (const char*)rField.pValue;
+				uLen = 4;
+				break;
+			default:
+				if (((String*)rField.pValue)->length() > rField.uMaxLen){
+					// one over-long value must not cost the other settings their save
+					ESP_LOGW(LOGTAG, "%s truncated to %u characters", rField.sKey, rField.uMaxLen);
+					((String*)rField.pValue)->remove(rField.uMaxLen);
+				}
+				pValue = ((String*)rField.pValue)->c_str();
+				uLen = ((String*)rField.pValue)->length();
+				break;
+		}
+		__uint8_t uKeyLen = strlen(rField.sKey);
+		rWriter.Append((char)uKeyLen);
+		rWriter.Append(rField.sKey, uKeyLen);
+		rWriter.Append((char)rField.uType);
+		rWriter.Append((char)uLen);
+		rWriter.Append((char)(uLen >> 8));
+		rWriter.Append(pValue, uLen);	// numbers in the native (little endian) byte order
+	}
+	if (!rWriter.IsValid() || (rWriter.GetLength() > CONFIG_BLOB_MAX)){
+		ESP_LOGE(LOGTAG, "settings exceed %u bytes", CONFIG_BLOB_MAX);
 		return false;
-	sBuf = (char*)malloc(u+1);
-	if (nvs_get_str(h, sKey, sBuf, &u) != ESP_OK)
-		return free(sBuf), false;
-	sBuf[u] = 0x00;
-	rsValue = sBuf;
-	free(sBuf);
+	}
 	return true;
 }
 
-bool Config::ReadBigString(nvs_handle h, const char* sKey, String& rsValue){
-	String sHelp;
-	if (!ReadString(h, sKey, sHelp))
+bool Config::Decode(const __uint8_t* pData, size_t uLen){
+	if ((uLen < BLOB_HEADER) || memcmp(pData, "UFC", 3) || (pData[3] != BLOB_FORMAT)){
+		ESP_LOGE(LOGTAG, "unknown settings format");
 		return false;
-	rsValue = sHelp;
-	int i = 1;
-	while ((i <= 5) && sHelp.length() == 1900){
-		String sKeyHelp = sKey;
-		sKeyHelp += i;
-		i++;
-		if (!ReadString(h, sKeyHelp.c_str(), sHelp))
+	}
+	muVersion = pData[4] | (pData[5] << 8) | (pData[6] << 16) | (pData[7] << 24);
+
+	KeepBlob(pData + BLOB_HEADER, uLen - BLOB_HEADER);
+
+	size_t uPos = BLOB_HEADER;
+	while (uPos < uLen){
+		__uint8_t uKeyLen = pData[uPos++];
+		if (uPos + uKeyLen + 3 > uLen)
+			break;
+		const char* sKey = (const char*)&pData[uPos];
+		uPos += uKeyLen;
+		__uint8_t uType = pData[uPos++];
+		__uint16_t uValueLen = pData[uPos] | (pData[uPos + 1] << 8);
+		uPos += 2;
+		if (uPos + uValueLen > uLen)
 			break;
-		rsValue += sHelp;
+		const __uint8_t* pValue = &pData[uPos];
+		uPos += uValueLen;
+
+		for (__uint8_t u=0 ; u<muFieldCount ; u++){
+			TConfigField& rField = mFields[u];
+			if ((rField.uType != uType) || strncmp(rField.sKey, sKey, uKeyLen) || rField.sKey[uKeyLen])
+				continue;
+			switch (uType){
+				case CONFIG_TYPE_BOOL:
+					if (uValueLen == 1)
+						*(bool*)rField.pValue = *pValue ? true : false;
+					break;
+				case CONFIG_TYPE_U8:
+				case CONFIG_TYPE_U16:
+				case CONFIG_TYPE_U32:
+				case CONFIG_TYPE_I32:
+					if (uValueLen == ((uType == CONFIG_TYPE_U8) ? 1 : (uType == CONFIG_TYPE_U16) ? 2 : 4))
+						memcpy(rField.pValue, pValue, uValueLen);
+					break;
+				case CONFIG_TYPE_BIGSTRING:
+					if (uValueLen == 6){
+						memcpy(&rField.uDigestLen, &pValue[0], 2);
+						memcpy(&rField.uDigestHash, &pValue[2], 4);
+						rField.bDigest = true;
+					}
+					break;
+				case CONFIG_TYPE_STRING:
+					if (uValueLen > rField.uMaxLen){
+						ESP_LOGW(LOGTAG, "%s truncated to %u characters", rField.sKey, rField.uMaxLen);
+						uValueLen = rField.uMaxLen;
+					}
+					{
+						String& rsValue = *(String*)rField.pValue;
+						rsValue = "";
+						rsValue.concat((const char*)pValue, uValueLen);
+					}
+					break;
+			}
+			break;
+		}
 	}
+	if (uPos != uLen)
+		ESP_LOGW(LOGTAG, "settings truncated at %u of %u bytes", (unsigned int)uPos, (unsigned int)uLen);
 	return true;
 }
 
-bool Config::ReadBool(nvs_handle h, const char* sKey, bool& rbValue){
-	__uint8_t u;
-	if (nvs_get_u8(h, sKey, &u) != ESP_OK)
-		return false;
-	rbValue = u ? true : false;
-	return true;
+String& Config::LoadLazy(String& rsValue){
+	xSemaphoreTake(mhLock, portMAX_DELAY);
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		TConfigField& rField = mFields[u];
+		if (rField.pValue != &rsValue)
+			continue;
+		if (!rField.bLoaded){
+			nvs_handle h;
+			rField.bLoaded = true;
+			if (nvs_open("Ufo Config", NVS_READONLY, &h) == ESP_OK){
+				ReadBigString(h, rField, rsValue);
+				nvs_close(h);
+			}
+		}
+		break;
+	}
+	xSemaphoreGive(mhLock);
+	return rsValue;
 }
 
-bool Config::ReadInt(nvs_handle h, const char* sKey, int& riValue){
-	__uint32_t u;
-	if (nvs_get_u32(h, sKey, &u) != ESP_OK)
-		return false;
-	riValue = u;
+// per field keys as written by older firmware versions
+bool Config::ReadLegacy(nvs_handle h){
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		TConfigField& rField = mFields[u];
+		__uint8_t uValue;
+		__uint32_t uLen = 0;
+		switch (rField.uType){
+			case CONFIG_TYPE_BOOL:
+				if (nvs_get_u8(h, rField.sKey, &uValue) == ESP_OK)
+					*(bool*)rField.pValue = uValue ? true : false;
+				break;
+			case CONFIG_TYPE_U8:
+				nvs_get_u8(h, rField.sKey, (__uint8_t*)rField.pValue);
+				break;
+			case CONFIG_TYPE_U16:
+				nvs_get_u16(h, rField.sKey, (__uint16_t*)rField.pValue);
+				break;
+			case CONFIG_TYPE_U32:
+			case CONFIG_TYPE_I32:
+				nvs_get_u32(h, rField.sKey, (__uint32_t*)rField.pValue);
+				break;
+			case CONFIG_TYPE_STRING:
+				nvs_get_str(h, rField.sKey, NULL, &uLen);
+				if (uLen){
+					char* sBuf = (char*)malloc(uLen + 1);
+					if (sBuf && (nvs_get_str(h, rField.sKey, sBuf, &uLen) == ESP_OK)){
+						sBuf[uLen] = 0x00;
+						// the legacy key is erased after the migration, so an over-long value is kept in part
+						if (strlen(sBuf) > rField.uMaxLen){
+							ESP_LOGW(LOGTAG, "%s truncated to %u characters", rField.sKey, rField.uMaxLen);
+							sBuf[rField.uMaxLen] = 0x00;
+						}
+						*(String*)rField.pValue = sBuf;
+					}
+					free(sBuf);
+				}
+				break;
+		}
+	}
 	return true;
 }
 
-bool Config::WriteString(nvs_handle h, const char* sKey, String& rsValue){
-	esp_err_t err = nvs_set_str(h, sKey, rsValue.c_str());
-	if (err != ESP_OK){
-		ESP_LOGE("Config", "  <%s>%d -> %d", sKey, rsValue.length(), err);
-		return false;
+void Config::EraseLegacy(nvs_handle h){
+	for (__uint8_t u=0 ; u<muFieldCount ; u++){
+		if (mFields[u].uType != CONFIG_TYPE_BIGSTRING)
+			nvs_erase_key(h, mFields[u].sKey);
 	}
-	return true;
+	nvs_erase_key(h, "Version");
 }
 
-bool Config::WriteBigString(nvs_handle h, const char* sKey, String& rsValue){
-	if (rsValue.length() <= 1900){
-		return WriteString(h, sKey, rsValue);
+void Config::CountWrite(size_t uDataLen){
+	muLastWriteKeys++;
+	muLastWriteBytes += NVS_ENTRY_SIZE + ((uDataLen + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE) * NVS_ENTRY_SIZE;
+}
+
+// stored in chunks of 1900 characters: key, key1, key2, ...
+// chunks not matching the digest of the blob are rejected, they are left of a torn save
+bool Config::ReadBigString(nvs_handle h, TConfigField& rField, String& rsValue){
+	String sKeyHelp = rField.sKey;
+	int i = 0;
+	rsValue = "";
+	while (i < BIGSTRING_CHUNKS){
+		__uint32_t u = 0;
+		nvs_get_str(h, sKeyHelp.c_str(), NULL, &u);
+		if (!u)
+			break;
+		char* sBuf = (char*)malloc(u + 1);
+		if (!sBuf)
+			return false;
+		if (nvs_get_str(h, sKeyHelp.c_str(), sBuf, &u) != ESP_OK)
+			return free(sBuf), false;
+		sBuf[u] = 0x00;
+		rsValue += sBuf;
+		free(sBuf);
+		if (u - 1 != BIGSTRING_CHUNK)
+			break;
+		i++;
+		sKeyHelp = rField.sKey;
+		sKeyHelp += i;
+	}
+	if (rField.bDigest){
+		__uint16_t uLen;
+		__uint32_t uHash;
+		Digest(rsValue, uLen, uHash);
+		if ((uLen != rField.uDigestLen) || (uHash != rField.uDigestHash)){
+			ESP_LOGE(LOGTAG, "%s does not match the settings (%u instead of %u characters), dropped", rField.sKey, uLen, rField.uDigestLen);
+			rsValue = "";
+			return false;
+		}
 	}
+	return i || rsValue.length();
+}
+
+// FNV-1a, only has to tell a torn save from a complete one
+void Config::Digest(String& rsValue, __uint16_t& ruLen, __uint32_t& ruHash){
+	const char* s = rsValue.c_str();
+	ruLen = rsValue.length();
+	ruHash = 2166136261u;
+	for (__uint16_t u=0 ; u<ruLen ; u++){
+		ruHash ^= (__uint8_t)s[u];
+		ruHash *= 16777619u;
+	}
+}
+
+bool Config::WriteBigString(nvs_handle h, const char* sKey, String& rsValue){
 	int i = 0;
 	int iWritten = 0;
-	while (iWritten < rsValue.length()){
+	do {
 		String sKeyHelp = sKey;
 		if (i)
 			sKeyHelp += i;
-		String sSub = rsValue.substring(iWritten, iWritten+1900);
-		if (!WriteString(h, sKeyHelp.c_str(), sSub))
+		String sSub = rsValue.substring(iWritten, iWritten + BIGSTRING_CHUNK);
+		esp_err_t err = nvs_set_str(h, sKeyHelp.c_str(), sSub.c_str());
+		if (err != ESP_OK){
+			ESP_LOGE(LOGTAG, "  <%s>%d -> %d", sKeyHelp.c_str(), sSub.length(), err);
 			return false;
+		}
+		CountWrite(sSub.length() + 1);
 		i++;
-		iWritten += 1900;
+		iWritten += BIGSTRING_CHUNK;
+	} while ((iWritten < rsValue.length()) && (i < BIGSTRING_CHUNKS));
+	// chunks of a former, longer value
+	for ( ; i < BIGSTRING_CHUNKS ; i++){
+		String sKeyHelp = sKey;
+		sKeyHelp += i;
+		nvs_erase_key(h, sKeyHelp.c_str());
 	}
 	return true;
 }
-
-
-bool Config:: WriteBool(nvs_handle h, const char* sKey, bool bValue){
-	return (nvs_set_u8(h, sKey, bValue ? 1 : 0) == ESP_OK);
-}
-
-bool Config:: WriteInt(nvs_handle h, const char* sKey, int iValue){
-	return (nvs_set_u32(h, sKey, iValue) == ESP_OK);
-}
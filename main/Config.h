@@ -3,6 +3,23 @@
 
 #include "nvs.h"
 #include "String.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define DT_MAX_ENVIRONMENTS 3
+
+#define CONFIG_MAX_FIELDS	48
+#define CONFIG_BLOB_MAX		1900	// the settings blob has to fit into a single NVS page
+
+#define CONFIG_TYPE_BOOL		1
+#define CONFIG_TYPE_U8			2
+#define CONFIG_TYPE_U16			3
+#define CONFIG_TYPE_U32			4
+#define CONFIG_TYPE_I32			5
+#define CONFIG_TYPE_STRING		6
+#define CONFIG_TYPE_BIGSTRING	7	// own NVS keys, loaded on first use
+
+class PayloadWriter;
 
 class Config {
 public:
@@ -10,19 +27,74 @@ public:
 	virtual ~Config();
 
 	bool Read();
+	// saves what changed since the last Read or Write, can be called from any task
 	bool Write();
 
 	void ToggleAPMode() { mbAPMode = !mbAPMode; };
 
+	// big fields are not read at startup but on first use
+	String& GetSTAENTCA() { return LoadLazy(msSTAENTCA); };
+	String& GetWebServerCert() { return LoadLazy(msWebServerCert); };
+
+	// statistics of the saves, bytes are NVS entry bytes (32 per entry)
+	__uint32_t GetVersion() { return muVersion; };
+	__uint32_t GetWrites() { return muWrites; };
+	__uint32_t GetWritesSkipped() { return muWritesSkipped; };
+	__uint32_t GetLastWriteKeys() { return muLastWriteKeys; };
+	__uint32_t GetLastWriteBytes() { return muLastWriteBytes; };
+	__uint32_t GetWriteBytesTotal() { return muWriteBytesTotal; };
+
 private:
-	bool ReadString(nvs_handle h, const char* sKey, String& rsValue);
-	bool ReadBigString(nvs_handle h, const char* sKey, String& rsValue);
-	bool ReadBool(nvs_handle h, const char* sKey, bool& rbValue);
-	bool ReadInt(nvs_handle h, const char* sKey, int& rbValue);
-	bool WriteString(nvs_handle h, const char* sKey, String& rsValue);
+	/*
+	 * Schema of the configuration - every field is declared once in the constructor with its key, type,
+	 * default and max. length. All fields but the big strings are stored together in the "Settings" blob.
+	 */
+	typedef struct {
+		const char* sKey;
+		__uint8_t uType;
+		bool bLoaded;			// big strings only
+		bool bDigest;			// big strings only, length and hash of the stored value are known
+		__uint16_t uMaxLen;		// strings only
+		__uint16_t uDigestLen;
+		__uint32_t uDigestHash;
+		void* pValue;
+	} TConfigField;
+
+	void DeclareBool(const char* sKey, bool& rbValue, bool bDefault);
+	void DeclareU8(const char* sKey, __uint8_t& ruValue, __uint8_t uDefault);
+	void DeclareU16(const char* sKey, __uint16_t& ruValue, __uint16_t uDefault);
+	void DeclareU32(const char* sKey, __uint32_t& ruValue, __uint32_t uDefault);
+	void DeclareI32(const char* sKey, int& riValue, int iDefault);
+	void DeclareString(const char* sKey, String& rsValue, const char* sDefault, __uint16_t uMaxLen);
+	void DeclareBigString(const char* sKey, String& rsValue);
+	TConfigField* Declare(const char* sKey, __uint8_t uType, void* pValue);
+
+	bool Decode(const __uint8_t* pData, size_t uLen);
+	bool Encode(PayloadWriter& rWriter);
+	bool ReadLegacy(nvs_handle h);
+	void EraseLegacy(nvs_handle h);
+	String& LoadLazy(String& rsValue);
+
+	bool Save();
+	bool BlobChanged(PayloadWriter& rWriter);
+	void KeepBlob(const __uint8_t* pFields, size_t uLen);
+	bool ReadBigString(nvs_handle h, TConfigField& rField, String& rsValue);
 	bool WriteBigString(nvs_handle h, const char* sKey, String& rsValue);
-	bool WriteBool(nvs_handle h, const char* sKey, bool bValue);
-	bool WriteInt(nvs_handle h, const char* sKey, int bValue);
+	void CountWrite(size_t uDataLen);
+	static void Digest(String& rsValue, __uint16_t& ruLen, __uint32_t& ruHash);
+
+	TConfigField mFields[CONFIG_MAX_FIELDS];
+	__uint8_t muFieldCount;
+	__uint8_t* mpBlob;			// fields of the stored blob (without header) to compare with, NULL if unknown
+	size_t muBlobLen;
+	SemaphoreHandle_t mhLock;	// Write and LoadLazy are called from the web server tasks and the button handler
+
+	__uint32_t muVersion;
+	__uint32_t muWrites;
+	__uint32_t muWritesSkipped;
+	__uint32_t muLastWriteKeys;
+	__uint32_t muLastWriteBytes;
+	__uint32_t muWriteBytesTotal;
 
 public:
 	bool mbAPMode;
@@ -32,7 +104,6 @@ public:
 	String msSTASsid;
 	String msSTAPass;
 	String msSTAENTUser;
-	String msSTAENTCA;
 	String msHostname;
 	String msUfoId;
 	String msUfoName;
@@ -40,18 +111,29 @@ public:
 	String msDepartment;
 	String msLocation;
 
-    String msDTEnvIdOrUrl;
-    String msDTApiToken;
+    String msDTEnvIdOrUrl[DT_MAX_ENVIRONMENTS];
+    String msDTApiToken[DT_MAX_ENVIRONMENTS];
 	bool mbDTEnabled;
     int miDTInterval;
+	bool mbDTProblemDetails;
+	String msDTWebhookToken;
 
 	bool mbDTMonitoring;
+	bool mbDTMonitoringCbor;
+	bool mbDTPublicIpLookup;			// adds the public IP (looked up at api.ipify.org) to the device data
+	__uint8_t muDTMonitoringExporter;	// DT_EXPORTER_xxx
+	String msDTMonitoringUrl;			// collector of the HTTP exporter
+	String msMqttHost;					// empty for the broker configured at build time
+	__uint16_t muMqttPort;
 
 	bool mbWebServerUseSsl;
 	__uint16_t muWebServerPort;
-	String msWebServerCert;
 
 	__uint32_t muLastSTAIpAddress;
+
+private:
+	String msSTAENTCA;
+	String msWebServerCert;
 };
 
 #endif /* MAIN_CONFIG_H_ */
@@ -76,100 +76,6 @@ void DisplayCharter::SetMorph(__uint16_t period, __uint8_t mspeed){
 	ESP_LOGD("DisplayCharter", "SetMorph %d, %d", period, mspeed);
 }
 
-__uint16_t DisplayCharter::ParseLedArg(String& argument, __uint16_t iPos){
-	__uint8_t seg = 0;
-	String pos;
-	String count;
-	String color;
-	__uint16_t i=iPos;
-	while ((i < argument.length()) && (seg < 3)){
-		char c = argument.charAt(i);
-		if (c == '|')
-			seg++;
-		else switch(seg){
-			case 0:
-				pos+= c;
-				break;
-			case 1:
-				count += c;
-				break;
-			case 2:
-				color += c;
-		}
-		i++;
-	}
-	//pos.trim();
-	//count.trim();
-	//color.trim();
-	ESP_LOGD("DisplayCharter", "ParseLedArg %s, %s, %s", pos.c_str(), count.c_str(), color.c_str());
-
-
-	if ((pos.length() > 0) && (count.length() > 0) && (color.length() == 6)){
-		SetLeds(atoi(pos.c_str()), atoi(count.c_str()), strtol(color.substring(0, 2).c_str(), NULL, 16),
-												  	  strtol(color.substring(2, 4).c_str(), NULL, 16),
-													  strtol(color.substring(4, 6).c_str(), NULL, 16));
-	}
-	return i;
-}
-
-void DisplayCharter::ParseBgArg(String& argument){
-	if (argument.length() == 6)
-		SetBackground(	strtol(argument.substring(0, 2).c_str(), NULL, 16),
-						strtol(argument.substring(2, 4).c_str(), NULL, 16),
-						strtol(argument.substring(4, 6).c_str(), NULL, 16));
-}
-
-void DisplayCharter::ParseWhirlArg(String& argument){
-	__uint8_t seg = 0;
-	String wspeed;
-
-	for (__uint8_t i=0 ; i< argument.length() ; i++){
-		char c = argument.charAt(i);
-		if (c == '|'){
-			if (++seg == 2)
-				break;
-		}
-		else switch(seg){
-			case 0:
-				wspeed += c;
-				break;
-		}
-	}
-	//wspeed.trim();
-
-	if (wspeed.length() > 0){
-		SetWhirl(atoi(wspeed.c_str()), !seg);
-	}
-}
-
-void DisplayCharter::ParseMorphArg(String& argument){
-	__uint8_t seg = 0;
-	String period;
-	String mspeed;
-
-	for (__uint8_t i=0 ; i< argument.length() ; i++){
-		char c = argument.charAt(i);
-		if (c == '|'){
-			if (++seg == 2)
-				break;
-		}
-		else switch(seg){
-			case 0:
-				period += c;
-				break;
-			case 1:
-				mspeed += c;
-				break;
-		}
-	}
-  //period.trim();
-  //mspeed.trim();
-
-	if ((period.length() > 0) && (mspeed.length() > 0)){
-		SetMorph(atoi(period.c_str()), atoi(mspeed.c_str()));
-	}
-}
-
 void DisplayCharter::GetPixelColor(__uint8_t i, __uint8_t& ruR, __uint8_t& ruG, __uint8_t& ruB){
 
 	if(! mLedSet[i]){
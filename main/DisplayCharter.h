@@ -17,10 +17,6 @@ class DisplayCharter
     void SetBackground(__uint32_t color);
     void SetWhirl(__uint8_t wspeed, bool clockwise);
     void SetMorph(__uint16_t period, __uint8_t mspeed);
-    __uint16_t ParseLedArg(String& argument, __uint16_t iPos);
-    void ParseBgArg(String& argument);
-    void ParseWhirlArg(String& argument);
-    void ParseMorphArg(String& argument);
     void Display(DotstarStripe &dotstar, bool send);
 
   private:
@@ -28,7 +28,7 @@ void DisplayCharterLogo::Init(){
 }
 
 void DisplayCharterLogo::SetLed(__uint8_t uLed, __uint8_t r, __uint8_t g, __uint8_t b){
-	if (uLed <= 4){
+	if (uLed < 4){
 		mLedRed[uLed] 	= r;
 		mLedGreen[uLed] = g;
 		mLedBlue[uLed]  = b;
@@ -36,22 +36,6 @@ void DisplayCharterLogo::SetLed(__uint8_t uLed, __uint8_t r, __uint8_t g, __uint
 	}
 }
 
-void DisplayCharterLogo::ParseLogoLedArg(String& argument){
-	__uint16_t u=0;
-	__uint8_t uLed = 0;
-
-	while (u + 6 <= argument.length()){
-		SetLed(uLed, strtol(argument.substring(u + 0, u + 2).c_str(), NULL, 16),
-					 strtol(argument.substring(u + 2, u + 4).c_str(), NULL, 16),
-					 strtol(argument.substring(u + 4, u + 6).c_str(), NULL, 16));
-		uLed++;
-		u+= 6;
-		if ((u >= argument.length()) || (argument.charAt(u) != '|'))
-			break;
-		u++;
-	}
-}
-
 void DisplayCharterLogo::Display(DotstarStripe &dotstar){
 	if (mbChanged || !muSendAnywayCount){
 		for (__uint8_t u=0 ; u<4 ; u++)
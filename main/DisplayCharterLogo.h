@@ -12,7 +12,6 @@ public:
 	void Init();
 
 	void SetLed(__uint8_t uLed, __uint8_t r, __uint8_t g, __uint8_t b);
-	void ParseLogoLedArg(String& argument);
 
 
 	void Display(DotstarStripe &dotstar);
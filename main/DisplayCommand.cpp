@@ -0,0 +1,346 @@
+#include "DisplayCommand.h"
+#include "DisplayCharter.h"
+#include "DisplayCharterLogo.h"
+#include "LatencyHistogram.h"
+#include <esp_log.h>
+
+static const char* LOGTAG = "DisplayCommand";
+
+#define COMMAND_METRIC	"ufo_display_command_seconds"
+#define COMMAND_HELP	"Compiling and executing display commands"
+static LatencyHistogram latencyCompile(COMMAND_METRIC, COMMAND_HELP, "phase=\"compile\"");
+static LatencyHistogram latencyExecute(COMMAND_METRIC, COMMAND_HELP, "phase=\"execute\"");
+static LatencyHistogram latencyApply(COMMAND_METRIC, COMMAND_HELP, "phase=\"apply\"");
+
+#if DC_RING_LEDS != RING_LEDCOUNT
+#error "DC_RING_LEDS has to match the LEDs of a ring"
+#endif
+
+DisplayCommand::DisplayCommand() {
+	mpCode = NULL;
+	muLength = 0;
+	muCapacity = 0;
+	mpTop = NULL;
+	mpBottom = NULL;
+	mpLogo = NULL;
+}
+
+DisplayCommand::~DisplayCommand() {
+	Clear();
+}
+
+void DisplayCommand::Clear(){
+	free(mpCode);
+	mpCode = NULL;
+	muLength = 0;
+	muCapacity = 0;
+}
+
+void DisplayCommand::Swap(DisplayCommand& rOther){
+	__uint8_t* pCode = mpCode;
+	__uint16_t uLength = muLength;
+	__uint16_t uCapacity = muCapacity;
+	mpCode = rOther.mpCode;
+	muLength = rOther.muLength;
+	muCapacity = rOther.muCapacity;
+	rOther.mpCode = pCode;
+	rOther.muLength = uLength;
+	rOther.muCapacity = uCapacity;
+}
+
+__uint8_t DisplayCommand::GetInstructionLength(__uint8_t uOp){
+	switch (uOp){
+		case DC_OP_INIT:		return 2;
+		case DC_OP_LEDS:		return 7;
+		case DC_OP_BACKGROUND:	return 5;
+		case DC_OP_WHIRL:		return 4;
+		case DC_OP_MORPH:		return 5;
+		case DC_OP_LOGO:		return 5;
+		case DC_OP_LOGO_RESET:	return 1;
+		case DC_OP_FRAME:		return 2 + 3 * DC_RING_LEDS;
+	}
+	return 0;
+}
+
+bool DisplayCommand::Compile(const char* sApi){
+	std::list<TParam> params;
+	UrlParser parser;
+	parser.ParseQuery(sApi, strlen(sApi), params);
+	return Compile(params);
+}
+
+bool DisplayCommand::Compile(std::list<TParam>& params){
+	__uint64_t uStart = LatencyHistogram::Start();
+	muLength = 0;
+	bool bOk = Translate(params);
+	if (!bOk){
+		ESP_LOGE(LOGTAG, "out of memory");
+		muLength = 0;
+	}
+	latencyCompile.RecordSince(uStart);
+	return bOk;
+}
+
+void DisplayCommand::Apply(std::list<TParam>& params, DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo){
+	__uint64_t uStart = LatencyHistogram::Start();
+	DisplayCommand command;
+	command.mpTop = pTop;
+	command.mpBottom = pBottom;
+	command.mpLogo = pLogo;
+	command.Translate(params);
+	latencyApply.RecordSince(uStart);
+}
+
+void DisplayCommand::Execute(DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo){
+	__uint64_t uStart = LatencyHistogram::Start();
+	ExecuteCode(mpCode, muLength, pTop, pBottom, pLogo);
+	latencyExecute.RecordSince(uStart);
+}
+
+// the one parser of /api params, every instruction goes through Emit
+bool DisplayCommand::Translate(std::list<TParam>& params){
+	bool bOk = true;
+	std::list<TParam>::iterator it = params.begin();
+	while (bOk && (it != params.end())){
+
+		if ((*it).paramName == "top_init")
+			bOk = Emit(DC_OP_INIT, DC_RING_TOP);
+		else if ((*it).paramName == "top")
+			bOk = CompileLedArg(DC_RING_TOP, (*it).paramValue);
+		else if ((*it).paramName == "top_bg")
+			bOk = CompileBgArg(DC_RING_TOP, (*it).paramValue);
+		else if ((*it).paramName == "top_whirl")
+			bOk = CompileWhirlArg(DC_RING_TOP, (*it).paramValue);
+		else if ((*it).paramName == "top_morph")
+			bOk = CompileMorphArg(DC_RING_TOP, (*it).paramValue);
+
+		else if ((*it).paramName == "bottom_init")
+			bOk = Emit(DC_OP_INIT, DC_RING_BOTTOM);
+		else if ((*it).paramName == "bottom")
+			bOk = CompileLedArg(DC_RING_BOTTOM, (*it).paramValue);
+		else if ((*it).paramName == "bottom_bg")
+			bOk = CompileBgArg(DC_RING_BOTTOM, (*it).paramValue);
+		else if ((*it).paramName == "bottom_whirl")
+			bOk = CompileWhirlArg(DC_RING_BOTTOM, (*it).paramValue);
+		else if ((*it).paramName == "bottom_morph")
+			bOk = CompileMorphArg(DC_RING_BOTTOM, (*it).paramValue);
+
+		else if ((*it).paramName == "logo")
+			bOk = CompileLogoLedArg((*it).paramValue);
+		else if ((*it).paramName == "logo_reset")
+			bOk = Emit(DC_OP_LOGO_RESET);
+
+		it++;
+	}
+	return bOk;
+}
+
+bool DisplayCommand::ValidatePacket(const __uint8_t* pPacket, size_t uLen){
+	if ((uLen < DC_HEADER_LENGTH) || (uLen > DC_MAX_PACKET) || (pPacket[0] != DC_MAGIC) || (pPacket[1] != DC_VERSION))
+		return false;
+
+	size_t uPos = DC_HEADER_LENGTH;
+	while (uPos < uLen){
+		const __uint8_t* p = pPacket + uPos;
+		__uint8_t uInstrLen = GetInstructionLength(p[0]);
+		if (!uInstrLen || (uPos + uInstrLen > uLen))
+			return false;
+		switch (p[0]){
+			case DC_OP_LOGO:
+				if (p[1] >= 4)
+					return false;
+				break;
+			case DC_OP_LOGO_RESET:
+				break;
+			case DC_OP_WHIRL:
+				if (p[3] > 1)
+					return false;
+				// no break
+			default:
+				if (p[1] > DC_RING_BOTTOM)
+					return false;
+		}
+		uPos += uInstrLen;
+	}
+	return true;
+}
+
+void DisplayCommand::ExecutePacket(const __uint8_t* pPacket, size_t uLen, DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo){
+	__uint64_t uStart = LatencyHistogram::Start();
+	ExecuteCode(pPacket + DC_HEADER_LENGTH, uLen - DC_HEADER_LENGTH, pTop, pBottom, pLogo);
+	latencyExecute.RecordSince(uStart);
+}
+
+void DisplayCommand::ExecuteCode(const __uint8_t* pCode, size_t uLen, DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo){
+	size_t uPos = 0;
+
+	while (uPos < uLen){
+		const __uint8_t* p = pCode + uPos;
+		__uint8_t uInstrLen = GetInstructionLength(p[0]);
+		if (!uInstrLen || (uPos + uInstrLen > uLen))
+			break;
+		uPos += uInstrLen;
+
+		if (p[0] == DC_OP_LOGO){
+			pLogo->SetLed(p[1], p[2], p[3], p[4]);
+			continue;
+		}
+		if (p[0] == DC_OP_LOGO_RESET){
+			pLogo->Init();
+			continue;
+		}
+		DisplayCharter* pRing = (p[1] == DC_RING_TOP) ? pTop : pBottom;
+		switch (p[0]){
+			case DC_OP_INIT:
+				pRing->Init();
+				break;
+			case DC_OP_LEDS:
+				pRing->SetLeds(p[2], p[3], p[4], p[5], p[6]);
+				break;
+			case DC_OP_BACKGROUND:
+				pRing->SetBackground(p[2], p[3], p[4]);
+				break;
+			case DC_OP_WHIRL:
+				pRing->SetWhirl(p[2], p[3]);
+				break;
+			case DC_OP_MORPH:
+				pRing->SetMorph(p[2] | (p[3] << 8), p[4]);
+				break;
+			case DC_OP_FRAME:
+				for (__uint8_t i=0 ; i<DC_RING_LEDS ; i++)
+					pRing->SetLeds(i, 1, p[2 + 3 * i], p[3 + 3 * i], p[4 + 3 * i]);
+				break;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------
+
+bool DisplayCommand::Emit(__uint8_t uOp, __uint8_t u0, __uint8_t u1, __uint8_t u2, __uint8_t u3, __uint8_t u4, __uint8_t u5){
+	__uint8_t uLen = GetInstructionLength(uOp);
+	const __uint8_t instruction[] = { uOp, u0, u1, u2, u3, u4, u5 };
+	if (mpTop){
+		ExecuteCode(instruction, uLen, mpTop, mpBottom, mpLogo);
+		return true;
+	}
+	if (muLength + uLen > muCapacity){
+		__uint16_t uCapacity = muCapacity ? muCapacity * 2 : 32;
+		__uint8_t* pCode = (__uint8_t*)realloc(mpCode, uCapacity);
+		if (!pCode)
+			return false;
+		mpCode = pCode;
+		muCapacity = uCapacity;
+	}
+	memcpy(mpCode + muLength, instruction, uLen);
+	muLength += uLen;
+	return true;
+}
+
+// pos|count|color, repeated - same rules as the former DisplayCharter::ParseLedArg
+bool DisplayCommand::CompileLedArg(__uint8_t uRing, String& argument){
+	__uint16_t i = 0;
+	while (i < argument.length()){
+		__uint8_t seg = 0;
+		String pos;
+		String count;
+		String color;
+		while ((i < argument.length()) && (seg < 3)){
+			char c = argument.charAt(i);
+			if (c == '|')
+				seg++;
+			else switch(seg){
+				case 0:
+					pos += c;
+					break;
+				case 1:
+					count += c;
+					break;
+				case 2:
+					color += c;
+			}
+			i++;
+		}
+		if ((pos.length() > 0) && (count.length() > 0) && (color.length() == 6)){
+			if (!Emit(DC_OP_LEDS, uRing, atoi(pos.c_str()), atoi(count.c_str()),
+					strtol(color.substring(0, 2).c_str(), NULL, 16),
+					strtol(color.substring(2, 4).c_str(), NULL, 16),
+					strtol(color.substring(4, 6).c_str(), NULL, 16)))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool DisplayCommand::CompileBgArg(__uint8_t uRing, String& argument){
+	if (argument.length() != 6)
+		return true;
+	return Emit(DC_OP_BACKGROUND, uRing,
+			strtol(argument.substring(0, 2).c_str(), NULL, 16),
+			strtol(argument.substring(2, 4).c_str(), NULL, 16),
+			strtol(argument.substring(4, 6).c_str(), NULL, 16));
+}
+
+// speed|direction, any direction makes it counter clockwise
+bool DisplayCommand::CompileWhirlArg(__uint8_t uRing, String& argument){
+	__uint8_t seg = 0;
+	String wspeed;
+
+	for (__uint8_t i=0 ; i< argument.length() ; i++){
+		char c = argument.charAt(i);
+		if (c == '|'){
+			if (++seg == 2)
+				break;
+		}
+		else if (!seg)
+			wspeed += c;
+	}
+	if (!wspeed.length())
+		return true;
+	return Emit(DC_OP_WHIRL, uRing, atoi(wspeed.c_str()), !seg);
+}
+
+bool DisplayCommand::CompileMorphArg(__uint8_t uRing, String& argument){
+	__uint8_t seg = 0;
+	String period;
+	String mspeed;
+
+	for (__uint8_t i=0 ; i< argument.length() ; i++){
+		char c = argument.charAt(i);
+		if (c == '|'){
+			if (++seg == 2)
+				break;
+		}
+		else switch(seg){
+			case 0:
+				period += c;
+				break;
+			case 1:
+				mspeed += c;
+				break;
+		}
+	}
+	if (!period.length() || !mspeed.length())
+		return true;
+	__uint16_t uPeriod = atoi(period.c_str());
+	return Emit(DC_OP_MORPH, uRing, uPeriod, uPeriod >> 8, atoi(mspeed.c_str()));
+}
+
+// color|color|color|color
+bool DisplayCommand::CompileLogoLedArg(String& argument){
+	__uint16_t u=0;
+	__uint8_t uLed = 0;
+
+	while ((u + 6 <= argument.length()) && (uLed < 4)){
+		if (!Emit(DC_OP_LOGO, uLed,
+				strtol(argument.substring(u + 0, u + 2).c_str(), NULL, 16),
+				strtol(argument.substring(u + 2, u + 4).c_str(), NULL, 16),
+				strtol(argument.substring(u + 4, u + 6).c_str(), NULL, 16)))
+			return false;
+		uLed++;
+		u+= 6;
+		if ((u >= argument.length()) || (argument.charAt(u) != '|'))
+			break;
+		u++;
+	}
+	return true;
+}
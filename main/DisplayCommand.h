@@ -0,0 +1,82 @@
+#ifndef MAIN_DISPLAYCOMMAND_H_
+#define MAIN_DISPLAYCOMMAND_H_
+
+#include "freertos/FreeRTOS.h"
+#include "UrlParser.h"
+#include <list>
+
+// opcodes, each followed by its fixed size arguments
+#define DC_OP_INIT			0x01	// ring
+#define DC_OP_LEDS			0x02	// ring, pos, count, r, g, b
+#define DC_OP_BACKGROUND	0x03	// ring, r, g, b
+#define DC_OP_WHIRL			0x04	// ring, speed, clockwise
+#define DC_OP_MORPH			0x05	// ring, period (u16 LE), speed
+#define DC_OP_LOGO			0x06	// led, r, g, b
+#define DC_OP_LOGO_RESET	0x07
+#define DC_OP_FRAME			0x08	// ring, r, g, b of all DC_RING_LEDS LEDs
+
+#define DC_RING_LEDS		15
+
+#define DC_RING_TOP			0
+#define DC_RING_BOTTOM		1
+
+// binary packets (POST /api with any other content type than a form, MQTT commands) start with magic and version
+#define DC_MAGIC			0xDC
+#define DC_VERSION			1
+#define DC_HEADER_LENGTH	2
+#define DC_MAX_PACKET		1024
+
+class DisplayCharter;
+class DisplayCharterLogo;
+
+/*
+ * An /api call compiled into a compact binary program - parsing the arguments is done once when compiling,
+ * executing the program only calls the setters of the display charters.
+ */
+class DisplayCommand {
+public:
+	DisplayCommand();
+	virtual ~DisplayCommand();
+
+	bool Compile(std::list<TParam>& params);
+	bool Compile(const char* sApi);		// "/api?top_init&top=0|15|ff0000..." as stored in the ApiStore
+	void Clear();
+	void Swap(DisplayCommand& rOther);	// exchanges the programs, nothing is allocated or freed
+
+	void Execute(DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo);
+
+	// an /api call that is applied once: every instruction is executed as soon as it is parsed, no program is built
+	static void Apply(std::list<TParam>& params, DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo);
+
+	// a packet is validated completely before anything of it is executed, both work on the caller's buffer
+	static bool IsPacket(const char* pData, size_t uLen) { return uLen && ((__uint8_t)pData[0] == DC_MAGIC); };
+	static bool ValidatePacket(const __uint8_t* pPacket, size_t uLen);
+	static void ExecutePacket(const __uint8_t* pPacket, size_t uLen, DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo);
+
+	const __uint8_t* GetCode() { return mpCode; };
+	__uint16_t GetLength() { return muLength; };
+
+	// length of an instruction including the opcode, 0 for an unknown opcode
+	static __uint8_t GetInstructionLength(__uint8_t uOp);
+
+private:
+	bool Translate(std::list<TParam>& params);
+	static void ExecuteCode(const __uint8_t* pCode, size_t uLen, DisplayCharter* pTop, DisplayCharter* pBottom, DisplayCharterLogo* pLogo);
+	bool Emit(__uint8_t uOp, __uint8_t u0 = 0, __uint8_t u1 = 0, __uint8_t u2 = 0, __uint8_t u3 = 0, __uint8_t u4 = 0, __uint8_t u5 = 0);
+	bool CompileLedArg(__uint8_t uRing, String& argument);
+	bool CompileBgArg(__uint8_t uRing, String& argument);
+	bool CompileWhirlArg(__uint8_t uRing, String& argument);
+	bool CompileMorphArg(__uint8_t uRing, String& argument);
+	bool CompileLogoLedArg(String& argument);
+
+	__uint8_t* mpCode;
+	__uint16_t muLength;
+	__uint16_t muCapacity;
+
+	// set while applying, Emit executes the instruction instead of appending it
+	DisplayCharter* mpTop;
+	DisplayCharter* mpBottom;
+	DisplayCharterLogo* mpLogo;
+};
+
+#endif /* MAIN_DISPLAYCOMMAND_H_ */
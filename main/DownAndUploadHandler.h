@@ -8,6 +8,7 @@ public:
 	virtual bool OnReceiveBegin(unsigned short int httpStatusCode, bool isContentLength, unsigned int contentLength) =0;
 	virtual bool OnReceiveBegin(String& sUrl, unsigned int contentLength) =0;
 	virtual bool OnReceiveEnd() =0;
+	// buf points into the receive buffer of the connection and is only valid during the call
 	virtual bool OnReceiveData(char* buf, int len) =0; // =0 means pure virtual; must override
 };
 
@@ -1,13 +1,16 @@
 #include "DynamicRequestHandler.h"
 #include "Ufo.h"
 #include "DisplayCharter.h"
+#include "DisplayCommand.h"
 #include "Config.h"
 #include "DynatraceAction.h"
 #include "esp_system.h"
+#include <esp_timer.h>
 #include <esp_log.h>
 #include "Ota.h"
 #include "String.h"
 #include "WebClient.h"
+#include "LatencyHistogram.h"
 
 static char tag[] = "DynamicRequestHandler";
 
@@ -30,53 +33,49 @@ DynamicRequestHandler::~DynamicRequestHandler() {
 
 }
 
-bool DynamicRequestHandler::HandleApiRequest(std::list<TParam>& params, HttpResponse& rResponse){
-
-    DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle API Request");	
+// applies the display instructions of an /api call, also used for commands not coming in via HTTP
+void DynamicRequestHandler::ApplyApiParams(std::list<TParam>& params){
 
 	mpUfo->IndicateApiCall();
 
-	String sBody;
+	// preset=<n> replays the program compiled when the preset was saved, the other params are applied after it
+	mpUfo->GetSceneLock().Enter(0);
 	std::list<TParam>::iterator it = params.begin();
 	while (it != params.end()){
-
-		if ((*it).paramName == "top_init")
-			mpDisplayCharterLevel1->Init();
-		else if ((*it).paramName == "top"){
-			__uint16_t i = 0;
-			 while (i < (*it).paramValue.length())
-				 i = mpDisplayCharterLevel1->ParseLedArg((*it).paramValue, i);
+		if ((*it).paramName == "preset"){
+			DisplayCommand* pProgram = mpUfo->GetApiStore().GetProgram(strtol((*it).paramValue.c_str(), NULL, 10) - 1);
+			if (pProgram)
+				pProgram->Execute(mpDisplayCharterLevel1, mpDisplayCharterLevel2, &mpUfo->GetLogoDisplay());
 		}
-		else if ((*it).paramName == "top_bg")
-			mpDisplayCharterLevel1->ParseBgArg((*it).paramValue);
-		else if ((*it).paramName == "top_whirl")
-			mpDisplayCharterLevel1->ParseWhirlArg((*it).paramValue);
-		else if ((*it).paramName == "top_morph")
-			mpDisplayCharterLevel1->ParseMorphArg((*it).paramValue);
-
-		if ((*it).paramName == "bottom_init")
-			mpDisplayCharterLevel2->Init();
-		else if ((*it).paramName == "bottom"){
-			__uint16_t i = 0;
-			 while (i < (*it).paramValue.length())
-				 i = mpDisplayCharterLevel2->ParseLedArg((*it).paramValue, i);
-		}
-		else if ((*it).paramName == "bottom_bg")
-			mpDisplayCharterLevel2->ParseBgArg((*it).paramValue);
-		else if ((*it).paramName == "bottom_whirl")
-			mpDisplayCharterLevel2->ParseWhirlArg((*it).paramValue);
-		else if ((*it).paramName == "bottom_morph")
-			mpDisplayCharterLevel2->ParseMorphArg((*it).paramValue);
-
-		else if ((*it).paramName == "logo")
-			mpUfo->GetLogoDisplay().ParseLogoLedArg((*it).paramValue);
-		else if ((*it).paramName == "logo_reset")
-			mpUfo->GetLogoDisplay().Init();
+		it++;
+	}
 
+	DisplayCommand::Apply(params, mpDisplayCharterLevel1, mpDisplayCharterLevel2, &mpUfo->GetLogoDisplay());
+	mpUfo->GetSceneLock().Leave();
+}
 
-		it++;
+// binary display commands (see DisplayCommand.h), nothing is applied unless the whole packet is valid
+bool DynamicRequestHandler::ApplyApiPacket(const __uint8_t* pPacket, size_t uLen){
+	bool bValid = DisplayCommand::ValidatePacket(pPacket, uLen);
+	mpUfo->CountApiPacket(bValid);
+	if (!bValid){
+		ESP_LOGW(tag, "invalid display command packet, %u bytes", uLen);
+		return false;
 	}
+	mpUfo->IndicateApiCall();
+	mpUfo->GetSceneLock().Enter(0);
+	DisplayCommand::ExecutePacket(pPacket, uLen, mpDisplayCharterLevel1, mpDisplayCharterLevel2, &mpUfo->GetLogoDisplay());
+	mpUfo->GetSceneLock().Leave();
+	return true;
+}
+
+bool DynamicRequestHandler::HandleApiRequest(std::list<TParam>& params, HttpResponse& rResponse){
+
+    DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle API Request");	
 
+	ApplyApiParams(params);
+
+	String sBody;
 	rResponse.AddHeader(HttpResponse::HeaderNoCache);
 	rResponse.SetRetCode(200);	
 	mpUfo->dt.leaveAction(dtHandleRequest);
@@ -84,6 +83,17 @@ bool DynamicRequestHandler::HandleApiRequest(std::list<TParam>& params, HttpResp
 	return rResponse.Send(sBody.c_str(), sBody.length());
 }
 
+bool DynamicRequestHandler::HandleApiPacketRequest(String& sBody, HttpResponse& rResponse){
+
+    DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle API Packet Request");
+
+	rResponse.AddHeader(HttpResponse::HeaderNoCache);
+	rResponse.SetRetCode(ApplyApiPacket((const __uint8_t*)sBody.c_str(), sBody.length()) ? 200 : 400);
+	mpUfo->dt.leaveAction(dtHandleRequest);
+
+	return rResponse.Send(NULL, 0);
+}
+
 bool DynamicRequestHandler::HandleApiListRequest(std::list<TParam>& params, HttpResponse& rResponse){
     DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle API List Request");	
 	String sBody;
@@ -170,9 +180,50 @@ bool DynamicRequestHandler::HandleInfoRequest(std::list<TParam>& params, HttpRes
 	sBody.printf("\"department\":\"%s\",", mpUfo->GetConfig().msDepartment.c_str());
 	sBody.printf("\"location\":\"%s\",", mpUfo->GetConfig().msLocation.c_str());
 	sBody.printf("\"dtenabled\":\"%u\",", mpUfo->GetConfig().mbDTEnabled);
-	sBody.printf("\"dtenvid\":\"%s\",", mpUfo->GetConfig().msDTEnvIdOrUrl.c_str());
+	sBody.printf("\"dtenvid\":\"%s\",", mpUfo->GetConfig().msDTEnvIdOrUrl[0].c_str());
+	for (__uint8_t i=1 ; i<DT_MAX_ENVIRONMENTS ; i++)
+		sBody.printf("\"dtenvid%u\":\"%s\",", i + 1, mpUfo->GetConfig().msDTEnvIdOrUrl[i].c_str());
 	//sBody.printf("\"dtapitoken\":\"%s\",", mpUfo->GetConfig().msDTApiToken.c_str());
 	sBody.printf("\"dtinterval\":\"%u\",", mpUfo->GetConfig().miDTInterval);
+	sBody.printf("\"dtdetails\":\"%u\",", mpUfo->GetConfig().mbDTProblemDetails);
+	sBody.printf("\"dtwebhook\":\"%u\",", mpUfo->GetConfig().msDTWebhookToken.length() ? 1 : 0);
+	sBody.printf("\"dtactionpool\":\"%u\",", mpUfo->dt.getPoolInUse());
+	sBody.printf("\"dtactionpoolmax\":\"%u\",", mpUfo->dt.getPoolHighWater());
+	sBody.printf("\"dtactionpoolsize\":\"%u\",", DT_ACTION_POOL_SIZE);
+	sBody.printf("\"dtbatchessent\":\"%u\",", mpUfo->dt.getBatchesSent());
+	sBody.printf("\"dtbatcheswaiting\":\"%u\",", mpUfo->dt.getBatchesWaiting());
+	sBody.printf("\"dtbatchesdropped\":\"%u\",", mpUfo->dt.getBatchesDropped());
+	sBody.printf("\"dtbytescopied\":\"%u\",", mpUfo->dt.getBytesCopied());
+	sBody.printf("\"awspublished\":\"%u\",", mpUfo->GetAWSIntegration().GetPublished());
+	sBody.printf("\"awsbytescopied\":\"%u\",", mpUfo->GetAWSIntegration().GetBytesCopied());
+	sBody.printf("\"awscommands\":\"%u\",", mpUfo->GetAWSIntegration().GetCommands());
+	sBody.printf("\"awscommandsrejected\":\"%u\",", mpUfo->GetAWSIntegration().GetCommandsRejected());
+	sBody.printf("\"cfgversion\":\"%u\",", mpUfo->GetConfig().GetVersion());
+	sBody.printf("\"cfgwrites\":\"%u\",", mpUfo->GetConfig().GetWrites());
+	sBody.printf("\"cfgwritesskipped\":\"%u\",", mpUfo->GetConfig().GetWritesSkipped());
+	sBody.printf("\"cfglastwritekeys\":\"%u\",", mpUfo->GetConfig().GetLastWriteKeys());
+	sBody.printf("\"cfglastwritebytes\":\"%u\",", mpUfo->GetConfig().GetLastWriteBytes());
+	sBody.printf("\"cfgwritebytes\":\"%u\",", mpUfo->GetConfig().GetWriteBytesTotal());
+	sBody.printf("\"apipresets\":\"%u\",", mpUfo->GetApiStore().GetCount());
+	sBody.printf("\"apimaxpresets\":\"%u\",", API_MAX_PRESETS);
+	sBody.printf("\"apiwrites\":\"%u\",", mpUfo->GetApiStore().GetWrites());
+	sBody.printf("\"apilastwritebytes\":\"%u\",", mpUfo->GetApiStore().GetLastWriteBytes());
+	sBody.printf("\"apiwritebytes\":\"%u\",", mpUfo->GetApiStore().GetWriteBytesTotal());
+	sBody.printf("\"apipackets\":\"%u\",", mpUfo->GetApiPackets());
+	sBody.printf("\"apipacketsrejected\":\"%u\",", mpUfo->GetApiPacketsRejected());
+	sBody.printf("\"streamport\":\"%u\",", FRAME_STREAM_PORT);
+	sBody.printf("\"streamframes\":\"%u\",", mpUfo->GetFrameStream().GetFramesAccepted());
+	sBody.printf("\"streamlate\":\"%u\",", mpUfo->GetFrameStream().GetFramesLate());
+	sBody.printf("\"streaminvalid\":\"%u\",", mpUfo->GetFrameStream().GetFramesInvalid());
+	sBody.printf("\"streamreplaced\":\"%u\",", mpUfo->GetFrameStream().GetFramesReplaced());
+	sBody.printf("\"streamshown\":\"%u\",", mpUfo->GetFrameStream().GetFramesShown());
+	sBody.printf("\"dtmonitoringcbor\":\"%u\",", mpUfo->GetConfig().mbDTMonitoringCbor);
+	sBody.printf("\"dtpubliciplookup\":\"%u\",", mpUfo->GetConfig().mbDTPublicIpLookup);
+	sBody.printf("\"dtexporter\":\"%u\",", mpUfo->GetConfig().muDTMonitoringExporter);
+	sBody.printf("\"dtexporteractive\":\"%s\",", mpUfo->dt.getExporterName());
+	sBody.printf("\"dtmonitoringurl\":\"%s\",", mpUfo->GetConfig().msDTMonitoringUrl.c_str());
+	sBody.printf("\"mqtthost\":\"%s\",", mpUfo->GetConfig().msMqttHost.c_str());
+	sBody.printf("\"mqttport\":\"%u\",", mpUfo->GetConfig().muMqttPort);
 	sBody.printf("\"dtmonitoring\":\"%u\"", mpUfo->GetConfig().mbDTMonitoring);
 	sBody += '}';
 
@@ -183,12 +234,60 @@ bool DynamicRequestHandler::HandleInfoRequest(std::list<TParam>& params, HttpRes
 	return rResponse.Send(sBody.c_str(), sBody.length());
 }
 
+// batches kept by the ring log exporter
+bool DynamicRequestHandler::HandleMonitoringLogRequest(std::list<TParam>& params, HttpResponse& rResponse){
+	String sBody;
+	mpUfo->dt.getRingLog().WriteJson(sBody);
+	rResponse.AddHeader(HttpResponse::HeaderContentTypeJson);
+	rResponse.AddHeader(HttpResponse::HeaderNoCache);
+	rResponse.SetRetCode(200);
+	return rResponse.Send(sBody.c_str(), sBody.length());
+}
+
+// latency histograms - JSON by default, "format=prometheus" returns the Prometheus text format
+// (no monitoring action here, scraping would flood the monitoring data)
+bool DynamicRequestHandler::HandleMetricsRequest(std::list<TParam>& params, HttpResponse& rResponse){
+
+	bool bPrometheus = false;
+	std::list<TParam>::iterator it = params.begin();
+	while (it != params.end()){
+		if ((*it).paramName == "format")
+			bPrometheus = ((*it).paramValue == "prometheus");
+		it++;
+	}
+
+	String sBody;
+	if (bPrometheus){
+		LatencyHistogram::WritePrometheus(sBody);
+		rResponse.AddHeader(HttpResponse::HeaderContentTypeText);
+	}
+	else{
+		LatencyHistogram::WriteJson(sBody);
+		rResponse.AddHeader(HttpResponse::HeaderContentTypeJson);
+	}
+	rResponse.AddHeader(HttpResponse::HeaderNoCache);
+	rResponse.SetRetCode(200);
+	return rResponse.Send(sBody.c_str(), sBody.length());
+}
+
+// "dtenvid" addresses the first environment, "dtenvid2", "dtenvid3",... the additional ones
+__uint8_t DynamicRequestHandler::GetEnvironmentIndex(String& sParamName, unsigned int uPrefixLength){
+	if (sParamName.length() == uPrefixLength)
+		return 0;
+	int i = atoi(sParamName.c_str() + uPrefixLength);
+	if ((i < 2) || (i > DT_MAX_ENVIRONMENTS))
+		return 0xff;
+	return i - 1;
+}
+
 bool DynamicRequestHandler::HandleDynatraceIntegrationRequest(std::list<TParam>& params, HttpResponse& rResponse){
 
     DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle Dynatrace Integration Request");	
-	String sEnvId;
-	String sApiToken;
+	String sEnvId[DT_MAX_ENVIRONMENTS];
+	String sApiToken[DT_MAX_ENVIRONMENTS];
 	bool bEnabled = false;
+	bool bDetails = false;
+	String sWebhookToken;
 	int iInterval = 0;
 
 	String sBody;
@@ -197,20 +296,35 @@ bool DynamicRequestHandler::HandleDynatraceIntegrationRequest(std::list<TParam>&
 	while (it != params.end()){
 		if ((*it).paramName == "dtenabled")
 			bEnabled = (*it).paramValue;
-		else if ((*it).paramName == "dtenvid")
-			sEnvId = (*it).paramValue;
-		else if ((*it).paramName == "dtapitoken")
-			sApiToken = (*it).paramValue;
 		else if ((*it).paramName == "dtinterval")
 			iInterval = (*it).paramValue.toInt();
+		else if ((*it).paramName == "dtdetails")
+			bDetails = (*it).paramValue;
+		else if ((*it).paramName == "dtwebhooktoken")
+			sWebhookToken = (*it).paramValue;
+		else if ((*it).paramName.startsWith("dtenvid")){
+			__uint8_t u = GetEnvironmentIndex((*it).paramName, 7);
+			if (u < DT_MAX_ENVIRONMENTS)
+				sEnvId[u] = (*it).paramValue;
+		}
+		else if ((*it).paramName.startsWith("dtapitoken")){
+			__uint8_t u = GetEnvironmentIndex((*it).paramName, 10);
+			if (u < DT_MAX_ENVIRONMENTS)
+				sApiToken[u] = (*it).paramValue;
+		}
 		it++;
 	}
 
 	mpUfo->GetConfig().mbDTEnabled = bEnabled;
-	mpUfo->GetConfig().msDTEnvIdOrUrl = sEnvId;
-	if (sApiToken.length())
-		mpUfo->GetConfig().msDTApiToken = sApiToken;
+	for (__uint8_t i=0 ; i<DT_MAX_ENVIRONMENTS ; i++){
+		mpUfo->GetConfig().msDTEnvIdOrUrl[i] = sEnvId[i];
+		if (sApiToken[i].length())
+			mpUfo->GetConfig().msDTApiToken[i] = sApiToken[i];
+	}
 	mpUfo->GetConfig().miDTInterval = iInterval;
+	mpUfo->GetConfig().mbDTProblemDetails = bDetails;
+	if (sWebhookToken.length())
+		mpUfo->GetConfig().msDTWebhookToken = (sWebhookToken == "-") ? "" : sWebhookToken;
 
 	if (mpUfo->GetConfig().Write())
 		mpUfo->GetDtIntegration().ProcessConfigChange();
@@ -229,13 +343,41 @@ bool DynamicRequestHandler::HandleDynatraceMonitoringRequest(std::list<TParam>&
 
     DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle Dynatrace Monitoring Request");	
 	bool bEnabled = false;
+	bool bCbor = false;
+	bool bPublicIp = false;
+
+	__uint8_t uExporter = mpUfo->GetConfig().muDTMonitoringExporter;
 
 	String sBody;
 
+	// an unknown exporter would fall back to MQTT silently, so the request is rejected before anything changes
 	std::list<TParam>::iterator it = params.begin();
+	while (it != params.end()){
+		if (((*it).paramName == "dtexporter") && !TelemetryExporter::ParseType((*it).paramValue.c_str(), uExporter)){
+			ESP_LOGW(tag, "unknown exporter: %s", (*it).paramValue.c_str());
+			sBody = "Invalid dtexporter.";
+			rResponse.AddHeader(HttpResponse::HeaderNoCache);
+			rResponse.SetRetCode(400);
+			mpUfo->dt.leaveAction(dtHandleRequest);
+			return rResponse.Send(sBody.c_str(), sBody.length());
+		}
+		it++;
+	}
+
+	it = params.begin();
 	while (it != params.end()){
 		if ((*it).paramName == "dtmonitoring")
 			bEnabled = (*it).paramValue;
+		else if ((*it).paramName == "dtmonitoringcbor")
+			bCbor = (*it).paramValue;
+		else if ((*it).paramName == "dtpubliciplookup")
+			bPublicIp = (*it).paramValue;
+		else if ((*it).paramName == "dtmonitoringurl")
+			mpUfo->GetConfig().msDTMonitoringUrl = (*it).paramValue;
+		else if ((*it).paramName == "mqtthost")
+			mpUfo->GetConfig().msMqttHost = (*it).paramValue;
+		else if ((*it).paramName == "mqttport")
+			mpUfo->GetConfig().muMqttPort = strtol((*it).paramValue.c_str(), NULL, 10);
 		else if ((*it).paramName == "ufoname")
 			mpUfo->GetConfig().msUfoName = (*it).paramValue;
 		else if ((*it).paramName == "organization")
@@ -249,6 +391,9 @@ bool DynamicRequestHandler::HandleDynatraceMonitoringRequest(std::list<TParam>&
 	}
 
 	mpUfo->GetConfig().mbDTMonitoring = bEnabled;
+	mpUfo->GetConfig().mbDTMonitoringCbor = bCbor;
+	mpUfo->GetConfig().mbDTPublicIpLookup = bPublicIp;
+	mpUfo->GetConfig().muDTMonitoringExporter = uExporter;
 
 	if (mpUfo->GetConfig().Write()) {
 		mpUfo->GetAWSIntegration().ProcessConfigChange();
@@ -305,9 +450,9 @@ bool DynamicRequestHandler::HandleConfigRequest(std::list<TParam>& params, HttpR
 			if (sWifiEntUser && (sWifiEntUser[0] != 0x00)){
 					mpUfo->GetConfig().msSTAENTUser = sWifiEntUser;
 				if (sWifiEntCA)
-					mpUfo->GetConfig().msSTAENTCA = sWifiEntCA;
+					mpUfo->GetConfig().GetSTAENTCA() = sWifiEntCA;
 				else
-					mpUfo->GetConfig().msSTAENTCA.clear();
+					mpUfo->GetConfig().GetSTAENTCA().clear();
 				if (sWifiEntPass)
 					mpUfo->GetConfig().msSTAPass = sWifiEntPass;
 				else
@@ -321,7 +466,7 @@ bool DynamicRequestHandler::HandleConfigRequest(std::list<TParam>& params, HttpR
 			else
 				mpUfo->GetConfig().msSTAPass.clear();
 			mpUfo->GetConfig().msSTAENTUser.clear();
-			mpUfo->GetConfig().msSTAENTCA.clear();
+			mpUfo->GetConfig().GetSTAENTCA().clear();
 			bOk = true;
 		}
 	}
@@ -371,7 +516,7 @@ bool DynamicRequestHandler::HandleSrvConfigRequest(std::list<TParam>& params, Ht
 	}
 	mpUfo->GetConfig().mbWebServerUseSsl = (sSslEnabled != NULL);
 	mpUfo->GetConfig().muWebServerPort = atoi(sListenPort);
-	mpUfo->GetConfig().msWebServerCert = sServerCert;
+	mpUfo->GetConfig().GetWebServerCert() = sServerCert;
 	ESP_LOGD(tag, "HandleSrvConfigRequest %d, %d", mpUfo->GetConfig().mbWebServerUseSsl, mpUfo->GetConfig().muWebServerPort);
 	mpUfo->GetConfig().Write();
 	mbRestart = true;
@@ -437,24 +582,12 @@ bool DynamicRequestHandler::HandleFirmwareRequest(std::list<TParam>& params, Htt
 
 		if ((*it).paramName == "progress") {
 			short progressPct = 0;
-			const char* progressStatus = "notyetstarted";
+			const char* progressStatus = Ota::GetStatus();
 			int   progress = Ota::GetProgress();
-			if (progress >= 0) {
+			if (progress >= 0)
 				progressPct = progress;
-				progressStatus = "inprogress";
-			} else {
-				switch (progress) {
-					case OTA_PROGRESS_NOTYETSTARTED: progressStatus = "notyetstarted"; 
-							break;
-					case OTA_PROGRESS_CONNECTIONERROR: progressStatus = "connectionerror"; 
-							break;
-					case OTA_PROGRESS_FLASHERROR: progressStatus = "flasherror"; 
-							break;
-					case OTA_PROGRESS_FINISHEDSUCCESS: progressStatus = "finishedsuccess"; 
-							progressPct = 100;
-							break;
-				}
-			}
+			else if (progress == OTA_PROGRESS_FINISHEDSUCCESS)
+				progressPct = 100;
 			sBody = "{ \"session\": \"";
 			sBody += Ota::GetTimestamp();
 			sBody += "\", \"progress\": \"";
@@ -531,15 +664,40 @@ bool DynamicRequestHandler::HandleCheckFirmwareRequest(std::list<TParam>& params
 		return false;
 	version = version.substring(0, i);
 
+	sBody = "{";
 	if (!version.equalsIgnoreCase(FIRMWARE_VERSION)){
-		sBody = "{\"newversion\":\"Firmware available: ";
+		sBody += "\"newversion\":\"Firmware available: ";
 		sBody += version;
-		sBody += "\"}";
+		sBody += "\",";
 	}
-	else
-		sBody = "{}";
+	// statistics of the last firmware update since the start
+	TOtaStats& stats = Ota::GetStats();
+	__uint64_t uDuration = 0;
+	if (stats.uStart)
+		uDuration = (stats.uEnd ? stats.uEnd : esp_timer_get_time()) - stats.uStart;
+	sBody.printf("\"ota\":{\"status\":\"%s\",\"progress\":\"%d\",", Ota::GetStatus(), Ota::GetProgress());
+	sBody.printf("\"compressed\":\"%u\",\"resumes\":\"%u\",", stats.bCompressed, stats.uResumes);
+	sBody.printf("\"delta\":\"%u\",\"received\":\"%u\",\"written\":\"%u\",", stats.bDelta, stats.uBytesReceived, stats.uBytesWritten);
+	sBody.printf("\"durationms\":\"%u\",", (__uint32_t)(uDuration / 1000));
+	sBody.printf("\"bytespersecond\":\"%u\",", uDuration ? (__uint32_t)((__uint64_t)stats.uBytesWritten * 1000000 / uDuration) : 0);
+	sBody.printf("\"receivestallms\":\"%u\",", (__uint32_t)(stats.uReceiveStall / 1000));
+	sBody.printf("\"flashidlems\":\"%u\",", (__uint32_t)(stats.uFlashIdle / 1000));
+	sBody.printf("\"flashbusyms\":\"%u\",", (__uint32_t)(stats.uFlashWrite / 1000));
+	sBody.printf("\"buffers\":\"%u\",\"buffersize\":\"%u\"}}", stats.uBuffers, OTA_BUFFER_SIZE);
+	response.AddHeader(HttpResponse::HeaderContentTypeJson);
 	response.SetRetCode(200);
 	mpUfo->dt.leaveAction(dtHandleRequest);
 	return response.Send(sBody);
 	
-}
\ No newline at end of file
+}
+
+
+// receives the problem notifications of a Dynatrace custom integration, see DynatraceIntegration::HandleWebhook
+bool DynamicRequestHandler::HandleDynatraceWebhookRequest(std::list<TParam>& params, String& sAuthorization, String& sBody, HttpResponse& rResponse){
+
+    DynatraceAction* dtHandleRequest = mpUfo->dt.enterAction("Handle Dynatrace Webhook Request");	
+	rResponse.AddHeader(HttpResponse::HeaderNoCache);
+	rResponse.SetRetCode(mpUfo->GetDtIntegration().HandleWebhook(params, sAuthorization, sBody));
+	mpUfo->dt.leaveAction(dtHandleRequest);
+	return rResponse.Send();
+}
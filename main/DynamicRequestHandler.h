@@ -3,6 +3,7 @@
 
 #include "UrlParser.h"
 #include "HttpResponse.h"
+#include "String.h"
 #include <list>
 
 class Ufo;
@@ -13,20 +14,28 @@ public:
 	DynamicRequestHandler(Ufo* pUfo, DisplayCharter* pDCLevel1, DisplayCharter* pDCLevel2);
 	virtual ~DynamicRequestHandler();
 
+	void ApplyApiParams(std::list<TParam>& params);
+	bool ApplyApiPacket(const __uint8_t* pPacket, size_t uLen);
 	bool HandleApiRequest(std::list<TParam>& params, HttpResponse& rResponse);
+	bool HandleApiPacketRequest(String& sBody, HttpResponse& rResponse);
 	bool HandleApiListRequest(std::list<TParam>& params, HttpResponse& rResponse);
 	bool HandleApiEditRequest(std::list<TParam>& params, HttpResponse& rResponse);
 	bool HandleInfoRequest(std::list<TParam>& params, HttpResponse& rResponse);
+	bool HandleMetricsRequest(std::list<TParam>& params, HttpResponse& rResponse);
+	bool HandleMonitoringLogRequest(std::list<TParam>& params, HttpResponse& rResponse);
 	bool HandleConfigRequest(std::list<TParam>& params, HttpResponse& rResponse);
 	bool HandleSrvConfigRequest(std::list<TParam>& params, HttpResponse& rResponse);
 	bool HandleFirmwareRequest(std::list<TParam>& params, HttpResponse& response);
 	bool HandleCheckFirmwareRequest(std::list<TParam>& params, HttpResponse& response);
 	bool HandleDynatraceIntegrationRequest(std::list<TParam>& params, HttpResponse& response);
 	bool HandleDynatraceMonitoringRequest(std::list<TParam>& params, HttpResponse& response);
+	bool HandleDynatraceWebhookRequest(std::list<TParam>& params, String& sAuthorization, String& sBody, HttpResponse& response);
 
 	bool ShouldRestart() { return mbRestart; }
 
 private:
+	__uint8_t GetEnvironmentIndex(String& sParamName, unsigned int uPrefixLength);
+
 	Ufo* mpUfo;
 	DisplayCharter* mpDisplayCharterLevel1;
 	DisplayCharter* mpDisplayCharterLevel2;
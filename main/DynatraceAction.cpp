@@ -1,5 +1,6 @@
 #include "DynatraceMonitoring.h"
 #include "DynatraceAction.h"
+#include "MonitoringClock.h"
 #include "String.h"
 #include <esp_log.h>
 #include <time.h>
@@ -8,84 +9,113 @@
 
 static const char* LOGTAG = "DTAction";
 
-DynatraceAction::DynatraceAction(DynatraceMonitoring* pMon) {
-    mpMon = pMon;
-    mId = mpMon->getSequence0();
-    
-	ESP_LOGI(LOGTAG, "Start %i", mId);
+DynatraceAction::DynatraceAction() {
+    mpMon = NULL;
+    mId = 0;
 }
 
 DynatraceAction::~DynatraceAction() {
 
 }
 
-__uint32_t DynatraceAction::enter(String pName) {
-    return this->enter(pName, ACTION_MANUAL, 0);    
-};
-
-__uint32_t DynatraceAction::enter(String pName, int pType) {
-    return this->enter(pName, pType, 0);    
-    
-};
-
-__uint32_t DynatraceAction::enter(String pName, __uint32_t pParent) {
-    return this->enter(pName, ACTION_MANUAL, pParent);    
-    
-};
+void DynatraceAction::init(DynatraceMonitoring* pMon) {
+    mpMon = pMon;
+    mId = mpMon->getSequence0();
+    mResponseCode = 0;
+    mResponseSize = 0;
+}
 
-__uint32_t DynatraceAction::enter(String pName, int pType, __uint32_t pParent) {
+__uint32_t DynatraceAction::enter(__uint8_t pNameId, int pType, __uint32_t pParent) {
 
-	ESP_LOGI(LOGTAG, "Start action %s", pName.c_str());
+	ESP_LOGD(LOGTAG, "Start action %u: %s", mId, mpMon->getActionName(pNameId));
 
-    mName = pName;
+    mNameId = pNameId;
     mType = pType;
     mParent = pParent;
     mS0 = mpMon->getSequence1();
-    mStart = mpMon->getTimestamp();
+    mStart = MonitoringClock::Now();
     return mId;
 };
 
 void DynatraceAction::leave() {
     mS1 = mpMon->getSequence1();
-    mEnd = mpMon->getTimestamp();
+    mEnd = MonitoringClock::Now();
     mpMon->addAction(this);
 }
 
-void DynatraceAction::leave(String* pUrl, ushort pResponseCode, uint pResponseSize) {
+void DynatraceAction::leave(__uint8_t pNameId, ushort pResponseCode, uint pResponseSize) {
 
     mS1 = mpMon->getSequence1();
-    mEnd = mpMon->getTimestamp();
+    mEnd = MonitoringClock::Now();
     mResponseCode = pResponseCode;
     mResponseSize = pResponseSize;
-    mName = *pUrl;
+    mNameId = pNameId;
 
     mpMon->addAction(this);
 
 };
 
-String DynatraceAction::getPayload() {
-    String sPayload = "{";
-    sPayload.printf("\"name\":\"%s\",", mName.c_str());
-    sPayload.printf("\"type\":\"%u\",", mType);
-    sPayload.printf("\"id\":\"%u\",", mId);
-    sPayload.printf("\"parent\":\"%u\",", mParent);
-    sPayload.printf("\"s0\":\"%u\",", mS0);
-    sPayload.printf("\"start\":\"%u\",", mStart);
-    sPayload.printf("\"t0\":\"%u\",", mStart - mpMon->mStartTimestamp);
-    sPayload.printf("\"s1\":\"%u\",", mS1);
-    sPayload.printf("\"end\":\"%u\",", mEnd);
-    sPayload.printf("\"t1\":\"%u\"", mEnd - mStart);
+const char* DynatraceAction::getName() {
+    return mpMon->getActionName(mNameId);
+}
+
+// upper bound of the JSON representation, used to decide when to flush
+__uint16_t DynatraceAction::getSizeEstimate() {
+    __uint16_t uSize = 200 + strlen(getName());
+    if (mType == WEBREQUEST)
+        uSize += 90;
+    return uSize;
+}
+
+void DynatraceAction::writeJson(PayloadWriter& rWriter) {
+    rWriter.Append("{\"name\":");
+    rWriter.AppendJsonString(getName());
+    rWriter.Append(",\"type\":");
+    rWriter.AppendQuotedUint(mType);
+    rWriter.Append(",\"id\":");
+    rWriter.AppendQuotedUint(mId);
+    rWriter.Append(",\"parent\":");
+    rWriter.AppendQuotedUint(mParent);
+    rWriter.Append(",\"s0\":");
+    rWriter.AppendQuotedUint(mS0);
+    rWriter.Append(",\"start\":");
+    rWriter.AppendQuotedUint(MonitoringClock::ToEpochMs(mStart));
+    rWriter.Append(",\"t0\":");
+    rWriter.AppendQuotedUint((mStart - mpMon->mStartTimestamp) / 1000);
+    rWriter.Append(",\"s1\":");
+    rWriter.AppendQuotedUint(mS1);
+    rWriter.Append(",\"end\":");
+    rWriter.AppendQuotedUint(MonitoringClock::ToEpochMs(mEnd));
+    rWriter.Append(",\"t1\":");
+    rWriter.AppendQuotedUint((mEnd - mStart) / 1000);
+    rWriter.Append(",\"t1us\":");
+    rWriter.AppendQuotedUint(mEnd - mStart);
 
     if (mType == WEBREQUEST) {
-        sPayload.printf(",\"network\": {");
-        sPayload.printf("\"responseCode\":\"%u\",", mResponseCode);
-        sPayload.printf("\"bytesSent\":\"%u\",", 0);
-        sPayload.printf("\"bytesReceived\":\"%u\"", mResponseSize);
-        sPayload.printf("}");
+        rWriter.Append(",\"network\":{\"responseCode\":");
+        rWriter.AppendQuotedUint(mResponseCode);
+        rWriter.Append(",\"bytesSent\":\"0\",\"bytesReceived\":");
+        rWriter.AppendQuotedUint(mResponseSize);
+        rWriter.Append('}');
     }
 
-    sPayload.printf("}");
-
-    return sPayload;
+    rWriter.Append('}');
 }
 
+// [name id, type, id, parent, s0, t0, s1, t1(, responseCode, bytesReceived)] - t0 and t1 in us, start and end follow from sessionStart
+void DynatraceAction::writeCbor(PayloadWriter& rWriter) {
+    bool bWebRequest = (mType == WEBREQUEST);
+    rWriter.CborArray(bWebRequest ? 10 : 8);
+    rWriter.CborUint(mNameId);
+    rWriter.CborUint(mType);
+    rWriter.CborUint(mId);
+    rWriter.CborUint(mParent);
+    rWriter.CborUint(mS0);
+    rWriter.CborUint(mStart - mpMon->mStartTimestamp);
+    rWriter.CborUint(mS1);
+    rWriter.CborUint(mEnd - mStart);
+    if (bWebRequest) {
+        rWriter.CborUint(mResponseCode);
+        rWriter.CborUint(mResponseSize);
+    }
+}
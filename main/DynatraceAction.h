@@ -2,6 +2,7 @@
 #define MAIN_DYNATRACEACTION_H_
 
 #include "String.h"
+#include "PayloadWriter.h"
 #include <cJSON.h>
 
 
@@ -11,20 +12,24 @@ class DynatraceAction {
 
 public:
 
-    DynatraceAction(DynatraceMonitoring* pMon);
+    DynatraceAction();
 	virtual ~DynatraceAction();
-    
-    __uint32_t enter(String pName);
-    __uint32_t enter(String pName, int pType);
-    __uint32_t enter(String pName, __uint32_t pParent);
-    __uint32_t enter(String pName, int pType, __uint32_t pParent);
+
+    // actions are pooled by DynatraceMonitoring - init is called whenever the record is taken from the pool
+    void init(DynatraceMonitoring* pMon);
+
+    __uint32_t enter(__uint8_t pNameId, int pType, __uint32_t pParent);
 
     void leave();
-    void leave(String* pUrl, ushort pResponseCode, uint pResponseSize);
+    void leave(__uint8_t pNameId, ushort pResponseCode, uint pResponseSize);
 
     __uint32_t getId() { return mId; } 
-    String& getName() { return mName; }
-    String getPayload();
+    __uint8_t getNameId() { return mNameId; }
+    __uint32_t getEnd() { return mEnd / 1000; }    // ms since boot
+    __uint16_t getSizeEstimate();
+    const char* getName();
+    void writeJson(PayloadWriter& rWriter);
+    void writeCbor(PayloadWriter& rWriter);
 
 private:
 
@@ -32,11 +37,11 @@ private:
 
     __uint32_t mId;
     __uint32_t mParent;
-    String mName;
-    uint mType;
-    __uint32_t mStart;
+    __uint8_t mNameId;
+    __uint8_t mType;
+    __uint64_t mStart;     // us, MonitoringClock
     __uint32_t mS0;
-    __uint32_t mEnd;
+    __uint64_t mEnd;
     __uint32_t mS1;
     ushort mResponseCode;
     uint mResponseSize;
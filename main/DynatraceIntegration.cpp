@@ -2,20 +2,24 @@
 #include "DynatraceAction.h"
 #include "WebClient.h"
 #include "Url.h"
-#include "Ufo.h"
+#include "DynatraceMonitoring.h"
 #include "DisplayCharter.h"
 #include "Config.h"
 #include "String.h"
+#include "LatencyHistogram.h"
 #include "esp_system.h"
 #include <esp_log.h>
 #include <cJSON.h>
 
 static const char* LOGTAG = "Dynatrace";
 
+static LatencyHistogram latencyPoll("ufo_dynatrace_poll_seconds", "Polling and processing the problems of one Dynatrace environment");
+
 
 typedef struct{
     DynatraceIntegration* pIntegration;
     __uint8_t uTaskId;
+    __uint8_t uEnvironment;
 } TDtTaskParam;
 
 void task_function_dynatrace_integration(void *pvParameter)
@@ -23,8 +27,8 @@ void task_function_dynatrace_integration(void *pvParameter)
     ESP_LOGI(LOGTAG, "task_function_dynatrace_integration");
     TDtTaskParam* p = (TDtTaskParam*)pvParameter;
     ESP_LOGI(LOGTAG, "run pIntegration");
-	p->pIntegration->Run(p->uTaskId);
-    ESP_LOGI(LOGTAG, "Ending Task %d", p->uTaskId);
+	p->pIntegration->Run(p->uTaskId, p->uEnvironment);
+    ESP_LOGI(LOGTAG, "Ending Task %d of environment %d", p->uTaskId, p->uEnvironment);
     delete p;
 
 	vTaskDelete(NULL);
@@ -46,49 +50,60 @@ DynatraceIntegration::~DynatraceIntegration() {
 }
 
 
-void DynatraceIntegration::Init(Ufo* pUfo, DisplayCharter* pDisplayLowerRing, DisplayCharter* pDisplayUpperRing) {
+void DynatraceIntegration::Init(DynatraceMonitoring* pMonitoring, Config* pConfig, Wifi* pWifi, DisplayCharter* pDisplayLowerRing, DisplayCharter* pDisplayUpperRing) {
 	ESP_LOGI(LOGTAG, "Init");
-    DynatraceAction* dtIntegration = pUfo->dt.enterAction("Init DynatraceIntegration");	
+    DynatraceAction* dtIntegration = pMonitoring->enterAction("Init DynatraceIntegration");	
 
-    mpUfo = pUfo;  
+    mpMonitoring = pMonitoring;
     mpDisplayLowerRing = pDisplayLowerRing;
     mpDisplayUpperRing = pDisplayUpperRing;
+    mpConfig = pConfig;
+    mpWifi = pWifi;
 
-    mpConfig = &(mpUfo->GetConfig());
     mEnabled = false;
+    mbProblemDetails = false;
     mInitialized = true;
     mActTaskId = 1;
-    mActConfigRevision = 0;
     ProcessConfigChange();
-    mpUfo->dt.leaveAction(dtIntegration);
+    mpMonitoring->leaveAction(dtIntegration);
 }
 
-// care about starting or ending the task
+// care about starting or ending the polling tasks - every configured environment is polled by a task of its own
 void DynatraceIntegration::ProcessConfigChange(){
     if (!mInitialized)
         return; 
 
-    //its a little tricky to handle an enable/disable race condition without ending up with 0 or 2 tasks running
-    //so whenever there is a (short) disabled situation detected we let the old task go and do not need to wait on its termination
-    if (mpConfig->mbDTEnabled){
-        if (!mEnabled){
-            TDtTaskParam* pParam = new TDtTaskParam;
-            pParam->pIntegration = this;
-            pParam->uTaskId = mActTaskId;
-            ESP_LOGI(LOGTAG, "Create Task %d", mActTaskId);
-            xTaskCreate(&task_function_dynatrace_integration, "Task_DynatraceIntegration", 8192, pParam, 5, NULL);
-            ESP_LOGI(LOGTAG, "task created");
-        }
-    }
-    else{
-        if (mEnabled)
-            mActTaskId++;
+    //its a little tricky to handle an enable/disable race condition without ending up with 0 or 2 tasks per environment running
+    //so whenever the configuration changes we let the old tasks go (they end within a second) and do not need to wait on their termination
+    mCriticalSection.Enter(0);
+    mActTaskId++;
+    for (__uint8_t i=0 ; i < DT_MAX_ENVIRONMENTS ; i++){
+        mEnvironments[i].bPolled = false;
+        mEnvironments[i].bFailed = false;
+        mbPollNow[i] = false;
     }
+    mProblems.Clear();
+    mbProblemDetails = mpConfig->mbDTProblemDetails;
+    mCriticalSection.Leave();
+
     mEnabled = mpConfig->mbDTEnabled;
-    mActConfigRevision++;
+    if (!mEnabled)
+        return;
+
+    for (__uint8_t i=0 ; i < DT_MAX_ENVIRONMENTS ; i++){
+        if (!mpConfig->msDTEnvIdOrUrl[i].length())
+            continue;
+        TDtTaskParam* pParam = new TDtTaskParam;
+        pParam->pIntegration = this;
+        pParam->uTaskId = mActTaskId;
+        pParam->uEnvironment = i;
+        ESP_LOGI(LOGTAG, "Create Task %d for environment %d", mActTaskId, i);
+        xTaskCreate(&task_function_dynatrace_integration, "Task_DynatraceIntegration", 8192, pParam, 5, NULL);
+    }
+    ESP_LOGI(LOGTAG, "tasks created");
 }
 
-void ParseIntegrationUrl(Url& rUrl, String& sEnvIdOrUrl, String& sApiToken){
+void ParseIntegrationUrl(Url& rUrl, String& sEnvIdOrUrl, String& sApiToken, const char* sApi){
     String sHelp;
  
     ESP_LOGI(LOGTAG, "%s", sEnvIdOrUrl.c_str());
@@ -96,20 +111,20 @@ void ParseIntegrationUrl(Url& rUrl, String& sEnvIdOrUrl, String& sApiToken){
 
     if (sEnvIdOrUrl.length()){
         if (sEnvIdOrUrl.indexOf(".") < 0){ //an environment id
-            sHelp.printf("https://%s.live.dynatrace.com/api/v1/problem/status?Api-Token=%s", sEnvIdOrUrl.c_str(), sApiToken.c_str());
+            sHelp.printf("https://%s.live.dynatrace.com/api/v1/%sApi-Token=%s", sEnvIdOrUrl.c_str(), sApi, sApiToken.c_str());
         }
         else{
             if (sEnvIdOrUrl.startsWith("http")){
                 if (sEnvIdOrUrl.charAt(sEnvIdOrUrl.length()-1) == '/')
-                    sHelp.printf("%sapi/v1/problem/status?Api-Token=%s", sEnvIdOrUrl.c_str(), sApiToken.c_str());
+                    sHelp.printf("%sapi/v1/%sApi-Token=%s", sEnvIdOrUrl.c_str(), sApi, sApiToken.c_str());
                 else
-                    sHelp.printf("%s/api/v1/problem/status?Api-Token=%s", sEnvIdOrUrl.c_str(), sApiToken.c_str());
+                    sHelp.printf("%s/api/v1/%sApi-Token=%s", sEnvIdOrUrl.c_str(), sApi, sApiToken.c_str());
             }
             else{
                 if (sEnvIdOrUrl.charAt(sEnvIdOrUrl.length()-1) == '/')
-                    sHelp.printf("https://%sapi/v1/problem/status?Api-Token=%s", sEnvIdOrUrl.c_str(), sApiToken.c_str());
+                    sHelp.printf("https://%sapi/v1/%sApi-Token=%s", sEnvIdOrUrl.c_str(), sApi, sApiToken.c_str());
                 else
-                    sHelp.printf("https://%s/api/v1/problem/status?Api-Token=%s", sEnvIdOrUrl.c_str(), sApiToken.c_str());
+                    sHelp.printf("https://%s/api/v1/%sApi-Token=%s", sEnvIdOrUrl.c_str(), sApi, sApiToken.c_str());
             }
                 
         }   
@@ -120,57 +135,273 @@ void ParseIntegrationUrl(Url& rUrl, String& sEnvIdOrUrl, String& sApiToken){
     rUrl.Parse(sHelp);
  }
 
-void DynatraceIntegration::Run(__uint8_t uTaskId) {
-    __uint8_t uConfigRevision = mActConfigRevision - 1;
+// every environment has its own task and WebClient, so a stalled tenant doesn't delay the others
+// the price is one TLS session per environment while they poll at the same time
+void DynatraceIntegration::Run(__uint8_t uTaskId, __uint8_t uEnvironment) {
+    WebClient dtClient;
+    Url dtUrl;
+    DynatraceProblemFeedParser* pParser = NULL;
+
+    //a running request is dropped as soon as the configuration changes, and a stalled server must not block the task
+    dtClient.SetCancelToken(&mActTaskId);
+    dtClient.SetTimeouts(10000, 15000, 30000);
+
+    if (mbProblemDetails){
+        //the problem feed can get large, so it is parsed while it is received instead of being buffered
+        pParser = new DynatraceProblemFeedParser();
+        dtClient.SetDownloadHandler(pParser);
+    }
+
     vTaskDelay(5000 / portTICK_PERIOD_MS);
-	ESP_LOGD(LOGTAG, "Run");
-    while (1) {
-        if (mpUfo->GetWifi().IsConnected()) {
-            //Configuration is not atomic - so in case of a change there is the possibility that we use inconsistent credentials - but who cares (the next time it would be fine again)
-            if (uConfigRevision != mActConfigRevision){
-                uConfigRevision = mActConfigRevision; //memory barrier would be needed here
-                ParseIntegrationUrl(mDtUrl, mpConfig->msDTEnvIdOrUrl, mpConfig->msDTApiToken);
-            }
-            GetData();
-            ESP_LOGD(LOGTAG, "free heap after processing DT: %i", esp_get_free_heap_size());            
+	ESP_LOGD(LOGTAG, "Run environment %d", uEnvironment);
+    //the interval counts from the start of the last poll, so neither the time a poll takes nor the sleeps add up to a drift
+    TickType_t uNextPoll = xTaskGetTickCount();
+    while (uTaskId == mActTaskId) {
+        if (mpWifi->IsConnected() && (((int)(xTaskGetTickCount() - uNextPoll) >= 0) || mbPollNow[uEnvironment])) {
+            TickType_t uPollStart = xTaskGetTickCount();
+            mbPollNow[uEnvironment] = false;
+            //Configuration is not atomic - so in case of a change there is the possibility that we use inconsistent credentials - but who cares (the task gets restarted anyway)
+            ParseIntegrationUrl(dtUrl, mpConfig->msDTEnvIdOrUrl[uEnvironment], mpConfig->msDTApiToken[uEnvironment], pParser ? "problem/feed?status=OPEN&" : "problem/status?");
+            GetData(uTaskId, uEnvironment, dtClient, dtUrl, pParser);
+            ESP_LOGD(LOGTAG, "free heap after polling environment %d: %u (minimum %u)", uEnvironment, esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
+
+            int iInterval = mpConfig->miDTInterval;
+            if (mpConfig->msDTWebhookToken.length() && (iInterval < DT_RECONCILE_INTERVAL))
+                iInterval = DT_RECONCILE_INTERVAL;
+            uNextPoll = uPollStart + iInterval * 1000 / portTICK_PERIOD_MS;
+        }
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    delete pParser;
+}
 
-            for (int i=0 ; i < mpConfig->miDTInterval ; i++){
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
+void DynatraceIntegration::GetData(__uint8_t uTaskId, __uint8_t uEnvironment, WebClient& rClient, Url& rUrl, DynatraceProblemFeedParser* pParser) {
+	ESP_LOGD(LOGTAG, "polling environment %d", uEnvironment);
+    TDtEnvironmentState state;
+    state.bPolled = true;
+    state.bFailed = true;
+    __uint64_t uStart = LatencyHistogram::Start();
+
+    DynatraceAction* dtPollApi = mpMonitoring->enterAction("Poll Dynatrace API");	
+    if (rClient.Prepare(&rUrl)) {
+
+        DynatraceAction* dtHttpGet = mpMonitoring->enterAction("HTTP Get Request", WEBREQUEST, dtPollApi);	
+        if (pParser)
+            pParser->Init();
+        unsigned short responseCode = rClient.HttpGet();
+        String& response = rClient.GetResponseData();
+        mpMonitoring->leaveAction(dtHttpGet, &rUrl.GetHost(), responseCode, response.length());
+        ESP_LOGD(LOGTAG, "%u body bytes copied, %u allocations", rClient.GetBytesCopied(), rClient.GetAllocations());
+        if (responseCode == 200) {
+            DynatraceAction* dtProcess = mpMonitoring->enterAction("Process Dynatrace Metrics", dtPollApi);	
+            if (pParser)
+                state.bFailed = !ProcessProblems(*pParser, state);
+            else
+                state.bFailed = !Process(response, state);
+            mpMonitoring->leaveAction(dtProcess);
+        } else {
+            ESP_LOGE(LOGTAG, "Communication with Dynatrace environment %d failed - error %u", uEnvironment, responseCode);
+        }        
+    }
+    rClient.Clear();
 
-                if (uTaskId != mActTaskId)
-                    return;
-            }
-        }
+    latencyPoll.RecordSince(uStart);
+    state.uLastPollMs = (LatencyHistogram::Start() - uStart) / 1000;
+    ESP_LOGI(LOGTAG, "environment %d polled in %u ms", uEnvironment, state.uLastPollMs);
+
+    DynatraceAction* dtAggregate = mpMonitoring->enterAction("Aggregate Dynatrace Environments", dtPollApi);	
+    UpdateEnvironment(uTaskId, uEnvironment, state, (!state.bFailed) ? pParser : NULL);
+    mpMonitoring->leaveAction(dtAggregate);
+    mpMonitoring->leaveAction(dtPollApi);
+}
+
+// merges the result of one environment into the aggregated problem model and updates the rings
+void DynatraceIntegration::UpdateEnvironment(__uint8_t uTaskId, __uint8_t uEnvironment, TDtEnvironmentState& rState, DynatraceProblemFeedParser* pParser) {
+    mCriticalSection.Enter(0);
+    if (uTaskId == mActTaskId){ //results of an outdated task are dropped
+        mEnvironments[uEnvironment] = rState;
+        if (pParser)
+            mProblems.Apply(uEnvironment, pParser->GetProblems(), pParser->GetCount());
         else
-		    vTaskDelay(1000 / portTICK_PERIOD_MS);
+            mProblems.RemoveEnvironment(uEnvironment);
+        Aggregate();
+    }
+    mCriticalSection.Leave();
+}
 
-        if (uTaskId != mActTaskId)
-            return;
+void DynatraceIntegration::Aggregate() {
+    int iTotalProblems = 0;
+    int iApplicationProblems = 0;
+    int iServiceProblems = 0;
+    int iInfrastructureProblems = 0;
+    __uint8_t uSucceeded = 0;
+
+    for (__uint8_t i=0 ; i < DT_MAX_ENVIRONMENTS ; i++){
+        TDtEnvironmentState& rState = mEnvironments[i];
+        if (!rState.bPolled || rState.bFailed)
+            continue;
+        uSucceeded++;
+        iTotalProblems += rState.iTotalProblems;
+        iApplicationProblems += rState.iApplicationProblems;
+        iServiceProblems += rState.iServiceProblems;
+        iInfrastructureProblems += rState.iInfrastructureProblems;
     }
+
+    // as long as at least one environment answers we show its problems, otherwise the failure
+    if (!uSucceeded){
+        ESP_LOGD(LOGTAG, "Handle Dynatrace API failure");
+        HandleFailure();
+        return;
+    }
+
+    ESP_LOGI(LOGTAG, "open Dynatrace problems (%d environments): %i", uSucceeded, iTotalProblems);
+
+    miInfrastructureProblems = iInfrastructureProblems;
+    miApplicationProblems = iApplicationProblems;
+    miServiceProblems = iServiceProblems;
+    miTotalProblems = iTotalProblems;
+
+    if (mbProblemDetails && miTotalProblems)
+        DisplayProblems();
+    else
+        DisplayDefault();
 }
 
-void DynatraceIntegration::GetData() {
-	ESP_LOGD(LOGTAG, "polling");
-    DynatraceAction* dtPollApi = mpUfo->dt.enterAction("Poll Dynatrace API");	
-    if (dtClient.Prepare(&mDtUrl)) {
+// a notification is applied to the problem table right away - what can not be applied exactly triggers an immediate poll of the environment
+bool DynatraceIntegration::ProcessNotification(__uint8_t uEnvironment, TDtProblem& rProblem, bool bOpen) {
+    if (!mEnabled || (uEnvironment >= DT_MAX_ENVIRONMENTS) || !mpConfig->msDTEnvIdOrUrl[uEnvironment].length())
+        return false;
+
+    mCriticalSection.Enter(0);
+    TDtEnvironmentState& rState = mEnvironments[uEnvironment];
+    //the status counters carry no problem ids, so without the details there is nothing to match the notification with
+    if (!mbProblemDetails || !rState.bPolled || rState.bFailed){
+        mbPollNow[uEnvironment] = true;
+        mCriticalSection.Leave();
+        ESP_LOGI(LOGTAG, "problem %s notified - polling environment %d", rProblem.sId, uEnvironment);
+        return true;
+    }
 
-        DynatraceAction* dtHttpGet = mpUfo->dt.enterAction("HTTP Get Request", WEBREQUEST, dtPollApi);	
-        unsigned short responseCode = dtClient.HttpGet();
-        String response = dtClient.GetResponseData();
-        mpUfo->dt.leaveAction(dtHttpGet, &mDtUrlString, responseCode, response.length());
-        if (responseCode == 200) {
-            DynatraceAction* dtProcess = mpUfo->dt.enterAction("Process Dynatrace Metrics", dtPollApi);	
-            Process(response);
-            mpUfo->dt.leaveAction(dtProcess);
-        } else {
-            ESP_LOGE(LOGTAG, "Communication with Dynatrace failed - error %u", responseCode);
-            DynatraceAction* dtFailure = mpUfo->dt.enterAction("Handle Dynatrace API failure", dtPollApi);	
-            HandleFailure();
-            mpUfo->dt.leaveAction(dtFailure);
-        }        
+    TDtProblem* pKnown = mProblems.Find(uEnvironment, rProblem.sId);
+    if (bOpen){
+        if (pKnown){
+            CountProblem(rState, pKnown->uImpact, -1);
+            mProblems.Upsert(uEnvironment, rProblem);
+            CountProblem(rState, rProblem.uImpact, 1);
+        }
+        else if (mProblems.Upsert(uEnvironment, rProblem))
+            CountProblem(rState, rProblem.uImpact, 1);
+        else
+            mbPollNow[uEnvironment] = true;
     }
-    dtClient.Clear();
-    mpUfo->dt.leaveAction(dtPollApi);
+    else{
+        if (pKnown){
+            CountProblem(rState, pKnown->uImpact, -1);
+            mProblems.Remove(uEnvironment, rProblem.sId);
+        }
+        else
+            mbPollNow[uEnvironment] = true;
+    }
+    ESP_LOGI(LOGTAG, "problem %s %s in environment %d", rProblem.sId, bOpen ? "opened" : "closed", uEnvironment);
+    Aggregate();
+    mCriticalSection.Leave();
+    return true;
+}
+
+// compares in a time that only depends on the length, so the response time tells nothing about how much of a guessed token is right
+static bool TokenEquals(String& sToken, String& sExpected){
+    if (sToken.length() != sExpected.length())
+        return false;
+    const char* p = sToken.c_str();
+    const char* q = sExpected.c_str();
+    unsigned char uDiff = 0;
+    for (unsigned int u=0 ; u < sExpected.length() ; u++)
+        uDiff |= p[u] ^ q[u];
+    return !uDiff;
+}
+
+__uint16_t DynatraceIntegration::HandleWebhook(std::list<TParam>& params, String& sAuthorization, String& sBody) {
+	String sToken;
+	__uint8_t uEnvironment = 0;
+
+	std::list<TParam>::iterator it = params.begin();
+	while (it != params.end()){
+		if ((*it).paramName == "token")
+			sToken = (*it).paramValue;
+		else if ((*it).paramName == "env")
+			uEnvironment = (*it).paramValue.toInt() - 1;
+		it++;
+	}
+	if (sAuthorization.length() > 7){
+		String sScheme = sAuthorization.substring(0, 7);
+		if (sScheme.equalsIgnoreCase("Bearer "))
+			sToken = sAuthorization.substring(7);
+	}
+
+	if (!mpConfig->msDTWebhookToken.length() || !TokenEquals(sToken, mpConfig->msDTWebhookToken)){
+		ESP_LOGW(LOGTAG, "Dynatrace webhook with invalid token");
+		return 401;
+	}
+
+	TDtProblem problem;
+	memset(&problem, 0, sizeof(problem));
+	bool bOpen = false;
+	bool bValid = false;
+
+	cJSON* json = cJSON_Parse(sBody.c_str());
+	if (json){
+		cJSON* pid = cJSON_GetObjectItem(json, "PID");
+		if (!pid || (pid->type != cJSON_String) || !pid->valuestring[0])
+			pid = cJSON_GetObjectItem(json, "ProblemID");
+		cJSON* state = cJSON_GetObjectItem(json, "State");
+		cJSON* impact = cJSON_GetObjectItem(json, "ProblemImpact");
+		cJSON* severity = cJSON_GetObjectItem(json, "ProblemSeverity");
+
+		if (pid && (pid->type == cJSON_String) && pid->valuestring[0] && state && (state->type == cJSON_String)){
+			strncpy(problem.sId, pid->valuestring, DT_PROBLEM_ID_LENGTH - 1);
+			bOpen = !strcmp(state->valuestring, "OPEN");
+			if (impact && (impact->type == cJSON_String))
+				problem.uImpact = DynatraceProblemTable::ParseImpact(impact->valuestring);
+			if (severity && (severity->type == cJSON_String))
+				problem.uSeverity = DynatraceProblemTable::ParseSeverity(severity->valuestring);
+			bValid = true;
+		}
+		cJSON_Delete(json);
+	}
+
+	if (!bValid){
+		ESP_LOGW(LOGTAG, "Dynatrace webhook with invalid payload");
+		return 400;
+	}
+	return ProcessNotification(uEnvironment, problem, bOpen) ? 200 : 404;
+}
+
+bool DynatraceIntegration::HasProblem(__uint8_t uEnvironment, const char* sId) {
+    mCriticalSection.Enter(0);
+    bool bFound = mProblems.Find(uEnvironment, sId) != NULL;
+    mCriticalSection.Leave();
+    return bFound;
+}
+
+void DynatraceIntegration::CountProblem(TDtEnvironmentState& rState, __uint8_t uImpact, int iDelta) {
+    int* piCounter;
+    switch (uImpact){
+        case DT_IMPACT_APPLICATION:
+            piCounter = &rState.iApplicationProblems;
+            break;
+        case DT_IMPACT_SERVICE:
+            piCounter = &rState.iServiceProblems;
+            break;
+        default:
+            piCounter = &rState.iInfrastructureProblems;
+            break;
+    }
+    *piCounter += iDelta;
+    rState.iTotalProblems += iDelta;
+    if (*piCounter < 0)
+        *piCounter = 0;
+    if (rState.iTotalProblems < 0)
+        rState.iTotalProblems = 0;
 }
 
 void DynatraceIntegration::HandleFailure() {
@@ -227,15 +458,88 @@ void DynatraceIntegration::DisplayDefault() {
 
 }
 
+// one ring segment per open problem - the upper ring shows the impact, the lower ring the severity
+void DynatraceIntegration::DisplayProblems() {
+	ESP_LOGD(LOGTAG, "DisplayProblems: %i", miTotalProblems);
+    mpDisplayLowerRing->Init();
+    mpDisplayUpperRing->Init();
+
+    for (__uint8_t u=0 ; u < DT_MAX_PROBLEMS ; u++){
+        TDtProblem* pProblem = mProblems.GetSlot(u);
+        if (!pProblem)
+            continue;
+        switch (pProblem->uImpact){
+            case DT_IMPACT_APPLICATION:
+                mpDisplayUpperRing->SetLeds(u, 1, 0xff0000);
+                break;
+            case DT_IMPACT_SERVICE:
+                mpDisplayUpperRing->SetLeds(u, 1, 0xff00aa);
+                break;
+            default:
+                mpDisplayUpperRing->SetLeds(u, 1, 0xffaa00);
+                break;
+        }
+        switch (pProblem->uSeverity){
+            case DT_SEVERITY_AVAILABILITY:
+                mpDisplayLowerRing->SetLeds(u, 1, 0xff0000);
+                break;
+            case DT_SEVERITY_ERROR:
+                mpDisplayLowerRing->SetLeds(u, 1, 0xff4000);
+                break;
+            case DT_SEVERITY_PERFORMANCE:
+                mpDisplayLowerRing->SetLeds(u, 1, 0xffaa00);
+                break;
+            case DT_SEVERITY_RESOURCE_CONTENTION:
+                mpDisplayLowerRing->SetLeds(u, 1, 0xffff00);
+                break;
+            default:
+                mpDisplayLowerRing->SetLeds(u, 1, 0x0000ff);
+                break;
+        }
+    }
+    mpDisplayUpperRing->SetMorph(2000, 6);
+    mpDisplayLowerRing->SetMorph(2000, 6);
+}
 
-void DynatraceIntegration::Process(String& jsonString) {
+
+// the problem feed was already parsed while it was received - just take over the counters
+bool DynatraceIntegration::ProcessProblems(DynatraceProblemFeedParser& rParser, TDtEnvironmentState& rState) {
+    if (!rParser.IsValid())
+        return false;
+
+    rState.iApplicationProblems = 0;
+    rState.iServiceProblems = 0;
+    rState.iInfrastructureProblems = 0;
+    TDtProblem* pProblems = rParser.GetProblems();
+    for (__uint8_t u=0 ; u < rParser.GetCount() ; u++){
+        switch (pProblems[u].uImpact){
+            case DT_IMPACT_APPLICATION:
+                rState.iApplicationProblems++;
+                break;
+            case DT_IMPACT_SERVICE:
+                rState.iServiceProblems++;
+                break;
+            default:
+                rState.iInfrastructureProblems++;
+                break;
+        }
+    }
+    //problems that did not fit into the table are only reflected in the total
+    rState.iTotalProblems = rParser.GetTotalCount();
+
+    ESP_LOGI(LOGTAG, "open Dynatrace problems: %i (%u tracked)", rState.iTotalProblems, rParser.GetCount());
+    return true;
+}
+
+
+bool DynatraceIntegration::Process(String& jsonString, TDtEnvironmentState& rState) {
     
     cJSON* parentJson = cJSON_Parse(jsonString.c_str());
     if (!parentJson)
-        return;
+        return false;
     cJSON* json = cJSON_GetObjectItem(parentJson, "result");
     if (!json)
-        return;
+        return cJSON_Delete(parentJson), false;
     
     if (LOG_LOCAL_LEVEL >= ESP_LOG_DEBUG){
         char* sJsonPrint = cJSON_Print(json);
@@ -243,35 +547,24 @@ void DynatraceIntegration::Process(String& jsonString) {
         free(sJsonPrint);
     }
 
-//    bool changed = false;
-    int iTotalProblems = cJSON_GetObjectItem(json, "totalOpenProblemsCount")->valueint;
-    int iInfrastructureProblems = cJSON_GetObjectItem(cJSON_GetObjectItem(json, "openProblemCounts"), "INFRASTRUCTURE")->valueint;
-    int iApplicationProblems = cJSON_GetObjectItem(cJSON_GetObjectItem(json, "openProblemCounts"), "APPLICATION")->valueint;
-    int iServiceProblems = cJSON_GetObjectItem(cJSON_GetObjectItem(json, "openProblemCounts"), "SERVICE")->valueint;
+    cJSON* total = cJSON_GetObjectItem(json, "totalOpenProblemsCount");
+    cJSON* counts = cJSON_GetObjectItem(json, "openProblemCounts");
+    if (!total || !counts)
+        return cJSON_Delete(parentJson), false;
+    cJSON* infrastructure = cJSON_GetObjectItem(counts, "INFRASTRUCTURE");
+    cJSON* application = cJSON_GetObjectItem(counts, "APPLICATION");
+    cJSON* service = cJSON_GetObjectItem(counts, "SERVICE");
 
-    ESP_LOGI(LOGTAG, "open Dynatrace problems: %i", iTotalProblems);
-    ESP_LOGI(LOGTAG, "open Infrastructure problems: %i", iInfrastructureProblems);
-    ESP_LOGI(LOGTAG, "open Application problems: %i", iApplicationProblems);
-    ESP_LOGI(LOGTAG, "open Service problems: %i", iServiceProblems);
+    rState.iTotalProblems = total->valueint;
+    rState.iInfrastructureProblems = infrastructure ? infrastructure->valueint : 0;
+    rState.iApplicationProblems = application ? application->valueint : 0;
+    rState.iServiceProblems = service ? service->valueint : 0;
 
-    cJSON_Delete(parentJson);
+    ESP_LOGI(LOGTAG, "open Dynatrace problems: %i", rState.iTotalProblems);
+    ESP_LOGI(LOGTAG, "open Infrastructure problems: %i", rState.iInfrastructureProblems);
+    ESP_LOGI(LOGTAG, "open Application problems: %i", rState.iApplicationProblems);
+    ESP_LOGI(LOGTAG, "open Service problems: %i", rState.iServiceProblems);
 
-    if (iInfrastructureProblems != miInfrastructureProblems) {
-//        changed = true;
-        miInfrastructureProblems = iInfrastructureProblems;
-    }
-    if (iApplicationProblems != miApplicationProblems) {
-//        changed = true;
-        miApplicationProblems = iApplicationProblems;
-    }
-    if (iServiceProblems != miServiceProblems) {
-//        changed = true;
-        miServiceProblems = iServiceProblems;
-    }
-    miTotalProblems = iTotalProblems;
-
-//    if (changed) {
-        DisplayDefault();
-//    }
-
-}
\ No newline at end of file
+    cJSON_Delete(parentJson);
+    return true;
+}
@@ -6,11 +6,29 @@
 #include "Wifi.h"
 #include "DisplayCharter.h"
 #include "Config.h"
+#include "CriticalSection.h"
+#include "DynatraceProblems.h"
 #include "String.h"
+#include "UrlParser.h"
 #include <cJSON.h>
+#include <list>
 
 
-class Ufo;
+class DynatraceMonitoring;
+
+// with the webhook receiving the problem notifications, polling is just a slow reconciliation
+#define DT_RECONCILE_INTERVAL   300
+
+// problem counters of one Dynatrace environment, as seen by its last poll
+typedef struct{
+    bool bPolled;
+    bool bFailed;
+    int iTotalProblems;
+    int iApplicationProblems;
+    int iServiceProblems;
+    int iInfrastructureProblems;
+    __uint32_t uLastPollMs;
+} TDtEnvironmentState;
 
 class DynatraceIntegration {
 
@@ -18,34 +36,57 @@ public:
 
     DynatraceIntegration();
 	virtual ~DynatraceIntegration();
-    
-    void Init(Ufo* pUfo, DisplayCharter* pDisplayLowerRing, DisplayCharter* pDisplayUpperRing);
+
+    void Init(DynatraceMonitoring* pMonitoring, Config* pConfig, Wifi* pWifi, DisplayCharter* pDisplayLowerRing, DisplayCharter* pDisplayUpperRing);
     void ProcessConfigChange();
-    void Run(__uint8_t uTaskId);
+    void Run(__uint8_t uTaskId, __uint8_t uEnvironment);
     bool IsActive() { return mEnabled; };
 
+    /*
+     * applies a problem notification pushed by Dynatrace (webhook) without waiting for the next poll
+     * @return false if the integration is not active or the environment is unknown
+     */
+    bool ProcessNotification(__uint8_t uEnvironment, TDtProblem& rProblem, bool bOpen);
+
+    /*
+     * receives a problem notification of a Dynatrace custom integration, the payload has to be configured like
+     * {"PID":"{PID}","ProblemID":"{ProblemID}","State":"{State}","ProblemImpact":"{ProblemImpact}","ProblemSeverity":"{ProblemSeverity}"}
+     * the URL like http://<ufo>/dynatracewebhook?env=<1..3, default 1> and the header "Authorization: Bearer <webhook token>"
+     * (the token is also still accepted as ?token=<webhook token>, but the query ends up in logs and browser histories)
+     * @return the HTTP status of the response - 401 for a wrong token, 400 for an invalid payload, 404 for an unknown environment
+     */
+    __uint16_t HandleWebhook(std::list<TParam>& params, String& sAuthorization, String& sBody);
+
+    // true if the problem is in the table, i.e. it is shown on the rings
+    bool HasProblem(__uint8_t uEnvironment, const char* sId);
+
 private:
 
-    void GetData();
-    void Process(String& jsonString);
+    void GetData(__uint8_t uTaskId, __uint8_t uEnvironment, WebClient& rClient, Url& rUrl, DynatraceProblemFeedParser* pParser);
+    bool Process(String& jsonString, TDtEnvironmentState& rState);
+    bool ProcessProblems(DynatraceProblemFeedParser& rParser, TDtEnvironmentState& rState);
+    void UpdateEnvironment(__uint8_t uTaskId, __uint8_t uEnvironment, TDtEnvironmentState& rState, DynatraceProblemFeedParser* pParser);
+    void Aggregate();
+    void CountProblem(TDtEnvironmentState& rState, __uint8_t uImpact, int iDelta);
     void DisplayDefault();
+    void DisplayProblems();
     void HandleFailure();
 
-    WebClient  dtClient;
-
-    Ufo* mpUfo;  
+    DynatraceMonitoring* mpMonitoring;
     DisplayCharter* mpDisplayLowerRing;
     DisplayCharter* mpDisplayUpperRing;
     Config* mpConfig;
-//	Wifi* mpWifi;
-    
-    Url mDtUrl;
-    String mDtUrlString;
-    
+    Wifi* mpWifi;
+
     bool mInitialized = false;
     bool mEnabled;
-    __uint8_t mActTaskId; 
-    __uint8_t mActConfigRevision;
+    bool mbProblemDetails;
+    volatile __uint8_t mActTaskId;
+    volatile bool mbPollNow[DT_MAX_ENVIRONMENTS];
+
+    CriticalSection mCriticalSection;
+    TDtEnvironmentState mEnvironments[DT_MAX_ENVIRONMENTS];
+    DynatraceProblemTable mProblems;
 
     int miTotalProblems;
     int miApplicationProblems;
@@ -53,4 +94,4 @@ private:
     int miInfrastructureProblems;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,7 +2,8 @@
 #include "AWSIntegration.h"
 #include "DynatraceMonitoring.h"
 #include "DynatraceAction.h"
-#include "CriticalSection.h"
+#include "ActionQueue.h"
+#include "MonitoringClock.h"
 #include "Config.h"
 #include "String.h"
 #include "esp_system.h"
@@ -22,24 +23,51 @@ void task_function_dynatrace_monitoring(void *pvParameter)
 	vTaskDelete(NULL);
 }
 
+void task_function_dynatrace_lookup(void *pvParameter)
+{
+	((DynatraceMonitoring*)pvParameter)->lookupPublicIp();
+	vTaskDelete(NULL);
+}
+
 
 DynatraceMonitoring::DynatraceMonitoring() {
 	ESP_LOGI(LOGTAG, "Start");
     mActive = true;
+    myMutex = portMUX_INITIALIZER_UNLOCKED;
+    muActionNameCount = 0;
+    muPoolInUse = 0;
+    muPoolHighWater = 0;
+    muPoolExhausted = 0;
+    mStartTimestamp = 0;    // boot, until Init starts the session
+    mhTask = NULL;
+    muPendingBytes = 0;
+    muOldestPending = 0;
+    muRetryFirst = 0;
+    muRetryCount = 0;
+    muBatchesSent = 0;
+    muBatchesDropped = 0;
+    muBytesCopied = 0;
+    mpExporter = NULL;
+    muLookupState = DT_LOOKUP_IDLE;
+    mbLookupOk = false;
+    muPublicIpTime = 0;
+    muLookupAttempt = 0;
+    for (__uint8_t i=0; i<DT_ACTION_POOL_SIZE; i++) {
+        mFreeActions.Push(&mActionPool[i]);
+    }
 }
 
 DynatraceMonitoring::~DynatraceMonitoring() {
 
 }
 
-bool DynatraceMonitoring::Init(Ufo* pUfo, AWSIntegration* pAws) {
+bool DynatraceMonitoring::Init(const TExporterContext& rContext) {
 	ESP_LOGI(LOGTAG, "Init");
-    mpUfo = pUfo;
-    mpAws = pAws;      
-    mpConfig = &(mpUfo->GetConfig());
+    mContext = rContext;
+    mpConfig = rContext.pConfig;
 
-    mStartTimestamp = getTimestamp();
-    mDevice.id = mpUfo->GetId();
+    mStartTimestamp = MonitoringClock::Now();
+    mDevice.id = *mContext.pId;
     mDevice.name = mpConfig->msUfoName.c_str();
     mDevice.cpu = "ESP32"; 
     mDevice.os = "ESP32";
@@ -59,25 +87,48 @@ void DynatraceMonitoring::ProcessConfigChange(){
         return; 
 
     if (mpConfig->mbDTMonitoring) {
+        TaskHandle_t hTask = mhTask;
+        if (hTask) {
+            xTaskNotifyGive(hTask);     // the running task picks up a changed exporter
+            return;
+        }
     	xTaskCreate(&task_function_dynatrace_monitoring, "Task_DynatraceMonitoring", 8192, this, 5, NULL);    
     } else {
     	ESP_LOGI(LOGTAG, "Monitoring disabled");
-        Shutdown();
-        return;
+        // the retry queue belongs to the monitoring task, so a running task is only woken up and shuts down itself
+        TaskHandle_t hTask = mhTask;
+        if (hTask)
+            xTaskNotifyGive(hTask);
+        else
+            Shutdown();
     }
 }
 
 
 bool DynatraceMonitoring::Connect() {
 	ESP_LOGI(LOGTAG, "Connecting");
+    mhTask = xTaskGetCurrentTaskHandle();
 
     while (!mConnected) {
-        if (mpAws->mActive) {
+        if (!mpConfig->mbDTMonitoring) {
+            Shutdown();
+            mhTask = NULL;
+            return false;
+        }
+        mpExporter = selectExporter();
+        if (mpExporter->Start(mContext)) {
+            ESP_LOGI(LOGTAG, "exporting to %s", mpExporter->GetName());
             mConnected = true;
-//            mDevice.clientIp = mpUfo->GetWifi().GetLocalAddress();
-            mDevice.clientIp = getPublicIp();
-            mDevice.id = mpUfo->GetId();
-            mDevice.name = mpUfo->GetId();
+            // start with what is known already, the public IP is filled in by refreshDevice later
+            if (!muPublicIpTime)
+                mDevice.clientIp = mContext.pWifi->GetLocalAddress();
+            mDevice.id = *mContext.pId;
+            mDevice.name = *mContext.pId;
+            mWriter.SetLimit(mpExporter->GetSettings().uMaxPayload);
+            mWriter.Reserve(mpExporter->GetSettings().uMaxPayload);
+            MonitoringClock::StartSync();
+            MonitoringClock::Align();
+            prepareHeader();
         }
 		vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
@@ -86,119 +137,382 @@ bool DynatraceMonitoring::Connect() {
 
 bool DynatraceMonitoring::Run() {
 	ESP_LOGI(LOGTAG, "Run");
-    mActive = mpAws->mActive;
-    while (mpAws->mActive) {
-        mActive = Process();
-		vTaskDelay(30000 / portTICK_PERIOD_MS);
+    mActive = mpExporter->IsActive();
+    // the MQTT exporter is active as long as the AWS connection is, so the configuration is checked here
+    while (mpConfig->mbDTMonitoring && mpExporter->IsActive()) {
+        // sleep until addAction signals a full batch or the oldest action reaches the max. age
+        __uint32_t uMaxAge = mpExporter->GetSettings().uFlushMaxAge;
+        __uint32_t uWait = uMaxAge;
+        __uint32_t uOldest = __atomic_load_n(&muOldestPending, __ATOMIC_RELAXED);
+        if (uOldest) {
+            __uint32_t uAge = getTimestamp() - uOldest;
+            uWait = (uAge < uMaxAge) ? uMaxAge - uAge : 0;
+        }
+        if (uWait)
+            ulTaskNotifyTake(pdTRUE, uWait / portTICK_PERIOD_MS);
+
+        // exporter changed in the configuration - waiting batches belong to the old one
+        TelemetryExporter* pExporter = selectExporter();
+        if ((pExporter != mpExporter) && pExporter->Start(mContext)) {
+            ESP_LOGI(LOGTAG, "exporting to %s", pExporter->GetName());
+            clearRetries();
+            mpExporter = pExporter;
+            mWriter.SetLimit(mpExporter->GetSettings().uMaxPayload);
+            mWriter.Reserve(mpExporter->GetSettings().uMaxPayload);
+        }
+        Process();
     }
+    // the handle is cleared last, until then ProcessConfigChange leaves the shutdown to this task
     Shutdown();
+    mhTask = NULL;
     return mActive;
 }
 
 bool DynatraceMonitoring::Process() {
 
-    ESP_LOGD(LOGTAG, "Processing monitoring payload (%i actions)", mActionCount);
+    ESP_LOGD(LOGTAG, "Processing monitoring payload (%u actions, %u dropped so far)", mActions.GetCount(), mActions.GetDropped());
+    ESP_LOGD(LOGTAG, "action pool: %u of %u in use, high water %u, exhausted %u times", getPoolInUse(), DT_ACTION_POOL_SIZE, getPoolHighWater(), getPoolExhausted());
+
+    if (MonitoringClock::Align())
+        prepareHeader();    // sessionStart is an epoch timestamp from now on
+    refreshDevice();
+    sendRetries();
+
+    __atomic_store_n(&muOldestPending, 0, __ATOMIC_RELAXED);
+    bool bPublished = false;
+    beginBatch();
+    DynatraceAction* action;
+    for (__uint16_t u=0; (u < ACTIONQUEUE_SIZE) && mActions.Pop(action); u++) {
+        __atomic_sub_fetch(&muPendingBytes, action->getSizeEstimate(), __ATOMIC_RELAXED);
+        if (!appendAction(action)) {
+            // batch is full - send it and continue with a new one
+            endBatch();
+            publishBatch();
+            bPublished = true;
+            beginBatch();
+            if (!appendAction(action))
+                ESP_LOGW(LOGTAG, "action %u does not fit into a batch", action->getId());
+        }
+        releaseAction(action);
+    }
+    if (muBatchActions || !bPublished) {
+        endBatch();
+        publishBatch();
+    }
+
+    ESP_LOGD(LOGTAG, "batches: %u sent, %u waiting, %u dropped", muBatchesSent, muRetryCount, muBatchesDropped);
+    ESP_LOGD(LOGTAG, "bytes copied for retries: %u", muBytesCopied);
+    ESP_LOGD(LOGTAG, "free heap after monitoring: %i", esp_get_free_heap_size());  
 
-//    taskENTER_CRITICAL(&myMutex);
-    if (!criticalSection.Enter(0)) return false;
-    __uint8_t actionCount = mActionCount;
-    DynatraceAction* actionBuffer[100];
-    for (__uint8_t i=0; i<mActionCount; i++) {
-        actionBuffer[i] = mAction[i];
+    return true;
+}
+
+// everything that does not change during a session
+void DynatraceMonitoring::prepareHeader() {
+    mJsonHeader.Reset();
+    mJsonHeader.Append("\"sessionStart\":");
+    mJsonHeader.AppendQuotedUint(MonitoringClock::ToEpochMs(mStartTimestamp));
+    mJsonHeader.Append(",\"endpoint\":");
+    mJsonHeader.AppendJsonString(ENDPOINT);
+    mJsonHeader.Append(",\"agent\":");
+    mJsonHeader.AppendJsonString(AGENT);
+    mJsonHeader.Append(",\"version\":");
+    mJsonHeader.AppendJsonString(VERSION);
+    mJsonHeader.Append(",\"device\":{\"id\":");
+    mJsonHeader.AppendJsonString(mDevice.id.c_str());
+    mJsonHeader.Append(",\"name\":");
+    mJsonHeader.AppendJsonString(mDevice.name.c_str());
+    mJsonHeader.Append(",\"clientIP\":");
+    mJsonHeader.AppendJsonString(mDevice.clientIp.c_str());
+    mJsonHeader.Append(",\"cpu\":");
+    mJsonHeader.AppendJsonString(mDevice.cpu.c_str());
+    mJsonHeader.Append(",\"os\":");
+    mJsonHeader.AppendJsonString(mDevice.os.c_str());
+    mJsonHeader.Append(",\"totalmem\":");
+    mJsonHeader.AppendQuotedUint(mDevice.totalmem);
+    mJsonHeader.Append(",\"manufacturer\":");
+    mJsonHeader.AppendJsonString(mDevice.manufacturer.c_str());
+    mJsonHeader.Append(",\"modelId\":");
+    mJsonHeader.AppendJsonString(mDevice.modelId.c_str());
+    mJsonHeader.Append(",\"appVersion\":");
+    mJsonHeader.AppendJsonString(mDevice.appVersion.c_str());
+    mJsonHeader.Append(",\"appBuild\":");
+    mJsonHeader.AppendJsonString(mDevice.appBuild.c_str());
+    mJsonHeader.Append(',');
+
+    mCborDevice.Reset();
+    mCborDevice.CborMap(14);
+    mCborDevice.CborText("sessionStart");
+    mCborDevice.CborUint(MonitoringClock::ToEpochMs(mStartTimestamp));
+    mCborDevice.CborText("endpoint");
+    mCborDevice.CborText(ENDPOINT);
+    mCborDevice.CborText("agent");
+    mCborDevice.CborText(AGENT);
+    mCborDevice.CborText("version");
+    mCborDevice.CborText(VERSION);
+    mCborDevice.CborText("id");
+    mCborDevice.CborText(mDevice.id.c_str());
+    mCborDevice.CborText("name");
+    mCborDevice.CborText(mDevice.name.c_str());
+    mCborDevice.CborText("clientIP");
+    mCborDevice.CborText(mDevice.clientIp.c_str());
+    mCborDevice.CborText("cpu");
+    mCborDevice.CborText(mDevice.cpu.c_str());
+    mCborDevice.CborText("os");
+    mCborDevice.CborText(mDevice.os.c_str());
+    mCborDevice.CborText("totalmem");
+    mCborDevice.CborUint(mDevice.totalmem);
+    mCborDevice.CborText("manufacturer");
+    mCborDevice.CborText(mDevice.manufacturer.c_str());
+    mCborDevice.CborText("modelId");
+    mCborDevice.CborText(mDevice.modelId.c_str());
+    mCborDevice.CborText("appVersion");
+    mCborDevice.CborText(mDevice.appVersion.c_str());
+    mCborDevice.CborText("appBuild");
+    mCborDevice.CborText(mDevice.appBuild.c_str());
+}
+
+// takes over a finished lookup and starts a new one when the cached public IP has expired
+void DynatraceMonitoring::refreshDevice() {
+    __uint8_t uState = __atomic_load_n(&muLookupState, __ATOMIC_ACQUIRE);
+    if (uState == DT_LOOKUP_RUNNING)
+        return;
+    if (uState == DT_LOOKUP_DONE) {
+        if (mbLookupOk) {
+            muPublicIpTime = getTimestamp() | 1;
+            if (!msPublicIp.equals(mDevice.clientIp)) {
+                mDevice.clientIp = msPublicIp;
+                prepareHeader();
+            }
+        }
+        __atomic_store_n(&muLookupState, DT_LOOKUP_IDLE, __ATOMIC_RELAXED);
     }
-    mActionCount = 0;
-//    taskEXIT_CRITICAL(&myMutex);
-    criticalSection.Leave();
 
-    String payload = getPayload(actionBuffer, actionCount);
-    Send(&payload);
+    if (!mpConfig->mbDTPublicIpLookup) {
+        if (muPublicIpTime) {
+            muPublicIpTime = 0;
+            mDevice.clientIp = mContext.pWifi->GetLocalAddress();
+            prepareHeader();
+        }
+        return;
+    }
+    __uint32_t uNow = getTimestamp();
+    if (muPublicIpTime && (uNow - muPublicIpTime < DT_PUBLIC_IP_TTL))
+        return;
+    if (muLookupAttempt && (uNow - muLookupAttempt < DT_PUBLIC_IP_RETRY))
+        return;
+    muLookupAttempt = uNow | 1;
+    __atomic_store_n(&muLookupState, DT_LOOKUP_RUNNING, __ATOMIC_RELAXED);
+    if (xTaskCreate(&task_function_dynatrace_lookup, "Task_DtLookup", 8192, this, 4, NULL) != pdPASS)
+        __atomic_store_n(&muLookupState, DT_LOOKUP_IDLE, __ATOMIC_RELAXED);
+}
 
-    for (uint i=0; i<actionCount; i++) {
-        delete actionBuffer[i];
+void DynatraceMonitoring::beginBatch() {
+    mWriter.Reset();
+    mbBatchCbor = mpConfig->mbDTMonitoringCbor;
+    muBatchActions = 0;
+    muBatchNames = 0;
+    int8_t iRssi = 0;
+    __uint8_t uChannel;
+    if (mContext.pWifi->IsConnected())
+        mContext.pWifi->GetApInfo(iRssi, uChannel);
+
+    if (mbBatchCbor) {
+        mWriter.CborMap(8);
+        mWriter.CborText("timestamp");
+        mWriter.CborUint(MonitoringClock::ToEpochMs(MonitoringClock::Now()));
+        mWriter.CborText("device");
+        mWriter.Append(mCborDevice.GetData(), mCborDevice.GetLength());
+        mWriter.CborText("freemem");
+        mWriter.CborUint(esp_get_free_heap_size());
+        mWriter.CborText("rssi");
+        mWriter.CborInt(iRssi);
+        mWriter.CborText("batteryLevel");
+        mWriter.CborUint(mBatterylevel);
+        mWriter.CborText("session");
+        mWriter.CborUint(1);
+        mWriter.CborText("actions");
+        mWriter.CborArrayBegin();
+        muBatchReserve = 1 + 6 + 3;     // break, "names", map header
+    } else {
+        mWriter.Append("{\"timestamp\":");
+        mWriter.AppendQuotedUint(MonitoringClock::ToEpochMs(MonitoringClock::Now()));
+        mWriter.Append(',');
+        mWriter.Append(mJsonHeader.GetData(), mJsonHeader.GetLength());
+        mWriter.Append("\"freemem\":");
+        mWriter.AppendQuotedUint(esp_get_free_heap_size());
+        mWriter.Append(",\"rssi\":");
+        mWriter.AppendQuotedInt(iRssi);
+        mWriter.Append(",\"batteryLevel\":");
+        mWriter.AppendQuotedUint(mBatterylevel);
+        mWriter.Append("},\"session\":{\"id\":\"1\"},\"actions\":[");
+        muBatchReserve = 2;             // ]}
     }
+}
 
-    ESP_LOGD(LOGTAG, "free heap after monitoring: %i", esp_get_free_heap_size());  
+// false if the action does not fit into the max. payload of the exporter anymore, the batch is left unchanged then
+// the space is checked before writing: the writer is limited to what is left for actions, so it never grows beyond the max. payload
+bool DynatraceMonitoring::appendAction(DynatraceAction* action) {
+    size_t uMark = mWriter.GetLength();
+    size_t uReserve = muBatchReserve;
+    __uint64_t uNames = muBatchNames;
+    size_t uMaxPayload = mpExporter->GetSettings().uMaxPayload;
+
+    if (mbBatchCbor) {
+        // actions reference their names by id, the batch carries the id -> name map of the names it uses
+        __uint8_t uNameId = action->getNameId();
+        if ((uNameId < DT_MAX_ACTION_NAMES) && !(uNames & (1ull << uNameId))) {
+            uNames |= 1ull << uNameId;
+            uReserve += 2 + 3 + strlen(getActionName(uNameId));
+        }
+    }
+    if (uMark + uReserve >= uMaxPayload)
+        return false;
 
+    mWriter.SetLimit(uMaxPayload - uReserve);
+    if (mbBatchCbor) {
+        action->writeCbor(mWriter);
+    } else {
+        if (muBatchActions)
+            mWriter.Append(',');
+        action->writeJson(mWriter);
+    }
+    bool bFits = mWriter.IsValid();
+    mWriter.SetLimit(uMaxPayload);
+
+    if (!bFits) {
+        mWriter.Truncate(uMark);
+        return false;
+    }
+    muBatchReserve = uReserve;
+    muBatchNames = uNames;
+    muBatchActions++;
     return true;
 }
 
-String DynatraceMonitoring::getPayload(DynatraceAction* pActions[], __uint8_t pCount) {
-    String sPayload = "{";
-    sPayload.printf("\"timestamp\":\"%i\",", getTimestamp());
-    sPayload.printf("\"sessionStart\":\"%i\",", mStartTimestamp);
-    sPayload.printf("\"endpoint\":\"%s\",", ENDPOINT);
-    sPayload.printf("\"agent\":\"%s\",", AGENT);
-    sPayload.printf("\"version\":\"%s\",", VERSION);
-
-    sPayload.printf("\"device\":{");
-    sPayload.printf("\"id\":\"%s\",", mDevice.id.c_str());
-    sPayload.printf("\"name\":\"%s\",", mDevice.name.c_str());
-    sPayload.printf("\"clientIP\":\"%s\",", mDevice.clientIp.c_str());
-    sPayload.printf("\"cpu\":\"%s\",", mDevice.cpu.c_str());
-    sPayload.printf("\"os\":\"%s\",", mDevice.os.c_str());
-    sPayload.printf("\"freemem\":\"%i\",", esp_get_free_heap_size());
-    sPayload.printf("\"totalmem\":\"%i\",", mDevice.totalmem);
-    sPayload.printf("\"batteryLevel\":\"%i\",", mBatterylevel);
-    sPayload.printf("\"manufacturer\":\"%s\",", mDevice.manufacturer.c_str());
-    sPayload.printf("\"modelId\":\"%s\",", mDevice.modelId.c_str());
-    sPayload.printf("\"appVersion\":\"%s\",", mDevice.appVersion.c_str());
-    sPayload.printf("\"appBuild\":\"%s\"},", mDevice.appBuild.c_str());
-//    sPayload.printf("\"organization\":\"%s\",", mpConfig->msOrganization.c_str());
-//    sPayload.printf("\"department\":\"%s\",", mpConfig->msDepartment.c_str());
-//    sPayload.printf("\"location\":\"%s\"},", mpConfig->msLocation.c_str());
-
-    sPayload.printf("\"session\":{");
-    sPayload.printf("\"id\":\"%i\"",1);
-    sPayload.printf("},");
-    sPayload.printf("\"actions\":[");
-    for (uint i=0; i<pCount; i++) {
-        sPayload.printf("%s", pActions[i]->getPayload().c_str());
-        if (i<pCount-1) sPayload.printf(",");
+void DynatraceMonitoring::endBatch() {
+    if (mbBatchCbor) {
+        mWriter.CborBreak();
+        mWriter.CborText("names");
+        mWriter.CborMap(__builtin_popcountll(muBatchNames));
+        for (__uint8_t u=0; u<DT_MAX_ACTION_NAMES; u++) {
+            if (muBatchNames & (1ull << u)) {
+                mWriter.CborUint(u);
+                mWriter.CborText(getActionName(u));
+            }
+        }
+    } else {
+        mWriter.Append("]}");
     }
-    sPayload.printf("]}");
+    ESP_LOGD(LOGTAG, "batch: %u actions, %u bytes (buffer %u bytes)", muBatchActions, (unsigned int)mWriter.GetLength(), (unsigned int)mWriter.GetCapacity());
+}
 
-    return sPayload;
+// keeps the order: while older batches are waiting, a new one is queued behind them
+void DynatraceMonitoring::publishBatch() {
+    if (!mWriter.IsValid()) {
+        ESP_LOGE(LOGTAG, "monitoring payload could not be allocated or exceeds %u bytes", mpExporter->GetSettings().uMaxPayload);
+        muBatchesDropped++;
+        return;
+    }
+    if (!muRetryCount && Send(mWriter.GetData(), mWriter.GetLength(), mbBatchCbor)) {
+        muBatchesSent++;
+        return;
+    }
+    queueRetry(mWriter.GetData(), mWriter.GetLength(), mbBatchCbor);
 }
 
-void DynatraceMonitoring::Send(String* json) {
-    ESP_LOGD(LOGTAG, "%s", json->c_str());
-    String topic;
-    topic.printf("/dynatraceufo/monitoring/%s", mpUfo->GetId().c_str());
-    mpAws->Publish(topic.c_str(), topic.length(), json);
+bool DynatraceMonitoring::sendRetries() {
+    while (muRetryCount) {
+        TDtBatch& rBatch = mRetry[muRetryFirst];
+        if (!Send(rBatch.pData, rBatch.uLength, rBatch.bCbor))
+            return false;
+        free(rBatch.pData);
+        muRetryFirst = (muRetryFirst + 1) % DT_MAX_RETRY_BATCHES;
+        muRetryCount--;
+        muBatchesSent++;
+    }
+    return true;
+}
+
+// bounded - when full, the oldest batch is dropped
+void DynatraceMonitoring::queueRetry(const char* pData, size_t uLength, bool bCbor) {
+    __uint8_t uCapacity = mpExporter->GetSettings().uRetryBatches;
+    if (uCapacity > DT_MAX_RETRY_BATCHES)
+        uCapacity = DT_MAX_RETRY_BATCHES;
+    if (!uCapacity) {
+        muBatchesDropped++;
+        return;
+    }
+    if (muRetryCount >= uCapacity) {
+        free(mRetry[muRetryFirst].pData);
+        muRetryFirst = (muRetryFirst + 1) % DT_MAX_RETRY_BATCHES;
+        muRetryCount--;
+        muBatchesDropped++;
+    }
+    char* pCopy = (char*)malloc(uLength);
+    if (!pCopy) {
+        muBatchesDropped++;
+        return;
+    }
+    memcpy(pCopy, pData, uLength);
+    muBytesCopied += uLength;
+    TDtBatch& rBatch = mRetry[(muRetryFirst + muRetryCount) % DT_MAX_RETRY_BATCHES];
+    rBatch.pData = pCopy;
+    rBatch.uLength = uLength;
+    rBatch.bCbor = bCbor;
+    muRetryCount++;
+    ESP_LOGW(LOGTAG, "batch could not be published, %u waiting", muRetryCount);
+}
+
+void DynatraceMonitoring::clearRetries() {
+    while (muRetryCount) {
+        free(mRetry[muRetryFirst].pData);
+        muRetryFirst = (muRetryFirst + 1) % DT_MAX_RETRY_BATCHES;
+        muRetryCount--;
+    }
+}
+
+bool DynatraceMonitoring::Send(const char* pPayload, size_t uLength, bool bCbor) {
+    if (!bCbor)
+        ESP_LOGD(LOGTAG, "%.*s", (int)uLength, pPayload);
+    return mpExporter->Export(pPayload, uLength, bCbor);
 }
 
 void DynatraceMonitoring::Shutdown() {
 	ESP_LOGI(LOGTAG, "delete action buffer and shutdown");
     mActive = false;
     mConnected = false;
-    for (__uint8_t i=0; i<mActionCount; i++) {
-        delete mAction[i];
-    }
-    mActionCount = 0;    
+    DynatraceAction* action;
+    while (mActions.Pop(action))
+        releaseAction(action);
+    __atomic_store_n(&muPendingBytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&muOldestPending, 0, __ATOMIC_RELAXED);
+    clearRetries();
 }
 
-DynatraceAction* DynatraceMonitoring::enterAction(String pName) {
+DynatraceAction* DynatraceMonitoring::enterAction(const char* pName) {
     return this->enterAction(pName, ACTION_MANUAL, NULL);    
 };
 
-DynatraceAction* DynatraceMonitoring::enterAction(String pName, int pType) {
+DynatraceAction* DynatraceMonitoring::enterAction(const char* pName, int pType) {
     return this->enterAction(pName, pType, NULL);    
 };
 
-DynatraceAction* DynatraceMonitoring::enterAction(String pName, DynatraceAction* pParent) {
+DynatraceAction* DynatraceMonitoring::enterAction(const char* pName, DynatraceAction* pParent) {
     return this->enterAction(pName, ACTION_MANUAL, pParent);
 };
 
-DynatraceAction* DynatraceMonitoring::enterAction(String pName, int pType, DynatraceAction* pParent) {
+DynatraceAction* DynatraceMonitoring::enterAction(const char* pName, int pType, DynatraceAction* pParent) {
     if (!mActive) return NULL;
     __uint32_t id = 0;
     __uint32_t parentId = 0;
     if (pParent) {
         parentId = pParent->getId();
     }
-    DynatraceAction* action = new DynatraceAction(this);
-    id = action->enter(pName, pType, parentId);
-    ESP_LOGD(LOGTAG, "Action %i created: %s", id, pName.c_str());
+    DynatraceAction* action = allocAction();
+    if (!action) return NULL;
+    id = action->enter(internName(pName, false), pType, parentId);
+    ESP_LOGD(LOGTAG, "Action %i created: %s", id, pName);
     return action;
 };
 
@@ -207,7 +521,7 @@ void DynatraceMonitoring::leaveAction(DynatraceAction* action) {
         if (mActive) { 
             action->leave();
         } else {
-            delete action;
+            releaseAction(action);
         }
     }
 }
@@ -215,51 +529,129 @@ void DynatraceMonitoring::leaveAction(DynatraceAction* action) {
 void DynatraceMonitoring::leaveAction(DynatraceAction* action, String* pUrl, ushort pResponseCode, uint pResponseSize) {
     if (action != NULL) {
         if (mActive) { 
-            action->leave(pUrl, pResponseCode, pResponseSize);
+            action->leave(internName(pUrl->c_str(), true), pResponseCode, pResponseSize);
         } else {
-            delete action;
+            releaseAction(action);
         }
     }    
 }
 
 void DynatraceMonitoring::addAction(DynatraceAction* action) {
-    ESP_LOGD(LOGTAG, "Action %i added to stack: %s", mActionCount, action->getName().c_str());
-//    taskENTER_CRITICAL(&myMutex);
-    if (!criticalSection.Enter(0)) return;
-    if (mActionCount < 90) {
-        mAction[mActionCount++] = action;
-    } else {
-        delete action;
+    ESP_LOGD(LOGTAG, "Action added to queue: %s", action->getName());
+    __uint32_t uEnd = action->getEnd() | 1;
+    __uint16_t uSize = action->getSizeEstimate();
+    //never blocks - if the monitoring task does not keep up, the action is dropped (and counted)
+    if (!mActions.Push(action)) {
+        releaseAction(action);
+        return;
+    }
+    //the action may already be processed by now, don't touch it anymore
+    __uint32_t uNone = 0;
+    __atomic_compare_exchange_n(&muOldestPending, &uNone, uEnd, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    __uint32_t uBytes = __atomic_add_fetch(&muPendingBytes, uSize, __ATOMIC_RELAXED);
+    TaskHandle_t hTask = mhTask;
+    TelemetryExporter* pExporter = mpExporter;
+    if (!hTask || !pExporter)
+        return;
+    const TExporterSettings& rSettings = pExporter->GetSettings();
+    if ((mActions.GetCount() >= rSettings.uFlushActions) || (uBytes >= rSettings.uFlushBytes))
+        xTaskNotifyGive(hTask);
+}
+
+TelemetryExporter* DynatraceMonitoring::selectExporter() {
+    switch (mpConfig->muDTMonitoringExporter) {
+        case DT_EXPORTER_HTTP:
+            return &mHttpExporter;
+        case DT_EXPORTER_RINGLOG:
+            return &mRingLogExporter;
+        default:
+            return &mMqttExporter;
+    }
+}
+
+DynatraceAction* DynatraceMonitoring::allocAction() {
+    DynatraceAction* action;
+    if (!mFreeActions.Pop(action)) {
+        __atomic_add_fetch(&muPoolExhausted, 1, __ATOMIC_RELAXED);
+        return NULL;
     }
-//    taskEXIT_CRITICAL(&myMutex);
-    criticalSection.Leave();
+    __uint32_t uInUse = __atomic_add_fetch(&muPoolInUse, 1, __ATOMIC_RELAXED);
+    __uint32_t uHighWater = __atomic_load_n(&muPoolHighWater, __ATOMIC_RELAXED);
+    while ((uInUse > uHighWater) && !__atomic_compare_exchange_n(&muPoolHighWater, &uHighWater, uInUse, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    action->init(this);
+    return action;
+}
+
+void DynatraceMonitoring::releaseAction(DynatraceAction* action) {
+    __atomic_sub_fetch(&muPoolInUse, 1, __ATOMIC_RELAXED);
+    mFreeActions.Push(action); //can not fail, the free list holds the whole pool
+}
+
+// literals are stored by reference, other names (like the hosts of web requests) get copied once
+__uint8_t DynatraceMonitoring::internName(const char* pName, bool bCopy) {
+    __uint8_t uCount = __atomic_load_n(&muActionNameCount, __ATOMIC_ACQUIRE);
+    for (__uint8_t u=0; u<uCount; u++) {
+        if ((mpActionNames[u] == pName) || !strcmp(mpActionNames[u], pName))
+            return u;
+    }
+    if (uCount >= DT_MAX_ACTION_NAMES)
+        return DT_ACTION_NAME_UNKNOWN;
+
+    char* pCopy = NULL;
+    if (bCopy) {
+        pCopy = strdup(pName);
+        if (!pCopy)
+            return DT_ACTION_NAME_UNKNOWN;
+    }
+
+    __uint8_t uId = DT_ACTION_NAME_UNKNOWN;
+    taskENTER_CRITICAL(&myMutex);
+    for (__uint8_t u=uCount; u<muActionNameCount; u++) { //added by another task meanwhile?
+        if (!strcmp(mpActionNames[u], pName)) {
+            uId = u;
+            break;
+        }
+    }
+    if ((uId == DT_ACTION_NAME_UNKNOWN) && (muActionNameCount < DT_MAX_ACTION_NAMES)) {
+        uId = muActionNameCount;
+        mpActionNames[uId] = bCopy ? pCopy : pName;
+        pCopy = NULL;
+        __atomic_store_n(&muActionNameCount, uId + 1, __ATOMIC_RELEASE);
+    }
+    taskEXIT_CRITICAL(&myMutex);
+
+    if (pCopy)
+        free(pCopy);
+    return uId;
+}
+
+const char* DynatraceMonitoring::getActionName(__uint8_t uNameId) {
+    if (uNameId >= __atomic_load_n(&muActionNameCount, __ATOMIC_ACQUIRE))
+        return "unknown";
+    return mpActionNames[uNameId];
 }
 
 __uint32_t DynatraceMonitoring::getSequence0() {
-    return seq0++;
+    return __atomic_fetch_add(&seq0, 1, __ATOMIC_RELAXED);
 };
 
 __uint32_t DynatraceMonitoring::getSequence1() {
-    return seq1++;
+    return __atomic_fetch_add(&seq1, 1, __ATOMIC_RELAXED);
 };
 
 __uint32_t DynatraceMonitoring::getTimestamp() {
-    __uint32_t ms = esp_log_timestamp();
-    ESP_LOGD(LOGTAG, "current timestamp: %i", ms);
-    return ms;
+    return MonitoringClock::Now() / 1000;
 };
 
-String DynatraceMonitoring::getPublicIp() {
-    String response;
+void DynatraceMonitoring::lookupPublicIp() {
+    msPublicIp.clear();
+    mClient.SetTimeouts(5000, 5000, 10000);
     mUrl.Parse("https://api.ipify.org");
-    if (mClient.Prepare(&mUrl)) {
-        unsigned short responseCode = mClient.HttpGet();
-        response = mClient.GetResponseData();
-    }
+    if (mClient.Prepare(&mUrl) && (mClient.HttpGet() == 200))
+        msPublicIp = mClient.GetResponseData();
     mClient.Clear();
-    ESP_LOGI(LOGTAG, "public IP: %s", response.c_str());
-    return response;
-    
+    mbLookupOk = msPublicIp.length() > 0;
+    ESP_LOGI(LOGTAG, "public IP: %s", mbLookupOk ? msPublicIp.c_str() : "lookup failed");
+    __atomic_store_n(&muLookupState, DT_LOOKUP_DONE, __ATOMIC_RELEASE);
 }
-
-
@@ -4,7 +4,12 @@
 #include "freertos/FreeRTOS.h"
 #include "Config.h"
 #include "WebClient.h"
-#include "CriticalSection.h"
+#include "ActionQueue.h"
+#include "DynatraceAction.h"
+#include "PayloadWriter.h"
+#include "MqttExporter.h"
+#include "HttpExporter.h"
+#include "RingLogExporter.h"
 #include "String.h"
 #include <cJSON.h>
 
@@ -44,10 +49,28 @@ typedef struct {
     String appBuild;
 } tdDevice;
 
+typedef struct {
+    char* pData;
+    size_t uLength;
+    bool bCbor;
+} TDtBatch;
+
+
+#define DT_ACTION_POOL_SIZE     96      // max. number of actions entered or waiting to be sent
+#define DT_MAX_RETRY_BATCHES    8       // upper limit of TExporterSettings::uRetryBatches
 
-class Ufo;
-class AWSIntegration;
-class DynatraceAction;
+#define DT_PUBLIC_IP_TTL        3600000 // ms a looked up public IP is used before it is looked up again
+#define DT_PUBLIC_IP_RETRY      60000   // ms before a failed lookup is repeated
+
+#define DT_LOOKUP_IDLE          0
+#define DT_LOOKUP_RUNNING       1
+#define DT_LOOKUP_DONE          2       // result waits to be taken over by the monitoring task
+#define DT_MAX_ACTION_NAMES     64
+#define DT_ACTION_NAME_UNKNOWN  0xff
+
+#if DT_ACTION_POOL_SIZE > ACTIONQUEUE_SIZE
+#error "the free list of the action pool has to be able to hold all actions"
+#endif
 
 class DynatraceMonitoring {
 
@@ -56,52 +79,118 @@ public:
     DynatraceMonitoring();
 	virtual ~DynatraceMonitoring();
     
-    bool Init(Ufo* pUfo, AWSIntegration* pAws);
+    bool Init(const TExporterContext& rContext);
     void ProcessConfigChange();
     bool Connect();
     bool Run();
     bool Process();
-    void Send(String* json);
+    bool Send(const char* pPayload, size_t uLength, bool bCbor);
+    RingLogExporter& getRingLog() { return mRingLogExporter; }
+    const char* getExporterName() { return mpExporter ? mpExporter->GetName() : "none"; }
     void Shutdown();
     
-    DynatraceAction* enterAction(String pName);
-    DynatraceAction* enterAction(String pName, int pType);
-    DynatraceAction* enterAction(String pName, DynatraceAction* pParent);
-    DynatraceAction* enterAction(String pName, int pType, DynatraceAction* pParent);
+    // the name has to be a string literal (or live forever) - it is stored by reference in the name table
+    DynatraceAction* enterAction(const char* pName);
+    DynatraceAction* enterAction(const char* pName, int pType);
+    DynatraceAction* enterAction(const char* pName, DynatraceAction* pParent);
+    DynatraceAction* enterAction(const char* pName, int pType, DynatraceAction* pParent);
     void leaveAction(DynatraceAction* action);
     void leaveAction(DynatraceAction* action, String* pUrl, ushort pResponseCode, uint pResponseSize);
 
     void addAction(DynatraceAction* action);
-    String getPayload(DynatraceAction* pActions[], __uint8_t pCount);
-    String getPublicIp();
+    void releaseAction(DynatraceAction* action);
+    const char* getActionName(__uint8_t uNameId);
+
+    __uint32_t getPoolInUse() { return __atomic_load_n(&muPoolInUse, __ATOMIC_RELAXED); }
+    __uint32_t getPoolHighWater() { return __atomic_load_n(&muPoolHighWater, __ATOMIC_RELAXED); }
+    __uint32_t getPoolExhausted() { return __atomic_load_n(&muPoolExhausted, __ATOMIC_RELAXED); }
+    __uint32_t getBatchesSent() { return muBatchesSent; }
+    __uint32_t getBatchesDropped() { return muBatchesDropped; }
+    __uint8_t getBatchesWaiting() { return muRetryCount; }
+    __uint32_t getBytesCopied() { return muBytesCopied; }
+    // runs in its own short lived task, so the TLS handshake never delays the monitoring task
+    void lookupPublicIp();
 
     __uint32_t getSequence0();
     __uint32_t getSequence1();
-    __uint32_t getTimestamp();
+    __uint32_t getTimestamp();     // ms since boot
 
     bool mInitialized = false;
     bool mConnected = false;
     bool mActive = false;
-    __uint32_t mStartTimestamp;
+    __uint64_t mStartTimestamp;    // us, MonitoringClock
 
 private:
 
-    DynatraceAction* mAction[100];
-    __uint8_t mActionCount;
+    TelemetryExporter* selectExporter();
+    DynatraceAction* allocAction();
+    __uint8_t internName(const char* pName, bool bCopy);
+    void prepareHeader();
+    void refreshDevice();
+    void beginBatch();
+    bool appendAction(DynatraceAction* action);
+    void endBatch();
+    void publishBatch();
+    bool sendRetries();
+    void queueRetry(const char* pData, size_t uLength, bool bCbor);
+    void clearRetries();
+
+    ActionQueue mActions;	// completed actions, filled from any task without locking
+
+    // preallocated action records, entering or leaving an action does not touch the heap
+    DynatraceAction mActionPool[DT_ACTION_POOL_SIZE];
+    ActionQueue mFreeActions;
+    __uint32_t muPoolInUse;
+    __uint32_t muPoolHighWater;
+    __uint32_t muPoolExhausted;
+
+    // action names are interned, the actions just keep the index
+    const char* mpActionNames[DT_MAX_ACTION_NAMES];
+    __uint8_t muActionNameCount;
 
     __uint32_t seq0;
     __uint32_t seq1;
 
-    Ufo* mpUfo;  
-    AWSIntegration* mpAws;
+    TExporterContext mContext;
     Config* mpConfig;
 
-    CriticalSection criticalSection;
     Url mUrl;
     WebClient  mClient;
 
     tdDevice mDevice;
+    // public IP enrichment - msPublicIp and mbLookupOk belong to the lookup task while it is running
+    __uint8_t muLookupState;
+    String msPublicIp;
+    bool mbLookupOk;
+    __uint32_t muPublicIpTime;      // ms timestamp of the last successful lookup, 0 if there is none
+    __uint32_t muLookupAttempt;     // ms timestamp of the last lookup attempt
     ushort mBatterylevel;
+
+    // the exporter is picked by Config::muDTMonitoringExporter, it brings its own batching and retry settings
+    TelemetryExporter* mpExporter;
+    MqttExporter mMqttExporter;
+    HttpExporter mHttpExporter;
+    RingLogExporter mRingLogExporter;
+
+    PayloadWriter mWriter;			// reused for every batch, sized for the max. payload of the exporter
+    __uint32_t muBytesCopied;		// payload bytes copied besides serializing and publishing (retry queue)
+    PayloadWriter mJsonHeader;		// static session and device fields, serialized once in Connect
+    PayloadWriter mCborDevice;
+    bool mbBatchCbor;
+    __uint16_t muBatchActions;
+    __uint64_t muBatchNames;		// name ids used in the actual CBOR batch
+    size_t muBatchReserve;			// bytes needed to close the actual batch
+
+    TaskHandle_t mhTask;
+    __uint32_t muPendingBytes;		// estimated size of the queued actions
+    __uint32_t muOldestPending;		// end of the first queued action, 0 if there is none
+
+    // batches that could not be published, oldest first - only accessed by the monitoring task
+    TDtBatch mRetry[DT_MAX_RETRY_BATCHES];
+    __uint8_t muRetryFirst;
+    __uint8_t muRetryCount;
+    __uint32_t muBatchesSent;
+    __uint32_t muBatchesDropped;
     portMUX_TYPE myMutex;
 
 };
@@ -0,0 +1,358 @@
+#include "DynatraceProblems.h"
+#include "String.h"
+#include <esp_log.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const char* LOGTAG = "DTProblems";
+
+
+DynatraceProblemTable::DynatraceProblemTable() {
+	Clear();
+}
+
+DynatraceProblemTable::~DynatraceProblemTable() {
+}
+
+void DynatraceProblemTable::Clear(){
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		mProblems[u].bUsed = false;
+		mpSlots[u] = NULL;
+	}
+}
+
+TDtProblem* DynatraceProblemTable::Find(__uint8_t uEnvironment, const char* sId){
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		if (mProblems[u].bUsed && (mProblems[u].uEnvironment == uEnvironment) && !strcmp(mProblems[u].sId, sId))
+			return &mProblems[u];
+	}
+	return NULL;
+}
+
+bool DynatraceProblemTable::Upsert(__uint8_t uEnvironment, TDtProblem& rProblem){
+	TDtProblem* pProblem = Find(uEnvironment, rProblem.sId);
+	if (pProblem){
+		pProblem->bSeen = true;
+		if ((pProblem->uImpact == rProblem.uImpact) && (pProblem->uSeverity == rProblem.uSeverity))
+			return false;
+		pProblem->uImpact = rProblem.uImpact;
+		pProblem->uSeverity = rProblem.uSeverity;
+		return true;
+	}
+
+	__uint8_t uSlot = 0;
+	while ((uSlot < DT_MAX_PROBLEMS) && mpSlots[uSlot])
+		uSlot++;
+	if (uSlot >= DT_MAX_PROBLEMS){
+		ESP_LOGD(LOGTAG, "no free slot for problem %s", rProblem.sId);
+		return false;
+	}
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		if (!mProblems[u].bUsed){
+			mProblems[u] = rProblem;
+			mProblems[u].uEnvironment = uEnvironment;
+			mProblems[u].uSlot = uSlot;
+			mProblems[u].bUsed = true;
+			mProblems[u].bSeen = true;
+			mpSlots[uSlot] = &mProblems[u];
+			ESP_LOGD(LOGTAG, "problem %s added to slot %u", rProblem.sId, uSlot);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool DynatraceProblemTable::Remove(__uint8_t uEnvironment, const char* sId){
+	TDtProblem* pProblem = Find(uEnvironment, sId);
+	if (!pProblem)
+		return false;
+	ESP_LOGD(LOGTAG, "problem %s removed from slot %u", sId, pProblem->uSlot);
+	mpSlots[pProblem->uSlot] = NULL;
+	pProblem->bUsed = false;
+	return true;
+}
+
+bool DynatraceProblemTable::RemoveEnvironment(__uint8_t uEnvironment){
+	bool bChanged = false;
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		if (mProblems[u].bUsed && (mProblems[u].uEnvironment == uEnvironment)){
+			mpSlots[mProblems[u].uSlot] = NULL;
+			mProblems[u].bUsed = false;
+			bChanged = true;
+		}
+	}
+	return bChanged;
+}
+
+bool DynatraceProblemTable::Apply(__uint8_t uEnvironment, TDtProblem* pProblems, __uint8_t uCount){
+	bool bChanged = false;
+
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		if (mProblems[u].uEnvironment == uEnvironment)
+			mProblems[u].bSeen = false;
+	}
+	for (__uint8_t u=0 ; u<uCount ; u++){
+		if (Find(uEnvironment, pProblems[u].sId) && Upsert(uEnvironment, pProblems[u]))
+			bChanged = true;
+	}
+	//closed problems free their segments before new problems are placed, so a full table does not drop a new problem
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		if (mProblems[u].bUsed && (mProblems[u].uEnvironment == uEnvironment) && !mProblems[u].bSeen){
+			ESP_LOGD(LOGTAG, "problem %s closed", mProblems[u].sId);
+			mpSlots[mProblems[u].uSlot] = NULL;
+			mProblems[u].bUsed = false;
+			bChanged = true;
+		}
+	}
+	for (__uint8_t u=0 ; u<uCount ; u++){
+		if (!Find(uEnvironment, pProblems[u].sId) && Upsert(uEnvironment, pProblems[u]))
+			bChanged = true;
+	}
+	return bChanged;
+}
+
+__uint8_t DynatraceProblemTable::GetCount(int* piApplication, int* piService, int* piInfrastructure){
+	__uint8_t uCount = 0;
+	*piApplication = 0;
+	*piService = 0;
+	*piInfrastructure = 0;
+	for (__uint8_t u=0 ; u<DT_MAX_PROBLEMS ; u++){
+		if (!mProblems[u].bUsed)
+			continue;
+		uCount++;
+		switch (mProblems[u].uImpact){
+			case DT_IMPACT_APPLICATION:
+				(*piApplication)++;
+				break;
+			case DT_IMPACT_SERVICE:
+				(*piService)++;
+				break;
+			default:
+				(*piInfrastructure)++;
+				break;
+		}
+	}
+	return uCount;
+}
+
+__uint8_t DynatraceProblemTable::ParseImpact(const char* sImpact){
+	if (!strcmp(sImpact, "APPLICATION"))
+		return DT_IMPACT_APPLICATION;
+	if (!strcmp(sImpact, "SERVICE"))
+		return DT_IMPACT_SERVICE;
+	return DT_IMPACT_INFRASTRUCTURE;
+}
+
+__uint8_t DynatraceProblemTable::ParseSeverity(const char* sSeverity){
+	if (!strcmp(sSeverity, "AVAILABILITY"))
+		return DT_SEVERITY_AVAILABILITY;
+	if (!strcmp(sSeverity, "ERROR"))
+		return DT_SEVERITY_ERROR;
+	if (!strcmp(sSeverity, "PERFORMANCE"))
+		return DT_SEVERITY_PERFORMANCE;
+	if (!strcmp(sSeverity, "RESOURCE_CONTENTION"))
+		return DT_SEVERITY_RESOURCE_CONTENTION;
+	if (!strcmp(sSeverity, "CUSTOM_ALERT"))
+		return DT_SEVERITY_CUSTOM_ALERT;
+	return DT_SEVERITY_UNKNOWN;
+}
+
+//------------------------------------------------------------------------------------------
+
+DynatraceProblemFeedParser::DynatraceProblemFeedParser() {
+	Init();
+}
+
+DynatraceProblemFeedParser::~DynatraceProblemFeedParser() {
+}
+
+void DynatraceProblemFeedParser::Init(){
+	muCount = 0;
+	muTotalCount = 0;
+	mbActProblemOpen = false;
+	muKeyLen = 0;
+	msKey[0] = 0x00;
+	muValueLen = 0;
+	msValue[0] = 0x00;
+	muDepth = 0;
+	muArrayMask = 0;
+	muProblemsDepth = 0;
+	mbInString = false;
+	mbEscape = false;
+	mbStringIsKey = false;
+	mbInScalar = false;
+	mbExpectKey = false;
+	mbProblemsFound = false;
+	mbFinished = false;
+	mbError = false;
+}
+
+bool DynatraceProblemFeedParser::OnReceiveBegin(unsigned short int httpStatusCode, bool isContentLength, unsigned int contentLength){
+	Init();
+	mbError = (httpStatusCode != 200);
+	return true;
+}
+
+bool DynatraceProblemFeedParser::OnReceiveEnd(){
+	mbFinished = true;
+	if (mbInScalar){
+		mbInScalar = false;
+		ValueComplete();
+	}
+	ESP_LOGD(LOGTAG, "feed parsed: %u open problems, %u kept", muTotalCount, muCount);
+	return true;
+}
+
+bool DynatraceProblemFeedParser::OnReceiveData(char* buf, int len){
+	if (mbError)
+		return true;
+	for (int i=0 ; i<len ; i++)
+		ConsumeChar(buf[i]);
+	return true;
+}
+
+void DynatraceProblemFeedParser::ConsumeChar(char c){
+
+	if (mbInString){
+		if (mbEscape)
+			mbEscape = false;
+		else if (c == '\\'){
+			mbEscape = true;
+			return;
+		}
+		else if (c == '"'){
+			mbInString = false;
+			if (!mbStringIsKey)
+				ValueComplete();
+			return;
+		}
+		if (mbStringIsKey){
+			if (muKeyLen < sizeof(msKey) - 1){
+				msKey[muKeyLen++] = c;
+				msKey[muKeyLen] = 0x00;
+			}
+		}
+		else if (muValueLen < sizeof(msValue) - 1){
+			msValue[muValueLen++] = c;
+			msValue[muValueLen] = 0x00;
+		}
+		return;
+	}
+
+	if (mbInScalar){
+		if (((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'z')) || (c == '-') || (c == '+') || (c == '.') || (c == 'E')){
+			if (muValueLen < sizeof(msValue) - 1){
+				msValue[muValueLen++] = c;
+				msValue[muValueLen] = 0x00;
+			}
+			return;
+		}
+		mbInScalar = false;
+		ValueComplete();
+		//no return here, c is a structural character
+	}
+
+	switch (c){
+		case '{':
+			muDepth++;
+			if (muDepth <= 32)
+				muArrayMask &= ~(1u << (muDepth - 1));
+			mbExpectKey = true;
+			if (muProblemsDepth && (muDepth == muProblemsDepth + 1)){
+				memset(&mActProblem, 0, sizeof(mActProblem));
+				mbActProblemOpen = false;
+			}
+			break;
+		case '[':
+			//only result.problems is the feed, other arrays named problems further down are not
+			if (IsObject() && !mbProblemsFound && (muDepth == 2) && !strcmp(msKey, "problems")){
+				muProblemsDepth = muDepth + 1;
+				mbProblemsFound = true;
+			}
+			muDepth++;
+			if (muDepth <= 32)
+				muArrayMask |= (1u << (muDepth - 1));
+			break;
+		case '}':
+			if (muProblemsDepth && (muDepth == muProblemsDepth + 1))
+				CommitProblem();
+			if (muDepth)
+				muDepth--;
+			mbExpectKey = false;
+			break;
+		case ']':
+			if (muDepth && (muDepth == muProblemsDepth))
+				muProblemsDepth = 0;
+			if (muDepth)
+				muDepth--;
+			break;
+		case ':':
+			mbExpectKey = false;
+			break;
+		case ',':
+			mbExpectKey = IsObject();
+			break;
+		case '"':
+			mbInString = true;
+			mbEscape = false;
+			mbStringIsKey = IsObject() && mbExpectKey;
+			if (mbStringIsKey){
+				muKeyLen = 0;
+				msKey[0] = 0x00;
+			}
+			else{
+				muValueLen = 0;
+				msValue[0] = 0x00;
+			}
+			break;
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			break;
+		default:
+			mbInScalar = true;
+			muValueLen = 1;
+			msValue[0] = c;
+			msValue[1] = 0x00;
+			break;
+	}
+}
+
+// a value of the object we are actually in is complete - just keep the fields of a problem we are interested in
+void DynatraceProblemFeedParser::ValueComplete(){
+	if (!muProblemsDepth || (muDepth != muProblemsDepth + 1))
+		return;
+
+	if (!strcmp(msKey, "id")){
+		strncpy(mActProblem.sId, msValue, DT_PROBLEM_ID_LENGTH - 1);
+		mActProblem.sId[DT_PROBLEM_ID_LENGTH - 1] = 0x00;
+	}
+	else if (!strcmp(msKey, "impactLevel"))
+		mActProblem.uImpact = DynatraceProblemTable::ParseImpact(msValue);
+	else if (!strcmp(msKey, "severityLevel"))
+		mActProblem.uSeverity = DynatraceProblemTable::ParseSeverity(msValue);
+	else if (!strcmp(msKey, "startTime"))
+		mActProblem.uStartTime = strtoull(msValue, NULL, 10) / 1000;
+	else if (!strcmp(msKey, "status"))
+		mbActProblemOpen = !strcmp(msValue, "OPEN");
+}
+
+// keeps the problem - when the table is full a more severe problem replaces the least severe one
+void DynatraceProblemFeedParser::CommitProblem(){
+	if (!mbActProblemOpen || !mActProblem.sId[0])
+		return;
+	muTotalCount++;
+
+	if (muCount < DT_MAX_PROBLEMS){
+		mProblems[muCount++] = mActProblem;
+		return;
+	}
+	__uint8_t uWeakest = 0;
+	for (__uint8_t u=1 ; u<muCount ; u++){
+		if (mProblems[u].uImpact < mProblems[uWeakest].uImpact)
+			uWeakest = u;
+	}
+	if (mActProblem.uImpact > mProblems[uWeakest].uImpact)
+		mProblems[uWeakest] = mActProblem;
+}
@@ -0,0 +1,124 @@
+#ifndef MAIN_DYNATRACEPROBLEMS_H_
+#define MAIN_DYNATRACEPROBLEMS_H_
+
+#include "freertos/FreeRTOS.h"
+#include "DownAndUploadHandler.h"
+#include "DisplayCharter.h"
+
+#define DT_MAX_PROBLEMS			RING_LEDCOUNT	// one ring segment per problem
+#define DT_PROBLEM_ID_LENGTH	40
+
+#define DT_IMPACT_INFRASTRUCTURE	0
+#define DT_IMPACT_SERVICE			1
+#define DT_IMPACT_APPLICATION		2
+
+#define DT_SEVERITY_UNKNOWN					0
+#define DT_SEVERITY_CUSTOM_ALERT			1
+#define DT_SEVERITY_RESOURCE_CONTENTION		2
+#define DT_SEVERITY_PERFORMANCE				3
+#define DT_SEVERITY_ERROR					4
+#define DT_SEVERITY_AVAILABILITY			5
+
+typedef struct{
+	char sId[DT_PROBLEM_ID_LENGTH];
+	__uint8_t uEnvironment;
+	__uint8_t uImpact;
+	__uint8_t uSeverity;
+	__uint8_t uSlot;
+	bool bUsed;
+	bool bSeen;
+	__uint32_t uStartTime;	// seconds since epoch
+} TDtProblem;
+
+
+/*
+ * Compact table of the open problems of all environments.
+ * Every problem keeps its slot (= ring segment) as long as it is open, so positions are stable across polls.
+ */
+class DynatraceProblemTable {
+public:
+	DynatraceProblemTable();
+	virtual ~DynatraceProblemTable();
+
+	void Clear();
+
+	/*
+	 * applies the open problems of one environment as a delta: known problems are updated,
+	 * new ones get a free slot and problems that are no longer reported are removed
+	 * @return true if the table changed
+	 */
+	bool Apply(__uint8_t uEnvironment, TDtProblem* pProblems, __uint8_t uCount);
+	bool Upsert(__uint8_t uEnvironment, TDtProblem& rProblem);
+	bool Remove(__uint8_t uEnvironment, const char* sId);
+	bool RemoveEnvironment(__uint8_t uEnvironment);
+
+	TDtProblem* Find(__uint8_t uEnvironment, const char* sId);
+
+	__uint8_t GetCount(int* piApplication, int* piService, int* piInfrastructure);
+	TDtProblem* GetSlot(__uint8_t uSlot) { return mpSlots[uSlot]; };
+
+	static __uint8_t ParseImpact(const char* sImpact);
+	static __uint8_t ParseSeverity(const char* sSeverity);
+
+private:
+	TDtProblem mProblems[DT_MAX_PROBLEMS];
+	TDtProblem* mpSlots[DT_MAX_PROBLEMS];
+};
+
+
+/*
+ * Incremental parser for the Dynatrace problem feed (/api/v1/problem/feed).
+ * It is fed with the response body as it arrives and keeps only the fields of the open problems,
+ * so memory usage is bounded independently of the size of the feed.
+ */
+class DynatraceProblemFeedParser : public DownAndUploadHandler {
+public:
+	DynatraceProblemFeedParser();
+	virtual ~DynatraceProblemFeedParser();
+
+	void Init();
+
+	bool OnReceiveBegin(unsigned short int httpStatusCode, bool isContentLength, unsigned int contentLength);
+	bool OnReceiveBegin(String& sUrl, unsigned int contentLength) { return false; };
+	bool OnReceiveEnd();
+	bool OnReceiveData(char* buf, int len);
+
+	bool IsValid() 				{ return mbFinished && !mbError && mbProblemsFound; };
+	TDtProblem* GetProblems() 	{ return mProblems; };
+	__uint8_t GetCount() 		{ return muCount; };
+	__uint16_t GetTotalCount()	{ return muTotalCount; };
+
+private:
+	void ConsumeChar(char c);
+	void ValueComplete();
+	void CommitProblem();
+	bool IsObject() { return muDepth && (muDepth > 32 || !(muArrayMask & (1u << (muDepth - 1)))); };
+
+private:
+	TDtProblem mProblems[DT_MAX_PROBLEMS];
+	__uint8_t muCount;
+	__uint16_t muTotalCount;
+
+	TDtProblem mActProblem;
+	bool mbActProblemOpen;
+
+	char msKey[16];
+	__uint8_t muKeyLen;
+	char msValue[DT_PROBLEM_ID_LENGTH];
+	__uint8_t muValueLen;
+
+	__uint8_t muDepth;
+	__uint32_t muArrayMask;
+	__uint8_t muProblemsDepth;
+
+	bool mbInString;
+	bool mbEscape;
+	bool mbStringIsKey;
+	bool mbInScalar;
+	bool mbExpectKey;
+	bool mbProblemsFound;
+	bool mbFinished;
+	bool mbError;
+};
+
+#endif /* MAIN_DYNATRACEPROBLEMS_H_ */
@@ -0,0 +1,195 @@
+#include "FirmwareDecompressor.h"
+#include <esp_log.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define STATE_Header		0
+#define STATE_Flags			1
+#define STATE_Token			2
+#define STATE_Match			3
+#define STATE_Failed		4
+#define STATE_Passthrough	5
+
+#define WINDOW_SIZE		(1 << FIRMWARE_WINDOW_BITS)
+#define WINDOW_MASK		(WINDOW_SIZE - 1)
+#define LENGTH_MASK		((1 << FIRMWARE_LENGTH_BITS) - 1)
+
+static const char* LOGTAG = "FirmwareDecompressor";
+
+
+static __uint32_t GetU32(const __uint8_t* p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((__uint32_t)p[3] << 24);
+}
+
+//------------------------------------------------------------------------------------------
+
+FirmwareDecompressor::FirmwareDecompressor() {
+	mpTarget = NULL;
+	mpWindow = NULL;
+	muState = STATE_Failed;
+	muLength = 0;
+	mbCompressed = false;
+	mbedtls_sha256_init(&mSha);
+}
+
+FirmwareDecompressor::~FirmwareDecompressor() {
+	if (mpWindow)
+		free(mpWindow);
+	mbedtls_sha256_free(&mSha);
+}
+
+bool FirmwareDecompressor::Begin(FirmwareWriter* pTarget){
+	mpTarget = pTarget;
+	muPos = 0;
+	muFlushed = 0;
+	muProduced = 0;
+	muFlagsLeft = 0;
+	muHeaderCollected = 0;
+	muLength = 0;
+	mbCompressed = false;
+	muState = STATE_Header;
+	return true;
+}
+
+bool FirmwareDecompressor::Fail(const char* sReason){
+	ESP_LOGE(LOGTAG, "%s", sReason);
+	muState = STATE_Failed;
+	return false;
+}
+
+bool FirmwareDecompressor::WriteFirmware(const char* pData, unsigned int uLen){
+	while (uLen){
+		switch (muState){
+			case STATE_Header: {
+				unsigned int u = FIRMWARE_COMPRESSED_HEADER - muHeaderCollected;
+				if (u > uLen)
+					u = uLen;
+				memcpy(&mHeader[muHeaderCollected], pData, u);
+				muHeaderCollected += u;
+				pData += u;
+				uLen -= u;
+				if (!mbCompressed){
+					unsigned int uCompare = (muHeaderCollected < FIRMWARE_COMPRESSED_MAGIC_LENGTH) ? muHeaderCollected : FIRMWARE_COMPRESSED_MAGIC_LENGTH;
+					if (memcmp(mHeader, FIRMWARE_COMPRESSED_MAGIC, uCompare)){
+						muState = STATE_Passthrough;
+						if (!mpTarget->WriteFirmware((const char*)mHeader, muHeaderCollected))
+							return false;
+						break;
+					}
+					mbCompressed = (uCompare == FIRMWARE_COMPRESSED_MAGIC_LENGTH);
+				}
+				if ((muHeaderCollected == FIRMWARE_COMPRESSED_HEADER) && !ProcessHeader())
+					return false;
+				break;
+			}
+			case STATE_Flags:
+				muFlags = *pData++;
+				uLen--;
+				muFlagsLeft = 8;
+				muState = STATE_Token;
+				break;
+			case STATE_Token: {
+				if (!muFlagsLeft){
+					muState = STATE_Flags;
+					break;
+				}
+				bool bLiteral = muFlags & 1;
+				muFlags >>= 1;
+				muFlagsLeft--;
+				if (bLiteral){
+					if (!Put(*pData))
+						return false;
+				}
+				else{
+					muMatchLow = *pData;
+					muState = STATE_Match;
+				}
+				pData++;
+				uLen--;
+				break;
+			}
+			case STATE_Match: {
+				__uint16_t uToken = muMatchLow | (*pData << 8);
+				pData++;
+				uLen--;
+				unsigned int uDistance = (uToken >> FIRMWARE_LENGTH_BITS) + 1;
+				unsigned int uMatch = (uToken & LENGTH_MASK) + FIRMWARE_MIN_MATCH;
+				if (uDistance > muProduced)
+					return Fail("match before the start");
+				while (uMatch--){
+					if (!Put(mpWindow[(muPos - uDistance) & WINDOW_MASK]))
+						return false;
+				}
+				muState = STATE_Token;
+				break;
+			}
+			case STATE_Passthrough:
+				return mpTarget->WriteFirmware(pData, uLen);
+			default:
+				return false;
+		}
+	}
+	// hand on what this chunk produced, the window just keeps the history
+	return (muState == STATE_Passthrough) || (muState == STATE_Header) || Flush();
+}
+
+bool FirmwareDecompressor::ProcessHeader(){
+	const __uint8_t* p = &mHeader[FIRMWARE_COMPRESSED_MAGIC_LENGTH];
+	if ((p[0] != FIRMWARE_COMPRESSED_VERSION) || (p[1] != FIRMWARE_WINDOW_BITS) || (p[2] != FIRMWARE_LENGTH_BITS))
+		return Fail("unsupported compression");
+	muLength = GetU32(&p[4]);
+	memcpy(mSha256, &p[8], FIRMWARE_SHA256_LENGTH);
+	if (!mpWindow)
+		mpWindow = (__uint8_t*)malloc(WINDOW_SIZE);
+	if (!mpWindow)
+		return Fail("memory allocation failed");
+	mbedtls_sha256_starts(&mSha, 0);
+	ESP_LOGI(LOGTAG, "decompressing %u bytes", muLength);
+	muState = STATE_Flags;
+	return true;
+}
+
+bool FirmwareDecompressor::Put(__uint8_t u){
+	if (muProduced >= muLength)
+		return Fail("data exceeds the length");
+	mpWindow[muPos++] = u;
+	muProduced++;
+	if (muPos == WINDOW_SIZE){
+		if (!Flush())
+			return false;
+		muPos = 0;
+		muFlushed = 0;
+	}
+	return true;
+}
+
+bool FirmwareDecompressor::Flush(){
+	unsigned int uLen = muPos - muFlushed;
+	if (!uLen)
+		return true;
+	mbedtls_sha256_update(&mSha, mpWindow + muFlushed, uLen);
+	muFlushed = muPos;
+	if (!mpTarget->WriteFirmware((const char*)mpWindow + muFlushed - uLen, uLen)){
+		muState = STATE_Failed;
+		return false;
+	}
+	return true;
+}
+
+bool FirmwareDecompressor::End(){
+	// a few bytes that started like the magic, but the data ended before it was complete
+	if ((muState == STATE_Header) && !mbCompressed){
+		muState = STATE_Passthrough;
+		if (muHeaderCollected && !mpTarget->WriteFirmware((const char*)mHeader, muHeaderCollected))
+			return false;
+	}
+	if (muState == STATE_Passthrough)
+		return true;
+	if (((muState != STATE_Flags) && (muState != STATE_Token)) || (muProduced != muLength))
+		return Fail("compressed data incomplete");
+	__uint8_t sha[FIRMWARE_SHA256_LENGTH];
+	mbedtls_sha256_finish(&mSha, sha);
+	if (memcmp(sha, mSha256, FIRMWARE_SHA256_LENGTH))
+		return Fail("hash of the decompressed data does not match");
+	return true;
+}
@@ -0,0 +1,63 @@
+#ifndef MAIN_FIRMWAREDECOMPRESSOR_H_
+#define MAIN_FIRMWAREDECOMPRESSOR_H_
+
+#include "FirmwarePatch.h"
+
+#define FIRMWARE_COMPRESSED_MAGIC			"UFOZ"
+#define FIRMWARE_COMPRESSED_MAGIC_LENGTH	4
+#define FIRMWARE_COMPRESSED_VERSION			1
+// magic, version, window bits, length bits, reserved, u32 length, SHA256 - of the decompressed data
+#define FIRMWARE_COMPRESSED_HEADER			(FIRMWARE_COMPRESSED_MAGIC_LENGTH + 4 + 4 + FIRMWARE_SHA256_LENGTH)
+
+#define FIRMWARE_WINDOW_BITS				12		// 4kB window
+#define FIRMWARE_LENGTH_BITS				4		// matches of 3..18 bytes
+#define FIRMWARE_MIN_MATCH					3
+
+/*
+ * Decompresses LZSS compressed firmware while it is received. After the header a flag byte announces
+ * the next eight tokens (LSB first): a set bit is a literal byte, a cleared bit a match of two bytes
+ * (little endian, distance - 1 in the upper FIRMWARE_WINDOW_BITS, length - 3 in the lower bits).
+ * Decompressed data is collected in the window and handed on in large pieces, the result has to
+ * match the SHA256 of the header. Data not starting with the magic is passed through.
+ */
+class FirmwareDecompressor : public FirmwareWriter {
+public:
+	FirmwareDecompressor();
+	virtual ~FirmwareDecompressor();
+
+	bool Begin(FirmwareWriter* pTarget);
+	bool WriteFirmware(const char* pData, unsigned int uLen);
+	// @return true if all data got decompressed and its hash matches - or the data got passed through
+	bool End();
+
+	// true as soon as the magic got received
+	bool IsCompressed()				{ return mbCompressed; };
+	// 0 until the header got received
+	unsigned int GetLength()		{ return muLength; };
+
+private:
+	bool ProcessHeader();
+	bool Put(__uint8_t u);
+	bool Flush();
+	bool Fail(const char* sReason);
+
+	FirmwareWriter* mpTarget;
+	__uint8_t* mpWindow;
+	unsigned int muPos;				// next byte in the window
+	unsigned int muFlushed;			// window bytes before it are handed on
+	unsigned int muProduced;
+
+	__uint8_t muState;
+	__uint8_t muFlags;
+	__uint8_t muFlagsLeft;
+	__uint8_t muMatchLow;
+	__uint8_t mHeader[FIRMWARE_COMPRESSED_HEADER];
+	unsigned int muHeaderCollected;
+
+	unsigned int muLength;
+	__uint8_t mSha256[FIRMWARE_SHA256_LENGTH];
+	mbedtls_sha256_context mSha;
+	bool mbCompressed;
+};
+
+#endif /* MAIN_FIRMWAREDECOMPRESSOR_H_ */
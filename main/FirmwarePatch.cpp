@@ -0,0 +1,274 @@
+#include "FirmwarePatch.h"
+#include <esp_ota_ops.h>
+#include <esp_log.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define STATE_Header	0
+#define STATE_Op		1
+#define STATE_Args		2
+#define STATE_Insert	3
+#define STATE_Failed	4
+#define STATE_Passthrough	5
+
+#define IMAGE_MAGIC				0xE9
+#define IMAGE_HEADER_LENGTH		24
+#define IMAGE_SEGMENT_HEADER	8
+#define IMAGE_HASH_APPENDED		23		// offset of the flag in the image header
+
+static const char* LOGTAG = "FirmwarePatch";
+
+bool FirmwarePatch::mbImageHashed = false;
+unsigned int FirmwarePatch::muImageLength = 0;
+__uint8_t FirmwarePatch::mImageSha256[FIRMWARE_SHA256_LENGTH];
+
+
+static __uint32_t GetU32(const __uint8_t* p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((__uint32_t)p[3] << 24);
+}
+
+// header, segments, the checksum (padded to 16 bytes) and the SHA256 if it is appended - as written by esptool
+static unsigned int GetImageLength(const esp_partition_t* pPartition){
+	__uint8_t header[IMAGE_HEADER_LENGTH];
+	if ((esp_partition_read(pPartition, 0, header, sizeof(header)) != ESP_OK) || (header[0] != IMAGE_MAGIC))
+		return 0;
+	unsigned int uPos = IMAGE_HEADER_LENGTH;
+	for (__uint8_t u = 0; u < header[1]; u++){
+		__uint8_t segment[IMAGE_SEGMENT_HEADER];
+		if (esp_partition_read(pPartition, uPos, segment, sizeof(segment)) != ESP_OK)
+			return 0;
+		uPos += IMAGE_SEGMENT_HEADER + GetU32(&segment[4]);
+		if (uPos > pPartition->size)
+			return 0;
+	}
+	uPos = (uPos | 15) + 1;
+	if (header[IMAGE_HASH_APPENDED] == 1)
+		uPos += FIRMWARE_SHA256_LENGTH;
+	return (uPos <= pPartition->size) ? uPos : 0;
+}
+
+bool FirmwarePatch::GetRunningImage(const esp_partition_t*& rpPartition, unsigned int& ruLength, const __uint8_t*& rpSha256){
+	rpPartition = esp_ota_get_running_partition();
+	if (!mbImageHashed){
+		if (!rpPartition)
+			return false;
+		unsigned int uLength = GetImageLength(rpPartition);
+		if (!uLength){
+			ESP_LOGE(LOGTAG, "no valid image in the running partition");
+			return false;
+		}
+		char* pBuffer = (char*)malloc(FIRMWARE_PATCH_COPY_BUFFER);
+		if (!pBuffer)
+			return false;
+		mbedtls_sha256_context sha;
+		mbedtls_sha256_init(&sha);
+		mbedtls_sha256_starts(&sha, 0);
+		for (unsigned int uPos = 0; uPos < uLength; uPos += FIRMWARE_PATCH_COPY_BUFFER){
+			unsigned int uLen = (uLength - uPos < FIRMWARE_PATCH_COPY_BUFFER) ? uLength - uPos : FIRMWARE_PATCH_COPY_BUFFER;
+			if (esp_partition_read(rpPartition, uPos, pBuffer, uLen) != ESP_OK){
+				mbedtls_sha256_free(&sha);
+				free(pBuffer);
+				return false;
+			}
+			mbedtls_sha256_update(&sha, (const unsigned char*)pBuffer, uLen);
+		}
+		mbedtls_sha256_finish(&sha, mImageSha256);
+		mbedtls_sha256_free(&sha);
+		free(pBuffer);
+		muImageLength = uLength;
+		mbImageHashed = true;
+	}
+	ruLength = muImageLength;
+	rpSha256 = mImageSha256;
+	return true;
+}
+
+void FirmwarePatch::ToHex(const __uint8_t* pSha256, char* sHex){
+	for (__uint8_t u = 0; u < FIRMWARE_SHA256_LENGTH; u++)
+		sprintf(&sHex[2 * u], "%02x", pSha256[u]);
+}
+
+//------------------------------------------------------------------------------------------
+
+FirmwarePatch::FirmwarePatch() {
+	mpTarget = NULL;
+	mpSource = NULL;
+	muSourceLength = 0;
+	mpSourceSha256 = NULL;
+	mpCopyBuffer = NULL;
+	muState = STATE_Failed;
+	muTargetLength = 0;
+	mbPatch = false;
+	mbSourceMismatch = false;
+	mbedtls_sha256_init(&mSha);
+}
+
+FirmwarePatch::~FirmwarePatch() {
+	if (mpCopyBuffer)
+		free(mpCopyBuffer);
+	mbedtls_sha256_free(&mSha);
+}
+
+bool FirmwarePatch::Begin(FirmwareWriter* pTarget){
+	mpTarget = pTarget;
+	muState = STATE_Failed;
+	muArgsCollected = 0;
+	muArgsNeeded = FIRMWARE_PATCH_HEADER;
+	muInsertLeft = 0;
+	muTargetLength = 0;
+	muWritten = 0;
+	mbPatch = false;
+	mbSourceMismatch = false;
+	muBytesCopied = 0;
+	muBytesInserted = 0;
+	muState = STATE_Header;
+	return true;
+}
+
+bool FirmwarePatch::Fail(const char* sReason){
+	ESP_LOGE(LOGTAG, "%s", sReason);
+	muState = STATE_Failed;
+	return false;
+}
+
+bool FirmwarePatch::WriteFirmware(const char* pData, unsigned int uLen){
+	while (uLen){
+		switch (muState){
+			case STATE_Header:
+			case STATE_Args: {
+				unsigned int u = muArgsNeeded - muArgsCollected;
+				if (u > uLen)
+					u = uLen;
+				memcpy(&mArgs[muArgsCollected], pData, u);
+				muArgsCollected += u;
+				pData += u;
+				uLen -= u;
+				if ((muState == STATE_Header) && !mbPatch){
+					unsigned int uCompare = (muArgsCollected < FIRMWARE_PATCH_MAGIC_LENGTH) ? muArgsCollected : FIRMWARE_PATCH_MAGIC_LENGTH;
+					if (memcmp(mArgs, FIRMWARE_PATCH_MAGIC, uCompare)){
+						muState = STATE_Passthrough;
+						if (!mpTarget->WriteFirmware((const char*)mArgs, muArgsCollected))
+							return false;
+						break;
+					}
+					mbPatch = (uCompare == FIRMWARE_PATCH_MAGIC_LENGTH);
+				}
+				if (muArgsCollected < muArgsNeeded)
+					break;
+				if (!((muState == STATE_Header) ? ProcessHeader() : ProcessArgs()))
+					return false;
+				break;
+			}
+			case STATE_Op:
+				muOp = *pData++;
+				uLen--;
+				if (muOp == FIRMWARE_PATCH_OP_COPY)
+					muArgsNeeded = 8;
+				else if (muOp == FIRMWARE_PATCH_OP_INSERT)
+					muArgsNeeded = 4;
+				else
+					return Fail("invalid instruction");
+				muArgsCollected = 0;
+				muState = STATE_Args;
+				break;
+			case STATE_Insert: {
+				unsigned int u = (muInsertLeft < uLen) ? muInsertLeft : uLen;
+				if (!Output(pData, u))
+					return false;
+				muBytesInserted += u;
+				muInsertLeft -= u;
+				pData += u;
+				uLen -= u;
+				if (!muInsertLeft)
+					muState = STATE_Op;
+				break;
+			}
+			case STATE_Passthrough:
+				return mpTarget->WriteFirmware(pData, uLen);
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+bool FirmwarePatch::ProcessHeader(){
+	if (!GetRunningImage(mpSource, muSourceLength, mpSourceSha256))
+		return Fail("running image unknown");
+	if (!mpCopyBuffer)
+		mpCopyBuffer = (char*)malloc(FIRMWARE_PATCH_COPY_BUFFER);
+	if (!mpCopyBuffer)
+		return Fail("memory allocation failed");
+	const __uint8_t* p = &mArgs[FIRMWARE_PATCH_MAGIC_LENGTH];
+	if ((GetU32(p) != muSourceLength) || memcmp(p + 4, mpSourceSha256, FIRMWARE_SHA256_LENGTH)){
+		mbSourceMismatch = true;
+		return Fail("patch is made for another image");
+	}
+	p += 4 + FIRMWARE_SHA256_LENGTH;
+	muTargetLength = GetU32(p);
+	memcpy(mTargetSha256, p + 4, FIRMWARE_SHA256_LENGTH);
+	mbedtls_sha256_starts(&mSha, 0);
+	ESP_LOGI(LOGTAG, "patching %u bytes into %u bytes", muSourceLength, muTargetLength);
+	muState = STATE_Op;
+	return true;
+}
+
+bool FirmwarePatch::ProcessArgs(){
+	if (muOp == FIRMWARE_PATCH_OP_COPY){
+		muState = STATE_Op;
+		return Copy(GetU32(mArgs), GetU32(&mArgs[4]));
+	}
+	muInsertLeft = GetU32(mArgs);
+	muState = muInsertLeft ? STATE_Insert : STATE_Op;
+	return true;
+}
+
+bool FirmwarePatch::Copy(unsigned int uOffset, unsigned int uLen){
+	if ((uOffset > muSourceLength) || (uLen > muSourceLength - uOffset))
+		return Fail("copy exceeds the running image");
+	while (uLen){
+		unsigned int u = (uLen < FIRMWARE_PATCH_COPY_BUFFER) ? uLen : FIRMWARE_PATCH_COPY_BUFFER;
+		if (esp_partition_read(mpSource, uOffset, mpCopyBuffer, u) != ESP_OK)
+			return Fail("reading the running image failed");
+		if (!Output(mpCopyBuffer, u))
+			return false;
+		muBytesCopied += u;
+		uOffset += u;
+		uLen -= u;
+	}
+	return true;
+}
+
+bool FirmwarePatch::Output(const char* pData, unsigned int uLen){
+	if (uLen > muTargetLength - muWritten)
+		return Fail("patch exceeds the new image");
+	mbedtls_sha256_update(&mSha, (const unsigned char*)pData, uLen);
+	muWritten += uLen;
+	if (!mpTarget->WriteFirmware(pData, uLen)){
+		muState = STATE_Failed;
+		return false;
+	}
+	return true;
+}
+
+bool FirmwarePatch::End(){
+	// a few bytes that started like the magic, but the data ended before it was complete
+	if ((muState == STATE_Header) && !mbPatch){
+		muState = STATE_Passthrough;
+		if (muArgsCollected && !mpTarget->WriteFirmware((const char*)mArgs, muArgsCollected))
+			return false;
+	}
+	if (muState == STATE_Passthrough)
+		return true;
+	if (muState != STATE_Op)
+		return Fail("patch incomplete");
+	if (muWritten != muTargetLength)
+		return Fail("new image incomplete");
+	__uint8_t sha[FIRMWARE_SHA256_LENGTH];
+	mbedtls_sha256_finish(&mSha, sha);
+	if (memcmp(sha, mTargetSha256, FIRMWARE_SHA256_LENGTH))
+		return Fail("hash of the new image does not match");
+	ESP_LOGI(LOGTAG, "patch applied: %u bytes copied, %u bytes inserted", muBytesCopied, muBytesInserted);
+	return true;
+}
@@ -0,0 +1,95 @@
+#ifndef MAIN_FIRMWAREPATCH_H_
+#define MAIN_FIRMWAREPATCH_H_
+
+#include <esp_partition.h>
+#include "mbedtls/sha256.h"
+
+#define FIRMWARE_PATCH_MAGIC		"UFODIFF1"
+#define FIRMWARE_PATCH_MAGIC_LENGTH	8
+#define FIRMWARE_SHA256_LENGTH		32
+// magic, u32 source length, source SHA256, u32 target length, target SHA256
+#define FIRMWARE_PATCH_HEADER		(FIRMWARE_PATCH_MAGIC_LENGTH + 4 + FIRMWARE_SHA256_LENGTH + 4 + FIRMWARE_SHA256_LENGTH)
+
+#define FIRMWARE_PATCH_OP_COPY		0x01	// u32 source offset, u32 length - bytes of the running image
+#define FIRMWARE_PATCH_OP_INSERT	0x02	// u32 length, followed by the bytes
+
+#define FIRMWARE_PATCH_COPY_BUFFER	4096
+
+/*
+ * Takes the firmware image (or a representation of it) in chunks of any size.
+ * Ota implements it to flash the image, FirmwarePatch to rebuild the image from a delta.
+ */
+class FirmwareWriter {
+public:
+	virtual bool WriteFirmware(const char* pData, unsigned int uLen) =0;
+};
+
+/*
+ * Applies a delta update while it is received. The patch is a header followed by instructions that
+ * build the new image from pieces of the running image and inserted bytes, all numbers are little endian.
+ * It only applies to the exact running image - the header carries its length and SHA256 - and the
+ * result has to match the SHA256 of the new image. Data not starting with the magic is passed through.
+ */
+class FirmwarePatch : public FirmwareWriter {
+public:
+	FirmwarePatch();
+	virtual ~FirmwarePatch();
+
+	/*
+	 * Determines the length of the image in the running partition from its segment headers and hashes it,
+	 * the result is kept for all further calls.
+	 * @return false if the partition holds no valid image
+	 */
+	static bool GetRunningImage(const esp_partition_t*& rpPartition, unsigned int& ruLength, const __uint8_t*& rpSha256);
+	// @param sHex - at least 2 * FIRMWARE_SHA256_LENGTH + 1 chars
+	static void ToHex(const __uint8_t* pSha256, char* sHex);
+
+	bool Begin(FirmwareWriter* pTarget);
+	bool WriteFirmware(const char* pData, unsigned int uLen);
+	// @return true if the complete new image got written and its hash matches - or the data got passed through
+	bool End();
+
+	// true as soon as the magic got received
+	bool IsPatch()					{ return mbPatch; };
+	// the patch was made for another image than the running one
+	bool IsSourceMismatch()			{ return mbSourceMismatch; };
+	// 0 until the header got received
+	unsigned int GetTargetLength()	{ return muTargetLength; };
+	unsigned int GetBytesCopied()	{ return muBytesCopied; };
+	unsigned int GetBytesInserted()	{ return muBytesInserted; };
+
+private:
+	bool ProcessHeader();
+	bool ProcessArgs();
+	bool Copy(unsigned int uOffset, unsigned int uLen);
+	bool Output(const char* pData, unsigned int uLen);
+	bool Fail(const char* sReason);
+
+	FirmwareWriter* mpTarget;
+	const esp_partition_t* mpSource;
+	unsigned int muSourceLength;
+	const __uint8_t* mpSourceSha256;
+	char* mpCopyBuffer;
+
+	__uint8_t muState;
+	__uint8_t muOp;
+	__uint8_t mArgs[FIRMWARE_PATCH_HEADER];		// header first, then the arguments of each instruction
+	unsigned int muArgsCollected;
+	unsigned int muArgsNeeded;
+	unsigned int muInsertLeft;
+
+	unsigned int muTargetLength;
+	__uint8_t mTargetSha256[FIRMWARE_SHA256_LENGTH];
+	unsigned int muWritten;
+	mbedtls_sha256_context mSha;
+	bool mbPatch;
+	bool mbSourceMismatch;
+	unsigned int muBytesCopied;
+	unsigned int muBytesInserted;
+
+	static bool mbImageHashed;
+	static unsigned int muImageLength;
+	static __uint8_t mImageSha256[FIRMWARE_SHA256_LENGTH];
+};
+
+#endif /* MAIN_FIRMWAREPATCH_H_ */
@@ -0,0 +1,141 @@
+#include "FrameStreamServer.h"
+#include "Ufo.h"
+#include "LatencyHistogram.h"
+#include <lwip/sockets.h>
+#include <esp_timer.h>
+#include <esp_log.h>
+
+static const char* LOGTAG = "FrameStream";
+
+static LatencyHistogram latencyInterval("ufo_stream_frame_interval_seconds", "Time between two accepted stream frames");
+static LatencyHistogram latencyHandoff("ufo_stream_frame_handoff_seconds", "Reception of a stream frame until the display task takes it");
+
+
+void task_function_frame_stream(void *pvParameter)
+{
+	((FrameStreamServer*)pvParameter)->Run();
+	vTaskDelete(NULL);
+}
+
+//------------------------------------------------------------------------------------------
+
+FrameStreamServer::FrameStreamServer() {
+	mpUfo = NULL;
+	muReceiving = 0;
+	muReady = 1;
+	muShowing = 2;
+	mbReadyNew = false;
+	mMux = portMUX_INITIALIZER_UNLOCKED;
+	muLastSequence = 0;
+	muLastFrame = 0;
+	muFramesAccepted = 0;
+	muFramesLate = 0;
+	muFramesInvalid = 0;
+	muFramesReplaced = 0;
+	muFramesShown = 0;
+}
+
+FrameStreamServer::~FrameStreamServer() {
+}
+
+void FrameStreamServer::Start(Ufo* pUfo){
+	mpUfo = pUfo;
+	if (!FRAME_STREAM_PORT)
+		return;
+	xTaskCreate(&task_function_frame_stream, "Task_FrameStream", 4096, this, 5, NULL);
+}
+
+void FrameStreamServer::Run(){
+	while (!mpUfo->GetWifi().IsConnected())
+		vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+	int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0){
+		ESP_LOGE(LOGTAG, "socket: %d %s", sock, strerror(errno));
+		return;
+	}
+	struct sockaddr_in serverAddress;
+	memset(&serverAddress, 0, sizeof(serverAddress));
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+	serverAddress.sin_port = htons(FRAME_STREAM_PORT);
+	int rc = bind(sock, (struct sockaddr *)&serverAddress, sizeof(serverAddress));
+	if (rc < 0){
+		ESP_LOGE(LOGTAG, "bind: %d %s", rc, strerror(errno));
+		close(sock);
+		return;
+	}
+	ESP_LOGI(LOGTAG, "receiving frames on udp port %d", FRAME_STREAM_PORT);
+
+	while (1){
+		// only this task changes muReceiving
+		TStreamBuffer* pBuffer = &mBuffers[muReceiving];
+		int iLen = recv(sock, &pBuffer->frame, sizeof(TStreamFrame), 0);
+		if (iLen < 0){
+			ESP_LOGE(LOGTAG, "recv: %d %s", iLen, strerror(errno));
+			vTaskDelay(100 / portTICK_PERIOD_MS);
+			continue;
+		}
+		Accept(pBuffer, iLen);
+	}
+}
+
+bool FrameStreamServer::Accept(TStreamBuffer* pBuffer, int iLen){
+	TStreamFrame& rFrame = pBuffer->frame;
+	if ((iLen != sizeof(TStreamFrame)) || (rFrame.uMagic[0] != FRAME_STREAM_MAGIC0) || (rFrame.uMagic[1] != FRAME_STREAM_MAGIC1)
+			|| (rFrame.uVersion != FRAME_STREAM_VERSION)){
+		muFramesInvalid++;
+		return false;
+	}
+	__uint64_t uNow = esp_timer_get_time();
+	__uint32_t uSequence = rFrame.uSequence;	// the ESP32 is little endian as well
+
+	// after a pause any sequence number starts a new stream, e.g. a restarted sender
+	bool bActive = muLastFrame && (uNow - muLastFrame < FRAME_STREAM_TIMEOUT * 1000ULL);
+	if (bActive && ((__int32_t)(uSequence - muLastSequence) <= 0)){
+		muFramesLate++;
+		return false;
+	}
+	if (bActive)
+		latencyInterval.Record(uNow - muLastFrame);
+	muLastSequence = uSequence;
+	pBuffer->uReceived = uNow;
+
+	taskENTER_CRITICAL(&mMux);
+	__uint8_t u = muReady;
+	muReady = muReceiving;
+	muReceiving = u;
+	if (mbReadyNew)
+		muFramesReplaced++;
+	mbReadyNew = true;
+	muLastFrame = uNow;
+	taskEXIT_CRITICAL(&mMux);
+
+	muFramesAccepted++;
+	return true;
+}
+
+bool FrameStreamServer::IsStreaming(){
+	taskENTER_CRITICAL(&mMux);
+	__uint64_t uLastFrame = muLastFrame;
+	taskEXIT_CRITICAL(&mMux);
+	return uLastFrame && (esp_timer_get_time() - uLastFrame < FRAME_STREAM_TIMEOUT * 1000ULL);
+}
+
+TStreamBuffer* FrameStreamServer::AcquireFrame(){
+	taskENTER_CRITICAL(&mMux);
+	if (!mbReadyNew){
+		taskEXIT_CRITICAL(&mMux);
+		return NULL;
+	}
+	__uint8_t u = muShowing;
+	muShowing = muReady;
+	muReady = u;
+	mbReadyNew = false;
+	taskEXIT_CRITICAL(&mMux);
+
+	TStreamBuffer* pBuffer = &mBuffers[muShowing];
+	latencyHandoff.RecordSince(pBuffer->uReceived);
+	muFramesShown++;
+	return pBuffer;
+}
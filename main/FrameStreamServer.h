@@ -0,0 +1,85 @@
+#ifndef MAIN_FRAMESTREAMSERVER_H_
+#define MAIN_FRAMESTREAMSERVER_H_
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_UFO_FRAME_STREAM_PORT
+#define FRAME_STREAM_PORT CONFIG_UFO_FRAME_STREAM_PORT
+#else
+#define FRAME_STREAM_PORT 0			// off, the stream is not authenticated
+#endif
+
+#define FRAME_STREAM_MAGIC0		'U'
+#define FRAME_STREAM_MAGIC1		'F'
+#define FRAME_STREAM_VERSION	1
+#define FRAME_STREAM_RING_LEDS	15
+#define FRAME_STREAM_LOGO_LEDS	4
+#define FRAME_STREAM_TIMEOUT	1000	// ms without a frame until the rings show the API state again
+
+/*
+ * UDP datagram of the frame stream, everything a frame shows - there is no state besides the sequence number.
+ */
+typedef struct {
+	__uint8_t uMagic[2];
+	__uint8_t uVersion;
+	__uint8_t uFlags;				// reserved, 0
+	__uint32_t uSequence;			// little endian, incremented per frame - lower or equal numbers are dropped
+	__uint8_t top[FRAME_STREAM_RING_LEDS][3];
+	__uint8_t bottom[FRAME_STREAM_RING_LEDS][3];
+	__uint8_t logo[FRAME_STREAM_LOGO_LEDS][3];
+} __attribute__((packed)) TStreamFrame;
+
+typedef struct {
+	TStreamFrame frame;
+	__uint64_t uReceived;			// us
+} TStreamBuffer;
+
+class Ufo;
+
+/*
+ * Receives full frames on a UDP port. Datagrams are received directly into one of three buffers:
+ * the receive task owns one, the display task owns one and the third holds the latest complete frame.
+ * Handing a frame over just swaps buffer indexes, nothing is copied and neither task waits for the other.
+ */
+class FrameStreamServer {
+public:
+	FrameStreamServer();
+	virtual ~FrameStreamServer();
+
+	void Start(Ufo* pUfo);
+	void Run();
+
+	bool IsStreaming();
+	// the latest frame not shown yet, NULL if there is none - valid until the next call
+	TStreamBuffer* AcquireFrame();
+
+	__uint32_t GetFramesAccepted() { return muFramesAccepted; };
+	__uint32_t GetFramesLate() { return muFramesLate; };
+	__uint32_t GetFramesInvalid() { return muFramesInvalid; };
+	__uint32_t GetFramesReplaced() { return muFramesReplaced; };
+	__uint32_t GetFramesShown() { return muFramesShown; };
+
+private:
+	bool Accept(TStreamBuffer* pBuffer, int iLen);
+
+	Ufo* mpUfo;
+
+	TStreamBuffer mBuffers[3];
+	__uint8_t muReceiving;			// receive task
+	__uint8_t muReady;				// latest complete frame
+	__uint8_t muShowing;			// display task
+	bool mbReadyNew;
+	portMUX_TYPE mMux;
+
+	__uint32_t muLastSequence;
+	__uint64_t muLastFrame;			// us, 0 if there was none yet
+
+	__uint32_t muFramesAccepted;
+	__uint32_t muFramesLate;
+	__uint32_t muFramesInvalid;
+	__uint32_t muFramesReplaced;	// overwritten by a newer frame before the display task showed them
+	__uint32_t muFramesShown;
+};
+
+#endif /* MAIN_FRAMESTREAMSERVER_H_ */
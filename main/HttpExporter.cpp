@@ -0,0 +1,50 @@
+#include "HttpExporter.h"
+#include "Config.h"
+#include "Wifi.h"
+#include <esp_log.h>
+
+static const char* LOGTAG = "HttpExporter";
+
+
+HttpExporter::HttpExporter() {
+    mpConfig = NULL;
+    // a request costs more than a publish, so fewer but bigger batches
+    mSettings.uFlushActions = 64;
+    mSettings.uFlushBytes = 6144;
+    mSettings.uFlushMaxAge = 60000;
+    mSettings.uMaxPayload = 8192;
+    mSettings.uRetryBatches = 2;
+    mClient.SetTimeouts(5000, 5000, 15000);
+}
+
+HttpExporter::~HttpExporter() {
+}
+
+bool HttpExporter::Start(const TExporterContext& rContext) {
+    mpConfig = rContext.pConfig;
+    if (!rContext.pWifi->IsConnected())
+        return false;
+    if (!mpConfig->msDTMonitoringUrl.length() || !mUrl.Parse(mpConfig->msDTMonitoringUrl)) {
+        ESP_LOGD(LOGTAG, "no valid collector URL configured");
+        return false;
+    }
+    ESP_LOGI(LOGTAG, "posting to %s", mUrl.GetUrl().c_str());
+    return true;
+}
+
+bool HttpExporter::IsActive() {
+    return mpConfig && mpConfig->mbDTMonitoring;
+}
+
+bool HttpExporter::Export(const char* pPayload, size_t uLength, bool bCbor) {
+    if (!mClient.Prepare(&mUrl))
+        return false;
+    mClient.AddHttpHeaderCStr(bCbor ? "Content-Type: application/cbor" : "Content-Type: application/json");
+    unsigned short uStatus = mClient.HttpPost(pPayload, uLength);
+    mClient.Clear();
+    if ((uStatus < 200) || (uStatus > 299)) {
+        ESP_LOGW(LOGTAG, "collector returned %u", uStatus);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef MAIN_HTTPEXPORTER_H_
+#define MAIN_HTTPEXPORTER_H_
+
+#include "TelemetryExporter.h"
+#include "WebClient.h"
+#include "Url.h"
+
+class Config;
+
+// posts every batch to the collector URL of the configuration (Config::msDTMonitoringUrl)
+class HttpExporter : public TelemetryExporter {
+public:
+    HttpExporter();
+    virtual ~HttpExporter();
+
+    virtual const char* GetName() { return "http"; };
+    virtual bool Start(const TExporterContext& rContext);
+    virtual bool IsActive();
+    virtual bool Export(const char* pPayload, size_t uLength, bool bCbor);
+
+private:
+    Config* mpConfig;
+    Url mUrl;
+    WebClient mClient;
+};
+
+#endif /* MAIN_HTTPEXPORTER_H_ */
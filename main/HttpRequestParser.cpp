@@ -40,6 +40,7 @@ void HttpRequestParser::Clear(){
 	mParams.clear();
 	mBody.clear();
 	mBoundary.clear();
+	mAuthorization.clear();
 }
 
 bool HttpRequestParser::ParseRequest(char* sBuffer, __uint16_t uLen){
@@ -107,6 +108,7 @@ bool HttpRequestParser::ParseRequest(char* sBuffer, __uint16_t uLen){
 					muParseState = STATE_CheckHeaderName;
 					mStringParser.Init();
 					mStringParser.AddStringToParse("connection");
+					mStringParser.AddStringToParse("authorization");
 					if (!mbIsGet){
 						mStringParser.AddStringToParse("content-length");
 						mStringParser.AddStringToParse("content-type");
@@ -156,11 +158,15 @@ bool HttpRequestParser::ParseRequest(char* sBuffer, __uint16_t uLen){
 								mStringParser.AddStringToParse("close");
 								mStringParser.AddStringToParse("keep-alive");
 								break;
-							case 1: //content-length
+							case 1: //authorization
+								muParseState = STATE_ReadAuthorization;
+								mAuthorization.clear();
+								break;
+							case 2: //content-length
 								muParseState = STATE_ReadContentLength;
 								muContentLength = 0;
 								break;
-							case 2: //content-type
+							case 3: //content-type
 								muParseState = STATE_CheckHeaderValue;
 								mStringParser.Init();
 								mStringParser.AddStringToParse("multipart/form-data");
@@ -225,6 +231,14 @@ bool HttpRequestParser::ParseRequest(char* sBuffer, __uint16_t uLen){
 					}
 				}
 				break;
+			case STATE_ReadAuthorization:
+				if ((c == 10) || (c == 13)){
+					muCrlfCount = 1;
+					muParseState = STATE_SearchEndOfHeaderLine;
+				}
+				else if ((mAuthorization.length() || (c != ' ')) && (mAuthorization.length() < MAX_AUTHORIZATION_LENGTH))
+					mAuthorization += c;
+				break;
 			case STATE_SearchBoundary:
 				if ((c == 10) || (c == 13)){
 					muCrlfCount = 1;
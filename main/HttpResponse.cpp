@@ -5,6 +5,7 @@
 constexpr char HttpResponse::HeaderContentTypeJson[];
 constexpr char HttpResponse::HeaderContentTypeHtml[];
 constexpr char HttpResponse::HeaderContentTypeBinary[];
+constexpr char HttpResponse::HeaderContentTypeText[];
 constexpr char HttpResponse::HeaderNoCache[];
 
 void HttpResponse::Init(int socket, __uint16_t uRetCode, bool bHttp11, bool bConnectionClose){
@@ -106,6 +107,9 @@ const char* HttpResponse::GetResponseMsg(__uint16_t uRetCode, __uint8_t& ruLen){
 		case 304:
 			ruLen = 15;
 			return " Not Modified\r\n";
+		case 400:
+			ruLen = 14;
+			return " Bad Request\r\n";
 		case 401:
 			ruLen = 15;
 			return " Unauthorized\r\n";
@@ -29,6 +29,7 @@ public:
 	constexpr static char HeaderContentTypeJson[] = "content-type: text/json";
 	constexpr static char HeaderContentTypeHtml[] = "content-type: text/html";
 	constexpr static char HeaderContentTypeBinary[] = "content-type: application/octet-stream";
+	constexpr static char HeaderContentTypeText[] = "content-type: text/plain; version=0.0.4";
 	constexpr static char HeaderNoCache[] = "cache-control: private, max-age=0, no-cache, no-store";
 
 private:
@@ -21,6 +21,8 @@
 #define STATE_ReadContentType		8
 #define STATE_ReadLocation			9
 #define STATE_CopyBody			   10
+#define STATE_ReadContentRange	   11
+#define STATE_ReadETag			   12
 
 #define ERROR_OK 									0
 #define ERROR_HTTPRESPONSE_NOVALIDHTTP 				1
@@ -47,9 +49,13 @@ void HttpResponseParser::Init(DownAndUploadHandler* pDownloadHandler, unsigned i
 	mpDownloadHandler = pDownloadHandler;
 	mBody.clear();
 	msLocation.clear();
+	msContentRange.clear();
+	msETag.clear();
 	muContentLength = 0;
 	muActualContentLength = 0;
 	muMaxBodyBufferSize = maxBodyBufferSize;
+	muBytesCopied = 0;
+	muAllocations = 0;
 	muStatusCode = 0;
 	mbHttp11 = false;
 
@@ -70,10 +76,30 @@ void HttpResponseParser::Clear(){
 	mBody.clear();
 	msLocation.clear();
 	msContentType.clear();
+	msContentRange.clear();
+	msETag.clear();
 }
 
-bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
+bool HttpResponseParser::GetContentRange(unsigned int& ruStart, unsigned int& ruTotal) {
+	unsigned int uEnd;
+	// e.g. "bytes 1024-4095/4096"
+	if (sscanf(msContentRange.c_str(), "bytes %u-%u/%u", &ruStart, &uEnd, &ruTotal) != 3)
+		return false;
+	return (ruStart <= uEnd) && (uEnd < ruTotal);
+}
 
+// the body buffer grows in one step to Content-Length or doubles, so it does not get reallocated (and copied) with every received chunk
+// only real reallocations are counted - the String rounds its buffer up, so a larger size may still fit
+bool HttpResponseParser::ReserveBody(unsigned int uSize) {
+	if (uSize <= mBody.getCapacity())
+		return true;
+	if (!mBody.reserve(uSize))
+		return false;
+	muAllocations++;
+	return true;
+}
+
+bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
 	// when uLen == 0, then connection is closed
 	if (uLen == 0) {
 		mbFinished = true;
@@ -136,6 +162,8 @@ bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
 				mStringParser.AddStringToParse("content-length");
 				mStringParser.AddStringToParse("content-type");
 				mStringParser.AddStringToParse("location");
+				mStringParser.AddStringToParse("content-range");
+				mStringParser.AddStringToParse("etag");
 			} else {
 				if (++muCrlfCount == 4) {
 					if (mbContentLength && muContentLength == 0) {
@@ -153,6 +181,8 @@ bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
 						ESP_LOGD(LOGTAG, "HEADER: location: %s", msLocation.c_str());
 					}
 					muParseState = STATE_CopyBody;
+					if (!mpDownloadHandler && mbContentLength)
+						ReserveBody(std::min(muContentLength, muMaxBodyBufferSize));
 					if (mpDownloadHandler) {
 						if (!mpDownloadHandler->OnReceiveBegin(muStatusCode, mbContentLength, muContentLength)) {
 							ESP_LOGW(LOGTAG, "DownloadHandler signaled to abort download begin.");
@@ -184,6 +214,12 @@ bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
 					} else if (uFound == 3) {
 						muParseState = STATE_ReadLocation;
 						msLocation.clear();
+					} else if (uFound == 4) {
+						muParseState = STATE_ReadContentRange;
+						msContentRange.clear();
+					} else if (uFound == 5) {
+						muParseState = STATE_ReadETag;
+						msETag.clear();
 					}
 				} else
 					muParseState = STATE_SkipHeader;
@@ -239,6 +275,24 @@ bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
 			}
 			break;
 
+		case STATE_ReadContentRange:
+			if ((c == 10) || (c == 13)) {
+				muCrlfCount = 1;
+				muParseState = STATE_SearchEndOfHeaderLine;
+			} else if ((c != ' ') || msContentRange.length()) {
+				msContentRange += c;
+			}
+			break;
+
+		case STATE_ReadETag:
+			if ((c == 10) || (c == 13)) {
+				muCrlfCount = 1;
+				muParseState = STATE_SearchEndOfHeaderLine;
+			} else if ((c != ' ') || msETag.length()) {
+				msETag += c;
+			}
+			break;
+
 		case STATE_ReadLocation:
 			if ((c == 10) || (c == 13)) {
 				muCrlfCount = 1;
@@ -273,14 +327,18 @@ bool HttpResponseParser::ParseResponse(char* sBuffer, unsigned int uLen) {
 					if (appendSize < 0) {
 						return SetError(ERROR_BODYBUFFERTOOSMALL), false;
 					}
+					if (mBody.length() + appendSize > mBody.getCapacity())
+						ReserveBody(std::min(std::max(mBody.length() + appendSize, 2 * mBody.getCapacity()), muMaxBodyBufferSize));
 					mBody.concat(&sBuffer[uPos], appendSize);
+					muBytesCopied += appendSize;
 				}
 				if (mbContentLength) {
 					mbFinished = muActualContentLength >= muContentLength;
 				}
 
 				if (mpDownloadHandler && mbFinished) {
-					mpDownloadHandler->OnReceiveEnd();
+					if (!mpDownloadHandler->OnReceiveEnd())
+						return SetError(ERROR_DOWNLOADHANDLER_ONRECEIVEEND_FAILED), false;
 				}
 
 				if (mbFinished) {
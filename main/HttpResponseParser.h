@@ -18,6 +18,7 @@ public:
 	 * @param pDownloadHandler
 	 * 			- if NULL, internal dynamic buffer will be used to store message content, which can be accessed with GetBody()
 	 * 			- if set, the message body data stream will be directly forwarded to the DownloadHandler implementation
+	 * 			  this is the zero-copy path: OnReceiveData() gets the body right out of the receive buffer, nothing is copied or allocated
 	 * 	@param maxBodyBufferSize
 	 * 			- protects from allocating too much memory to store the message body.
 	 * 			  default is 16kB max message body size when not using DownloadHandlers.
@@ -52,6 +53,15 @@ public:
 	unsigned int GetContentLength() { return muActualContentLength; }
 	unsigned short GetStatusCode() { return muStatusCode; }
 	String& GetRedirectLocation() { return msLocation; }
+	// the entity tag identifies the version of the resource, e.g. for continuing it with a range request
+	String& GetETag() { return msETag; }
+	// parses the Content-Range header of a 206 response
+	// @return false if there is none or it is invalid
+	bool GetContentRange(unsigned int& ruStart, unsigned int& ruTotal);
+
+	// bytes copied into the body buffer and number of body buffer allocations since Init(), both stay 0 with a DownloadHandler
+	unsigned int GetBytesCopied() { return muBytesCopied; }
+	unsigned int GetAllocations() { return muAllocations; }
 
 
 	short GetError()  	{ return muError; };
@@ -59,12 +69,15 @@ public:
 private:
 	void InternalInit(DownAndUploadHandler* pDownloadHandler, unsigned int maxBodyBufferSize);
 	void SetError(short u) { muError = u; };
+	bool ReserveBody(unsigned int uSize);
 
 private:
 	String mBody;
 	unsigned int muContentLength;
 	unsigned int muActualContentLength;
 	unsigned int muMaxBodyBufferSize;
+	unsigned int muBytesCopied;
+	unsigned int muAllocations;
 
 	bool mbFinished;
 	bool mbHttp11;
@@ -73,6 +86,8 @@ private:
 	unsigned short muStatusCode;
 	String msContentType;
 	String msLocation;
+	String msContentRange;
+	String msETag;
 	DownAndUploadHandler* mpDownloadHandler = NULL;
 	uint8_t muParseState;
 	StringParser mStringParser;
@@ -0,0 +1,152 @@
+#include "LatencyHistogram.h"
+#include "MonitoringClock.h"
+#include <string.h>
+
+#define SUB_BUCKETS		(1 << LATENCY_SUB_BUCKET_BITS)
+
+// zero initialized before any constructor runs
+LatencyHistogram* LatencyHistogram::mpFirst;
+
+
+LatencyHistogram::LatencyHistogram(const char* sName, const char* sHelp, const char* sLabels) {
+	msName = sName;
+	msHelp = sHelp;
+	msLabels = sLabels;
+	memset(muBuckets, 0, sizeof(muBuckets));
+	muCount = 0;
+	muMax = 0;
+
+	// append, so the export keeps the definition order
+	mpNext = NULL;
+	LatencyHistogram** ppLast = &mpFirst;
+	while (*ppLast)
+		ppLast = &((*ppLast)->mpNext);
+	*ppLast = this;
+}
+
+LatencyHistogram::~LatencyHistogram() {
+}
+
+__uint64_t LatencyHistogram::Start(){
+	return MonitoringClock::Now();
+}
+
+// values below SUB_BUCKETS get a bucket of their own, above the bucket is given by the
+// most significant bit and the next LATENCY_SUB_BUCKET_BITS bits
+__uint8_t LatencyHistogram::GetBucket(__uint32_t uMicros){
+	if (uMicros < SUB_BUCKETS)
+		return uMicros;
+	__uint8_t uMsb = 31 - __builtin_clz(uMicros);
+	if (uMsb >= LATENCY_MAX_BITS)
+		return LATENCY_BUCKETS - 1;
+	return ((uMsb - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS) + ((uMicros >> (uMsb - LATENCY_SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+// smallest value that does not belong to the bucket anymore
+__uint32_t LatencyHistogram::GetBucketUpper(__uint8_t uBucket){
+	if (uBucket < SUB_BUCKETS)
+		return uBucket + 1;
+	__uint8_t uMsb = (uBucket >> LATENCY_SUB_BUCKET_BITS) + LATENCY_SUB_BUCKET_BITS - 1;
+	__uint32_t uSub = uBucket & (SUB_BUCKETS - 1);
+	return (1u << uMsb) + ((uSub + 1) << (uMsb - LATENCY_SUB_BUCKET_BITS));
+}
+
+void LatencyHistogram::Record(__uint32_t uMicros){
+	__atomic_add_fetch(&muBuckets[GetBucket(uMicros)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&muCount, 1, __ATOMIC_RELAXED);
+	__uint32_t uMax = __atomic_load_n(&muMax, __ATOMIC_RELAXED);
+	while ((uMicros > uMax) && !__atomic_compare_exchange_n(&muMax, &uMax, uMicros, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+void LatencyHistogram::RecordSince(__uint64_t uStart){
+	__uint64_t uMicros = MonitoringClock::Now() - uStart;
+	Record((uMicros > 0xffffffff) ? 0xffffffff : uMicros);
+}
+
+// upper bound of the bucket the percentile falls into
+__uint32_t LatencyHistogram::GetPercentile(__uint8_t uPercent){
+	__uint32_t uCount = GetCount();
+	if (!uCount)
+		return 0;
+	__uint64_t uThreshold = ((__uint64_t)uCount * uPercent + 99) / 100;
+	__uint64_t uSeen = 0;
+	for (__uint8_t u=0 ; u<LATENCY_BUCKETS ; u++){
+		uSeen += __atomic_load_n(&muBuckets[u], __ATOMIC_RELAXED);
+		if (uSeen >= uThreshold){
+			__uint32_t uUpper = GetBucketUpper(u) - 1;
+			__uint32_t uMax = GetMax();
+			return (uUpper < uMax) ? uUpper : uMax;
+		}
+	}
+	return GetMax();
+}
+
+__uint64_t LatencyHistogram::GetSum(){
+	__uint64_t uSum = 0;
+	__uint32_t uLower = 0;
+	for (__uint8_t u=0 ; u<LATENCY_BUCKETS ; u++){
+		__uint32_t uUpper = GetBucketUpper(u);
+		uSum += (__uint64_t)__atomic_load_n(&muBuckets[u], __ATOMIC_RELAXED) * ((uLower + uUpper) / 2);
+		uLower = uUpper;
+	}
+	return uSum;
+}
+
+__uint8_t LatencyHistogram::GetInstanceCount(){
+	__uint8_t uCount = 0;
+	for (LatencyHistogram* p = mpFirst ; p ; p = p->mpNext)
+		uCount++;
+	return uCount;
+}
+
+//------------------------------------------------------------------
+
+// values in us
+void LatencyHistogram::WriteJson(String& rBody){
+	rBody.reserve(rBody.length() + GetInstanceCount() * 160);
+	rBody += "{\"histograms\":[";
+	for (LatencyHistogram* p = mpFirst ; p ; p = p->mpNext){
+		rBody.printf("{\"name\":\"%s\",\"labels\":\"", p->msName);
+		if (p->msLabels){
+			for (const char* s = p->msLabels ; *s ; s++){
+				if (*s == '"')
+					rBody += '\\';
+				rBody += *s;
+			}
+		}
+		rBody.printf("\",\"count\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}",
+			p->GetCount(), p->GetPercentile(50), p->GetPercentile(90), p->GetPercentile(99), p->GetMax());
+		if (p->mpNext)
+			rBody += ',';
+	}
+	rBody += "]}";
+}
+
+// Prometheus text format - only the power of 2 boundaries are exported as buckets (in seconds)
+void LatencyHistogram::WritePrometheus(String& rBody){
+	rBody.reserve(rBody.length() + GetInstanceCount() * 2048);
+	const char* sLastName = NULL;
+	for (LatencyHistogram* p = mpFirst ; p ; p = p->mpNext){
+		if (!sLastName || strcmp(sLastName, p->msName)){
+			rBody.printf("# HELP %s %s\n# TYPE %s histogram\n", p->msName, p->msHelp, p->msName);
+			sLastName = p->msName;
+		}
+		const char* sLabels = p->msLabels ? p->msLabels : "";
+		const char* sSeparator = p->msLabels ? "," : "";
+
+		__uint32_t uCumulative = 0;
+		__uint8_t uBucket = 0;
+		for (__uint8_t uBits=LATENCY_SUB_BUCKET_BITS ; uBits<=LATENCY_MAX_BITS ; uBits++){
+			__uint32_t uLe = 1u << uBits;
+			while ((uBucket < LATENCY_BUCKETS - 1) && (GetBucketUpper(uBucket) <= uLe))
+				uCumulative += __atomic_load_n(&p->muBuckets[uBucket++], __ATOMIC_RELAXED);
+			rBody.printf("%s_bucket{%s%sle=\"%u.%06u\"} %u\n", p->msName, sLabels, sSeparator, uLe / 1000000, uLe % 1000000, uCumulative);
+		}
+		__uint32_t uCount = p->GetCount();
+		__uint64_t uSum = p->GetSum();
+		rBody.printf("%s_bucket{%s%sle=\"+Inf\"} %u\n", p->msName, sLabels, sSeparator, uCount);
+		rBody.printf("%s_sum{%s} %u.%06u\n", p->msName, sLabels, (__uint32_t)(uSum / 1000000), (__uint32_t)(uSum % 1000000));
+		rBody.printf("%s_count{%s} %u\n", p->msName, sLabels, uCount);
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef MAIN_LATENCYHISTOGRAM_H_
+#define MAIN_LATENCYHISTOGRAM_H_
+
+#include "freertos/FreeRTOS.h"
+#include "String.h"
+
+// log2 buckets with 4 linear sub-buckets each (max. 25% error), values in us up to 2^27 us (~134s)
+#define LATENCY_SUB_BUCKET_BITS		2
+#define LATENCY_MAX_BITS			27
+#define LATENCY_BUCKETS				((LATENCY_MAX_BITS - 1) << LATENCY_SUB_BUCKET_BITS)
+
+/*
+ * Fixed size latency histogram (HDR style). Record() only does atomic increments, so it can be called
+ * from any task without locking. All histograms register themselves in a global list which is exported at /metrics.
+ * Instances are meant to be static objects - histograms of the same metric (different labels) have to be defined next to each other.
+ */
+class LatencyHistogram {
+public:
+	LatencyHistogram(const char* sName, const char* sHelp, const char* sLabels = NULL);
+	virtual ~LatencyHistogram();
+
+	static __uint64_t Start();
+	void Record(__uint32_t uMicros);
+	void RecordSince(__uint64_t uStart);
+
+	__uint32_t GetCount() 	{ return __atomic_load_n(&muCount, __ATOMIC_RELAXED); };
+	__uint32_t GetMax() 	{ return __atomic_load_n(&muMax, __ATOMIC_RELAXED); };
+	__uint32_t GetPercentile(__uint8_t uPercent);
+	__uint64_t GetSum();	// approximated from the buckets
+
+	static void WriteJson(String& rBody);
+	static void WritePrometheus(String& rBody);
+
+private:
+	static __uint8_t GetInstanceCount();
+	static __uint8_t GetBucket(__uint32_t uMicros);
+	static __uint32_t GetBucketUpper(__uint8_t uBucket);
+
+	const char* msName;
+	const char* msHelp;
+	const char* msLabels;
+
+	__uint32_t muBuckets[LATENCY_BUCKETS];
+	__uint32_t muCount;
+	__uint32_t muMax;
+
+	LatencyHistogram* mpNext;
+	static LatencyHistogram* mpFirst;
+};
+
+#endif /* MAIN_LATENCYHISTOGRAM_H_ */
@@ -0,0 +1,58 @@
+#include "MonitoringClock.h"
+#include <esp_timer.h>
+#include <esp_log.h>
+#include <apps/sntp.h>
+#include <sys/time.h>
+
+#define NTP_SERVER			"pool.ntp.org"
+#define NTP_VALID_AFTER		1500000000	// anything before 2017 means the clock has not been set yet
+
+static const char* LOGTAG = "Clock";
+
+static __uint64_t PlatformNow(){
+	return esp_timer_get_time();
+}
+
+static __int64_t PlatformWallClock(){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (__int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+TMonotonicSource MonitoringClock::mfNow = PlatformNow;
+TWallClockSource MonitoringClock::mfWallClock = PlatformWallClock;
+__int64_t MonitoringClock::miEpochOffset = 0;
+bool MonitoringClock::mbSynced = false;
+bool MonitoringClock::mbSntpStarted = false;
+
+
+void MonitoringClock::SetSources(TMonotonicSource fNow, TWallClockSource fWallClock){
+	mfNow = fNow ? fNow : PlatformNow;
+	mfWallClock = fWallClock ? fWallClock : PlatformWallClock;
+	miEpochOffset = 0;
+	mbSynced = false;
+}
+
+void MonitoringClock::StartSync(){
+	if (mbSntpStarted)
+		return;
+	mbSntpStarted = true;
+	ESP_LOGI(LOGTAG, "starting SNTP with %s", NTP_SERVER);
+	sntp_setoperatingmode(SNTP_OPMODE_POLL);
+	sntp_setservername(0, (char*)NTP_SERVER);
+	sntp_init();
+}
+
+// re-aligned on every call, so adjustments of the system time by SNTP are followed
+bool MonitoringClock::Align(){
+	__int64_t iWallClock = mfWallClock();
+	if (iWallClock < (__int64_t)NTP_VALID_AFTER * 1000000)
+		return false;
+
+	miEpochOffset = iWallClock - (__int64_t)Now();
+	if (mbSynced)
+		return false;
+	mbSynced = true;
+	ESP_LOGI(LOGTAG, "wall clock synchronized: %u", (__uint32_t)(iWallClock / 1000000));
+	return true;
+}
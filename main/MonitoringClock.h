@@ -0,0 +1,41 @@
+#ifndef MAIN_MONITORINGCLOCK_H_
+#define MAIN_MONITORINGCLOCK_H_
+
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Time base of the monitoring data.
+ * Now() is the monotonic microsecond clock since boot - it takes no lock and does not log, so it can be used
+ * around very short operations. Once SNTP delivered the wall clock, Align() determines the offset and
+ * ToEpochMs() converts monotonic timestamps to epoch milliseconds (before that they stay relative to boot).
+ * Both time sources can be replaced with SetSources(), e.g. by tests that need a clock under their control.
+ */
+typedef __uint64_t (*TMonotonicSource)();	// us since boot
+typedef __int64_t (*TWallClockSource)();	// us since the epoch
+
+class MonitoringClock {
+public:
+	static __uint64_t Now() { return mfNow(); };
+
+	// NULL restores the platform clocks; forgets the alignment, so only call it before monitoring starts
+	static void SetSources(TMonotonicSource fNow, TWallClockSource fWallClock);
+
+	// starts SNTP (once), needs a network connection
+	static void StartSync();
+
+	// updates the offset to the wall clock, returns true when the clock got synchronized for the first time
+	// only call it from one task (the monitoring task), the offset is not protected
+	static bool Align();
+	static bool IsSynced() { return mbSynced; };
+
+	static __uint64_t ToEpochMs(__uint64_t uMicros) { return (uMicros + miEpochOffset) / 1000; };
+
+private:
+	static TMonotonicSource mfNow;
+	static TWallClockSource mfWallClock;
+	static __int64_t miEpochOffset;
+	static bool mbSynced;
+	static bool mbSntpStarted;
+};
+
+#endif /* MAIN_MONITORINGCLOCK_H_ */
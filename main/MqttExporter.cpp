@@ -0,0 +1,42 @@
+#include "MqttExporter.h"
+#include "AWSIntegration.h"
+#include "aws_iot_config.h"
+#include <esp_log.h>
+
+static const char* LOGTAG = "MqttExporter";
+
+#define MQTT_OVERHEAD   128     // topic and MQTT header have to fit into the TX buffer as well
+
+
+MqttExporter::MqttExporter() {
+    mpAws = NULL;
+    mSettings.uFlushActions = 32;
+    mSettings.uFlushBytes = 3072;
+    mSettings.uFlushMaxAge = 30000;
+    mSettings.uMaxPayload = AWS_IOT_MQTT_TX_BUF_LEN - MQTT_OVERHEAD;
+    mSettings.uRetryBatches = 4;
+}
+
+MqttExporter::~MqttExporter() {
+}
+
+bool MqttExporter::Start(const TExporterContext& rContext) {
+    mpAws = rContext.pAws;
+    if (!mpAws->mActive)
+        return false;
+    msTopic.clear();
+    msTopic.printf("/dynatraceufo/monitoring/%s", rContext.pId->c_str());
+    msTopicCbor.clear();
+    msTopicCbor.printf("/dynatraceufo/monitoring/cbor/%s", rContext.pId->c_str());
+    ESP_LOGI(LOGTAG, "publishing to %s", msTopic.c_str());
+    return true;
+}
+
+bool MqttExporter::IsActive() {
+    return mpAws && mpAws->mActive;
+}
+
+bool MqttExporter::Export(const char* pPayload, size_t uLength, bool bCbor) {
+    String& rTopic = bCbor ? msTopicCbor : msTopic;
+    return mpAws->Publish(rTopic.c_str(), rTopic.length(), pPayload, uLength);
+}
@@ -0,0 +1,26 @@
+#ifndef MAIN_MQTTEXPORTER_H_
+#define MAIN_MQTTEXPORTER_H_
+
+#include "TelemetryExporter.h"
+#include "String.h"
+
+class AWSIntegration;
+
+// publishes the batches to /dynatraceufo/monitoring[/cbor]/<ufo id> on the broker of AWSIntegration
+class MqttExporter : public TelemetryExporter {
+public:
+    MqttExporter();
+    virtual ~MqttExporter();
+
+    virtual const char* GetName() { return "mqtt"; };
+    virtual bool Start(const TExporterContext& rContext);
+    virtual bool IsActive();
+    virtual bool Export(const char* pPayload, size_t uLength, bool bCbor);
+
+private:
+    AWSIntegration* mpAws;
+    String msTopic;
+    String msTopicCbor;
+};
+
+#endif /* MAIN_MQTTEXPORTER_H_ */
@@ -5,7 +5,7 @@
 #include "Ota.h"
 
 #include "sdkconfig.h"
-//#include <string.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <netdb.h>
 
@@ -19,37 +19,222 @@
 #include <esp_log.h>
 #include <esp_partition.h>
 #include <esp_system.h>
+#include <esp_spi_flash.h>
 
 #include <nvs.h>
 #include <nvs_flash.h>
 
+#include <esp_timer.h>
+
 #include "String.h"
 #include "WebClient.h"
+#include "LatencyHistogram.h"
 
 //#define BUFFSIZE 1024
 //#define TEXT_BUFFSIZE 1024
 
 static const char* LOGTAG = "ota";
 
+static LatencyHistogram latencyFlashWrite("ufo_ota_flash_write_seconds", "Writing one OTA buffer to the flash");
+
 
 volatile int Ota::miProgress = OTA_PROGRESS_NOTYETSTARTED;
 volatile unsigned int Ota::muTimestamp = 0;
+TOtaStats Ota::mStats;
+String Ota::msResumeUrl;
 int Ota::GetProgress() { return miProgress; }
 unsigned int Ota::GetTimestamp() { return muTimestamp; }
 
+const char* Ota::GetStatus() {
+    int progress = miProgress;
+    if (progress >= 0)
+        return "inprogress";
+    switch (progress) {
+        case OTA_PROGRESS_CONNECTIONERROR: return "connectionerror";
+        case OTA_PROGRESS_FLASHERROR: return "flasherror";
+        case OTA_PROGRESS_FINISHEDSUCCESS: return "finishedsuccess";
+    }
+    return "notyetstarted";
+}
+
+
+void task_function_otawriter(void* user_data) {
+    ((Ota*)user_data)->WriterTask();
+    vTaskDelete(NULL);
+}
+
 
 Ota::Ota() {
     miProgress = OTA_PROGRESS_NOTYETSTARTED;
     muTimestamp = esp_log_early_timestamp();
+    for (int i = 0; i < OTA_BUFFER_COUNT; i++)
+        mpBuffers[i] = NULL;
+    mbedtls_sha256_init(&mSha);
 }
 
 Ota::~Ota() {
-	// TODO Auto-generated destructor stub
+    // no AbortImage() - the flashed part of an interrupted plain image is kept for its checkpoint, the UFO reboots next
+    StopWriter(false);
+    mbedtls_sha256_free(&mSha);
 }
 
+bool Ota::StartWriter() {
+    memset(&mStats, 0, sizeof(mStats));
+    mStats.uStart = esp_timer_get_time();
+    mbWriteFailed = false;
+    mpFilling = NULL;
+    muFilled = 0;
+
+    // the queues hold every buffer, plus the end marker for the writer
+    mhFull = xQueueCreate(OTA_BUFFER_COUNT + 1, sizeof(TOtaChunk));
+    mhFree = xQueueCreate(OTA_BUFFER_COUNT, sizeof(char*));
+    mhWriterDone = xSemaphoreCreateBinary();
+    if (!mhFull || !mhFree || !mhWriterDone) {
+        ESP_LOGE(LOGTAG, "could not create the writer queues");
+        return StopWriter(false), false;
+    }
+    // less buffers just mean less overlap - as long as there is one the update can go on
+    for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+        mpBuffers[i] = (char*)malloc(OTA_BUFFER_SIZE);
+        if (!mpBuffers[i])
+            break;
+        xQueueSend(mhFree, &mpBuffers[i], 0);
+        mStats.uBuffers++;
+    }
+    if (!mStats.uBuffers) {
+        ESP_LOGE(LOGTAG, "memory allocation failed (%d)", OTA_BUFFER_SIZE);
+        return StopWriter(false), false;
+    }
+    ESP_LOGI(LOGTAG, "%u buffers of %d bytes", mStats.uBuffers, OTA_BUFFER_SIZE);
+
+    // the download task runs on core 0 next to the network stack, flashing happens on the other core
+    if (xTaskCreatePinnedToCore(&task_function_otawriter, "otawriter", 4096, this, 5, NULL, 1) != pdPASS) {
+        ESP_LOGE(LOGTAG, "could not start the writer task");
+        return StopWriter(false), false;
+    }
+    mbWriterRunning = true;
+    return true;
+}
+
+// ends the writer task after it flashed all queued buffers
+// @param bFlush - also flash the buffer that is filled partially
+// @return false if any write failed
+bool Ota::StopWriter(bool bFlush) {
+    if (mbWriterRunning) {
+        if (bFlush && muFilled && !mbWriteFailed)
+            QueueFilled();
+        TOtaChunk chunk;
+        chunk.pData = NULL;
+        chunk.uLen = 0;
+        xQueueSend(mhFull, &chunk, portMAX_DELAY);
+        xSemaphoreTake(mhWriterDone, portMAX_DELAY);
+        mbWriterRunning = false;
+        mStats.uEnd = esp_timer_get_time();
+    }
+    mpFilling = NULL;
+    muFilled = 0;
+    for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+        if (mpBuffers[i])
+            free(mpBuffers[i]);
+        mpBuffers[i] = NULL;
+    }
+    if (mhFull)
+        vQueueDelete(mhFull);
+    if (mhFree)
+        vQueueDelete(mhFree);
+    if (mhWriterDone)
+        vSemaphoreDelete(mhWriterDone);
+    mhFull = NULL;
+    mhFree = NULL;
+    mhWriterDone = NULL;
+    return !mbWriteFailed;
+}
+
+void Ota::QueueFilled() {
+    TOtaChunk chunk;
+    chunk.pData = mpFilling;
+    chunk.uLen = muFilled;
+    // there is always room - the queue is as long as there are buffers
+    xQueueSend(mhFull, &chunk, portMAX_DELAY);
+    mpFilling = NULL;
+    muFilled = 0;
+}
+
+void Ota::WriterTask() {
+    TOtaChunk chunk;
+    while (true) {
+        __uint64_t uWait = esp_timer_get_time();
+        xQueueReceive(mhFull, &chunk, portMAX_DELAY);
+        __uint64_t uStart = esp_timer_get_time();
+        mStats.uFlashIdle += uStart - uWait;
+        if (!chunk.pData)
+            break;
+
+        // after an error the buffers are just passed back, so the receiving side never blocks
+        if (!mbWriteFailed) {
+            esp_err_t err;
+            if (mbPartitionWrite)
+                err = esp_partition_write(mpUpdatePartition, muActualDataLength, (const void *)chunk.pData, chunk.uLen);
+            else
+                err = esp_ota_write(mOtaHandle, (const void *)chunk.pData, chunk.uLen);
+            if (err == ESP_ERR_INVALID_SIZE) {
+                ESP_LOGE(LOGTAG, "Error partition too small for firmware data: %d", muActualDataLength + chunk.uLen);
+                miProgress = OTA_PROGRESS_FLASHERROR;
+                mbWriteFailed = true;
+            } else if (err != ESP_OK) {
+                ESP_LOGE(LOGTAG, "Error writing data: %d", err);
+                miProgress = OTA_PROGRESS_FLASHERROR;
+                mbWriteFailed = true;
+            } else {
+                mbedtls_sha256_update(&mSha, (const unsigned char*)chunk.pData, chunk.uLen);
+                muActualDataLength += chunk.uLen;
+                mStats.uBytesWritten = muActualDataLength;
+                miProgress = 100 * muActualDataLength / muContentLength;
+                ESP_LOGD(LOGTAG, "Have written image length %d, total %d", chunk.uLen, muActualDataLength);
+                // only on sector boundaries - after a reboot the rest of the partition gets erased from there
+                if (mbRaw && (muActualDataLength >= muNextCheckpoint) && !(muActualDataLength % SPI_FLASH_SEC_SIZE))
+                    SaveCheckpoint();
+            }
+            latencyFlashWrite.RecordSince(uStart);
+            mStats.uFlashWrite += esp_timer_get_time() - uStart;
+        }
+        xQueueSend(mhFree, &chunk.pData, portMAX_DELAY);
+    }
+    xSemaphoreGive(mhWriterDone);
+}
+
+
+// IDF has no esp_ota_abort() - esp_ota_end() is the only way to release the handle, but it must not validate
+// an incomplete image. With the first sector erased it refuses the image right at its header.
+void Ota::AbortImage() {
+    StopWriter(false);
+    if (!mOtaHandle)
+        return;
+    ESP_LOGW(LOGTAG, "dropping the incomplete image");
+    esp_partition_erase_range(mpUpdatePartition, 0, SPI_FLASH_SEC_SIZE);
+    esp_ota_end(mOtaHandle);
+    mOtaHandle = 0;
+}
 
 bool Ota::InternalOnRecvBegin(bool isContentLength, unsigned int contentLength){
-    
+    // an update that got interrupted before its end
+    AbortImage();
+    muActualDataLength = 0;
+    mDecompressor.Begin(&mPatch);
+    mPatch.Begin(this);
+    mbPatchFailed = false;
+    // a new image, whatever got flashed before is gone
+    ClearCheckpoint();
+    msETag.clear();
+    muTotalLength = 0;
+    muTransferred = 0;
+    muForwarded = 0;
+    mbRaw = false;
+    mbPartitionWrite = false;
+    muNextCheckpoint = OTA_CHECKPOINT_INTERVAL;
+    // muBoots stays, an update that started over after a reboot still counts the reboots
+    mbedtls_sha256_starts(&mSha, 0);
+
     if (isContentLength) {
         muContentLength = contentLength;
     } else {
@@ -85,15 +270,83 @@ bool Ota::InternalOnRecvBegin(bool isContentLength, unsigned int contentLength){
         return false;
     }
     ESP_LOGI(LOGTAG, "esp_ota_begin succeeded");
+    if (!StartWriter()) {
+        miProgress = OTA_PROGRESS_FLASHERROR;
+        return false;
+    }
     return true;
 }
 
 bool Ota::OnReceiveBegin(unsigned short int httpStatusCode, bool isContentLength, unsigned int contentLength) {
     ESP_LOGD(LOGTAG, "OnReceiveBegin(%u, %u)", httpStatusCode, contentLength);
 
+    if (httpStatusCode == 206)
+        return OnResumeBegin();
     if (httpStatusCode != 200)
         return false;
-    return InternalOnRecvBegin(isContentLength, contentLength);
+    if (mbResumeOnly) {
+        // starting over after every reboot would never end
+        ESP_LOGE(LOGTAG, "the image changed or the server does not support ranges, not starting over");
+        mbRaw = false;
+        ClearCheckpoint();
+        AbortImage();
+        return false;
+    }
+    if (GetResumePosition())
+        ESP_LOGW(LOGTAG, "the image changed or the server does not support ranges, starting over");
+    if (!InternalOnRecvBegin(isContentLength, contentLength))
+        return false;
+    if (isContentLength)
+        muTotalLength = contentLength;
+    // only a strong entity tag guarantees the same bytes when continuing
+    if (isContentLength && mWebClient.GetETag().startsWith("\"") && (mWebClient.GetETag().length() < OTA_ETAG_LENGTH))
+        msETag = mWebClient.GetETag();
+    return true;
+}
+
+bool Ota::OnResumeBegin() {
+    unsigned int uResumeAt = GetResumePosition();
+    unsigned int uStart;
+    unsigned int uTotal;
+    if (!uResumeAt || !mWebClient.GetContentRange(uStart, uTotal) || (uStart != uResumeAt) || (uTotal != muTotalLength)
+            || !mWebClient.GetETag().equals(msETag)) {
+        ESP_LOGE(LOGTAG, "partial content does not continue the image");
+        mbRaw = false;
+        ClearCheckpoint();
+        AbortImage();
+        return false;
+    }
+    ESP_LOGI(LOGTAG, "continuing the image at %u of %u bytes", uStart, uTotal);
+    if (!mbWriterRunning) {
+        // after a reboot: the image continues behind the checkpoint, there is no OTA handle to write with
+        ESP_LOGI(LOGTAG, "erasing the partition behind the checkpoint");
+        if (esp_partition_erase_range(mpUpdatePartition, uStart, mpUpdatePartition->size - uStart) != ESP_OK) {
+            ESP_LOGE(LOGTAG, "erasing the partition failed");
+            miProgress = OTA_PROGRESS_FLASHERROR;
+            return false;
+        }
+        mbPartitionWrite = true;
+        muActualDataLength = uStart;
+        muContentLength = uTotal;
+        muNextCheckpoint = uStart + OTA_CHECKPOINT_INTERVAL;
+        if (!StartWriter()) {
+            miProgress = OTA_PROGRESS_FLASHERROR;
+            return false;
+        }
+        mStats.uBytesWritten = uStart;
+    }
+    mStats.uResumes++;
+    return true;
+}
+
+// @return the byte the download can continue at, 0 if it has to start over
+unsigned int Ota::GetResumePosition() {
+    if (mbWriteFailed || mbPatchFailed || !msETag.length() || (muTransferred >= muTotalLength))
+        return 0;
+    // decompressor and patch keep their state only while the writer runs, a plain image continues after a reboot too
+    if (!mbRaw && !mbWriterRunning)
+        return 0;
+    return muTransferred;
 }
 
 bool Ota::OnReceiveBegin(String& sUrl, unsigned int contentLength){
@@ -107,29 +360,93 @@ bool Ota::OnReceiveBegin(String& sUrl, unsigned int contentLength){
 bool Ota::OnReceiveData(char* buf, int len) {
     ESP_LOGD(LOGTAG, "OnReceiveData(%d)", len);
 
-	esp_err_t err;
-    //ESP_LOGI(LOGTAG, "Before esp_ota_write");
-    err = esp_ota_write( mOtaHandle, (const void *)buf, len);
-    if (err == ESP_ERR_INVALID_SIZE) {
-    	ESP_LOGE(LOGTAG, "Error partition too small for firmware data: %d", muActualDataLength + len );
-        miProgress = OTA_PROGRESS_FLASHERROR;
-    	return false;
-    } else if (err != ESP_OK) {
-    	ESP_LOGE(LOGTAG, "Error writing data: %d", err);
-        miProgress = OTA_PROGRESS_FLASHERROR;
-    	return false;
+    if (!mbWriterRunning)
+        return false;
+    if (len <= 0)
+        return true;
+    mStats.uBytesReceived += len;
+    muTransferred += len;
+    if (mbRaw)
+        return WriteFirmware(buf, len);
+    // compressed data is decompressed first, then a delta gets applied - each stage passes on what is not meant for it
+    if (!mDecompressor.WriteFirmware(buf, len)) {
+        if (mPatch.IsPatch() && !mbWriteFailed)
+            mbPatchFailed = true;
+        // broken data can not be continued
+        AbortImage();
+        return false;
     }
-    muActualDataLength += len;
-    miProgress = 100 * muActualDataLength / muContentLength;
-    ESP_LOGD(LOGTAG, "Have written image length %d, total %d", len, muActualDataLength);
-    return err == ESP_OK;
+    mStats.bCompressed = mDecompressor.IsCompressed();
+    mStats.bDelta = mPatch.IsPatch();
+    // the progress refers to the image, not to what is transferred
+    if (mPatch.GetTargetLength())
+        muContentLength = mPatch.GetTargetLength();
+    else if (mDecompressor.GetLength())
+        muContentLength = mDecompressor.GetLength();
+    // everything received went straight to the flash buffers, so the download can be continued at any byte
+    if (!mStats.bCompressed && !mStats.bDelta && (muForwarded == muTransferred))
+        mbRaw = true;
+    return !mbWriteFailed;
+}
+
+bool Ota::WriteFirmware(const char* pData, unsigned int uLen) {
+    muForwarded += uLen;
+    while (uLen > 0) {
+        if (mbWriteFailed)
+            return false;
+        if (!mpFilling) {
+            __uint64_t uWait = esp_timer_get_time();
+            xQueueReceive(mhFree, &mpFilling, portMAX_DELAY);
+            mStats.uReceiveStall += esp_timer_get_time() - uWait;
+            muFilled = 0;
+        }
+        unsigned int uCopy = OTA_BUFFER_SIZE - muFilled;
+        if (uCopy > uLen)
+            uCopy = uLen;
+        memcpy(mpFilling + muFilled, pData, uCopy);
+        muFilled += uCopy;
+        pData += uCopy;
+        uLen -= uCopy;
+        if (muFilled == OTA_BUFFER_SIZE)
+            QueueFilled();
+    }
+    return !mbWriteFailed;
 }
 
 bool Ota::OnReceiveEnd() {
+    if (mbWriterRunning && (muTransferred < muTotalLength)) {
+        // the connection closed early - the writer keeps running if the next attempt can continue
+        ESP_LOGW(LOGTAG, "download ended after %u of %u bytes", muTransferred, muTotalLength);
+        if (!GetResumePosition())
+            StopWriter(false);
+        return false;
+    }
+    // complete, but broken - nothing to continue
+    if (mbWriterRunning && !mbRaw && !mDecompressor.End()) {
+        AbortImage();
+        return false;
+    }
+    if (mbWriterRunning && !mbRaw && !mPatch.End()) {
+        mbPatchFailed = true;
+        AbortImage();
+        return false;
+    }
+    if (!StopWriter(true))
+        return AbortImage(), false;
     ESP_LOGI(LOGTAG, "Total Write binary data length : %u", muActualDataLength);
+    ESP_LOGI(LOGTAG, "%u ms, waited %u ms for the flash, flash waited %u ms for data", (__uint32_t)((mStats.uEnd - mStats.uStart) / 1000),
+             (__uint32_t)(mStats.uReceiveStall / 1000), (__uint32_t)(mStats.uFlashIdle / 1000));
     //ESP_LOGI(LOGTAG, "DATA: %s", dummy.c_str());
-
-    if (esp_ota_end(mOtaHandle) != ESP_OK) {
+    __uint8_t sha[FIRMWARE_SHA256_LENGTH];
+    char sHex[2 * FIRMWARE_SHA256_LENGTH + 1];
+    mbedtls_sha256_finish(&mSha, sha);
+    FirmwarePatch::ToHex(sha, sHex);
+    ESP_LOGI(LOGTAG, "SHA256 of the image: %s", sHex);
+
+    // a resumed image got written to the partition directly, setting the boot partition verifies it
+    esp_err_t err = mbPartitionWrite ? ESP_OK : esp_ota_end(mOtaHandle);
+    mOtaHandle = 0;
+    if (err != ESP_OK) {
         ESP_LOGE(LOGTAG, "esp_ota_end failed!");
         miProgress = OTA_PROGRESS_FLASHERROR;
         //task_fatal_error();
@@ -138,7 +455,7 @@ bool Ota::OnReceiveEnd() {
 
     //ESP_LOGW(LOGTAG, "DEBUGGING CODE ACTIVE ---- NO BOOT PARTITION SET!!!!!");
 
-    esp_err_t err = esp_ota_set_boot_partition(mpUpdatePartition);
+    err = esp_ota_set_boot_partition(mpUpdatePartition);
     if (err != ESP_OK) {
         ESP_LOGE(LOGTAG, "esp_ota_set_boot_partition failed! err=0x%x", err);
         miProgress = OTA_PROGRESS_FLASHERROR;
@@ -146,6 +463,7 @@ bool Ota::OnReceiveEnd() {
         return false;
     } 
     
+    ClearCheckpoint();
     ESP_LOGI(LOGTAG, "Prepare to restart system!");
     miProgress = OTA_PROGRESS_FINISHEDSUCCESS;
     return true;
@@ -153,29 +471,180 @@ bool Ota::OnReceiveEnd() {
 
 
 
-bool Ota::UpdateFirmware(String sUrl)
+bool Ota::UpdateFirmware(String sUrl, bool bResumeOnly)
 {
 	Url url;
-	url.Parse(sUrl);
+	msUrl = sUrl;
+	mbResumeOnly = bResumeOnly;
+	if (LoadCheckpoint(sUrl))
+		ESP_LOGI(LOGTAG, "continuing the interrupted update after %u bytes", muTransferred);
+	else if (bResumeOnly) {
+		ESP_LOGW(LOGTAG, "no interrupted update to continue");
+		return false;
+	}
+
+	bool bOfferPatch = true;
+	unsigned short statuscode = 0;
+	for (unsigned int uAttempt = 0; ; uAttempt++) {
+		url.Parse(sUrl);
+		ESP_LOGI(LOGTAG, "Retrieve firmware from: %s", url.GetUrl().c_str());
+		mWebClient.Prepare(&url);
+		mWebClient.SetDownloadHandler(this);
+		mWebClient.SetTimeouts(10000, 20000, 0); //the download may take a while, but must not stall
+		mWebClient.SetReceiveBufferSize(OTA_RECEIVE_BUFFER_SIZE);
+
+		// offer compressed images and a delta update against the running image - other servers just ignore the headers
+		mWebClient.AddHttpHeaderCStr("X-Ufo-Accept: ufoz");
+		const esp_partition_t* pRunning;
+		unsigned int uImageLength;
+		const __uint8_t* pImageSha256;
+		if (bOfferPatch && FirmwarePatch::GetRunningImage(pRunning, uImageLength, pImageSha256)) {
+			char sHeader[32 + 2 * FIRMWARE_SHA256_LENGTH];
+			strcpy(sHeader, "X-Ufo-Image-Sha256: ");
+			FirmwarePatch::ToHex(pImageSha256, &sHeader[strlen(sHeader)]);
+			mWebClient.AddHttpHeaderCStr(sHeader);
+		}
+		unsigned int uResumeAt = GetResumePosition();
+		if (uResumeAt)
+			mWebClient.AddRangeHeader(uResumeAt, msETag.c_str());
+
+		statuscode = mWebClient.HttpGet();
+		if (miProgress == OTA_PROGRESS_FINISHEDSUCCESS)
+			break;
+		if (bOfferPatch && mbPatchFailed) {
+			// the patch does not fit the running image (or got corrupted), so retrieve the full image
+			ESP_LOGW(LOGTAG, "delta update failed, retrieving the full image");
+			AbortImage();
+			bOfferPatch = false;
+			continue;
+		}
+		if ((miProgress == OTA_PROGRESS_FLASHERROR) || (uAttempt >= OTA_RESUME_ATTEMPTS) || !GetResumePosition())
+			break;
+		// give the WiFi some time to reconnect
+		ESP_LOGW(LOGTAG, "download interrupted after %u bytes (error %u), continuing", muTransferred, statuscode);
+		vTaskDelay(OTA_RESUME_DELAY_MS / portTICK_PERIOD_MS);
+	}
+
+	if (miProgress != OTA_PROGRESS_FINISHEDSUCCESS) {
+		if (miProgress == OTA_PROGRESS_NOTYETSTARTED || miProgress >= 0) {
+			miProgress = OTA_PROGRESS_CONNECTIONERROR;
+		}
+		// the checkpoint stays for continuing after the reboot
+		if (!GetResumePosition())
+			ClearCheckpoint();
+		ESP_LOGE(LOGTAG, "Ota update failed - error %u", statuscode);
+		// esp_reboot();
+		return false;
+	}
 
-	ESP_LOGI(LOGTAG, "Retrieve firmware from: %s", url.GetUrl().c_str());
-	mWebClient.Prepare(&url);
-	mWebClient.SetDownloadHandler(this);
+	ESP_LOGI(LOGTAG, "UpdateFirmware finished successfully. downloaded %u bytes" , muActualDataLength);
 
-    unsigned short statuscode = mWebClient.HttpGet();
-    if (statuscode != 200) {
-        if (miProgress == OTA_PROGRESS_NOTYETSTARTED || miProgress >= 0) {
-            miProgress = OTA_PROGRESS_CONNECTIONERROR;
-        }
-      	ESP_LOGE(LOGTAG, "Ota update failed - error %u", statuscode);
-        // esp_reboot();
-      	return false;
+    return true;
+
+}
+
+bool Ota::LoadCheckpoint(String& sUrl) {
+    nvs_handle h;
+    if (nvs_open("Ota", NVS_READONLY, &h) != ESP_OK)
+        return false;
+    char sStoredUrl[256];
+    __uint32_t uUrlLen = sizeof(sStoredUrl);
+    TOtaCheckpoint* pCheckpoint = (TOtaCheckpoint*)malloc(sizeof(TOtaCheckpoint));
+    __uint32_t uLen = sizeof(TOtaCheckpoint);
+    bool bOk = pCheckpoint && (nvs_get_str(h, "Url", sStoredUrl, &uUrlLen) == ESP_OK)
+            && (nvs_get_blob(h, "Checkpoint", pCheckpoint, &uLen) == ESP_OK) && (uLen == sizeof(TOtaCheckpoint));
+    nvs_close(h);
+    if (!bOk) {
+        free(pCheckpoint);
+        return false;
     }
 
-	ESP_LOGI(LOGTAG, "UpdateFirmware finished successfully. downloaded %u bytes" , muActualDataLength);
+    const esp_partition_t* pPartition = esp_ota_get_next_update_partition(NULL);
+    pCheckpoint->sETag[OTA_ETAG_LENGTH - 1] = 0;
+    if (!sUrl.equals(sStoredUrl) || !pPartition || (pPartition->address != pCheckpoint->uPartition)
+            || !pCheckpoint->uWritten || (pCheckpoint->uWritten >= pCheckpoint->uTotal) || (pCheckpoint->uTotal > pPartition->size)
+            || (pCheckpoint->uWritten % SPI_FLASH_SEC_SIZE) || (pCheckpoint->uBoots >= OTA_RESUME_BOOTS)) {
+        ESP_LOGW(LOGTAG, "dropping the checkpoint of an interrupted update");
+        free(pCheckpoint);
+        ClearCheckpoint();
+        return false;
+    }
+
+    // the flashed part has to match the hash of the checkpoint
+    __uint8_t shaCheckpoint[FIRMWARE_SHA256_LENGTH];
+    __uint8_t shaFlash[FIRMWARE_SHA256_LENGTH];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_clone(&sha, &pCheckpoint->sha);
+    mbedtls_sha256_finish(&sha, shaCheckpoint);
+    mbedtls_sha256_starts(&sha, 0);
+    char* pBuffer = (char*)malloc(SPI_FLASH_SEC_SIZE);
+    bOk = pBuffer;
+    for (unsigned int uPos = 0; bOk && (uPos < pCheckpoint->uWritten); uPos += SPI_FLASH_SEC_SIZE) {
+        bOk = (esp_partition_read(pPartition, uPos, pBuffer, SPI_FLASH_SEC_SIZE) == ESP_OK);
+        mbedtls_sha256_update(&sha, (const unsigned char*)pBuffer, SPI_FLASH_SEC_SIZE);
+    }
+    mbedtls_sha256_finish(&sha, shaFlash);
+    mbedtls_sha256_free(&sha);
+    free(pBuffer);
+    if (!bOk || memcmp(shaCheckpoint, shaFlash, FIRMWARE_SHA256_LENGTH)) {
+        ESP_LOGW(LOGTAG, "the flashed part does not match the checkpoint");
+        free(pCheckpoint);
+        ClearCheckpoint();
+        return false;
+    }
 
+    mpUpdatePartition = pPartition;
+    muTransferred = pCheckpoint->uWritten;
+    muForwarded = pCheckpoint->uWritten;
+    muTotalLength = pCheckpoint->uTotal;
+    msETag = pCheckpoint->sETag;
+    memcpy(&mSha, &pCheckpoint->sha, sizeof(mSha));
+    mbRaw = true;
+    // an update that keeps crashing the UFO must not continue forever
+    muBoots = pCheckpoint->uBoots + 1;
+    free(pCheckpoint);
+    muActualDataLength = muTransferred;
+    SaveCheckpoint();
     return true;
+}
+
+void Ota::SaveCheckpoint() {
+    if (!msETag.length() || !muTotalLength)
+        return;
+    TOtaCheckpoint* pCheckpoint = (TOtaCheckpoint*)malloc(sizeof(TOtaCheckpoint));
+    if (!pCheckpoint)
+        return;
+    memset(pCheckpoint, 0, sizeof(TOtaCheckpoint));
+    pCheckpoint->uPartition = mpUpdatePartition->address;
+    pCheckpoint->uWritten = muActualDataLength;
+    pCheckpoint->uTotal = muTotalLength;
+    pCheckpoint->uBoots = muBoots;
+    strncpy(pCheckpoint->sETag, msETag.c_str(), OTA_ETAG_LENGTH - 1);
+    // the hardware SHA engine keeps the state in its registers, the clone holds it in the context
+    mbedtls_sha256_init(&pCheckpoint->sha);
+    mbedtls_sha256_clone(&pCheckpoint->sha, &mSha);
+
+    nvs_handle h;
+    if (nvs_open("Ota", NVS_READWRITE, &h) == ESP_OK) {
+        if ((nvs_set_str(h, "Url", msUrl.c_str()) != ESP_OK) || (nvs_set_blob(h, "Checkpoint", pCheckpoint, sizeof(TOtaCheckpoint)) != ESP_OK)
+                || (nvs_commit(h) != ESP_OK))
+            ESP_LOGW(LOGTAG, "could not store the checkpoint");
+        nvs_close(h);
+    }
+    ESP_LOGD(LOGTAG, "checkpoint at %u bytes", muActualDataLength);
+    mbedtls_sha256_free(&pCheckpoint->sha);
+    free(pCheckpoint);
+    muNextCheckpoint = muActualDataLength + OTA_CHECKPOINT_INTERVAL;
+}
 
+void Ota::ClearCheckpoint() {
+    nvs_handle h;
+    if (nvs_open("Ota", NVS_READWRITE, &h) != ESP_OK)
+        return;
+    if (nvs_erase_all(h) == ESP_OK)
+        nvs_commit(h);
+    nvs_close(h);
 }
 
 bool Ota::SwitchBootPartition() {
@@ -223,7 +692,45 @@ void task_function_firmwareupdate(void* user_data) {
 	esp_restart();
 }
 
+void task_function_firmwareresume(void* user_data) {
+	bool bOk;
+	{
+		Ota ota;
+		bOk = ota.UpdateFirmware((const char*)user_data, true);
+	}
+	if (!bOk) {
+		// the UFO keeps the running firmware, a checkpoint that is left gets another try after the next reboot
+		ESP_LOGE(LOGTAG, "continuing the update failed");
+		vTaskDelete(NULL);
+		return;
+	}
+	ESP_LOGI(LOGTAG, "Firmware updated. Rebooting now......");
+	vTaskDelay(10*1000 / portTICK_PERIOD_MS);
+	esp_restart();
+}
+
 
+void Ota::ResumeUpdateFirmwareTask() {
+    static bool bChecked = false;
+    if (bChecked)
+        return;
+    bChecked = true;
+
+    nvs_handle h;
+    if (nvs_open("Ota", NVS_READONLY, &h) != ESP_OK)
+        return;
+    char sUrl[256];
+    __uint32_t uLen = sizeof(sUrl);
+    esp_err_t ret = nvs_get_str(h, "Url", sUrl, &uLen);
+    nvs_close(h);
+    if ((ret != ESP_OK) || (miProgress != OTA_PROGRESS_NOTYETSTARTED))
+        return;
+    ESP_LOGW(LOGTAG, "continuing the firmware update from %s", sUrl);
+    // the task keeps the pointer
+    msResumeUrl = sUrl;
+    miProgress = 0;
+    xTaskCreatePinnedToCore(&task_function_firmwareresume, "firmwareupdate", 8192, (void*)msResumeUrl.c_str(), 6, NULL, 0);
+}
 
 void Ota::StartUpdateFirmwareTask(const char* url) {
     miProgress = 0;
@@ -8,7 +8,13 @@
 
 #include <esp_ota_ops.h>
 //#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
 #include "DownAndUploadHandler.h"
+#include "FirmwarePatch.h"
+#include "FirmwareDecompressor.h"
 #include "String.h"
 #include "WebClient.h"
 
@@ -17,7 +23,61 @@
 #define OTA_PROGRESS_FLASHERROR	        -3
 #define OTA_PROGRESS_FINISHEDSUCCESS  -200
 
-class Ota : public DownAndUploadHandler {
+#ifdef CONFIG_UFO_OTA_BUFFER_SIZE
+#define OTA_BUFFER_SIZE CONFIG_UFO_OTA_BUFFER_SIZE
+#else
+#define OTA_BUFFER_SIZE 16384
+#endif
+#ifdef CONFIG_UFO_OTA_BUFFER_COUNT
+#define OTA_BUFFER_COUNT CONFIG_UFO_OTA_BUFFER_COUNT
+#else
+#define OTA_BUFFER_COUNT 3
+#endif
+#ifdef CONFIG_UFO_OTA_RECEIVE_BUFFER_SIZE
+#define OTA_RECEIVE_BUFFER_SIZE CONFIG_UFO_OTA_RECEIVE_BUFFER_SIZE
+#else
+#define OTA_RECEIVE_BUFFER_SIZE 8192
+#endif
+
+#define OTA_CHECKPOINT_INTERVAL	(64*1024)	// bytes flashed between two checkpoints, a multiple of the flash sector size
+#define OTA_RESUME_ATTEMPTS		5			// resumes of an interrupted download before the update fails
+#define OTA_RESUME_DELAY_MS		5000
+#define OTA_RESUME_BOOTS		3			// reboots an update may continue after
+#define OTA_ETAG_LENGTH			80
+
+typedef struct {
+	char* pData;
+	unsigned int uLen;				// NULL/0 ends the writer task
+} TOtaChunk;
+
+typedef struct {
+	unsigned int uBytesReceived;
+	unsigned int uBytesWritten;
+	unsigned int uBuffers;			// flash write buffers allocated for the update
+	bool bDelta;					// a patch against the running image got received
+	bool bCompressed;
+	unsigned int uResumes;			// the download continued after it got interrupted
+	__uint64_t uStart;				// us
+	__uint64_t uEnd;				// us, 0 while the update runs
+	__uint64_t uReceiveStall;		// us the download waited for a free buffer - the flash is the bottleneck
+	__uint64_t uFlashIdle;			// us the writer waited for data - the network is the bottleneck
+	__uint64_t uFlashWrite;			// us spent in esp_ota_write
+} TOtaStats;
+
+/*
+ * Stored in the NVS while a plain image gets downloaded, so the download can continue with a range request
+ * after the connection dropped or the UFO rebooted.
+ */
+typedef struct {
+	__uint32_t uPartition;			// address of the update partition
+	__uint32_t uWritten;			// bytes flashed, a multiple of the flash sector size
+	__uint32_t uTotal;				// length of the image
+	__uint8_t uBoots;
+	char sETag[OTA_ETAG_LENGTH];	// version of the image on the server
+	mbedtls_sha256_context sha;		// state of the hash over the flashed bytes
+} TOtaCheckpoint;
+
+class Ota : public DownAndUploadHandler, public FirmwareWriter {
 public:
 	static void StartUpdateFirmwareTask(const char* url);
 	//static int  smErrorCode; //TODO this should provide "feedback" from the static class*/
@@ -27,12 +87,20 @@ public:
 	*   @returns in case of an error, it returns negative error codes
 	*/
 	static int GetProgress();
+	static const char* GetStatus();
 	static unsigned int GetTimestamp();
+	static TOtaStats& GetStats() { return mStats; };
+	// continues an update that got interrupted by a reboot - call it once there is a connection
+	static void ResumeUpdateFirmwareTask();
 
 public:
 	Ota();
 	virtual ~Ota();
-	bool UpdateFirmware(String url);
+	/*
+	 * @param bResumeOnly - only continue the interrupted update of the checkpoint, fail instead of downloading
+	 * the image from its start (the update got continued after a reboot)
+	 */
+	bool UpdateFirmware(String url, bool bResumeOnly = false);
 	
 
 	bool SwitchBootPartition();
@@ -44,10 +112,34 @@ public:
 	bool OnReceiveBegin(String& sUrl, unsigned int contentLength);
 	bool OnReceiveEnd();
 	bool OnReceiveData(char* buf, int len); // override DownloadHandler virtual method
+	bool WriteFirmware(const char* pData, unsigned int uLen);
+
+	void WriterTask();
 
 
 
 private:
+	/*
+	 * The download (or upload) only copies into large buffers and queues them, a writer task flashes them.
+	 * So receiving from the network and erasing/programming the flash overlap instead of waiting for each other.
+	 */
+	bool StartWriter();
+	bool StopWriter(bool bFlush);
+	void QueueFilled();
+	// stops the writer and releases the OTA handle of an image that did not get complete
+	void AbortImage();
+
+	/*
+	 * A download can be continued where it broke off: in the same session the writer keeps running and the
+	 * decompressor and the patch keep their state. A plain image also after a reboot, the checkpoint tells
+	 * how much got flashed - that part is verified against its hash.
+	 */
+	unsigned int GetResumePosition();
+	bool OnResumeBegin();
+	bool LoadCheckpoint(String& sUrl);
+	void SaveCheckpoint();
+	static void ClearCheckpoint();
+
 	WebClient mWebClient;
     esp_ota_handle_t mOtaHandle = 0 ;
     const esp_partition_t *mpUpdatePartition = NULL;
@@ -55,6 +147,34 @@ private:
 	unsigned int muContentLength = 0;
 	static volatile int miProgress; 
 	static volatile unsigned int muTimestamp;
+	static TOtaStats mStats;
+
+	// the received data passes the decompressor and the patch on its way to WriteFirmware
+	FirmwareDecompressor mDecompressor;
+	FirmwarePatch mPatch;
+	bool mbPatchFailed = false;
+
+	String msUrl;
+	String msETag;
+	unsigned int muTotalLength = 0;			// length of the download, 0 if unknown
+	unsigned int muTransferred = 0;			// bytes of the download received so far, over all attempts
+	unsigned int muForwarded = 0;			// bytes that reached the flash buffers
+	volatile bool mbRaw = false;			// a plain image, neither compressed nor a patch
+	bool mbPartitionWrite = false;			// resumed after a reboot, written without an OTA handle
+	unsigned int muNextCheckpoint = 0;
+	__uint8_t muBoots = 0;
+	bool mbResumeOnly = false;
+	mbedtls_sha256_context mSha;			// over the flashed bytes
+	static String msResumeUrl;
+
+	char* mpBuffers[OTA_BUFFER_COUNT];
+	char* mpFilling = NULL;
+	unsigned int muFilled = 0;
+	QueueHandle_t mhFull = NULL;
+	QueueHandle_t mhFree = NULL;
+	SemaphoreHandle_t mhWriterDone = NULL;
+	volatile bool mbWriteFailed = false;
+	bool mbWriterRunning = false;
 };
 
 #endif /* MAIN_OTA_H_ */
@@ -0,0 +1,189 @@
+#include "PayloadWriter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CBOR_MAJOR_UINT		0
+#define CBOR_MAJOR_NEGINT	1
+#define CBOR_MAJOR_TEXT		3
+#define CBOR_MAJOR_ARRAY	4
+#define CBOR_MAJOR_MAP		5
+#define CBOR_INDEFINITE		31
+#define CBOR_BREAK			0xff
+
+
+PayloadWriter::PayloadWriter() {
+	mpBuffer = NULL;
+	muLength = 0;
+	muCapacity = 0;
+	muLimit = SIZE_MAX;
+	mbError = false;
+}
+
+PayloadWriter::~PayloadWriter() {
+	if (mpBuffer)
+		free(mpBuffer);
+}
+
+// grows geometrically up to the limit, the buffer is never shrunk
+bool PayloadWriter::Ensure(size_t uAdditional){
+	if (mbError)
+		return false;
+	if (muLength + uAdditional > muLimit)
+		return mbError = true, false;
+	if (muLength + uAdditional <= muCapacity)
+		return true;
+	size_t uNewCapacity = muCapacity ? muCapacity : PAYLOADWRITER_INITIAL_CAPACITY;
+	while (uNewCapacity < muLength + uAdditional)
+		uNewCapacity *= 2;
+	if (uNewCapacity > muLimit)
+		uNewCapacity = muLimit;
+	char* pNew = (char*)realloc(mpBuffer, uNewCapacity);
+	if (!pNew){
+		mbError = true;
+		return false;
+	}
+	mpBuffer = pNew;
+	muCapacity = uNewCapacity;
+	return true;
+}
+
+bool PayloadWriter::Append(const char* pData, size_t uLen){
+	if (!Ensure(uLen))
+		return false;
+	memcpy(mpBuffer + muLength, pData, uLen);
+	muLength += uLen;
+	return true;
+}
+
+bool PayloadWriter::Append(const char* sText){
+	return Append(sText, strlen(sText));
+}
+
+bool PayloadWriter::Append(char c){
+	if (!Ensure(1))
+		return false;
+	mpBuffer[muLength++] = c;
+	return true;
+}
+
+bool PayloadWriter::AppendUint(__uint64_t uValue){
+	char sDigits[20];
+	__uint8_t uCount = 0;
+	while (uValue > 0xffffffff){	// 64 bit division is done in software, only use it for the upper digits
+		sDigits[uCount++] = '0' + (uValue % 10);
+		uValue /= 10;
+	}
+	__uint32_t uLow = uValue;
+	do {
+		sDigits[uCount++] = '0' + (uLow % 10);
+		uLow /= 10;
+	} while (uLow);
+	if (!Ensure(uCount))
+		return false;
+	while (uCount)
+		mpBuffer[muLength++] = sDigits[--uCount];
+	return true;
+}
+
+bool PayloadWriter::AppendQuotedUint(__uint64_t uValue){
+	return Append('"') && AppendUint(uValue) && Append('"');
+}
+
+bool PayloadWriter::AppendQuotedInt(__int64_t iValue){
+	if (iValue >= 0)
+		return AppendQuotedUint(iValue);
+	return Append("\"-") && AppendUint(-(__uint64_t)iValue) && Append('"');
+}
+
+bool PayloadWriter::AppendJsonString(const char* sText){
+	if (!Append('"'))
+		return false;
+	const char* pRun = sText;
+	while (*sText){
+		char c = *sText;
+		if ((c == '"') || (c == '\\') || ((unsigned char)c < 0x20)){
+			if (!Append(pRun, sText - pRun))
+				return false;
+			if ((unsigned char)c < 0x20){
+				char sEscape[7];
+				static const char* HEX = "0123456789abcdef";
+				memcpy(sEscape, "\\u00", 4);
+				sEscape[4] = HEX[(c >> 4) & 0x0f];
+				sEscape[5] = HEX[c & 0x0f];
+				if (!Append(sEscape, 6))
+					return false;
+			}
+			else if (!Append('\\') || !Append(c))
+				return false;
+			pRun = sText + 1;
+		}
+		sText++;
+	}
+	return Append(pRun, sText - pRun) && Append('"');
+}
+
+//------------------------------------------------------------------
+
+// major type in the upper 3 bits, the value (or its size) in the lower 5 bits, big endian argument
+bool PayloadWriter::CborHead(__uint8_t uMajor, __uint64_t uValue){
+	if (!Ensure(9))
+		return false;
+	uMajor <<= 5;
+	if (uValue < 24)
+		mpBuffer[muLength++] = uMajor | uValue;
+	else if (uValue <= 0xff){
+		mpBuffer[muLength++] = uMajor | 24;
+		mpBuffer[muLength++] = uValue;
+	}
+	else if (uValue <= 0xffff){
+		mpBuffer[muLength++] = uMajor | 25;
+		mpBuffer[muLength++] = uValue >> 8;
+		mpBuffer[muLength++] = uValue;
+	}
+	else if (uValue <= 0xffffffff){
+		mpBuffer[muLength++] = uMajor | 26;
+		mpBuffer[muLength++] = uValue >> 24;
+		mpBuffer[muLength++] = uValue >> 16;
+		mpBuffer[muLength++] = uValue >> 8;
+		mpBuffer[muLength++] = uValue;
+	}
+	else{
+		mpBuffer[muLength++] = uMajor | 27;
+		for (int i=56 ; i>=0 ; i-=8)
+			mpBuffer[muLength++] = uValue >> i;
+	}
+	return true;
+}
+
+bool PayloadWriter::CborUint(__uint64_t uValue){
+	return CborHead(CBOR_MAJOR_UINT, uValue);
+}
+
+// negative values are encoded as -1 - n
+bool PayloadWriter::CborInt(__int64_t iValue){
+	if (iValue >= 0)
+		return CborHead(CBOR_MAJOR_UINT, iValue);
+	return CborHead(CBOR_MAJOR_NEGINT, -1 - iValue);
+}
+
+bool PayloadWriter::CborText(const char* sText){
+	size_t uLen = strlen(sText);
+	return CborHead(CBOR_MAJOR_TEXT, uLen) && Append(sText, uLen);
+}
+
+bool PayloadWriter::CborArray(__uint32_t uCount){
+	return CborHead(CBOR_MAJOR_ARRAY, uCount);
+}
+
+bool PayloadWriter::CborMap(__uint32_t uCount){
+	return CborHead(CBOR_MAJOR_MAP, uCount);
+}
+
+bool PayloadWriter::CborArrayBegin(){
+	return Append((char)((CBOR_MAJOR_ARRAY << 5) | CBOR_INDEFINITE));
+}
+
+bool PayloadWriter::CborBreak(){
+	return Append((char)CBOR_BREAK);
+}
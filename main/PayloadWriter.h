@@ -0,0 +1,58 @@
+#ifndef MAIN_PAYLOADWRITER_H_
+#define MAIN_PAYLOADWRITER_H_
+
+#include "freertos/FreeRTOS.h"
+#include <stddef.h>
+
+#define PAYLOADWRITER_INITIAL_CAPACITY	1024
+
+/*
+ * Append-only byte buffer that is reused from batch to batch - Reset() keeps the memory,
+ * so after the first few batches serializing a payload does not allocate anymore.
+ * Provides plain JSON fragments as well as the few CBOR (RFC 7049) items the monitoring payload needs.
+ */
+class PayloadWriter {
+public:
+	PayloadWriter();
+	virtual ~PayloadWriter();
+
+	void Reset() { muLength = 0; mbError = false; };
+	// the buffer does not grow beyond uLimit bytes, a write that would need more fails (before anything is copied)
+	void SetLimit(size_t uLimit) { muLimit = uLimit; };
+	bool Reserve(size_t uCapacity) { return (uCapacity <= muCapacity) || Ensure(uCapacity - muLength); };
+	// drops everything behind uLength, e.g. an item that did not fit (or could not be allocated)
+	void Truncate(size_t uLength) { if (uLength < muLength) muLength = uLength; mbError = false; };
+
+	bool Append(const char* pData, size_t uLen);
+	bool Append(const char* sText);
+	bool Append(char c);
+	bool AppendUint(__uint64_t uValue);
+	bool AppendQuotedUint(__uint64_t uValue);		// "123" - the monitoring backend expects all numbers as strings
+	bool AppendQuotedInt(__int64_t iValue);
+	bool AppendJsonString(const char* sText);		// quoted and escaped
+
+	bool CborUint(__uint64_t uValue);
+	bool CborInt(__int64_t iValue);
+	bool CborText(const char* sText);
+	bool CborArray(__uint32_t uCount);
+	bool CborMap(__uint32_t uCount);
+	bool CborArrayBegin();		// indefinite length, terminated by CborBreak
+	bool CborBreak();
+
+	const char* GetData() 	{ return mpBuffer; };
+	size_t GetLength() 		{ return muLength; };
+	size_t GetCapacity() 	{ return muCapacity; };
+	bool IsValid()			{ return !mbError; };
+
+private:
+	bool Ensure(size_t uAdditional);
+	bool CborHead(__uint8_t uMajor, __uint64_t uValue);
+
+	char* mpBuffer;
+	size_t muLength;
+	size_t muCapacity;
+	size_t muLimit;
+	bool mbError;
+};
+
+#endif /* MAIN_PAYLOADWRITER_H_ */
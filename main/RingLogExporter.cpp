@@ -0,0 +1,99 @@
+#include "RingLogExporter.h"
+#include "Config.h"
+#include <esp_log.h>
+
+static const char* LOGTAG = "RingLogExporter";
+
+
+RingLogExporter::RingLogExporter() {
+    mpConfig = NULL;
+    mhLock = xSemaphoreCreateMutex();
+    muFirst = 0;
+    muCount = 0;
+    muExported = 0;
+    muOverwritten = 0;
+    // small batches, a batch never fails so nothing has to be retried
+    mSettings.uFlushActions = 16;
+    mSettings.uFlushBytes = 2048;
+    mSettings.uFlushMaxAge = 10000;
+    mSettings.uMaxPayload = 2048;
+    mSettings.uRetryBatches = 0;
+}
+
+RingLogExporter::~RingLogExporter() {
+    Clear();
+    vSemaphoreDelete(mhLock);
+}
+
+bool RingLogExporter::Start(const TExporterContext& rContext) {
+    mpConfig = rContext.pConfig;
+    ESP_LOGI(LOGTAG, "keeping the last %u batches", RINGLOG_BATCHES);
+    return true;
+}
+
+bool RingLogExporter::IsActive() {
+    return mpConfig && mpConfig->mbDTMonitoring;
+}
+
+bool RingLogExporter::Export(const char* pPayload, size_t uLength, bool bCbor) {
+    char* pCopy = (char*)malloc(uLength);
+    if (!pCopy)
+        return false;
+    memcpy(pCopy, pPayload, uLength);
+
+    xSemaphoreTake(mhLock, portMAX_DELAY);
+    if (muCount == RINGLOG_BATCHES) {
+        free(mBatches[muFirst].pData);
+        muFirst = (muFirst + 1) % RINGLOG_BATCHES;
+        muCount--;
+        muOverwritten++;
+    }
+    TRingLogBatch& rBatch = mBatches[(muFirst + muCount) % RINGLOG_BATCHES];
+    rBatch.pData = pCopy;
+    rBatch.uLength = uLength;
+    rBatch.bCbor = bCbor;
+    muCount++;
+    muExported++;
+    xSemaphoreGive(mhLock);
+    return true;
+}
+
+void RingLogExporter::WriteJson(String& rsBody) {
+    static const char hex[] = "0123456789abcdef";
+
+    xSemaphoreTake(mhLock, portMAX_DELAY);
+    size_t uSize = 64;
+    for (__uint8_t u=0; u<muCount; u++) {
+        TRingLogBatch& rBatch = mBatches[(muFirst + u) % RINGLOG_BATCHES];
+        uSize += (rBatch.bCbor ? 2 * rBatch.uLength + 2 : rBatch.uLength) + 1;
+    }
+    rsBody.reserve(rsBody.length() + uSize);
+    rsBody.printf("{\"exported\":%u,\"overwritten\":%u,\"batches\":[", muExported, muOverwritten);
+    for (__uint8_t u=0; u<muCount; u++) {
+        TRingLogBatch& rBatch = mBatches[(muFirst + u) % RINGLOG_BATCHES];
+        if (u)
+            rsBody += ',';
+        if (rBatch.bCbor) {
+            rsBody += '"';
+            for (size_t i=0; i<rBatch.uLength; i++) {
+                rsBody += hex[((__uint8_t)rBatch.pData[i]) >> 4];
+                rsBody += hex[((__uint8_t)rBatch.pData[i]) & 0x0f];
+            }
+            rsBody += '"';
+        } else {
+            rsBody.concat(rBatch.pData, rBatch.uLength);
+        }
+    }
+    rsBody += "]}";
+    xSemaphoreGive(mhLock);
+}
+
+void RingLogExporter::Clear() {
+    xSemaphoreTake(mhLock, portMAX_DELAY);
+    while (muCount) {
+        free(mBatches[muFirst].pData);
+        muFirst = (muFirst + 1) % RINGLOG_BATCHES;
+        muCount--;
+    }
+    xSemaphoreGive(mhLock);
+}
@@ -0,0 +1,46 @@
+#ifndef MAIN_RINGLOGEXPORTER_H_
+#define MAIN_RINGLOGEXPORTER_H_
+
+#include "TelemetryExporter.h"
+#include "String.h"
+#include "freertos/semphr.h"
+
+#define RINGLOG_BATCHES     8       // the oldest batch is overwritten when the log is full
+
+class Config;
+
+/*
+ * Keeps the last batches in memory instead of sending them anywhere - for testing without a backend,
+ * the log is read with /monitoringlog.
+ */
+class RingLogExporter : public TelemetryExporter {
+public:
+    RingLogExporter();
+    virtual ~RingLogExporter();
+
+    virtual const char* GetName() { return "ringlog"; };
+    virtual bool Start(const TExporterContext& rContext);
+    virtual bool IsActive();
+    virtual bool Export(const char* pPayload, size_t uLength, bool bCbor);
+
+    // {"exported":n,"overwritten":n,"batches":[...]} - JSON batches are embedded as they are, CBOR batches as hex strings
+    void WriteJson(String& rsBody);
+    void Clear();
+
+private:
+    typedef struct {
+        char* pData;
+        size_t uLength;
+        bool bCbor;
+    } TRingLogBatch;
+
+    Config* mpConfig;
+    SemaphoreHandle_t mhLock;       // the web server reads the log while the monitoring task writes it
+    TRingLogBatch mBatches[RINGLOG_BATCHES];
+    __uint8_t muFirst;
+    __uint8_t muCount;
+    __uint32_t muExported;
+    __uint32_t muOverwritten;
+};
+
+#endif /* MAIN_RINGLOGEXPORTER_H_ */
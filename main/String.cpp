@@ -39,6 +39,7 @@ int String::printf(const char* format, ...) {
         return addLen;
     }
 
+    va_start(args, format); // the arguments got consumed by the first vsnprintf
     if (len) { // add to existing string, so create temp buffer
         String s;
         s.resize(addLen); // resize always allocates at least 1 byte more than addLen
@@ -49,6 +50,7 @@ int String::printf(const char* format, ...) {
         addLen = vsnprintf((char*)c_str(), addLen+1, format, args);
         len = addLen;
     }
+    va_end(args);
     return addLen; 
 }
 
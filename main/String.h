@@ -55,6 +55,11 @@ public:
     */
     void clear() { invalidate(); };
 
+    //ADDED!!!
+    /* @brief   number of characters the String can hold without reallocating its buffer
+    */
+    unsigned int getCapacity() const { return buffer ? capacity : 0; };
+
     //ADDED!!!
     /* @brief stream-like printf method that appends the "printf" formatted output to the String data
      * use clear() if you dont want to append but simply reuse an existing String object 
@@ -3,7 +3,7 @@
 
 #include "freertos/FreeRTOS.h"
 
-#define MAX_STRINGS		5
+#define MAX_STRINGS		6
 
 class StringParser {
 public:
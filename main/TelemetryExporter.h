@@ -0,0 +1,69 @@
+#ifndef MAIN_TELEMETRYEXPORTER_H_
+#define MAIN_TELEMETRYEXPORTER_H_
+
+#include "freertos/FreeRTOS.h"
+#include <stddef.h>
+#include <stdlib.h>
+
+#define DT_EXPORTER_MQTT        0
+#define DT_EXPORTER_HTTP        1
+#define DT_EXPORTER_RINGLOG     2
+#define DT_EXPORTER_LAST        DT_EXPORTER_RINGLOG
+
+// a batch is exported as soon as one of the flush limits is reached
+typedef struct {
+    __uint16_t uFlushActions;   // waiting actions
+    __uint16_t uFlushBytes;     // estimated payload size of the waiting actions
+    __uint32_t uFlushMaxAge;    // ms the oldest action waits (without actions an empty batch is sent in this interval)
+    __uint16_t uMaxPayload;     // max. size of a single batch
+    __uint8_t uRetryBatches;    // batches kept while they can not be exported
+} TExporterSettings;
+
+class Config;
+class Wifi;
+class AWSIntegration;
+class String;
+
+// what the monitoring and its exporters use of the device - Ufo fills it in, the host tests bring their own
+typedef struct {
+    Config* pConfig;
+    Wifi* pWifi;
+    AWSIntegration* pAws;
+    String* pId;                // ufo id, it is set after the monitoring got initialized
+} TExporterContext;
+
+/*
+ * Destination of the monitoring batches. DynatraceMonitoring serializes the batches and calls Export
+ * from the monitoring task only - implementations don't need to be thread safe towards it.
+ */
+class TelemetryExporter {
+public:
+    TelemetryExporter() {};
+    virtual ~TelemetryExporter() {};
+
+    virtual const char* GetName() = 0;
+    // called until it returns true, batches are exported from then on
+    virtual bool Start(const TExporterContext& rContext) = 0;
+    // false ends the monitoring task
+    virtual bool IsActive() = 0;
+    virtual bool Export(const char* pPayload, size_t uLength, bool bCbor) = 0;
+
+    const TExporterSettings& GetSettings() { return mSettings; };
+
+    // DT_EXPORTER_xxx from its decimal value (the dtexporter setting), false for anything else
+    static bool ParseType(const char* sValue, __uint8_t& ruType) {
+        if ((*sValue < '0') || (*sValue > '9'))
+            return false;
+        char* pEnd;
+        long iType = strtol(sValue, &pEnd, 10);
+        if (*pEnd || (iType > DT_EXPORTER_LAST))
+            return false;
+        ruType = iType;
+        return true;
+    };
+
+protected:
+    TExporterSettings mSettings;
+};
+
+#endif /* MAIN_TELEMETRYEXPORTER_H_ */
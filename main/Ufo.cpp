@@ -5,12 +5,16 @@
 #include "DynatraceAction.h"
 #include "AWSIntegration.h"
 #include "DotstarStripe.h"
+#include "LatencyHistogram.h"
+#include "Ota.h"
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include <esp_log.h>
 
 static const char* LOGTAG = "Ufo";
 
+static LatencyHistogram latencyFrame("ufo_display_frame_seconds", "Rendering one frame of the LED rings and the logo");
+
 
 extern "C"{
 	void app_main();
@@ -39,6 +43,8 @@ Ufo::Ufo() : mStripeLevel1(15, GPIO_NUM_16, GPIO_NUM_18), mStripeLevel2(15, GPIO
 	mWifi.SetConfig(&mConfig);
 	mWifi.SetStateDisplay(&mStateDisplay);
 	mbApiCallReceived = false;
+	muApiPackets = 0;
+	muApiPacketsRejected = 0;
 }
 
 Ufo::~Ufo() {
@@ -55,7 +61,7 @@ void Ufo::Start(){
 
 	mbButtonPressed = !gpio_get_level(GPIO_NUM_0);
 	mStateDisplay.SetAPMode(mConfig.mbAPMode);
-	mApiStore.Init();
+	mApiStore.Init(&mSceneLock);
 
 	gpio_pad_select_gpio(10);
 	gpio_set_direction(GPIO_NUM_0, GPIO_MODE_INPUT);
@@ -74,7 +80,8 @@ void Ufo::Start(){
 	xTaskCreate(&task_function_display, "Task_Display", 4096, this, 5, NULL);
 
 	// Dynatrace Monitoring
-	dt.Init(this, &mAws);
+	TExporterContext context = { &mConfig, &mWifi, &mAws, &mId };
+	dt.Init(context);
 
 	if (mConfig.mbAPMode){
 		if (mConfig.muLastSTAIpAddress){
@@ -88,16 +95,18 @@ void Ufo::Start(){
 	else{
 		DynatraceAction* dtWifi = dt.enterAction("Start Wifi", dtStartup);	
 		if (mConfig.msSTAENTUser.length())
-			mWifi.StartSTAModeEnterprise(mConfig.msSTASsid, mConfig.msSTAENTUser, mConfig.msSTAPass, mConfig.msSTAENTCA, mConfig.msHostname);
+			mWifi.StartSTAModeEnterprise(mConfig.msSTASsid, mConfig.msSTAENTUser, mConfig.msSTAPass, mConfig.GetSTAENTCA(), mConfig.msHostname);
 		else
 			mWifi.StartSTAMode(mConfig.msSTASsid, mConfig.msSTAPass, mConfig.msHostname);
 	
 		dt.leaveAction(dtWifi);
 		SetId();
 		// Dynatrace API Integration
-		mDt.Init(this, &mDisplayCharterLevel1, &mDisplayCharterLevel2);
+		mDt.Init(&dt, &mConfig, &mWifi, &mDisplayCharterLevel1, &mDisplayCharterLevel2);
 		// AWS communication layer
 		mAws.Init(this);
+		// real-time frames via UDP
+		mFrameStream.Start(this);
 	}
 	dt.leaveAction(dtStartup);
 
@@ -107,6 +116,8 @@ void Ufo::TaskWebServer(){
 
 	while (1){
 		if (mWifi.IsConnected()){
+			// an update interrupted by a reboot continues as soon as there is a connection
+			Ota::ResumeUpdateFirmwareTask();
 			ESP_LOGI("Ufo", "starting Webserver");
 			mServer.StartUfoServer();
 		}
@@ -117,7 +128,17 @@ void Ufo::TaskWebServer(){
 void Ufo::TaskDisplay(){
 	__uint8_t uSendState = 0;
 	while (1){
-		if (mWifi.IsConnected() && (mbApiCallReceived || (mDt.IsActive() && mStateDisplay.IpShownLongEnough()))){
+		__uint64_t uFrameStart = LatencyHistogram::Start();
+		mSceneLock.Enter(0);
+		bool bStreaming = mFrameStream.IsStreaming();
+		if (bStreaming){
+			// the stream owns all LEDs, the rings show the API state again after FRAME_STREAM_TIMEOUT
+			TStreamBuffer* pBuffer = mFrameStream.AcquireFrame();
+			if (pBuffer)
+				ShowStreamFrame(pBuffer->frame);
+			uSendState = 0;
+		}
+		else if (mWifi.IsConnected() && (mbApiCallReceived || (mDt.IsActive() && mStateDisplay.IpShownLongEnough()))){
 			if (!uSendState){
 				mDisplayCharterLevel1.Display(mStripeLevel1, true);
 				mDisplayCharterLevel2.Display(mStripeLevel2, true);
@@ -135,7 +156,10 @@ void Ufo::TaskDisplay(){
 		else
 			mStateDisplay.Display(mStripeLevel1, mStripeLevel2);
 
-		mDisplayCharterLogo.Display(mStripeLogo);
+		if (!bStreaming)
+			mDisplayCharterLogo.Display(mStripeLogo);
+		mSceneLock.Leave();
+		latencyFrame.RecordSince(uFrameStart);
 
 		if (!gpio_get_level(GPIO_NUM_0)){
 			if (!mbButtonPressed){
@@ -180,6 +204,20 @@ void Ufo::ShowLogoLeds(){
 	mStripeLevel1.Show();
 }
 
+void Ufo::ShowStreamFrame(TStreamFrame& rFrame){
+	for (__uint8_t i = 0; i < FRAME_STREAM_RING_LEDS; i++){
+		mStripeLevel1.SetLeds(i, 1, rFrame.top[i][0], rFrame.top[i][1], rFrame.top[i][2]);
+		mStripeLevel2.SetLeds(i, 1, rFrame.bottom[i][0], rFrame.bottom[i][1], rFrame.bottom[i][2]);
+	}
+	for (__uint8_t i = 0; i < FRAME_STREAM_LOGO_LEDS; i++)
+		mStripeLogo.SetLeds(i, 1, rFrame.logo[i][0], rFrame.logo[i][1], rFrame.logo[i][2]);
+	mStripeLevel1.SetStartPos(0);
+	mStripeLevel2.SetStartPos(0);
+	mStripeLevel1.Show();
+	mStripeLevel2.Show();
+	mStripeLogo.Show();
+}
+
 void Ufo::SetId() {
 	char sHelp[20];
 	mWifi.GetMac((__uint8_t*)sHelp);
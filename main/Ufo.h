@@ -12,6 +12,8 @@
 #include "Config.h"
 #include "UfoWebServer.h"
 #include "ApiStore.h"
+#include "CriticalSection.h"
+#include "FrameStreamServer.h"
 
 #define FIRMWARE_VERSION __DATE__ " - " __TIME__
 
@@ -29,13 +31,22 @@ public:
 	void ShowLogoLeds();
 
 	void IndicateApiCall() 	{ mbApiCallReceived = true; };
+	void CountApiPacket(bool bApplied) { if (bApplied) muApiPackets++; else muApiPacketsRejected++; };
+	__uint32_t GetApiPackets() { return muApiPackets; };
+	__uint32_t GetApiPacketsRejected() { return muApiPacketsRejected; };
+
+	// held while the display task renders a frame - changes made under it show up completely or not at all
+	CriticalSection&		GetSceneLock()		{ return mSceneLock; };
 
 	Config& 				GetConfig()			{ return mConfig; };
 	Wifi& 					GetWifi()			{ return mWifi; };
 	DisplayCharterLogo& 	GetLogoDisplay() 	{ return mDisplayCharterLogo; };
+	DisplayCharter&			GetDisplayLevel1()	{ return mDisplayCharterLevel1; };
+	DisplayCharter&			GetDisplayLevel2()	{ return mDisplayCharterLevel2; };
 	ApiStore& 				GetApiStore() 		{ return mApiStore; };
 	DynatraceIntegration&	GetDtIntegration() 	{ return mDt; };
 	AWSIntegration&			GetAWSIntegration() { return mAws; };
+	FrameStreamServer&		GetFrameStream()	{ return mFrameStream; };
     String&					GetId()             { return mId; };
 
 	DynatraceMonitoring dt;
@@ -43,11 +54,13 @@ public:
 private:
 
 	void SetId();
+	void ShowStreamFrame(TStreamFrame& rFrame);
     String mId;
 	
 	DisplayCharter mDisplayCharterLevel1;
 	DisplayCharter mDisplayCharterLevel2;
 	DisplayCharterLogo mDisplayCharterLogo;
+	CriticalSection mSceneLock;
 
 	StateDisplay mStateDisplay;
 
@@ -63,9 +76,12 @@ private:
 
 	DynatraceIntegration mDt;
 	AWSIntegration mAws;
+	FrameStreamServer mFrameStream;
 
 	bool mbButtonPressed;
 	bool mbApiCallReceived;
+	__uint32_t muApiPackets;
+	__uint32_t muApiPacketsRejected;
 };
 
 #endif /* MAIN_UFO_H_ */
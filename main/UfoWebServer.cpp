@@ -2,8 +2,10 @@
 #include "Ufo.h"
 #include "Config.h"
 #include "DynamicRequestHandler.h"
+#include "DisplayCommand.h"
 #include "HttpRequestParser.h"
 #include "HttpResponse.h"
+#include "LatencyHistogram.h"
 #include <lwip/sockets.h>
 #include <esp_log.h>
 #include <esp_system.h>
@@ -19,6 +21,27 @@
 
 static char tag[] = "UfoWebServer";
 
+#define REQUEST_METRIC	"ufo_http_request_seconds"
+#define REQUEST_HELP	"Handling of incoming HTTP requests"
+static LatencyHistogram latencyApi(REQUEST_METRIC, REQUEST_HELP, "endpoint=\"api\"");
+static LatencyHistogram latencyInfo(REQUEST_METRIC, REQUEST_HELP, "endpoint=\"info\"");
+static LatencyHistogram latencyConfig(REQUEST_METRIC, REQUEST_HELP, "endpoint=\"config\"");
+static LatencyHistogram latencyStatic(REQUEST_METRIC, REQUEST_HELP, "endpoint=\"static\"");
+static LatencyHistogram latencyOther(REQUEST_METRIC, REQUEST_HELP, "endpoint=\"other\"");
+
+static LatencyHistogram& GetRequestLatency(String& sUrl){
+	if (sUrl.equals("/api"))
+		return latencyApi;
+	if (sUrl.equals("/info"))
+		return latencyInfo;
+	if (sUrl.equals("/") || sUrl.equals("/index.html") || sUrl.startsWith("/fonts/"))
+		return latencyStatic;
+	if (sUrl.equals("/config") || sUrl.equals("/srvconfig") || sUrl.equals("/apilist") || sUrl.equals("/apiedit")
+			|| sUrl.equals("/dynatraceintegration") || sUrl.equals("/dynatracemonitoring"))
+		return latencyConfig;
+	return latencyOther;
+}
+
 //------------------------------------------------------------------
 
 UfoWebServer::UfoWebServer() {
@@ -40,11 +63,20 @@ bool UfoWebServer::StartUfoServer(){
 	else
 		port = mpUfo->GetConfig().mbWebServerUseSsl ? 443 : 80;
 	
-	return Start(port, mpUfo->GetConfig().mbWebServerUseSsl, &(mpUfo->GetConfig().msWebServerCert));		
+	if (!mpUfo->GetConfig().mbWebServerUseSsl)
+		return Start(port, false, NULL);
+	return Start(port, true, &(mpUfo->GetConfig().GetWebServerCert()));
 }
 
 
 bool UfoWebServer::HandleRequest(HttpRequestParser& httpParser, HttpResponse& httpResponse){
+	__uint64_t uStart = LatencyHistogram::Start();
+	bool bResult = HandleRoute(httpParser, httpResponse);
+	GetRequestLatency(httpParser.GetUrl()).RecordSince(uStart);
+	return bResult;
+}
+
+bool UfoWebServer::HandleRoute(HttpRequestParser& httpParser, HttpResponse& httpResponse){
 
 	DynamicRequestHandler requestHandler(mpUfo, mpDisplayCharterLevel1, mpDisplayCharterLevel2);
 
@@ -78,12 +110,20 @@ bool UfoWebServer::HandleRequest(HttpRequestParser& httpParser, HttpResponse& ht
 		if (!requestHandler.HandleDynatraceIntegrationRequest(httpParser.GetParams(), httpResponse))
 			return false;
 	}
+	else if (httpParser.GetUrl().equals("/dynatracewebhook")){
+		if (!requestHandler.HandleDynatraceWebhookRequest(httpParser.GetParams(), httpParser.GetAuthorization(), httpParser.GetBody(), httpResponse))
+			return false;
+	}
 	else if (httpParser.GetUrl().equals("/dynatracemonitoring")){
 		if (!requestHandler.HandleDynatraceMonitoringRequest(httpParser.GetParams(), httpResponse))
 			return false;
 	}
 	else if (httpParser.GetUrl().equals("/api")){
-		if (!requestHandler.HandleApiRequest(httpParser.GetParams(), httpResponse))
+		if (!httpParser.IsGet() && DisplayCommand::IsPacket(httpParser.GetBody().c_str(), httpParser.GetBody().length())){
+			if (!requestHandler.HandleApiPacketRequest(httpParser.GetBody(), httpResponse))
+				return false;
+		}
+		else if (!requestHandler.HandleApiRequest(httpParser.GetParams(), httpResponse))
 			return false;
 	}
 	else if (httpParser.GetUrl().equals("/apilist")){
@@ -98,6 +138,14 @@ bool UfoWebServer::HandleRequest(HttpRequestParser& httpParser, HttpResponse& ht
 		if (!requestHandler.HandleInfoRequest(httpParser.GetParams(), httpResponse))
 			return false;
 	}
+	else if (httpParser.GetUrl().equals("/metrics")){
+		if (!requestHandler.HandleMetricsRequest(httpParser.GetParams(), httpResponse))
+			return false;
+	}
+	else if (httpParser.GetUrl().equals("/monitoringlog")){
+		if (!requestHandler.HandleMonitoringLogRequest(httpParser.GetParams(), httpResponse))
+			return false;
+	}
 	else if (httpParser.GetUrl().equals("/config")){
 		if (!requestHandler.HandleConfigRequest(httpParser.GetParams(), httpResponse))
 			return false;
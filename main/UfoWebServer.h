@@ -23,6 +23,8 @@ public:
 
 
 private:
+	bool HandleRoute(HttpRequestParser& httpParser, HttpResponse& httpResponse);
+
 	Ufo* mpUfo;
 	DisplayCharter* mpDisplayCharterLevel1;
 	DisplayCharter* mpDisplayCharterLevel2;
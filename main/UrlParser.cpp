@@ -91,6 +91,35 @@ void UrlParser::SignalEnd(){
 	}
 }
 
+void UrlParser::ParseQuery(const char* pQuery, size_t uLength, std::list<TParam>& params){
+	String sUrl; // stays empty, there is no path part
+	TParam* pParam;
+
+	for (size_t u=0 ; u<uLength ; u++){
+		if (pQuery[u] == '?'){
+			pQuery += u + 1;
+			uLength -= u + 1;
+			break;
+		}
+	}
+
+	Init();
+	muState = STATE_UrlComplete;
+	params.emplace_back();
+	pParam = &params.back();
+	for (size_t u=0 ; u<uLength ; u++){
+		ConsumeChar(pQuery[u], sUrl, pParam);
+		switch (muState){
+			case STATE_UrlComplete:
+			case STATE_ParamComplete:
+				params.emplace_back();
+				pParam = &params.back();
+				break;
+		}
+	}
+	SignalEnd();
+}
+
 bool UrlParser::ProcessHash(char c){
 
 	__uint8_t u;
@@ -3,6 +3,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "String.h"
+#include <list>
 
 
 #define MAX_Params		10
@@ -31,6 +32,9 @@ public:
 	void ConsumeChar(char c, String& url, TParam* pParam);
 	void SignalEnd();
 
+	// parses a bare query string ("a=1&b=2", anything up to and including '?' is skipped) into params
+	void ParseQuery(const char* pQuery, size_t uLength, std::list<TParam>& params);
+
 	__uint8_t GetState() { return muState; };
 
 private:
@@ -20,6 +20,7 @@
 #include <netdb.h>
 
 #include "HttpResponseParser.h"
+#include "LatencyHistogram.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
@@ -38,14 +39,40 @@
 #define DEFAULT_MAXRESPONSEDATASIZE 16*1024
 #define RECEIVE_BUFFER_SIZE 2*1024
 
+#define DEFAULT_CONNECTTIMEOUT_MS 10000
+#define DEFAULT_READTIMEOUT_MS 15000
+#define DEFAULT_REQUESTTIMEOUT_MS 60000
+#define POLL_SLICE_MS 250	// granularity for checking deadlines and cancellation while waiting on a socket
+
 static const char LOGTAG[] = "WebClient";
 
+static LatencyHistogram latencyRequest("ufo_http_client_request_seconds", "Outbound HTTP requests including redirects");
+static LatencyHistogram latencyHandshake("ufo_tls_handshake_seconds", "TLS handshakes of outbound HTTPS requests");
+
 WebClient::WebClient() {
   muMaxResponseDataSize = DEFAULT_MAXRESPONSEDATASIZE;
+  muConnectTimeoutMs = DEFAULT_CONNECTTIMEOUT_MS;
+  muReadTimeoutMs = DEFAULT_READTIMEOUT_MS;
+  muRequestTimeoutMs = DEFAULT_REQUESTTIMEOUT_MS;
+  muReceiveBufferSize = RECEIVE_BUFFER_SIZE;
 }
 
 WebClient::~WebClient() {
+	if (mpReceiveBuffer)
+		free(mpReceiveBuffer);
+}
 
+bool WebClient::AllocateReceiveBuffer() {
+	muReceiveBufferAllocations = 0;
+	if (mpReceiveBuffer)
+		return true;
+	mpReceiveBuffer = (char*)malloc(muReceiveBufferSize);
+	if (!mpReceiveBuffer) {
+		ESP_LOGE(LOGTAG, "memory allocation failed (%u)", muReceiveBufferSize);
+		return false;
+	}
+	muReceiveBufferAllocations = 1;
+	return true;
 }
 
 bool WebClient::Prepare(Url* pUrl) {
@@ -73,16 +100,179 @@ bool WebClient::AddHttpHeaderCStr(const char* header) {
 	return true;
 }
 
+bool WebClient::AddRangeHeader(unsigned int uStart, const char* sIfRange) {
+	char sHeader[32];
+	sprintf(sHeader, "Range: bytes=%u-", uStart);
+	mlRequestHeaders.push_back(sHeader);
+	if (sIfRange && *sIfRange) {
+		String sIfRangeHeader = "If-Range: ";
+		sIfRangeHeader += sIfRange;
+		mlRequestHeaders.push_back(sIfRangeHeader);
+	}
+	return true;
+}
+
 void WebClient::SetDownloadHandler(DownAndUploadHandler* pDownloadHandler) {
 	mpDownloadHandler = pDownloadHandler;
 }
 
+void WebClient::SetReceiveBufferSize(unsigned int uReceiveBufferSize) {
+	if (uReceiveBufferSize == muReceiveBufferSize)
+		return;
+	if (mpReceiveBuffer) {
+		free(mpReceiveBuffer);
+		mpReceiveBuffer = NULL;
+	}
+	muReceiveBufferSize = uReceiveBufferSize;
+}
+
+void WebClient::SetTimeouts(unsigned int uConnectTimeoutMs, unsigned int uReadTimeoutMs, unsigned int uRequestTimeoutMs) {
+	muConnectTimeoutMs = uConnectTimeoutMs;
+	muReadTimeoutMs = uReadTimeoutMs;
+	muRequestTimeoutMs = uRequestTimeoutMs;
+}
+
+void WebClient::StartRequest() {
+	muRequestStart = esp_log_timestamp();
+	if (mpCancelToken)
+		muCancelTokenValue = *mpCancelToken;
+}
+
+// @return 0 if the request may go on, 1011 if the overall deadline is exceeded, 1012 if it got cancelled
+unsigned short WebClient::CheckAbort() {
+	if (mpCancelToken && (*mpCancelToken != muCancelTokenValue)) {
+		ESP_LOGW(LOGTAG, "request cancelled");
+		return 1012;
+	}
+	if (muRequestTimeoutMs && (esp_log_timestamp() - muRequestStart >= muRequestTimeoutMs)) {
+		ESP_LOGE(LOGTAG, "request deadline of %u ms exceeded", muRequestTimeoutMs);
+		return 1011;
+	}
+	return 0;
+}
+
+// waits until the socket gets readable/writable - in slices, so cancellation and the overall deadline are noticed in time
+unsigned short WebClient::WaitSocket(int s, bool bWrite, unsigned int uTimeoutMs) {
+	__uint32_t uStart = esp_log_timestamp();
+
+	while (true) {
+		unsigned short uError = CheckAbort();
+		if (uError)
+			return uError;
+		__uint32_t uElapsed = esp_log_timestamp() - uStart;
+		if (uElapsed >= uTimeoutMs) {
+			ESP_LOGE(LOGTAG, "... socket timeout after %u ms", uElapsed);
+			return 1011;
+		}
+		unsigned int uWait = uTimeoutMs - uElapsed;
+		if (uWait > POLL_SLICE_MS)
+			uWait = POLL_SLICE_MS;
+
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(s, &fds);
+		struct timeval tv;
+		tv.tv_sec = uWait / 1000;
+		tv.tv_usec = (uWait % 1000) * 1000;
+		int ret = select(s + 1, bWrite ? NULL : &fds, bWrite ? &fds : NULL, NULL, &tv);
+		if (ret > 0)
+			return 0;
+		if ((ret < 0) && (errno != EINTR)) {
+			ESP_LOGE(LOGTAG, "... select failed errno=%d", errno);
+			return 1008;
+		}
+	}
+}
+
+// resolves the host and connects a non-blocking socket within the connect timeout
+// @return the socket or -1 with ruError set
+int WebClient::Connect(unsigned short& ruError) {
+	struct addrinfo *res;
+	char service[6];
+	sprintf(service, "%i", mpUrl->GetPort());
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	int err = getaddrinfo(mpUrl->GetHost().c_str(), service, &hints, &res);
+
+	if (err != 0 || res == NULL) {
+		ESP_LOGE(LOGTAG, "DNS lookup failed err=%d res=%p", err, res);
+		return ruError = 1003, -1;
+	}
+
+	// Code to print the resolved IP.
+	// Note: inet_ntoa is non-reentrant, look at ipaddr_ntoa_r for "real" code
+	struct in_addr *addr = &((struct sockaddr_in *) res->ai_addr)->sin_addr;
+	ESP_LOGD(LOGTAG, "DNS lookup succeeded. IP=%s", inet_ntoa(*addr));
+
+	// Socket
+	int s = socket(res->ai_family, res->ai_socktype, 0);
+	if (s < 0) {
+		ESP_LOGE(LOGTAG, "... Failed to allocate socket.");
+		freeaddrinfo(res);
+		return ruError = 1004, -1;
+	}
+	ESP_LOGD(LOGTAG, "... allocated socket\r\n");
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+
+	// CONNECT
+	if (connect(s, res->ai_addr, res->ai_addrlen) != 0) {
+		if (errno != EINPROGRESS) {
+			ESP_LOGE(LOGTAG, "... socket connect failed errno=%d", errno);
+			close(s);
+			freeaddrinfo(res);
+			return ruError = 1005, -1;
+		}
+		ruError = WaitSocket(s, true, muConnectTimeoutMs);
+		if (ruError) {
+			close(s);
+			freeaddrinfo(res);
+			return -1;
+		}
+		int iSocketError = 0;
+		socklen_t len = sizeof(iSocketError);
+		getsockopt(s, SOL_SOCKET, SO_ERROR, &iSocketError, &len);
+		if (iSocketError) {
+			ESP_LOGE(LOGTAG, "... socket connect failed errno=%d", iSocketError);
+			close(s);
+			freeaddrinfo(res);
+			return ruError = 1005, -1;
+		}
+	}
+	ESP_LOGD(LOGTAG, "... connected");
+	freeaddrinfo(res);
+	return s;
+}
+
+unsigned short WebClient::Send(int s, const char* pData, unsigned int uLen) {
+	while (uLen) {
+		int ret = write(s, pData, uLen);
+		if (ret < 0) {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+				return 1006;
+			unsigned short uError = WaitSocket(s, true, muReadTimeoutMs);
+			if (uError)
+				return uError;
+			continue;
+		}
+		pData += ret;
+		uLen -= ret;
+	}
+	return 0;
+}
+
 unsigned short WebClient::HttpPost(const char* data, unsigned int size) {
 	if (!data) return 0;
 
 	mpPostData = data;
 	muPostDataSize = size;
-	return HttpExecute();
+	StartRequest();
+	__uint64_t uStart = LatencyHistogram::Start();
+	unsigned short statuscode = HttpExecute();
+	latencyRequest.RecordSince(uStart);
+	return statuscode;
 }
 
 unsigned short WebClient::HttpPost(String& sData) {
@@ -123,15 +313,19 @@ unsigned short WebClient::HttpGet() {
 	
 	if (!mpUrl) return 1001;
 
+	StartRequest();
+	__uint64_t uStart = LatencyHistogram::Start();
 	for (short redirects = 0; redirects < 5; redirects++) {
 		statuscode = HttpExecute();
 		if (statuscode != 302 && statuscode != 301) {
 			ESP_LOGD(LOGTAG, "HttpExecute* finished with %u", mHttpResponseParser.GetStatusCode());
+			latencyRequest.RecordSince(uStart);
 			return statuscode;
 		}
 		mpUrl->Parse(mHttpResponseParser.GetRedirectLocation());
 		ESP_LOGD(LOGTAG, "Redirecting to: %s", mHttpResponseParser.GetRedirectLocation().c_str());
 	}
+	latencyRequest.RecordSince(uStart);
 	return 399; // max redirects exceeded
 
 }
@@ -150,44 +344,10 @@ unsigned short WebClient::HttpExecute() {
 		return HttpExecuteSecure();
 	}
 
-	struct addrinfo *res;
-	char service[6];
-	sprintf(service, "%i", mpUrl->GetPort());
-	struct addrinfo hints;
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
-
-	int err = getaddrinfo(mpUrl->GetHost().c_str(), service, &hints, &res);
-
-	if (err != 0 || res == NULL) {
-		ESP_LOGE(LOGTAG, "DNS lookup failed err=%d res=%p", err, res);
-		return 1003;
-	}
-
-	// Code to print the resolved IP.
-	// Note: inet_ntoa is non-reentrant, look at ipaddr_ntoa_r for "real" code
-	struct in_addr *addr = &((struct sockaddr_in *) res->ai_addr)->sin_addr;
-	ESP_LOGD(LOGTAG, "DNS lookup succeeded. IP=%s", inet_ntoa(*addr));
-
-	// Socket
-	int s = socket(res->ai_family, res->ai_socktype, 0);
-	if (s < 0) {
-		ESP_LOGE(LOGTAG, "... Failed to allocate socket.");
-		freeaddrinfo(res);
-		return 1004;
-	}
-	ESP_LOGD(LOGTAG, "... allocated socket\r\n");
-
-	// CONNECT
-	if (connect(s, res->ai_addr, res->ai_addrlen) != 0) {
-		ESP_LOGE(LOGTAG, "... socket connect failed errno=%d", errno);
-		close(s);
-		freeaddrinfo(res);
-		return 1005;
-	}
-	ESP_LOGD(LOGTAG, "... connected");
-	freeaddrinfo(res);
+	unsigned short uError;
+	int s = Connect(uError);
+	if (s < 0)
+		return uError;
 
 	// Build HTTP Request
 	String sRequest;
@@ -196,19 +356,21 @@ unsigned short WebClient::HttpExecute() {
 
 	// send HTTP request
 	ESP_LOGD(LOGTAG, "sRequest: %s", sRequest.c_str());
-	if (write(s, sRequest.c_str(), sRequest.length()) < 0) {
+	uError = Send(s, sRequest.c_str(), sRequest.length());
+	if (uError) {
 		ESP_LOGE(LOGTAG, "... socket send failed");
 		close(s);
-		return 1006;
+		return uError;
 	}
 	sRequest.clear(); // free memory
 
 
 	if (mpPostData) {
-		if (write(s, mpPostData, muPostDataSize) < 0) {
+		uError = Send(s, mpPostData, muPostDataSize);
+		if (uError) {
 			ESP_LOGE(LOGTAG, "... socket send post data failed");
 			close(s);
-			return 1007;
+			return (uError == 1006) ? 1007 : uError;
 		}
 	}
 
@@ -217,13 +379,27 @@ unsigned short WebClient::HttpExecute() {
 
 	// Read HTTP response
 	mHttpResponseParser.Init(mpDownloadHandler, muMaxResponseDataSize);
+	if (!AllocateReceiveBuffer()) {
+		close(s);
+		return 1009;
+	}
 
-	//char recv_buf[1024];
-	String sReceiveBuf;
-	sReceiveBuf.resize(RECEIVE_BUFFER_SIZE);
 	while (!mHttpResponseParser.ResponseFinished()) {
-		size_t sizeRead = read(s, (char*)sReceiveBuf.c_str(), sReceiveBuf.length());
-		if (!mHttpResponseParser.ParseResponse((char*)sReceiveBuf.c_str(), sizeRead)) {
+		uError = WaitSocket(s, false, muReadTimeoutMs);
+		if (uError) {
+			close(s);
+			return uError;
+		}
+		int iRead = read(s, mpReceiveBuffer, muReceiveBufferSize);
+		if (iRead < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+				continue;
+			ESP_LOGE(LOGTAG, "... socket read failed errno=%d", errno);
+			close(s);
+			return 1008;
+		}
+		// 0 means the connection got closed, the parser finishes the response then
+		if (!mHttpResponseParser.ParseResponse(mpReceiveBuffer, iRead)) {
 			ESP_LOGE(LOGTAG, "HTTP Response error: %d", mHttpResponseParser.GetError());
 			close(s);
 			return 1008;
@@ -242,7 +418,6 @@ unsigned short WebClient::HttpExecuteSecure() {
 	String sRequest;
 
 	char buf[512]; //TODO REMOVE EXTRA LARGE BUFFER AFTER TESTING
-	String sReceiveBuf;
 
 	int ret, flags, len;
 
@@ -253,6 +428,9 @@ unsigned short WebClient::HttpExecuteSecure() {
 	mbedtls_ssl_config conf;
 	mbedtls_net_context server_fd;
 	bool netInitDone = false;
+	unsigned short uError = 0;
+	__uint32_t uLastData;
+	__uint64_t uHandshakeStart;
 
 	mbedtls_ssl_init(&ssl);
 	mbedtls_x509_crt_init(&cacert);
@@ -305,6 +483,8 @@ unsigned short WebClient::HttpExecuteSecure() {
 	mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
 	mbedtls_ssl_conf_ca_chain(&conf, &cacert, NULL);
 	mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+	// reads return MBEDTLS_ERR_SSL_TIMEOUT after a slice, so we can check the deadlines and cancellation
+	mbedtls_ssl_conf_read_timeout(&conf, POLL_SLICE_MS);
 #ifdef CONFIG_MBEDTLS_DEBUG
 	//mbedtls_esp_enable_debug_log(&conf, 4);
 #endif
@@ -320,24 +500,46 @@ unsigned short WebClient::HttpExecuteSecure() {
 
 	ESP_LOGD(LOGTAG, "Connecting to %s:%hu...", mpUrl->GetHost().c_str(), mpUrl->GetPort());
 	ESP_LOGD(LOGTAG, "Port as string '%s'", mpUrl->GetPortAsString().c_str());
-	if ((ret = mbedtls_net_connect(&server_fd, mpUrl->GetHost().c_str(), mpUrl->GetPortAsString().c_str(), MBEDTLS_NET_PROTO_TCP))
-			!= 0) {
-		ESP_LOGE(LOGTAG, "mbedtls_net_connect returned -%x", -ret);
+	// connect ourselves (non-blocking with timeout), mbedtls_net_connect would block without limit
+	server_fd.fd = Connect(uError);
+	if (server_fd.fd < 0) {
+		ret = -1;
 		goto exit;
 	}
+	// the TLS layer works on a blocking socket, reads are bounded by the read timeout and writes by SO_SNDTIMEO
+	mbedtls_net_set_block(&server_fd);
+	{
+		struct timeval tv;
+		tv.tv_sec = muReadTimeoutMs / 1000;
+		tv.tv_usec = (muReadTimeoutMs % 1000) * 1000;
+		setsockopt(server_fd.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	}
 
 	ESP_LOGD(LOGTAG, "Connected.");
 
-	mbedtls_ssl_set_bio(&ssl, &server_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
+	mbedtls_ssl_set_bio(&ssl, &server_fd, mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
 
 	ESP_LOGD(LOGTAG, "Performing the SSL/TLS handshake...");
 
+	uLastData = esp_log_timestamp();
+	uHandshakeStart = LatencyHistogram::Start();
 	while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+		if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+			uError = CheckAbort();
+			if (!uError && (esp_log_timestamp() - uLastData >= muConnectTimeoutMs)) {
+				ESP_LOGE(LOGTAG, "TLS handshake timeout");
+				uError = 1011;
+			}
+			if (uError)
+				goto exit;
+			continue;
+		}
 		if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
 			ESP_LOGE(LOGTAG, "mbedtls_ssl_handshake returned -0x%x", -ret);
 			goto exit;
 		}
 	}
+	latencyHandshake.RecordSince(uHandshakeStart);
 
 	ESP_LOGD(LOGTAG, "Verifying peer X.509 certificate...");
 
@@ -383,22 +585,38 @@ unsigned short WebClient::HttpExecuteSecure() {
 
 	// Read HTTP response
 	mHttpResponseParser.Init(mpDownloadHandler, muMaxResponseDataSize);
-	if (!sReceiveBuf.resize(RECEIVE_BUFFER_SIZE))
-		ESP_LOGE(LOGTAG, "memory allocation failed (%d)", RECEIVE_BUFFER_SIZE);
+	if (!AllocateReceiveBuffer()) {
+		uError = 1009;
+		goto exit;
+	}
 
 	//ESP_LOGI(LOGTAG, "sReceiveBuf.length(%d)", sReceiveBuf.length());
 
 
+	uLastData = esp_log_timestamp();
 	while (!mHttpResponseParser.ResponseFinished()) {
+		// checked on every read, not only on timeouts - a server trickling data must not outlast the deadline
+		uError = CheckAbort();
+		if (uError)
+			goto exit;
 		//ESP_LOGI(LOGTAG, "before ssl_read");
 		//ESP_LOGI(LOGTAG, "sReceiveBuf.length(%d), pointer=%p", sReceiveBuf.length(), sReceiveBuf.c_str());
-		ret = mbedtls_ssl_read(&ssl, (unsigned char*)sReceiveBuf.c_str(), sReceiveBuf.length());
+		ret = mbedtls_ssl_read(&ssl, (unsigned char*)mpReceiveBuffer, muReceiveBufferSize);
 		//ESP_LOGI(LOGTAG, "after ssl_read ret=%d", ret);
 
 
 		if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
 			continue;
 
+		if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+			if (esp_log_timestamp() - uLastData >= muReadTimeoutMs) {
+				ESP_LOGE(LOGTAG, "read timeout");
+				uError = 1011;
+				goto exit;
+			}
+			continue;
+		}
+
 		if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
 			ret = 0;
 			break;
@@ -411,10 +629,12 @@ unsigned short WebClient::HttpExecuteSecure() {
 		}
 
 		len = ret;
+		uLastData = esp_log_timestamp();
 
 		//ESP_LOGI(LOGTAG, "invoking responseparse(buflen=%d)", len);
-		if (!mHttpResponseParser.ParseResponse((char*)sReceiveBuf.c_str(), len)) {
+		if (!mHttpResponseParser.ParseResponse(mpReceiveBuffer, len)) {
 			ESP_LOGE(LOGTAG, "HTTP Error Code: %d", mHttpResponseParser.GetError());
+			uError = 1008;
 			goto exit;
 		}
 		//ESP_LOGI(LOGTAG, "responseparser actual length %d", mHttpResponseParser.GetContentLength());
@@ -433,6 +653,8 @@ exit:
     mbedtls_ctr_drbg_free(&ctr_drbg);
     mbedtls_entropy_free(&entropy);
 
+	if (uError)
+		return uError;
 	if (!mHttpResponseParser.ResponseFinished() && ret != 0) {
 		mbedtls_strerror(ret, buf, 100);
 		ESP_LOGE(LOGTAG, "Last MBEDTLS error was: -0x%x - %s", -ret, buf);
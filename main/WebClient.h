@@ -33,6 +33,13 @@ public:
 	bool AddHttpHeader(String& sHeader);
 	bool AddHttpHeaderCStr(const char* header);
 
+	/*
+	 * Requests the resource from uStart on - the server answers with 206 and a Content-Range header, or
+	 * with 200 and the complete resource if it does not support ranges or if it changed in the meantime
+	 * @param sIfRange - entity tag of the part already received, NULL to skip the check
+	 */
+	bool AddRangeHeader(unsigned int uStart, const char* sIfRange);
+
 
 	/*
 	 * Sets a DownloadHandler for retrieving large responses that do not fit in memory.
@@ -45,6 +52,23 @@ public:
 	void SetDownloadHandler(DownAndUploadHandler* pDownloadHandler);
 
 
+	/*
+	 * Sets the timeouts of the requests (in ms), a request exceeding one of them returns 1011
+	 * @param uConnectTimeoutMs - max. time for establishing the connection (and the TLS handshake)
+	 * @param uReadTimeoutMs - max. time without receiving any data
+	 * @param uRequestTimeoutMs - overall deadline of a request including redirects, 0 for no overall deadline
+	 */
+	void SetTimeouts(unsigned int uConnectTimeoutMs, unsigned int uReadTimeoutMs, unsigned int uRequestTimeoutMs);
+
+
+	/*
+	 * Ties the requests to a token (e.g. the id of the calling task) - as soon as its value changes
+	 * a running request is cancelled and returns 1012
+	 * @param pointer to the token, NULL for no cancellation
+	 */
+	void SetCancelToken(volatile __uint8_t* pToken) { mpCancelToken = pToken; }
+
+
 
 	/*
 	 * executes HTTP(S) GET request
@@ -54,6 +78,7 @@ public:
 	 * @return
 	 * 		- HTTP response status code
 	 * 		- 0 on error
+	 * 		- 1009 if the receive buffer could not be allocated (HTTP and HTTPS), 1011 on timeout, 1012 if cancelled
 	 */
 	unsigned short HttpGet();
 
@@ -93,6 +118,13 @@ public:
 	void SetMaxResponseDataSize(unsigned int maxResponseDataSize) { muMaxResponseDataSize = maxResponseDataSize; }
 
 
+	/*
+	 * size of the buffer the response is read into, default 2kB
+	 * a larger buffer means less reads (and less DownloadHandler calls) for large downloads
+	 */
+	void SetReceiveBufferSize(unsigned int uReceiveBufferSize);
+
+
 	/*
 	 * get a reference to response data
 	 * use GetResponseData().data() for accessing binary data and GetResponseData().size() for its length
@@ -105,6 +137,23 @@ public:
 	 */
 	String& GetContentType() { return mHttpResponseParser.GetContentType(); }
 
+	/*
+	 * @returns the entity tag of the response, an empty string if there was none
+	 */
+	String& GetETag() { return mHttpResponseParser.GetETag(); }
+
+	/*
+	 * range of a 206 response
+	 * @return false if the response has no valid Content-Range header
+	 */
+	bool GetContentRange(unsigned int& ruStart, unsigned int& ruTotal) { return mHttpResponseParser.GetContentRange(ruStart, ruTotal); }
+
+	/*
+	 * copy and allocation statistics of the last request (receive buffer and response body)
+	 */
+	unsigned int GetBytesCopied() { return mHttpResponseParser.GetBytesCopied(); }
+	unsigned int GetAllocations() { return mHttpResponseParser.GetAllocations() + muReceiveBufferAllocations; }
+
 	//TODO: verify server certificates / CA
 
 private:
@@ -120,6 +169,21 @@ private:
 	 */
 	unsigned short HttpExecuteSecure();
 	unsigned int muMaxResponseDataSize;
+	unsigned int muConnectTimeoutMs;
+	unsigned int muReadTimeoutMs;
+	unsigned int muRequestTimeoutMs;
+	volatile __uint8_t* mpCancelToken = NULL;
+	__uint8_t muCancelTokenValue = 0;
+	__uint32_t muRequestStart = 0;
+	void StartRequest();
+	unsigned short CheckAbort();
+	unsigned short WaitSocket(int s, bool bWrite, unsigned int uTimeoutMs);
+	int Connect(unsigned short& ruError);
+	unsigned short Send(int s, const char* pData, unsigned int uLen);
+	char* mpReceiveBuffer = NULL;	// allocated with the first request and reused for all further requests of this client
+	unsigned int muReceiveBufferSize;
+	unsigned int muReceiveBufferAllocations = 0;
+	bool AllocateReceiveBuffer();
 	unsigned short HttpExecute();
 	void PrepareRequest(String& sRequest);
 };
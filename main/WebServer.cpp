@@ -2,6 +2,7 @@
 #include "HttpRequestParser.h"
 #include "HttpResponse.h"
 #include "String.h"
+#include "LatencyHistogram.h"
 #include <lwip/sockets.h>
 #include <esp_log.h>
 #include <esp_system.h>
@@ -17,6 +18,8 @@
 
 static char tag[] = "WebServer";
 
+static LatencyHistogram latencyAccept("ufo_http_tls_accept_seconds", "TLS handshakes of incoming connections");
+
 extern const unsigned char certkey_pem_start[] asm("_binary_certkey_pem_start");
 extern const unsigned char certkey_pem_end[]   asm("_binary_certkey_pem_end");
 unsigned int uWsCertLength = certkey_pem_end - certkey_pem_start;
@@ -226,10 +229,12 @@ void WebServer::WebRequestHandler(int socket, int conNumber){
 		}
 
 		ESP_LOGD(tag, "<%d> Enter SSL_accept", conNumber);
+		__uint64_t uAcceptStart = LatencyHistogram::Start();
 		if (!SSL_accept(ssl)){
 			ESP_LOGW(tag, "<%d> SSL_accept %s", conNumber, strerror(errno));
 			goto EXIT;
 		}
+		latencyAccept.RecordSince(uAcceptStart);
 	}
 	ESP_LOGD(tag, "<%d> Socket Accepted", conNumber);
 	ESP_LOGD(tag, "<%d> WebRequestHandler after - heapfree: %d", conNumber, esp_get_free_heap_size());
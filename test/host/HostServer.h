@@ -0,0 +1,88 @@
+#ifndef TEST_HOST_HOSTSERVER_H_
+#define TEST_HOST_HOSTSERVER_H_
+
+#include "esp_host.h"
+#include <poll.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Local server on loopback answering one request per connection with the given behaviour.
+ * The last request (headers and body as far as Content-Length says) is kept for the test to look at.
+ */
+class HostServer {
+public:
+	HostServer(std::function<void(int)> respond) : HostServer([respond](int s, const std::string&){ respond(s); }) {}
+
+	// the response depends on the request, e.g. on its headers
+	HostServer(std::function<void(int, const std::string&)> respond) : mRespond(respond) {
+		miListen = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(miListen, (struct sockaddr*)&addr, sizeof(addr));
+		socklen_t len = sizeof(addr);
+		getsockname(miListen, (struct sockaddr*)&addr, &len);
+		muPort = ntohs(addr.sin_port);
+		listen(miListen, 4);
+		mThread = std::thread(&HostServer::Serve, this);
+	}
+
+	~HostServer() {
+		shutdown(miListen, SHUT_RDWR);
+		close(miListen);
+		mThread.join();
+	}
+
+	std::string GetRequest() { std::lock_guard<std::mutex> lock(mMutex); return msRequest; }
+
+	std::string Url(const char* sScheme) { return std::string(sScheme) + "://127.0.0.1:" + std::to_string(muPort) + "/test"; }
+
+	// waits until the client closed the connection (at most 5s), a stalling server must not outlive the test
+	static void WaitForClose(int s) {
+		char buf[64];
+		struct pollfd fd = { s, POLLIN, 0 };
+		while ((poll(&fd, 1, 5000) > 0) && (read(s, buf, sizeof(buf)) > 0));
+	}
+
+	static void Send(int s, const std::string& sData) {
+		if (write(s, sData.data(), sData.size()) < 0)
+			return;
+	}
+
+private:
+	void Serve() {
+		int s;
+		while ((s = accept(miListen, NULL, NULL)) >= 0) {
+			std::string sRequest;
+			char buf[256];
+			int iRead;
+			while ((sRequest.find("\r\n\r\n") == std::string::npos) && ((iRead = read(s, buf, sizeof(buf))) > 0))
+				sRequest.append(buf, iRead);
+			size_t uLength = sRequest.find("Content-Length: ");
+			if (uLength != std::string::npos){
+				size_t uEnd = sRequest.find("\r\n\r\n") + 4 + atoi(sRequest.c_str() + uLength + 16);
+				while ((sRequest.size() < uEnd) && ((iRead = read(s, buf, sizeof(buf))) > 0))
+					sRequest.append(buf, iRead);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				msRequest = sRequest;
+			}
+			mRespond(s, sRequest);
+			close(s);
+		}
+	}
+
+	std::function<void(int, const std::string&)> mRespond;
+	std::mutex mMutex;
+	std::string msRequest;
+	int miListen;
+	unsigned short muPort;
+	std::thread mThread;
+};
+
+#endif
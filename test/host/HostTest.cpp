@@ -0,0 +1,51 @@
+#include "HostTest.h"
+#include <signal.h>
+#include <string.h>
+
+static HostTest* gpFirst = NULL;
+static HostTest* gpLast = NULL;
+static unsigned int guFailures = 0;
+
+
+HostTest::HostTest(const char* sName, THostTestFunction pFunction, bool bBenchmark) {
+	msName = sName;
+	mpFunction = pFunction;
+	mbBenchmark = bBenchmark;
+	mpNext = NULL;
+	if (gpLast)
+		gpLast->mpNext = this;
+	else
+		gpFirst = this;
+	gpLast = this;
+}
+
+void HostTest::Fail(const char* sFile, int iLine, const char* sExpression) {
+	printf("%s:%d: CHECK(%s) failed\n", sFile, iLine, sExpression);
+	guFailures++;
+}
+
+int HostTest::RunAll(bool bBenchmarks) {
+	unsigned int uTests = 0;
+	unsigned int uFailedTests = 0;
+	for (HostTest* p = gpFirst; p; p = p->mpNext) {
+		if (p->mbBenchmark != bBenchmarks)
+			continue;
+		unsigned int uFailures = guFailures;
+		p->mpFunction();
+		uTests++;
+		if (guFailures != uFailures) {
+			uFailedTests++;
+			printf("FAILED %s\n", p->msName);
+		}
+		else
+			printf("ok     %s\n", p->msName);
+	}
+	printf("%u of %u tests failed\n", uFailedTests, uTests);
+	return uFailedTests ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+	// lwip reports writes to closed sockets as errors, it has no SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+	return HostTest::RunAll((argc > 1) && !strcmp(argv[1], "--bench"));
+}
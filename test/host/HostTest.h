@@ -0,0 +1,41 @@
+#ifndef TEST_HOST_HOSTTEST_H_
+#define TEST_HOST_HOSTTEST_H_
+
+#include <stdio.h>
+
+/*
+ * Minimal test registry for the host tests: every TEST() runs once from main(),
+ * a failing CHECK() is reported with its location and makes the binary exit non-zero.
+ * BENCH() registers a benchmark instead, benchmarks only run with --bench (make bench) and report their own numbers.
+ */
+
+typedef void (*THostTestFunction)();
+
+class HostTest {
+public:
+	HostTest(const char* sName, THostTestFunction pFunction, bool bBenchmark = false);
+
+	static int RunAll(bool bBenchmarks);
+	static void Fail(const char* sFile, int iLine, const char* sExpression);
+
+private:
+	const char* msName;
+	THostTestFunction mpFunction;
+	bool mbBenchmark;
+	HostTest* mpNext;
+};
+
+#define TEST(name) \
+	static void name(); \
+	static HostTest hostTest_##name(#name, name); \
+	static void name()
+
+#define BENCH(name) \
+	static void name(); \
+	static HostTest hostBench_##name(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) HostTest::Fail(__FILE__, __LINE__, #expression); } while (0)
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * DotstarStripe stand-in for the host tests: keeps the colors, Show() does not bit-bang the GPIOs.
+ */
+#include "esp_host.h"
+#include "DotstarStripe.h"
+
+DotstarStripe::DotstarStripe(__uint8_t count, gpio_num_t cl, gpio_num_t dt) {
+	clock = cl;
+	data = dt;
+	ledCount = count;
+	startPos = 0;
+	colorRed = (__uint8_t*)malloc(count);
+	colorGreen = (__uint8_t*)malloc(count);
+	colorBlue = (__uint8_t*)malloc(count);
+	InitColor(0, 0, 0);
+}
+
+DotstarStripe::~DotstarStripe() {
+	free(colorRed);
+	free(colorGreen);
+	free(colorBlue);
+}
+
+void DotstarStripe::InitColor(__uint8_t r, __uint8_t g, __uint8_t b){
+	for (__uint8_t i=0 ; i<ledCount ; i++){
+		colorRed[i] = r;
+		colorGreen[i] = g;
+		colorBlue[i] = b;
+	}
+}
+
+void DotstarStripe::SetLeds(__uint8_t pos, __uint8_t count, __uint8_t r, __uint8_t g, __uint8_t b){
+	if (count > ledCount)
+		count = ledCount;
+	for (__uint8_t i=0 ; i<count ; i++){
+		__uint8_t p = (pos + i) % ledCount;
+		colorRed[p] = r;
+		colorGreen[p] = g;
+		colorBlue[p] = b;
+	}
+}
+
+void DotstarStripe::Show(){
+}
+
+void DotstarStripe::SendByte(__uint8_t out){
+}
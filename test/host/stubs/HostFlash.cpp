@@ -0,0 +1,166 @@
+/*
+ * In-memory flash and OTA stand-in for the host tests, see HostFlash.h
+ */
+#include "esp_host.h"
+#include "HostFlash.h"
+#include <mutex>
+#include <unistd.h>
+
+#define PARTITION_SIZE	(1600 * 1024)
+#define IMAGE_MAGIC		0xE9
+
+static const esp_partition_t gPartitions[2] = {
+	{ ESP_PARTITION_TYPE_APP, 0x10, 0x10000, PARTITION_SIZE, "ota_0", false },
+	{ ESP_PARTITION_TYPE_APP, 0x11, 0x10000 + PARTITION_SIZE, PARTITION_SIZE, "ota_1", false },
+};
+
+static std::mutex gMutex;
+static std::string gFlash[2];
+static int giBoot = 0;
+static bool gbUpdateBooted = false;
+static esp_ota_handle_t guOtaHandle = 0;
+static size_t guOtaLength = 0;
+static size_t guWritten = 0;
+static size_t guFailAfter = 0;
+static size_t guWriteRate = 0;
+
+
+static int HostFlashIndex(const esp_partition_t* pPartition){
+	return (pPartition == &gPartitions[1]) ? 1 : ((pPartition == &gPartitions[0]) ? 0 : -1);
+}
+
+// NOR flash can only clear bits
+static esp_err_t HostFlashProgram(int iIndex, size_t uOffset, const void* pData, size_t uSize){
+	if ((iIndex < 0) || (uOffset + uSize > PARTITION_SIZE))
+		return ESP_ERR_INVALID_ARG;
+	if (guFailAfter && (guWritten + uSize > guFailAfter))
+		return ESP_FAIL;
+	guWritten += uSize;
+	for (size_t u = 0; u < uSize; u++)
+		gFlash[iIndex][uOffset + u] &= ((const char*)pData)[u];
+	if (guWriteRate)
+		usleep(uSize * 1000000ull / guWriteRate);
+	return ESP_OK;
+}
+
+
+void HostFlashReset(const std::string& sRunningImage){
+	std::lock_guard<std::mutex> lock(gMutex);
+	for (int i = 0; i < 2; i++)
+		gFlash[i].assign(PARTITION_SIZE, (char)0xff);
+	gFlash[0].replace(0, sRunningImage.size(), sRunningImage);
+	giBoot = 0;
+	gbUpdateBooted = false;
+	guOtaHandle = 0;
+	guOtaLength = 0;
+	guWritten = 0;
+	guFailAfter = 0;
+	guWriteRate = 0;
+}
+
+std::string HostFlashGetUpdate(size_t uLength){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return gFlash[1].substr(0, uLength);
+}
+
+size_t HostFlashGetOtaLength(){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return guOtaLength;
+}
+
+bool HostFlashIsUpdateBooted(){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return gbUpdateBooted;
+}
+
+void HostFlashFailWritesAfter(size_t uBytes){
+	std::lock_guard<std::mutex> lock(gMutex);
+	guWritten = 0;
+	guFailAfter = uBytes;
+}
+
+
+void HostFlashSetWriteRate(size_t uBytesPerSecond){
+	std::lock_guard<std::mutex> lock(gMutex);
+	guWriteRate = uBytesPerSecond;
+}
+
+
+const esp_partition_t* esp_ota_get_boot_partition(){
+	return &gPartitions[giBoot];
+}
+
+const esp_partition_t* esp_ota_get_running_partition(){
+	return &gPartitions[0];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* pStart){
+	return &gPartitions[1];
+}
+
+// an unknown size erases the whole partition, like on the target
+esp_err_t esp_ota_begin(const esp_partition_t* pPartition, size_t uImageSize, esp_ota_handle_t* pHandle){
+	std::lock_guard<std::mutex> lock(gMutex);
+	int iIndex = HostFlashIndex(pPartition);
+	if (iIndex != 1)
+		return ESP_ERR_INVALID_ARG;
+	size_t uErase = (uImageSize == OTA_SIZE_UNKNOWN) ? PARTITION_SIZE : ((uImageSize + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE);
+	gFlash[iIndex].replace(0, uErase, uErase, (char)0xff);
+	guOtaLength = 0;
+	*pHandle = ++guOtaHandle;
+	return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t h, const void* pData, size_t uSize){
+	std::lock_guard<std::mutex> lock(gMutex);
+	if (!h || (h != guOtaHandle))
+		return ESP_ERR_INVALID_ARG;
+	esp_err_t err = HostFlashProgram(1, guOtaLength, pData, uSize);
+	if (err == ESP_OK)
+		guOtaLength += uSize;
+	return err;
+}
+
+// the image is validated (here only its magic byte) and the handle is released
+esp_err_t esp_ota_end(esp_ota_handle_t h){
+	std::lock_guard<std::mutex> lock(gMutex);
+	if (!h || (h != guOtaHandle))
+		return ESP_ERR_INVALID_ARG;
+	guOtaHandle++;
+	if (!guOtaLength || ((__uint8_t)gFlash[1][0] != IMAGE_MAGIC))
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* pPartition){
+	std::lock_guard<std::mutex> lock(gMutex);
+	int iIndex = HostFlashIndex(pPartition);
+	if ((iIndex < 0) || ((__uint8_t)gFlash[iIndex][0] != IMAGE_MAGIC))
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	giBoot = iIndex;
+	gbUpdateBooted = (iIndex == 1);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* pPartition, size_t uOffset, void* pDst, size_t uSize){
+	std::lock_guard<std::mutex> lock(gMutex);
+	int iIndex = HostFlashIndex(pPartition);
+	if ((iIndex < 0) || (uOffset + uSize > PARTITION_SIZE))
+		return ESP_ERR_INVALID_ARG;
+	memcpy(pDst, gFlash[iIndex].data() + uOffset, uSize);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* pPartition, size_t uOffset, const void* pSrc, size_t uSize){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return HostFlashProgram(HostFlashIndex(pPartition), uOffset, pSrc, uSize);
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* pPartition, size_t uOffset, size_t uSize){
+	std::lock_guard<std::mutex> lock(gMutex);
+	int iIndex = HostFlashIndex(pPartition);
+	if ((iIndex < 0) || (uOffset % SPI_FLASH_SEC_SIZE) || (uSize % SPI_FLASH_SEC_SIZE) || (uOffset + uSize > PARTITION_SIZE))
+		return ESP_ERR_INVALID_ARG;
+	gFlash[iIndex].replace(uOffset, uSize, uSize, (char)0xff);
+	return ESP_OK;
+}
@@ -0,0 +1,30 @@
+#ifndef TEST_HOST_HOSTFLASH_H_
+#define TEST_HOST_HOSTFLASH_H_
+
+#include <string>
+
+/*
+ * In-memory flash with the two OTA app partitions of partitions.csv. Writes behave like
+ * NOR flash (bits can only be cleared, erases work on whole sectors), so writing into
+ * flash that was not erased corrupts the data just like on the target.
+ */
+
+// erases both partitions, boots from ota_0 and puts the given image into it
+void HostFlashReset(const std::string& sRunningImage);
+
+// content of the update partition (ota_1) - the first uLength bytes
+std::string HostFlashGetUpdate(size_t uLength);
+
+// length of the image passed to esp_ota_write() since the last esp_ota_begin()
+size_t HostFlashGetOtaLength();
+
+// true once esp_ota_set_boot_partition() selected the update partition
+bool HostFlashIsUpdateBooted();
+
+// lets esp_ota_write()/esp_partition_write() fail after the given number of bytes (0 = never)
+void HostFlashFailWritesAfter(size_t uBytes);
+
+// slows the writes down to the given rate like the flash of the target (0 = as fast as possible)
+void HostFlashSetWriteRate(size_t uBytesPerSecond);
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * cJSON stand-in for the host tests, see cJSON.h
+ */
+#include "cJSON.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char* ParseValue(cJSON* item, const char* p);
+
+static const char* Skip(const char* p){
+	while (p && *p && isspace((unsigned char)*p))
+		p++;
+	return p;
+}
+
+static const char* ParseString(char** ps, const char* p){
+	if (*p != '"')
+		return NULL;
+	p++;
+	char* s = malloc(strlen(p) + 1);
+	size_t u = 0;
+	while (*p && (*p != '"')){
+		if (*p == '\\'){
+			p++;
+			switch (*p){
+				case 'n': s[u++] = '\n'; break;
+				case 't': s[u++] = '\t'; break;
+				case 'r': s[u++] = '\r'; break;
+				case 'b': s[u++] = '\b'; break;
+				case 'f': s[u++] = '\f'; break;
+				case '\0': free(s); return NULL;
+				default: s[u++] = *p; break;
+			}
+			p++;
+		}
+		else
+			s[u++] = *p++;
+	}
+	if (*p != '"')
+		return free(s), NULL;
+	s[u] = 0;
+	*ps = s;
+	return p + 1;
+}
+
+static const char* ParseItems(cJSON* item, const char* p, char cEnd, int bNamed){
+	cJSON* last = NULL;
+	p = Skip(p + 1);
+	if (*p == cEnd)
+		return p + 1;
+	while (1){
+		cJSON* child = calloc(1, sizeof(cJSON));
+		if (last){
+			last->next = child;
+			child->prev = last;
+		}
+		else
+			item->child = child;
+		last = child;
+		if (bNamed){
+			p = ParseString(&child->string, Skip(p));
+			if (!p)
+				return NULL;
+			p = Skip(p);
+			if (*p != ':')
+				return NULL;
+			p++;
+		}
+		p = ParseValue(child, Skip(p));
+		if (!p)
+			return NULL;
+		p = Skip(p);
+		if (*p == cEnd)
+			return p + 1;
+		if (*p != ',')
+			return NULL;
+		p++;
+	}
+}
+
+static const char* ParseValue(cJSON* item, const char* p){
+	if (!strncmp(p, "null", 4))
+		return item->type = cJSON_NULL, p + 4;
+	if (!strncmp(p, "false", 5))
+		return item->type = cJSON_False, p + 5;
+	if (!strncmp(p, "true", 4))
+		return item->type = cJSON_True, item->valueint = 1, p + 4;
+	if (*p == '"')
+		return item->type = cJSON_String, ParseString(&item->valuestring, p);
+	if (*p == '[')
+		return item->type = cJSON_Array, ParseItems(item, p, ']', 0);
+	if (*p == '{')
+		return item->type = cJSON_Object, ParseItems(item, p, '}', 1);
+	if ((*p == '-') || isdigit((unsigned char)*p)){
+		char* pEnd;
+		item->type = cJSON_Number;
+		item->valuedouble = strtod(p, &pEnd);
+		item->valueint = (int)item->valuedouble;
+		return pEnd;
+	}
+	return NULL;
+}
+
+cJSON* cJSON_Parse(const char* value){
+	cJSON* item = calloc(1, sizeof(cJSON));
+	const char* p = ParseValue(item, Skip(value));
+	if (!p || *Skip(p))
+		return cJSON_Delete(item), NULL;
+	return item;
+}
+
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string){
+	cJSON* child = object ? object->child : NULL;
+	while (child && (!child->string || strcasecmp(child->string, string)))
+		child = child->next;
+	return child;
+}
+
+static void Print(const cJSON* item, char** ps, size_t* puLen){
+	FILE* f = open_memstream(ps, puLen);
+	switch (item->type){
+		case cJSON_NULL: fputs("null", f); break;
+		case cJSON_False: fputs("false", f); break;
+		case cJSON_True: fputs("true", f); break;
+		case cJSON_Number: fprintf(f, "%g", item->valuedouble); break;
+		case cJSON_String: fprintf(f, "\"%s\"", item->valuestring); break;
+		default:
+			fputc((item->type == cJSON_Array) ? '[' : '{', f);
+			for (cJSON* child = item->child; child; child = child->next){
+				char* s;
+				size_t u;
+				if (child != item->child)
+					fputc(',', f);
+				if (item->type == cJSON_Object)
+					fprintf(f, "\"%s\":", child->string);
+				Print(child, &s, &u);
+				fputs(s, f);
+				free(s);
+			}
+			fputc((item->type == cJSON_Array) ? ']' : '}', f);
+			break;
+	}
+	fclose(f);
+}
+
+char* cJSON_Print(const cJSON* item){
+	char* s;
+	size_t u;
+	Print(item, &s, &u);
+	return s;
+}
+
+void cJSON_Delete(cJSON* item){
+	while (item){
+		cJSON* next = item->next;
+		cJSON_Delete(item->child);
+		free(item->valuestring);
+		free(item->string);
+		free(item);
+		item = next;
+	}
+}
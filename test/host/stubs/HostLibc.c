@@ -0,0 +1,12 @@
+/*
+ * newlib functions the firmware relies on that glibc does not have
+ */
+#include "stdlib_noniso.h"
+
+char* itoa(int value, char* result, int base){
+	return ltoa(value, result, base);
+}
+
+char* utoa(unsigned int value, char* result, int base){
+	return ultoa(value, result, base);
+}
@@ -0,0 +1,236 @@
+/*
+ * In-memory NVS stand-in for the host tests, see HostNvs.h
+ */
+#include "esp_host.h"
+#include "HostNvs.h"
+#include <map>
+#include <mutex>
+#include <string>
+
+#define NVS_KEY_MAX_LENGTH		15
+#define NVS_VALUE_MAX_LENGTH	1984
+
+typedef enum { NVS_TYPE_I8, NVS_TYPE_U8, NVS_TYPE_U16, NVS_TYPE_I32, NVS_TYPE_U32, NVS_TYPE_STR, NVS_TYPE_BLOB } THostNvsType;
+
+typedef struct {
+	THostNvsType type;
+	std::string sData;
+} THostNvsEntry;
+
+typedef struct {
+	std::string sNamespace;
+	nvs_open_mode mode;
+} THostNvsHandle;
+
+static std::mutex gMutex;
+static std::map< std::string, std::map<std::string, THostNvsEntry> > gNamespaces;
+static std::map<nvs_handle, THostNvsHandle> gHandles;
+static nvs_handle guNextHandle = 1;
+static unsigned int guWrites = 0;
+static unsigned int guFailAfter = 0;
+static unsigned int guWrittenBeforeFail = 0;
+
+
+void HostNvsReset(){
+	std::lock_guard<std::mutex> lock(gMutex);
+	gNamespaces.clear();
+	guWrites = 0;
+	guFailAfter = 0;
+}
+
+unsigned int HostNvsGetWrites(){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return guWrites;
+}
+
+int HostNvsGetOpenHandles(){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return gHandles.size();
+}
+
+void HostNvsFailWritesAfter(unsigned int uWrites){
+	std::lock_guard<std::mutex> lock(gMutex);
+	guWrittenBeforeFail = 0;
+	guFailAfter = uWrites;
+}
+
+// counts the writes until a set/erase fails, like the power getting lost
+static bool HostNvsWriteFails(){
+	if (!guFailAfter)
+		return false;
+	if (guWrittenBeforeFail >= guFailAfter)
+		return true;
+	guWrittenBeforeFail++;
+	return false;
+}
+
+bool HostNvsExists(const char* sNamespace, const char* sKey){
+	std::lock_guard<std::mutex> lock(gMutex);
+	auto ns = gNamespaces.find(sNamespace);
+	return (ns != gNamespaces.end()) && ns->second.count(sKey);
+}
+
+
+static esp_err_t HostNvsSet(nvs_handle h, const char* sKey, THostNvsType type, const void* pData, size_t uLength){
+	std::lock_guard<std::mutex> lock(gMutex);
+	auto handle = gHandles.find(h);
+	if (handle == gHandles.end())
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	if (handle->second.mode == NVS_READONLY)
+		return ESP_ERR_NVS_READ_ONLY;
+	if (strlen(sKey) > NVS_KEY_MAX_LENGTH)
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	if (uLength > NVS_VALUE_MAX_LENGTH)
+		return ESP_ERR_NVS_VALUE_TOO_LONG;
+	if (HostNvsWriteFails())
+		return ESP_FAIL;
+	THostNvsEntry& rEntry = gNamespaces[handle->second.sNamespace][sKey];
+	rEntry.type = type;
+	rEntry.sData.assign((const char*)pData, uLength);
+	guWrites++;
+	return ESP_OK;
+}
+
+// a NULL destination only queries the length, like nvs_get_str/nvs_get_blob
+static esp_err_t HostNvsGet(nvs_handle h, const char* sKey, THostNvsType type, void* pData, uint32_t* pLength){
+	std::lock_guard<std::mutex> lock(gMutex);
+	auto handle = gHandles.find(h);
+	if (handle == gHandles.end())
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	auto ns = gNamespaces.find(handle->second.sNamespace);
+	if (ns == gNamespaces.end())
+		return ESP_ERR_NVS_NOT_FOUND;
+	auto entry = ns->second.find(sKey);
+	if ((entry == ns->second.end()) || (entry->second.type != type))
+		return ESP_ERR_NVS_NOT_FOUND;
+	const std::string& rData = entry->second.sData;
+	if (!pData){
+		*pLength = rData.size();
+		return ESP_OK;
+	}
+	if (*pLength < rData.size())
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	memcpy(pData, rData.data(), rData.size());
+	*pLength = rData.size();
+	return ESP_OK;
+}
+
+template <typename T> static esp_err_t HostNvsGetScalar(nvs_handle h, const char* sKey, THostNvsType type, T* pValue){
+	uint32_t uLength = sizeof(T);
+	return HostNvsGet(h, sKey, type, pValue, &uLength);
+}
+
+
+esp_err_t nvs_flash_init(){
+	return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* sNamespace, nvs_open_mode mode, nvs_handle* pHandle){
+	std::lock_guard<std::mutex> lock(gMutex);
+	if (strlen(sNamespace) > NVS_KEY_MAX_LENGTH)
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	if ((mode == NVS_READONLY) && !gNamespaces.count(sNamespace))
+		return ESP_ERR_NVS_NOT_FOUND;
+	gNamespaces[sNamespace];
+	*pHandle = guNextHandle++;
+	gHandles[*pHandle] = { sNamespace, mode };
+	return ESP_OK;
+}
+
+void nvs_close(nvs_handle h){
+	std::lock_guard<std::mutex> lock(gMutex);
+	gHandles.erase(h);
+}
+
+esp_err_t nvs_commit(nvs_handle h){
+	std::lock_guard<std::mutex> lock(gMutex);
+	return gHandles.count(h) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_erase_all(nvs_handle h){
+	std::lock_guard<std::mutex> lock(gMutex);
+	auto handle = gHandles.find(h);
+	if (handle == gHandles.end())
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	if (handle->second.mode == NVS_READONLY)
+		return ESP_ERR_NVS_READ_ONLY;
+	if (HostNvsWriteFails())
+		return ESP_FAIL;
+	gNamespaces[handle->second.sNamespace].clear();
+	guWrites++;
+	return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle h, const char* sKey){
+	std::lock_guard<std::mutex> lock(gMutex);
+	auto handle = gHandles.find(h);
+	if (handle == gHandles.end())
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	if (handle->second.mode == NVS_READONLY)
+		return ESP_ERR_NVS_READ_ONLY;
+	auto& rNamespace = gNamespaces[handle->second.sNamespace];
+	if (!rNamespace.count(sKey))
+		return ESP_ERR_NVS_NOT_FOUND;
+	if (HostNvsWriteFails())
+		return ESP_FAIL;
+	rNamespace.erase(sKey);
+	guWrites++;
+	return ESP_OK;
+}
+
+// strings are stored with their terminating zero, the reported length includes it
+esp_err_t nvs_get_str(nvs_handle h, const char* sKey, char* sValue, uint32_t* pLength){
+	return HostNvsGet(h, sKey, NVS_TYPE_STR, sValue, pLength);
+}
+
+esp_err_t nvs_set_str(nvs_handle h, const char* sKey, const char* sValue){
+	return HostNvsSet(h, sKey, NVS_TYPE_STR, sValue, strlen(sValue) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle h, const char* sKey, void* pValue, uint32_t* pLength){
+	return HostNvsGet(h, sKey, NVS_TYPE_BLOB, pValue, pLength);
+}
+
+esp_err_t nvs_set_blob(nvs_handle h, const char* sKey, const void* pValue, size_t uLength){
+	return HostNvsSet(h, sKey, NVS_TYPE_BLOB, pValue, uLength);
+}
+
+esp_err_t nvs_get_i8(nvs_handle h, const char* sKey, int8_t* pValue){
+	return HostNvsGetScalar(h, sKey, NVS_TYPE_I8, pValue);
+}
+
+esp_err_t nvs_set_i8(nvs_handle h, const char* sKey, int8_t iValue){
+	return HostNvsSet(h, sKey, NVS_TYPE_I8, &iValue, sizeof(iValue));
+}
+
+esp_err_t nvs_get_u8(nvs_handle h, const char* sKey, uint8_t* pValue){
+	return HostNvsGetScalar(h, sKey, NVS_TYPE_U8, pValue);
+}
+
+esp_err_t nvs_set_u8(nvs_handle h, const char* sKey, uint8_t uValue){
+	return HostNvsSet(h, sKey, NVS_TYPE_U8, &uValue, sizeof(uValue));
+}
+
+esp_err_t nvs_get_u16(nvs_handle h, const char* sKey, uint16_t* pValue){
+	return HostNvsGetScalar(h, sKey, NVS_TYPE_U16, pValue);
+}
+
+esp_err_t nvs_set_u16(nvs_handle h, const char* sKey, uint16_t uValue){
+	return HostNvsSet(h, sKey, NVS_TYPE_U16, &uValue, sizeof(uValue));
+}
+
+esp_err_t nvs_get_i32(nvs_handle h, const char* sKey, int32_t* pValue){
+	return HostNvsGetScalar(h, sKey, NVS_TYPE_I32, pValue);
+}
+
+esp_err_t nvs_set_i32(nvs_handle h, const char* sKey, int32_t iValue){
+	return HostNvsSet(h, sKey, NVS_TYPE_I32, &iValue, sizeof(iValue));
+}
+
+esp_err_t nvs_get_u32(nvs_handle h, const char* sKey, uint32_t* pValue){
+	return HostNvsGetScalar(h, sKey, NVS_TYPE_U32, pValue);
+}
+
+esp_err_t nvs_set_u32(nvs_handle h, const char* sKey, uint32_t uValue){
+	return HostNvsSet(h, sKey, NVS_TYPE_U32, &uValue, sizeof(uValue));
+}
@@ -0,0 +1,25 @@
+#ifndef TEST_HOST_HOSTNVS_H_
+#define TEST_HOST_HOSTNVS_H_
+
+/*
+ * In-memory NVS for the host tests. It keeps namespaces and value types apart and applies
+ * the limits of the target (15 character keys, ~1984 byte strings and blobs), every
+ * set/erase counts as one flash write.
+ */
+
+// drops all namespaces and resets the counters
+void HostNvsReset();
+
+// number of set/erase operations since the last reset
+unsigned int HostNvsGetWrites();
+
+// lets every set/erase fail after the given number of further writes (0 = never)
+void HostNvsFailWritesAfter(unsigned int uWrites);
+
+// number of handles currently open
+int HostNvsGetOpenHandles();
+
+// true if the key exists in the namespace (of any type)
+bool HostNvsExists(const char* sNamespace, const char* sKey);
+
+#endif
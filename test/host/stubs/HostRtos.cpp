@@ -0,0 +1,214 @@
+/*
+ * FreeRTOS stand-in for the host tests: tasks are detached threads, queues and
+ * semaphores block like their FreeRTOS counterparts (including timeouts) and the
+ * critical sections of all tasks share one recursive lock.
+ */
+#include "esp_host.h"
+#include "HostRtos.h"
+#include <pthread.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct {
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque< std::vector<char> > items;
+	size_t uItemSize;
+	size_t uCapacity;
+} THostQueue;
+
+typedef struct {
+	TaskFunction_t pFunction;
+	void* pParam;
+} THostTask;
+
+static std::recursive_mutex gCriticalSection;
+static std::mutex gNotifyLock;
+static std::condition_variable gNotified;
+static std::map<TaskHandle_t, uint32_t> gNotifications;
+static unsigned int guTimeScale = 100;
+static thread_local bool gbTaskThread = false;
+static const std::chrono::steady_clock::time_point gStart = std::chrono::steady_clock::now();
+
+
+void HostRtosSetTimeScale(unsigned int uPercent){
+	guTimeScale = uPercent;
+}
+
+
+void vPortCPUAcquireMutex(portMUX_TYPE* pMux){
+	gCriticalSection.lock();
+	pMux->iCount++;
+}
+
+void vPortCPUReleaseMutex(portMUX_TYPE* pMux){
+	pMux->iCount--;
+	gCriticalSection.unlock();
+}
+
+
+static void* HostTaskThread(void* pvParameter){
+	THostTask* pTask = (THostTask*)pvParameter;
+	gbTaskThread = true;
+	pTask->pFunction(pTask->pParam);
+	delete pTask;
+	return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pFunction, const char* sName, uint32_t uStackDepth, void* pParam, UBaseType_t uPriority, TaskHandle_t* pHandle){
+	return xTaskCreatePinnedToCore(pFunction, sName, uStackDepth, pParam, uPriority, pHandle, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pFunction, const char* sName, uint32_t uStackDepth, void* pParam, UBaseType_t uPriority, TaskHandle_t* pHandle, BaseType_t iCore){
+	THostTask* pTask = new THostTask;
+	pTask->pFunction = pFunction;
+	pTask->pParam = pParam;
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, HostTaskThread, pTask))
+		return delete pTask, pdFAIL;
+	pthread_detach(thread);
+	if (pHandle)
+		*pHandle = (TaskHandle_t)thread;
+	return pdPASS;
+}
+
+// a task deleting itself does not return - like on the target
+void vTaskDelete(TaskHandle_t hTask){
+	if (!hTask && gbTaskThread)
+		pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t uTicks){
+	std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)uTicks * portTICK_PERIOD_MS * 10 * guTimeScale));
+}
+
+TickType_t xTaskGetTickCount(){
+	return (TickType_t)(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - gStart).count() / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(){
+	return (TaskHandle_t)pthread_self();
+}
+
+// the notification value of a task used as counting semaphore, like xTaskNotifyGive/ulTaskNotifyTake do it
+BaseType_t xTaskNotifyGive(TaskHandle_t hTask){
+	std::unique_lock<std::mutex> lock(gNotifyLock);
+	gNotifications[hTask]++;
+	gNotified.notify_all();
+	return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t bClearCountOnExit, TickType_t uTicks){
+	TaskHandle_t hTask = xTaskGetCurrentTaskHandle();
+	std::unique_lock<std::mutex> lock(gNotifyLock);
+	auto notified = [hTask]{ return gNotifications[hTask] > 0; };
+	if (uTicks == portMAX_DELAY)
+		gNotified.wait(lock, notified);
+	else if (!gNotified.wait_for(lock, std::chrono::microseconds((uint64_t)uTicks * portTICK_PERIOD_MS * 10 * guTimeScale), notified))
+		return 0;
+	uint32_t uValue = gNotifications[hTask];
+	gNotifications[hTask] = bClearCountOnExit ? 0 : uValue - 1;
+	return uValue;
+}
+
+
+// waits until the predicate holds - portMAX_DELAY blocks forever, 0 does not block at all
+template <typename Predicate> static bool HostWait(THostQueue* pQueue, std::unique_lock<std::mutex>& rLock, TickType_t uTicks, Predicate predicate){
+	if (uTicks == portMAX_DELAY){
+		pQueue->changed.wait(rLock, predicate);
+		return true;
+	}
+	return pQueue->changed.wait_for(rLock, std::chrono::milliseconds((uint64_t)uTicks * portTICK_PERIOD_MS), predicate);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uLength, UBaseType_t uItemSize){
+	THostQueue* pQueue = new THostQueue;
+	pQueue->uItemSize = uItemSize;
+	pQueue->uCapacity = uLength;
+	return pQueue;
+}
+
+static BaseType_t HostQueueSend(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks, bool bFront){
+	THostQueue* pQueue = (THostQueue*)hQueue;
+	std::unique_lock<std::mutex> lock(pQueue->mutex);
+	if (!HostWait(pQueue, lock, uTicks, [pQueue]{ return pQueue->items.size() < pQueue->uCapacity; }))
+		return errQUEUE_FULL;
+	std::vector<char> item((const char*)pItem, (const char*)pItem + pQueue->uItemSize);
+	if (bFront)
+		pQueue->items.push_front(item);
+	else
+		pQueue->items.push_back(item);
+	pQueue->changed.notify_all();
+	return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks){
+	return HostQueueSend(hQueue, pItem, uTicks, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks){
+	return HostQueueSend(hQueue, pItem, uTicks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks){
+	return HostQueueSend(hQueue, pItem, uTicks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t hQueue, void* pItem, TickType_t uTicks){
+	THostQueue* pQueue = (THostQueue*)hQueue;
+	std::unique_lock<std::mutex> lock(pQueue->mutex);
+	if (!HostWait(pQueue, lock, uTicks, [pQueue]{ return !pQueue->items.empty(); }))
+		return pdFALSE;
+	if (pQueue->uItemSize)
+		memcpy(pItem, pQueue->items.front().data(), pQueue->uItemSize);
+	pQueue->items.pop_front();
+	pQueue->changed.notify_all();
+	return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t hQueue){
+	THostQueue* pQueue = (THostQueue*)hQueue;
+	std::unique_lock<std::mutex> lock(pQueue->mutex);
+	return pQueue->items.size();
+}
+
+BaseType_t xQueueReset(QueueHandle_t hQueue){
+	THostQueue* pQueue = (THostQueue*)hQueue;
+	std::unique_lock<std::mutex> lock(pQueue->mutex);
+	pQueue->items.clear();
+	pQueue->changed.notify_all();
+	return pdPASS;
+}
+
+void vQueueDelete(QueueHandle_t hQueue){
+	delete (THostQueue*)hQueue;
+}
+
+
+// semaphores are queues of empty items, like in FreeRTOS
+SemaphoreHandle_t xSemaphoreCreateBinary(){
+	return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(){
+	SemaphoreHandle_t h = xQueueCreate(1, 0);
+	xQueueSend(h, NULL, 0);
+	return h;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t hSemaphore, TickType_t uTicks){
+	return xQueueReceive(hSemaphore, NULL, uTicks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t hSemaphore){
+	return xQueueSend(hSemaphore, NULL, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t hSemaphore){
+	vQueueDelete(hSemaphore);
+}
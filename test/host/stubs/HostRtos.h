@@ -0,0 +1,10 @@
+#ifndef TEST_HOST_HOSTRTOS_H_
+#define TEST_HOST_HOSTRTOS_H_
+
+/*
+ * vTaskDelay() and the timeout of ulTaskNotifyTake() take the given percentage of the requested time (default 100),
+ * so tests can run through retry delays and flush intervals without waiting for them
+ */
+void HostRtosSetTimeScale(unsigned int uPercent);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * SHA-256 (FIPS 180-4) behind the mbedtls API for the host tests - SHA-224 is not supported
+ */
+#include "mbedtls/sha256.h"
+
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_process(mbedtls_sha256_context* ctx, const unsigned char data[64]){
+	uint32_t w[64];
+	uint32_t s[8];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((uint32_t)data[4 * i] << 24) | ((uint32_t)data[4 * i + 1] << 16) | ((uint32_t)data[4 * i + 2] << 8) | data[4 * i + 3];
+	for (i = 16; i < 64; i++)
+		w[i] = w[i - 16] + (ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 7] + (ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10));
+	for (i = 0; i < 8; i++)
+		s[i] = ctx->state[i];
+	for (i = 0; i < 64; i++){
+		uint32_t t1 = s[7] + (ROTR(s[4], 6) ^ ROTR(s[4], 11) ^ ROTR(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + K[i] + w[i];
+		uint32_t t2 = (ROTR(s[0], 2) ^ ROTR(s[0], 13) ^ ROTR(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		s[7] = s[6];
+		s[6] = s[5];
+		s[5] = s[4];
+		s[4] = s[3] + t1;
+		s[3] = s[2];
+		s[2] = s[1];
+		s[1] = s[0];
+		s[0] = t1 + t2;
+	}
+	for (i = 0; i < 8; i++)
+		ctx->state[i] += s[i];
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx){
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx){
+	if (ctx)
+		memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_clone(mbedtls_sha256_context* dst, const mbedtls_sha256_context* src){
+	*dst = *src;
+}
+
+void mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224){
+	static const uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	memcpy(ctx->state, init, sizeof(init));
+	ctx->total[0] = 0;
+	ctx->total[1] = 0;
+	ctx->is224 = is224;
+}
+
+void mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen){
+	while (ilen){
+		size_t fill = ctx->total[0] & 0x3f;
+		size_t n = 64 - fill;
+		if (n > ilen)
+			n = ilen;
+		memcpy(ctx->buffer + fill, input, n);
+		ctx->total[0] += n;
+		if (ctx->total[0] < n)
+			ctx->total[1]++;
+		input += n;
+		ilen -= n;
+		if ((fill + n) == 64)
+			sha256_process(ctx, ctx->buffer);
+	}
+}
+
+void mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]){
+	uint64_t bits = (((uint64_t)ctx->total[1] << 32) | ctx->total[0]) << 3;
+	unsigned char pad[72];
+	size_t fill = ctx->total[0] & 0x3f;
+	size_t padlen = (fill < 56) ? (56 - fill) : (120 - fill);
+	int i;
+
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for (i = 0; i < 8; i++)
+		pad[padlen + i] = (unsigned char)(bits >> (56 - 8 * i));
+	mbedtls_sha256_update(ctx, pad, padlen + 8);
+	for (i = 0; i < 32; i++)
+		output[i] = (unsigned char)(ctx->state[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+void mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char output[32], int is224){
+	mbedtls_sha256_context ctx;
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, is224);
+	mbedtls_sha256_update(&ctx, input, ilen);
+	mbedtls_sha256_finish(&ctx, output);
+	mbedtls_sha256_free(&ctx);
+}
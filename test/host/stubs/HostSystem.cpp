@@ -0,0 +1,98 @@
+/*
+ * esp_system / esp_timer / esp_log stand-ins for the host tests
+ */
+#include "esp_host.h"
+#include "HostSystem.h"
+
+static const char gLevelChar[] = "NEWIDV";
+static int64_t giTimeOffset = 0;
+static unsigned int guRestarts = 0;
+static int giGpioLevels[GPIO_NUM_MAX];
+
+
+void HostSystemAdvanceTime(int64_t iMicroSeconds){
+	giTimeOffset += iMicroSeconds;
+}
+
+unsigned int HostSystemGetRestarts(){
+	return guRestarts;
+}
+
+
+void HostLog(esp_log_level_t level, const char* sTag, const char* sFormat, ...){
+	static const char* sLogEnv = getenv("UFO_HOST_LOG");
+	if (!sLogEnv || (level > (esp_log_level_t)atoi(sLogEnv)))
+		return;
+	va_list args;
+	va_start(args, sFormat);
+	fprintf(stderr, "%c (%u) %s: ", gLevelChar[level], esp_log_timestamp(), sTag);
+	vfprintf(stderr, sFormat, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+
+int64_t esp_timer_get_time(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (int64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000 + giTimeOffset;
+}
+
+uint32_t esp_log_timestamp(){
+	static const int64_t iStart = esp_timer_get_time();
+	return (uint32_t)((esp_timer_get_time() - iStart) / 1000);
+}
+
+uint32_t esp_log_early_timestamp(){
+	return esp_log_timestamp();
+}
+
+// the host has no heap limit worth reporting - this is roughly what the firmware sees after start
+uint32_t esp_get_free_heap_size(){
+	return 100000;
+}
+
+uint32_t esp_get_minimum_free_heap_size(){
+	return 90000;
+}
+
+uint32_t esp_random(){
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+// the firmware does not expect esp_restart() to return, but tests check that it was called
+void esp_restart(){
+	guRestarts++;
+}
+
+
+void gpio_pad_select_gpio(uint8_t uGpio){
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode){
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull){
+	giGpioLevels[gpio] = (pull == GPIO_PULLUP_ONLY);
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t uLevel){
+	giGpioLevels[gpio] = uLevel ? 1 : 0;
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio){
+	return giGpioLevels[gpio];
+}
+
+
+void sntp_setoperatingmode(uint8_t uMode){
+}
+
+void sntp_setservername(uint8_t uIndex, char* sServer){
+}
+
+void sntp_init(){
+}
@@ -0,0 +1,12 @@
+#ifndef TEST_HOST_HOSTSYSTEM_H_
+#define TEST_HOST_HOSTSYSTEM_H_
+
+#include <stdint.h>
+
+// moves esp_timer_get_time() (and everything based on it) forward without sleeping
+void HostSystemAdvanceTime(int64_t iMicroSeconds);
+
+// number of esp_restart() calls so far
+unsigned int HostSystemGetRestarts();
+
+#endif
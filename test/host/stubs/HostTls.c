@@ -0,0 +1,169 @@
+/*
+ * mbedtls stand-in for the host tests - a "TLS" session without any encryption, the handshake succeeds
+ * right away and the records are the plain data on the socket
+ */
+#include "mbedtls/ssl.h"
+#include <poll.h>
+
+
+void mbedtls_net_init(mbedtls_net_context* ctx){
+	ctx->fd = -1;
+}
+
+void mbedtls_net_free(mbedtls_net_context* ctx){
+	if (ctx->fd >= 0)
+		close(ctx->fd);
+	ctx->fd = -1;
+}
+
+int mbedtls_net_set_block(mbedtls_net_context* ctx){
+	return fcntl(ctx->fd, F_SETFL, fcntl(ctx->fd, F_GETFL, 0) & ~O_NONBLOCK);
+}
+
+int mbedtls_net_send(void* ctx, const unsigned char* buf, size_t len){
+	int ret = write(((mbedtls_net_context*)ctx)->fd, buf, len);
+	if (ret < 0)
+		return ((errno == EAGAIN) || (errno == EINTR)) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+	return ret;
+}
+
+int mbedtls_net_recv(void* ctx, unsigned char* buf, size_t len){
+	int ret = read(((mbedtls_net_context*)ctx)->fd, buf, len);
+	if (ret < 0)
+		return ((errno == EAGAIN) || (errno == EINTR)) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+	return ret;
+}
+
+int mbedtls_net_recv_timeout(void* ctx, unsigned char* buf, size_t len, uint32_t timeout){
+	struct pollfd fd = { ((mbedtls_net_context*)ctx)->fd, POLLIN, 0 };
+	int ret = poll(&fd, 1, timeout ? (int)timeout : -1);
+	if (ret == 0)
+		return MBEDTLS_ERR_SSL_TIMEOUT;
+	if (ret < 0)
+		return (errno == EINTR) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+	return mbedtls_net_recv(ctx, buf, len);
+}
+
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl){
+	memset(ssl, 0, sizeof(*ssl));
+}
+
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl){
+	memset(ssl, 0, sizeof(*ssl));
+}
+
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf){
+	ssl->conf = conf;
+	return 0;
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname){
+	return 0;
+}
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t* f_send, mbedtls_ssl_recv_t* f_recv, mbedtls_ssl_recv_timeout_t* f_recv_timeout){
+	ssl->p_bio = p_bio;
+	ssl->f_send = f_send;
+	ssl->f_recv = f_recv;
+	ssl->f_recv_timeout = f_recv_timeout;
+}
+
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl){
+	return 0;
+}
+
+uint32_t mbedtls_ssl_get_verify_result(const mbedtls_ssl_context* ssl){
+	return 0;
+}
+
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len){
+	return ssl->f_send(ssl->p_bio, buf, len);
+}
+
+// a closed connection counts as close notify, as if the server had ended the session properly
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len){
+	int ret;
+	if (ssl->f_recv_timeout)
+		ret = ssl->f_recv_timeout(ssl->p_bio, buf, len, ssl->conf->read_timeout);
+	else
+		ret = ssl->f_recv(ssl->p_bio, buf, len);
+	return ret ? ret : MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+}
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl){
+	return 0;
+}
+
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl){
+	return 0;
+}
+
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf){
+	memset(conf, 0, sizeof(*conf));
+}
+
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf){
+}
+
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset){
+	return 0;
+}
+
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode){
+}
+
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl){
+}
+
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng){
+}
+
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config* conf, uint32_t timeout){
+	conf->read_timeout = timeout;
+}
+
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt){
+}
+
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt){
+}
+
+int mbedtls_x509_crt_verify_info(char* buf, size_t size, const char* prefix, uint32_t flags){
+	return snprintf(buf, size, "%sflags 0x%x", prefix, flags);
+}
+
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx){
+}
+
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx){
+}
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*f_entropy)(void*, unsigned char*, size_t), void* p_entropy, const unsigned char* custom, size_t len){
+	return 0;
+}
+
+int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t output_len){
+	while (output_len--)
+		*output++ = (unsigned char)rand();
+	return 0;
+}
+
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx){
+}
+
+void mbedtls_entropy_free(mbedtls_entropy_context* ctx){
+}
+
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len){
+	return mbedtls_ctr_drbg_random(data, output, len);
+}
+
+
+void mbedtls_strerror(int errnum, char* buffer, size_t buflen){
+	snprintf(buffer, buflen, "host TLS stand-in error -0x%04x", -errnum);
+}
@@ -0,0 +1,71 @@
+/*
+ * Wifi and AWSIntegration stand-ins for the host tests, see HostUfo.h
+ */
+#include "esp_host.h"
+#include "HostUfo.h"
+#include "Wifi.h"
+#include "AWSIntegration.h"
+
+static std::vector<THostPublished> gPublished;
+static bool gbFailPublish = false;
+
+
+std::vector<THostPublished>& HostAwsGetPublished(){
+	return gPublished;
+}
+
+void HostAwsFailPublish(bool bFail){
+	gbFailPublish = bFail;
+}
+
+
+Wifi::Wifi(){
+	mpConfig = NULL;
+	mpStateDisplay = NULL;
+	muMode = 0;
+	muConnectedClients = 0;
+	mbConnected = false;
+}
+
+String Wifi::GetLocalAddress(){
+	return String(mbConnected ? HOST_WIFI_ADDRESS : "0.0.0.0");
+}
+
+void Wifi::GetLocalAddress(char* sBuf){
+	strcpy(sBuf, GetLocalAddress().c_str());
+}
+
+void Wifi::GetApInfo(int8_t& riRssi, uint8_t& ruChannel){
+	riRssi = HOST_WIFI_RSSI;
+	ruChannel = 6;
+}
+
+void Wifi::StartAPMode(String& rsSsid, String& rsPass, String& rsHostname){
+	msSsid = rsSsid;
+	mbConnected = false;
+}
+
+void Wifi::StartSTAMode(String& rsSsid, String& rsPass, String& rsHostname){
+	msSsid = rsSsid;
+	mbConnected = true;
+}
+
+
+AWSIntegration::AWSIntegration(){
+	mpUfo = NULL;
+	mpConfig = NULL;
+	mhClientLock = xSemaphoreCreateMutex();
+}
+
+AWSIntegration::~AWSIntegration(){
+	vSemaphoreDelete(mhClientLock);
+}
+
+bool AWSIntegration::Publish(const char* pTopic, short pTopicLenth, const char* pPayload, size_t uPayloadLength){
+	if (!mActive || gbFailPublish)
+		return false;
+	THostPublished published = { std::string(pTopic, pTopicLenth), std::string(pPayload, uPayloadLength) };
+	gPublished.push_back(published);
+	muPublished++;
+	return true;
+}
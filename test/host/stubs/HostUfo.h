@@ -0,0 +1,25 @@
+#ifndef TEST_HOST_HOSTUFO_H_
+#define TEST_HOST_HOSTUFO_H_
+
+#include <string>
+#include <vector>
+
+/*
+ * Link stand-ins for the firmware classes that talk to the radio or the cloud (HostUfo.cpp):
+ * - Wifi: StartSTAMode connects right away (address HOST_WIFI_ADDRESS, rssi HOST_WIFI_RSSI), StartAPMode disconnects
+ * - AWSIntegration: Publish records the messages instead of sending them
+ * Link HostUfo.cpp instead of Wifi.cpp and AWSIntegration.cpp.
+ */
+
+#define HOST_WIFI_ADDRESS	"192.168.1.23"
+#define HOST_WIFI_RSSI		-57
+
+typedef struct {
+	std::string sTopic;
+	std::string sPayload;
+} THostPublished;
+
+std::vector<THostPublished>& HostAwsGetPublished();
+void HostAwsFailPublish(bool bFail);
+
+#endif
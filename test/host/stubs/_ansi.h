@@ -0,0 +1,6 @@
+#ifndef TEST_HOST_ANSI_H_
+#define TEST_HOST_ANSI_H_
+
+// newlib only
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef TEST_HOST_AWS_IOT_LOG_H_
+#define TEST_HOST_AWS_IOT_LOG_H_
+
+#include "aws_iot_mqtt_client_interface.h"
+
+#endif
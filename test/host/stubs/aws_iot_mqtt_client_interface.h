@@ -0,0 +1,11 @@
+#ifndef TEST_HOST_AWS_IOT_MQTT_CLIENT_INTERFACE_H_
+#define TEST_HOST_AWS_IOT_MQTT_CLIENT_INTERFACE_H_
+
+#include "esp_host.h"
+
+// the AWS IoT client is not part of the host tests, AWSIntegration is replaced as a whole (see HostUfo.h)
+typedef struct { int dummy; } AWS_IoT_Client;
+typedef struct { int dummy; } IoT_Client_Init_Params;
+typedef struct { int dummy; } IoT_Client_Connect_Params;
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef TEST_HOST_CJSON_H_
+#define TEST_HOST_CJSON_H_
+
+#include "esp_host.h"
+
+/*
+ * The part of the cJSON API the firmware uses, implemented by HostJson.c
+ * (objects, arrays, strings without \u escapes, numbers, true/false/null)
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define cJSON_False		(1 << 0)
+#define cJSON_True		(1 << 1)
+#define cJSON_NULL		(1 << 2)
+#define cJSON_Number	(1 << 3)
+#define cJSON_String	(1 << 4)
+#define cJSON_Array		(1 << 5)
+#define cJSON_Object	(1 << 6)
+
+typedef struct cJSON {
+	struct cJSON* next;
+	struct cJSON* prev;
+	struct cJSON* child;
+	int type;
+	char* valuestring;
+	int valueint;
+	double valuedouble;
+	char* string;
+} cJSON;
+
+cJSON* cJSON_Parse(const char* value);
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string);
+char* cJSON_Print(const cJSON* item);
+void cJSON_Delete(cJSON* item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Host (Linux) stand-in for the parts of ESP-IDF and FreeRTOS the firmware uses.
+ * It is force-included into every translation unit of the host tests, the individual
+ * SDK headers (esp_log.h, freertos/task.h, nvs.h, ...) in this directory just include it.
+ * Tasks are threads, queues and semaphores are blocking and critical sections are one
+ * global recursive lock, so the concurrency of the firmware is kept on the host.
+ */
+#ifndef TEST_HOST_ESP_HOST_H_
+#define TEST_HOST_ESP_HOST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ----- esp_err / esp_system / esp_timer / esp_log
+
+typedef int esp_err_t;
+#define ESP_OK						0
+#define ESP_FAIL					-1
+#define ESP_ERR_NO_MEM				0x101
+#define ESP_ERR_INVALID_ARG			0x102
+#define ESP_ERR_INVALID_STATE		0x103
+#define ESP_ERR_INVALID_SIZE		0x104
+#define ESP_ERR_NOT_FOUND			0x105
+#define ESP_ERR_NVS_BASE			0x1100
+#define ESP_ERR_NVS_NOT_FOUND		(ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_READ_ONLY		(ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_INVALID_HANDLE	(ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_KEY_TOO_LONG	(ESP_ERR_NVS_BASE + 0x09)
+#define ESP_ERR_NVS_INVALID_LENGTH	(ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_VALUE_TOO_LONG	(ESP_ERR_NVS_BASE + 0x0e)
+
+uint32_t esp_get_free_heap_size();
+uint32_t esp_get_minimum_free_heap_size();
+uint32_t esp_random();
+void esp_restart();
+int64_t esp_timer_get_time();
+uint32_t esp_log_timestamp();
+uint32_t esp_log_early_timestamp();
+
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#endif
+
+// the format is checked by the compiler just like on the target, the output is only printed with UFO_HOST_LOG set
+void HostLog(esp_log_level_t level, const char* sTag, const char* sFormat, ...) __attribute__((format(printf, 3, 4)));
+#define ESP_LOGE(tag, format, ...) HostLog(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HostLog(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HostLog(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HostLog(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HostLog(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+// only passed through by the firmware (Wifi::OnEvent), the host never raises events
+typedef struct { int event_id; } system_event_t;
+
+// ----- FreeRTOS
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void* EventGroupHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define configTICK_RATE_HZ		CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS		(1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS		portTICK_PERIOD_MS
+#define portMAX_DELAY			0xffffffff
+#define pdTRUE					1
+#define pdFALSE					0
+#define pdPASS					1
+#define pdFAIL					0
+#define errQUEUE_FULL			0
+#define tskNO_AFFINITY			0x7fffffff
+
+typedef struct { int iOwner; int iCount; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED	{ 0, 0 }
+void vPortCPUAcquireMutex(portMUX_TYPE* pMux);
+void vPortCPUReleaseMutex(portMUX_TYPE* pMux);
+#define taskENTER_CRITICAL(mux)	vPortCPUAcquireMutex(mux)
+#define taskEXIT_CRITICAL(mux)	vPortCPUReleaseMutex(mux)
+#define portENTER_CRITICAL(mux)	vPortCPUAcquireMutex(mux)
+#define portEXIT_CRITICAL(mux)	vPortCPUReleaseMutex(mux)
+
+BaseType_t xTaskCreate(TaskFunction_t pFunction, const char* sName, uint32_t uStackDepth, void* pParam, UBaseType_t uPriority, TaskHandle_t* pHandle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pFunction, const char* sName, uint32_t uStackDepth, void* pParam, UBaseType_t uPriority, TaskHandle_t* pHandle, BaseType_t iCore);
+void vTaskDelete(TaskHandle_t hTask);
+void vTaskDelay(TickType_t uTicks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskNotifyGive(TaskHandle_t hTask);
+uint32_t ulTaskNotifyTake(BaseType_t bClearCountOnExit, TickType_t uTicks);
+
+QueueHandle_t xQueueCreate(UBaseType_t uLength, UBaseType_t uItemSize);
+BaseType_t xQueueSend(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks);
+BaseType_t xQueueSendToBack(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks);
+BaseType_t xQueueSendToFront(QueueHandle_t hQueue, const void* pItem, TickType_t uTicks);
+BaseType_t xQueueReceive(QueueHandle_t hQueue, void* pItem, TickType_t uTicks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t hQueue);
+BaseType_t xQueueReset(QueueHandle_t hQueue);
+void vQueueDelete(QueueHandle_t hQueue);
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t hSemaphore, TickType_t uTicks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t hSemaphore);
+void vSemaphoreDelete(SemaphoreHandle_t hSemaphore);
+
+// ----- nvs
+
+typedef uint32_t nvs_handle;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode;
+
+esp_err_t nvs_flash_init();
+esp_err_t nvs_open(const char* sNamespace, nvs_open_mode mode, nvs_handle* pHandle);
+void nvs_close(nvs_handle h);
+esp_err_t nvs_commit(nvs_handle h);
+esp_err_t nvs_erase_all(nvs_handle h);
+esp_err_t nvs_erase_key(nvs_handle h, const char* sKey);
+esp_err_t nvs_get_str(nvs_handle h, const char* sKey, char* sValue, uint32_t* pLength);
+esp_err_t nvs_set_str(nvs_handle h, const char* sKey, const char* sValue);
+esp_err_t nvs_get_blob(nvs_handle h, const char* sKey, void* pValue, uint32_t* pLength);
+esp_err_t nvs_set_blob(nvs_handle h, const char* sKey, const void* pValue, size_t uLength);
+esp_err_t nvs_get_i8(nvs_handle h, const char* sKey, int8_t* pValue);
+esp_err_t nvs_set_i8(nvs_handle h, const char* sKey, int8_t iValue);
+esp_err_t nvs_get_u8(nvs_handle h, const char* sKey, uint8_t* pValue);
+esp_err_t nvs_set_u8(nvs_handle h, const char* sKey, uint8_t uValue);
+esp_err_t nvs_get_u16(nvs_handle h, const char* sKey, uint16_t* pValue);
+esp_err_t nvs_set_u16(nvs_handle h, const char* sKey, uint16_t uValue);
+esp_err_t nvs_get_i32(nvs_handle h, const char* sKey, int32_t* pValue);
+esp_err_t nvs_set_i32(nvs_handle h, const char* sKey, int32_t iValue);
+esp_err_t nvs_get_u32(nvs_handle h, const char* sKey, uint32_t* pValue);
+esp_err_t nvs_set_u32(nvs_handle h, const char* sKey, uint32_t uValue);
+
+// ----- gpio (levels are only remembered)
+
+typedef enum { GPIO_NUM_0 = 0, GPIO_NUM_16 = 16, GPIO_NUM_17 = 17, GPIO_NUM_18 = 18, GPIO_NUM_19 = 19, GPIO_NUM_MAX = 40 } gpio_num_t;
+typedef enum { GPIO_MODE_INPUT, GPIO_MODE_OUTPUT } gpio_mode_t;
+typedef enum { GPIO_PULLUP_ONLY, GPIO_PULLDOWN_ONLY, GPIO_FLOATING } gpio_pull_mode_t;
+
+void gpio_pad_select_gpio(uint8_t uGpio);
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode);
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull);
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t uLevel);
+int gpio_get_level(gpio_num_t gpio);
+
+// ----- SNTP (there is no network time on the host, the wall clock is the one of the host)
+
+#define SNTP_OPMODE_POLL			0
+
+void sntp_setoperatingmode(uint8_t uMode);
+void sntp_setservername(uint8_t uIndex, char* sServer);
+void sntp_init();
+
+// ----- partitions and OTA (backed by in-memory flash, see HostFlash.h)
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0, ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+typedef struct {
+	esp_partition_type_t type;
+	esp_partition_subtype_t subtype;
+	uint32_t address;
+	uint32_t size;
+	char label[17];
+	bool encrypted;
+} esp_partition_t;
+typedef uint32_t esp_ota_handle_t;
+#define OTA_SIZE_UNKNOWN			0xffffffff
+#define SPI_FLASH_SEC_SIZE			4096
+#define ESP_ERR_OTA_BASE			0x1500
+#define ESP_ERR_OTA_VALIDATE_FAILED	(ESP_ERR_OTA_BASE + 0x03)
+
+const esp_partition_t* esp_ota_get_boot_partition();
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* pStart);
+esp_err_t esp_ota_begin(const esp_partition_t* pPartition, size_t uImageSize, esp_ota_handle_t* pHandle);
+esp_err_t esp_ota_write(esp_ota_handle_t h, const void* pData, size_t uSize);
+esp_err_t esp_ota_end(esp_ota_handle_t h);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* pPartition);
+esp_err_t esp_partition_read(const esp_partition_t* pPartition, size_t uOffset, void* pDst, size_t uSize);
+esp_err_t esp_partition_write(const esp_partition_t* pPartition, size_t uOffset, const void* pSrc, size_t uSize);
+esp_err_t esp_partition_erase_range(const esp_partition_t* pPartition, size_t uOffset, size_t uSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_HOST_ESP_HOST_H_ */
@@ -0,0 +1,6 @@
+#ifndef TEST_HOST_FREERTOS_EVENT_GROUPS_H_
+#define TEST_HOST_FREERTOS_EVENT_GROUPS_H_
+
+#include "esp_host.h"
+
+#endif
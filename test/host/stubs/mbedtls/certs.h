@@ -0,0 +1,6 @@
+#ifndef TEST_HOST_MBEDTLS_CERTS_H_
+#define TEST_HOST_MBEDTLS_CERTS_H_
+
+#include "mbedtls/ssl.h"
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef TEST_HOST_MBEDTLS_SHA256_H_
+#define TEST_HOST_MBEDTLS_SHA256_H_
+
+#include "esp_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// same layout as in mbedtls, implemented in HostSha256.c
+typedef struct {
+	uint32_t total[2];
+	uint32_t state[8];
+	unsigned char buffer[64];
+	int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_clone(mbedtls_sha256_context* dst, const mbedtls_sha256_context* src);
+void mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+void mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+void mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]);
+void mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char output[32], int is224);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
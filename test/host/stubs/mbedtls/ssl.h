@@ -0,0 +1,98 @@
+#ifndef TEST_HOST_MBEDTLS_SSL_H_
+#define TEST_HOST_MBEDTLS_SSL_H_
+
+#include "esp_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * TLS stand-in for the host tests, implemented in HostTls.c - the "TLS" layer passes the data through
+ * unencrypted, so the HTTPS code paths of the firmware can run against a plain local server.
+ * Covers the ssl, net, x509, ctr_drbg, entropy and error APIs, the other mbedtls headers include this one.
+ */
+
+#define MBEDTLS_ERR_NET_SEND_FAILED			-0x004E
+#define MBEDTLS_ERR_NET_RECV_FAILED			-0x004C
+#define MBEDTLS_ERR_SSL_TIMEOUT				-0x6800
+#define MBEDTLS_ERR_SSL_WANT_WRITE			-0x6880
+#define MBEDTLS_ERR_SSL_WANT_READ			-0x6900
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY	-0x7880
+
+#define MBEDTLS_SSL_IS_CLIENT			0
+#define MBEDTLS_SSL_TRANSPORT_STREAM	0
+#define MBEDTLS_SSL_PRESET_DEFAULT		0
+#define MBEDTLS_SSL_VERIFY_OPTIONAL		1
+
+typedef int mbedtls_ssl_send_t(void* ctx, const unsigned char* buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void* ctx, unsigned char* buf, size_t len);
+typedef int mbedtls_ssl_recv_timeout_t(void* ctx, unsigned char* buf, size_t len, uint32_t timeout);
+
+typedef struct {
+	int fd;
+} mbedtls_net_context;
+
+typedef struct {
+	uint32_t read_timeout;
+} mbedtls_ssl_config;
+
+typedef struct {
+	const mbedtls_ssl_config* conf;
+	void* p_bio;
+	mbedtls_ssl_send_t* f_send;
+	mbedtls_ssl_recv_t* f_recv;
+	mbedtls_ssl_recv_timeout_t* f_recv_timeout;
+} mbedtls_ssl_context;
+
+typedef struct { int dummy; } mbedtls_x509_crt;
+typedef struct { int dummy; } mbedtls_ctr_drbg_context;
+typedef struct { int dummy; } mbedtls_entropy_context;
+
+void mbedtls_net_init(mbedtls_net_context* ctx);
+void mbedtls_net_free(mbedtls_net_context* ctx);
+int mbedtls_net_set_block(mbedtls_net_context* ctx);
+int mbedtls_net_send(void* ctx, const unsigned char* buf, size_t len);
+int mbedtls_net_recv(void* ctx, unsigned char* buf, size_t len);
+int mbedtls_net_recv_timeout(void* ctx, unsigned char* buf, size_t len, uint32_t timeout);
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t* f_send, mbedtls_ssl_recv_t* f_recv, mbedtls_ssl_recv_timeout_t* f_recv_timeout);
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl);
+uint32_t mbedtls_ssl_get_verify_result(const mbedtls_ssl_context* ssl);
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len);
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl);
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf);
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode);
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng);
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config* conf, uint32_t timeout);
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt);
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt);
+int mbedtls_x509_crt_verify_info(char* buf, size_t size, const char* prefix, uint32_t flags);
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx);
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx);
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*f_entropy)(void*, unsigned char*, size_t), void* p_entropy, const unsigned char* custom, size_t len);
+int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t output_len);
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx);
+void mbedtls_entropy_free(mbedtls_entropy_context* ctx);
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len);
+
+void mbedtls_strerror(int errnum, char* buffer, size_t buflen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef TEST_HOST_NVS_FLASH_H_
+#define TEST_HOST_NVS_FLASH_H_
+
+#include "esp_host.h"
+
+#endif
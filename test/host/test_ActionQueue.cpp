@@ -0,0 +1,120 @@
+#include "HostTest.h"
+#include "ActionQueue.h"
+#include <thread>
+#include <vector>
+
+#define PRODUCERS		4
+#define PER_PRODUCER	500000
+
+// the queue only moves the pointers, so the values can stand in for actions: producer in the upper bits, sequence below
+static DynatraceAction* Value(__uint32_t uProducer, __uint32_t uSequence){
+	return (DynatraceAction*)(uintptr_t)(((uintptr_t)uProducer << 24) | (uSequence + 1));
+}
+
+
+TEST(pushAndPopInOrder){
+	ActionQueue queue;
+	DynatraceAction* pAction;
+	CHECK(!queue.Pop(pAction));
+	for (__uint32_t u = 0; u < 1000; u++){
+		CHECK(queue.Push(Value(0, u)));
+		CHECK(queue.GetCount() == 1);
+		CHECK(queue.Pop(pAction) && (pAction == Value(0, u)));
+		CHECK(!queue.Pop(pAction));
+	}
+	CHECK(queue.GetDropped() == 0);
+}
+
+TEST(fullQueueDropsAndRecovers){
+	ActionQueue queue;
+	DynatraceAction* pAction;
+	for (__uint32_t u = 0; u < ACTIONQUEUE_SIZE; u++)
+		CHECK(queue.Push(Value(0, u)));
+	CHECK(queue.GetCount() == ACTIONQUEUE_SIZE);
+	CHECK(!queue.Push(Value(1, 0)));
+	CHECK(!queue.Push(Value(1, 1)));
+	CHECK(queue.GetDropped() == 2);
+
+	CHECK(queue.Pop(pAction) && (pAction == Value(0, 0)));
+	CHECK(queue.Push(Value(2, 0)));
+	for (__uint32_t u = 1; u < ACTIONQUEUE_SIZE; u++)
+		CHECK(queue.Pop(pAction) && (pAction == Value(0, u)));
+	CHECK(queue.Pop(pAction) && (pAction == Value(2, 0)));
+	CHECK(queue.GetCount() == 0);
+}
+
+// several producers against one consumer: every value arrives exactly once and in the order of its producer
+TEST(concurrentProducersLoseNothing){
+	ActionQueue queue;
+	std::vector<std::thread> producers;
+	for (__uint32_t p = 0; p < PRODUCERS; p++)
+		producers.push_back(std::thread([&queue, p](){
+			for (__uint32_t u = 0; u < PER_PRODUCER; u++)
+				while (!queue.Push(Value(p, u)))
+					std::this_thread::yield();
+		}));
+
+	__uint32_t uNext[PRODUCERS] = { 0 };
+	__uint32_t uReceived = 0;
+	bool bInOrder = true;
+	while (uReceived < PRODUCERS * PER_PRODUCER){
+		DynatraceAction* pAction;
+		if (!queue.Pop(pAction)){
+			std::this_thread::yield();
+			continue;
+		}
+		uintptr_t uValue = (uintptr_t)pAction;
+		__uint32_t uProducer = uValue >> 24;
+		__uint32_t uSequence = (uValue & 0xffffff) - 1;
+		bInOrder &= (uProducer < PRODUCERS) && (uSequence == uNext[uProducer]);
+		if (uProducer < PRODUCERS)
+			uNext[uProducer] = uSequence + 1;
+		uReceived++;
+	}
+	for (auto& t : producers)
+		t.join();
+
+	CHECK(bInOrder);
+	for (__uint32_t p = 0; p < PRODUCERS; p++)
+		CHECK(uNext[p] == PER_PRODUCER);
+	DynatraceAction* pAction;
+	CHECK(!queue.Pop(pAction));
+	CHECK(queue.GetDropped() > 0);	// the producers retried on a full queue, every retry counts as drop
+}
+
+
+BENCH(pushPopUncontended){
+	ActionQueue queue;
+	DynatraceAction* pAction;
+	const __uint32_t uRounds = 10000000;
+	int64_t iStart = esp_timer_get_time();
+	for (__uint32_t u = 0; u < uRounds; u++){
+		queue.Push(Value(0, u & 0xffff));
+		queue.Pop(pAction);
+	}
+	int64_t iDuration = esp_timer_get_time() - iStart;
+	printf("bench  Push+Pop uncontended: %.1f ns per pair\n", iDuration * 1000.0 / uRounds);
+}
+
+BENCH(pushPopContended){
+	ActionQueue queue;
+	std::vector<std::thread> producers;
+	int64_t iStart = esp_timer_get_time();
+	for (__uint32_t p = 0; p < PRODUCERS; p++)
+		producers.push_back(std::thread([&queue, p](){
+			for (__uint32_t u = 0; u < PER_PRODUCER; u++)
+				while (!queue.Push(Value(p, u)))
+					std::this_thread::yield();
+		}));
+	DynatraceAction* pAction;
+	for (__uint32_t uReceived = 0; uReceived < PRODUCERS * PER_PRODUCER; )
+		if (queue.Pop(pAction))
+			uReceived++;
+		else
+			std::this_thread::yield();
+	int64_t iDuration = esp_timer_get_time() - iStart;
+	for (auto& t : producers)
+		t.join();
+	printf("bench  %d producers, 1 consumer: %.1f ns per action, %.1f M actions/s\n", PRODUCERS,
+		iDuration * 1000.0 / (PRODUCERS * PER_PRODUCER), (PRODUCERS * PER_PRODUCER) / (double)iDuration);
+}
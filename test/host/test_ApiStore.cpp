@@ -0,0 +1,124 @@
+#include "HostTest.h"
+#include "HostNvs.h"
+#include "ApiStore.h"
+#include "DisplayCharter.h"
+#include "DisplayCharterLogo.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define NAMESPACE	"Api"
+
+static CriticalSection gSceneLock;
+
+static std::string Preset(__uint8_t uSlot){
+	return "/api?top_init&top=0|" + std::to_string(uSlot % 16) + "|ff0000&logo_reset";
+}
+
+// presets as written by a firmware with another API_MAX_PRESETS
+static void Store(const std::vector<__uint8_t>& order){
+	HostNvsReset();
+	nvs_handle h;
+	CHECK(nvs_open(NAMESPACE, NVS_READWRITE, &h) == ESP_OK);
+	for (__uint8_t uSlot : order)
+		CHECK(nvs_set_str(h, ("Api" + std::to_string(uSlot)).c_str(), Preset(uSlot).c_str()) == ESP_OK);
+	CHECK(nvs_set_blob(h, "Order", order.data(), order.size()) == ESP_OK);
+	CHECK(nvs_commit(h) == ESP_OK);
+	nvs_close(h);
+}
+
+
+TEST(builtInPresetsAreStoredOnTheFirstEdit){
+	HostNvsReset();
+	ApiStore store;
+	store.Init(&gSceneLock);
+	CHECK(store.GetCount() == 8);
+	CHECK(!HostNvsExists(NAMESPACE, "Order"));
+	CHECK(store.SetApi(1, "/api?logo_reset"));
+	CHECK(HostNvsExists(NAMESPACE, "Order") && HostNvsExists(NAMESPACE, "Api7"));
+
+	ApiStore reread;
+	reread.Init(&gSceneLock);
+	CHECK((reread.GetCount() == 8) && (*reread.GetApi(1) == "/api?logo_reset"));
+	CHECK(HostNvsGetOpenHandles() == 0);
+}
+
+// a lower CONFIG_UFO_MAX_API_PRESETS keeps the first presets and leaves the stored ones alone
+TEST(moreStoredPresetsThanSlotsAreTruncated){
+	std::vector<__uint8_t> order;
+	for (__uint8_t u = 0; u < API_MAX_PRESETS + 5; u++)
+		order.push_back(u);
+	Store(order);
+	unsigned int uWrites = HostNvsGetWrites();
+
+	ApiStore store;
+	store.Init(&gSceneLock);
+	CHECK(store.GetCount() == API_MAX_PRESETS);
+	for (__uint8_t u = 0; u < API_MAX_PRESETS; u++)
+		CHECK(*store.GetApi(u) == Preset(u).c_str());
+	CHECK(store.GetProgram(0)->GetLength() > 0);
+	CHECK(HostNvsGetWrites() == uWrites);
+	CHECK(HostNvsExists(NAMESPACE, ("Api" + std::to_string(API_MAX_PRESETS + 4)).c_str()));
+}
+
+// presets in slots beyond API_MAX_PRESETS move into free slots and keep their order
+TEST(slotsBeyondTheLimitMove){
+	std::vector<__uint8_t> order = { API_MAX_PRESETS + 2, 0, API_MAX_PRESETS + 1, 1 };
+	Store(order);
+	std::vector<std::string> expected;
+	for (__uint8_t uSlot : order)
+		expected.push_back(Preset(uSlot));
+
+	{
+		ApiStore store;
+		store.Init(&gSceneLock);
+		CHECK(store.GetCount() == order.size());
+		for (__uint8_t u = 0; u < order.size(); u++)
+			CHECK(*store.GetApi(u) == expected[u].c_str());
+	}
+	__uint8_t uStored[API_MAX_PRESETS + 8];
+	__uint32_t uLen = sizeof(uStored);
+	nvs_handle h;
+	CHECK(nvs_open(NAMESPACE, NVS_READONLY, &h) == ESP_OK);
+	CHECK((nvs_get_blob(h, "Order", uStored, &uLen) == ESP_OK) && (uLen == order.size()));
+	nvs_close(h);
+	for (__uint32_t u = 0; u < uLen; u++)
+		CHECK(uStored[u] < API_MAX_PRESETS);
+
+	ApiStore reread;
+	reread.Init(&gSceneLock);
+	CHECK(reread.GetCount() == order.size());
+	for (__uint8_t u = 0; u < order.size(); u++)
+		CHECK(*reread.GetApi(u) == expected[u].c_str());
+}
+
+// the display task replays a preset while a web task saves it again
+TEST(presetsCanBeSavedWhileReplayed){
+	HostNvsReset();
+	ApiStore store;
+	store.Init(&gSceneLock);
+	const char* sApis[] = { "/api?top_init&top=0|15|ff0000&top_morph=80|8", "/api?logo=ff0000|00ff00|0000ff|ff00cc&bottom_init&bottom=0|3|00ff00&bottom_whirl=190" };
+	std::atomic<bool> bDone(false);
+	unsigned int uReplays = 0;
+	std::thread display([&](){
+		DisplayCharter top, bottom;
+		DisplayCharterLogo logo;
+		while (!bDone){
+			gSceneLock.Enter(0);
+			store.GetProgram(0)->Execute(&top, &bottom, &logo);
+			gSceneLock.Leave();
+			uReplays++;
+			std::this_thread::yield();
+		}
+	});
+	for (int i = 0; i < 2000; i++)
+		CHECK(store.SetApi(0, sApis[i & 1]));
+	bDone = true;
+	display.join();
+
+	DisplayCommand expected;
+	CHECK(expected.Compile(sApis[1]));
+	CHECK((uReplays > 0) && (store.GetProgram(0)->GetLength() == expected.GetLength()));
+	CHECK(!memcmp(store.GetProgram(0)->GetCode(), expected.GetCode(), expected.GetLength()));
+}
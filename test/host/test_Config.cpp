@@ -0,0 +1,199 @@
+#include "HostTest.h"
+#include "HostNvs.h"
+#include "Config.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+#define NAMESPACE	"Ufo Config"
+
+
+TEST(unchangedSettingsAreNotWritten){
+	HostNvsReset();
+	{
+		Config config;
+		config.msUfoName = "ufo";
+		CHECK(config.Write());
+	}
+	Config config;
+	CHECK(config.Read());
+	CHECK(config.msUfoName == "ufo");
+	unsigned int uWrites = HostNvsGetWrites();
+	CHECK(config.Write());
+	CHECK((HostNvsGetWrites() == uWrites) && (config.GetWritesSkipped() == 1));
+
+	config.msUfoName = "ufo2";
+	CHECK(config.Write());
+	CHECK((HostNvsGetWrites() == uWrites + 1) && (config.GetVersion() == 2));
+	CHECK(config.Write());
+	CHECK(HostNvsGetWrites() == uWrites + 1);
+	CHECK(HostNvsGetOpenHandles() == 0);
+}
+
+// big strings are compared with the stored value, a changed one is written in chunks
+TEST(bigStringsAreWrittenWhenChanged){
+	HostNvsReset();
+	Config config;
+	CHECK(config.Write());
+	unsigned int uWrites = HostNvsGetWrites();
+	config.GetSTAENTCA();
+	CHECK(config.Write());
+	CHECK(HostNvsGetWrites() == uWrites);
+
+	std::string sCert(4000, 'c');
+	config.GetSTAENTCA() = sCert.c_str();
+	CHECK(config.Write());
+	CHECK(HostNvsExists(NAMESPACE, "STAENTCA2") && !HostNvsExists(NAMESPACE, "STAENTCA3"));
+	uWrites = HostNvsGetWrites();
+	config.GetSTAENTCA() = sCert.c_str();
+	CHECK(config.Write());
+	CHECK(HostNvsGetWrites() == uWrites);
+
+	Config reread;
+	CHECK(reread.Read());
+	CHECK(reread.GetSTAENTCA() == sCert.c_str());
+	CHECK(reread.GetVersion() == config.GetVersion());
+}
+
+// power lost between the chunks and the blob - the chunks don't match the blob and are dropped instead of mixing two certificates
+TEST(tornBigStringIsRejected){
+	HostNvsReset();
+	std::string sOld(4000, 'a'), sNew(4000, 'b');
+	Config config;
+	config.GetSTAENTCA() = sOld.c_str();
+	CHECK(config.Write());
+
+	for (unsigned int uWrites : { 1, 3 }){	// the first chunk of the new value, all of its chunks
+		config.GetSTAENTCA() = sNew.c_str();
+		HostNvsFailWritesAfter(uWrites);
+		CHECK(!config.Write());
+		HostNvsFailWritesAfter(0);
+		Config reread;
+		CHECK(reread.Read());
+		CHECK(reread.GetSTAENTCA() == "");
+	}
+
+	CHECK(config.Write());
+	Config reread;
+	CHECK(reread.Read());
+	CHECK(reread.GetSTAENTCA() == sNew.c_str());
+	CHECK(HostNvsGetOpenHandles() == 0);
+}
+
+// a blob of an older firmware has no digests, its big strings are taken as they are
+TEST(bigStringsWithoutDigestAreRead){
+	HostNvsReset();
+	nvs_handle h;
+	CHECK(nvs_open(NAMESPACE, NVS_READWRITE, &h) == ESP_OK);
+	const char blob[] = "UFC\x01\x01\x00\x00\x00" "\x07" "UfoName" "\x06\x03\x00" "old";
+	CHECK(nvs_set_blob(h, "Settings", blob, sizeof(blob) - 1) == ESP_OK);
+	CHECK(nvs_set_str(h, "STAENTCA", "cert") == ESP_OK);
+	CHECK(nvs_commit(h) == ESP_OK);
+	nvs_close(h);
+
+	{
+		Config config;
+		CHECK(config.Read());
+		CHECK(config.msUfoName == "old");
+		config.msUfoName = "new";
+		CHECK(config.Write());
+	}
+	Config config;
+	CHECK(config.Read());
+	CHECK((config.msUfoName == "new") && (config.GetSTAENTCA() == "cert"));
+}
+
+// the web server tasks and the button handler save concurrently, every save gets its own version
+TEST(concurrentWritesAreSerialized){
+	HostNvsReset();
+	Config config;
+	const int iRounds = 200;
+	std::vector<std::thread> writers;
+	writers.push_back(std::thread([&](){ for (int i = 1; i <= iRounds; i++){ config.muMqttPort = i; config.Write(); } }));
+	writers.push_back(std::thread([&](){ for (int i = 1; i <= iRounds; i++){ config.muWebServerPort = i; config.Write(); } }));
+	writers.push_back(std::thread([&](){ for (int i = 1; i <= iRounds; i++){ config.miDTInterval = i; config.Write(); } }));
+	for (auto& t : writers)
+		t.join();
+
+	CHECK(HostNvsGetOpenHandles() == 0);
+	CHECK(config.GetVersion() == config.GetWrites());
+	Config reread;
+	CHECK(reread.Read());
+	CHECK(reread.GetVersion() == config.GetVersion());
+	CHECK((reread.muMqttPort == iRounds) && (reread.muWebServerPort == iRounds) && (reread.miDTInterval == iRounds));
+}
+
+TEST(everyTypeSurvivesTheRoundTrip){
+	HostNvsReset();
+	{
+		Config config;
+		config.mbAPMode = false;
+		config.muDTMonitoringExporter = 2;
+		config.muMqttPort = 8883;
+		config.muLastSTAIpAddress = 0xc0a80102;
+		config.miDTInterval = -5;
+		config.msDTApiToken[0] = "token";
+		config.msLocation = "";
+		CHECK(config.Write());
+	}
+	Config config;
+	CHECK(config.Read());
+	CHECK(!config.mbAPMode && (config.muDTMonitoringExporter == 2) && (config.muMqttPort == 8883));
+	CHECK((config.muLastSTAIpAddress == 0xc0a80102) && (config.miDTInterval == -5));
+	CHECK((config.msDTApiToken[0] == "token") && (config.msLocation == "") && (config.msAPSsid == "UFO"));
+	CHECK(config.GetVersion() == 1);
+}
+
+// one over-long string is stored shortened, the other settings are still saved
+TEST(overLongStringsAreClamped){
+	HostNvsReset();
+	std::string sHost(100, 'h');
+	{
+		Config config;
+		config.msMqttHost = sHost.c_str();
+		config.msDTEnvIdOrUrl[0] = std::string(150, 'e').c_str();
+		config.muMqttPort = 1883;
+		CHECK(config.Write());
+		CHECK(config.msMqttHost.length() == 64);
+	}
+	Config config;
+	CHECK(config.Read());
+	CHECK(config.msMqttHost == sHost.substr(0, 64).c_str());
+	CHECK(config.msDTEnvIdOrUrl[0].length() == 100);
+	CHECK(config.muMqttPort == 1883);
+}
+
+// settings of an older firmware (one key per field) move into the blob, over-long strings are kept in part
+TEST(legacyKeysAreMigrated){
+	HostNvsReset();
+	nvs_handle h;
+	CHECK(nvs_open(NAMESPACE, NVS_READWRITE, &h) == ESP_OK);
+	std::string sHost(80, 'm');
+	CHECK(nvs_set_u8(h, "APMode", 0) == ESP_OK);
+	CHECK(nvs_set_u16(h, "MqttPort", 8883) == ESP_OK);
+	CHECK(nvs_set_u32(h, "DTInterval", 30) == ESP_OK);
+	CHECK(nvs_set_str(h, "UfoName", "legacy") == ESP_OK);
+	CHECK(nvs_set_str(h, "MqttHost", sHost.c_str()) == ESP_OK);
+	CHECK(nvs_set_str(h, "STAENTCA", "cert") == ESP_OK);
+	CHECK(nvs_set_u8(h, "Version", 7) == ESP_OK);
+	CHECK(nvs_commit(h) == ESP_OK);
+	nvs_close(h);
+
+	{
+		Config config;
+		CHECK(config.Read());
+		CHECK(!config.mbAPMode && (config.muMqttPort == 8883) && (config.miDTInterval == 30));
+		CHECK((config.msUfoName == "legacy") && (config.msMqttHost == sHost.substr(0, 64).c_str()));
+	}
+	CHECK(HostNvsExists(NAMESPACE, "Settings"));
+	const char* sErased[] = { "APMode", "MqttPort", "DTInterval", "UfoName", "MqttHost", "Version" };
+	for (const char* sKey : sErased)
+		CHECK(!HostNvsExists(NAMESPACE, sKey));
+	CHECK(HostNvsExists(NAMESPACE, "STAENTCA"));	// big strings kept their keys
+
+	Config config;
+	CHECK(config.Read());
+	CHECK((config.msUfoName == "legacy") && (config.muMqttPort == 8883));
+	CHECK(config.GetSTAENTCA() == "cert");
+	CHECK(HostNvsGetOpenHandles() == 0);
+}
@@ -0,0 +1,190 @@
+#include "HostTest.h"
+#include "DisplayCommand.h"
+#include "DisplayCharter.h"
+#include "DisplayCharterLogo.h"
+#include "UrlParser.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// written by the Go encoder (go/src/ufocommand), every line: /api call, tab, hex packet that shows the same
+#define PACKET_FILE		"ufocommand_packets.txt"
+
+// the longest built-in preset
+#define LONGEST_PRESET	"/api?top_init&top=0|15|ff0000&top_morph=80|8&bottom_init&bottom=0|15|ff0000&bottom_morph=80|8&logo=ff0000|ff0000|ff0000|ff0000"
+
+static const char* APIS[] = {
+	"/api?logo=ff0000|00ff00|0000ff|ff00cc",
+	"/api?logo_reset",
+	"/api?top_init&top=0|15|00ff00&top_morph=1000|5&bottom_init&bottom=0|15|00ff00&bottom_morph=1000|5",
+	"/api?top_init&top=0|1|ff0000&top_bg=00ff00&top_whirl=240|ccw&bottom_init&bottom=0|1|00ff00&bottom_bg=ff0000&bottom_whirl=190",
+	LONGEST_PRESET,
+	// malformed arguments are skipped the same way by both paths
+	"/api?top=1|2|zz&top=3|4|00ff00|5|&top_bg=12345&top_whirl=&bottom_morph=10&logo=ff00|00ff00|x",
+	"/api?bottom=|||&bottom_whirl=|ccw&top_morph=|5&logo_reset&unknown=1",
+	"/api?"
+};
+
+// rings and logo with their stripes, rendered to compare what the display would show
+class Scene {
+public:
+	Scene() : mTopStripe(RING_LEDCOUNT, GPIO_NUM_0, GPIO_NUM_0), mBottomStripe(RING_LEDCOUNT, GPIO_NUM_0, GPIO_NUM_0), mLogoStripe(4, GPIO_NUM_0, GPIO_NUM_0) {}
+
+	// a few frames, so whirl and morph are compared as well
+	std::vector<__uint8_t> Render(){
+		std::vector<__uint8_t> pixels;
+		for (int iFrame = 0; iFrame < 40; iFrame++){
+			mTop.Display(mTopStripe, true);
+			mBottom.Display(mBottomStripe, true);
+			mLogo.Display(mLogoStripe);
+			for (DotstarStripe* pStripe : { &mTopStripe, &mBottomStripe, &mLogoStripe })
+				for (__uint8_t i = 0; i < pStripe->getCount(); i++){
+					pixels.push_back(pStripe->getRed(i));
+					pixels.push_back(pStripe->getGreen(i));
+					pixels.push_back(pStripe->getBlue(i));
+				}
+		}
+		return pixels;
+	}
+
+	DisplayCharter mTop;
+	DisplayCharter mBottom;
+	DisplayCharterLogo mLogo;
+	DotstarStripe mTopStripe;
+	DotstarStripe mBottomStripe;
+	DotstarStripe mLogoStripe;
+};
+
+static void Parse(const char* sApi, std::list<TParam>& params){
+	UrlParser parser;
+	parser.ParseQuery(sApi, strlen(sApi), params);
+}
+
+
+TEST(applyShowsTheSameAsCompileAndExecute){
+	for (const char* sApi : APIS){
+		std::list<TParam> params;
+		Parse(sApi, params);
+		Scene compiled, applied;
+		DisplayCommand command;
+		CHECK(command.Compile(params));
+		command.Execute(&compiled.mTop, &compiled.mBottom, &compiled.mLogo);
+		DisplayCommand::Apply(params, &applied.mTop, &applied.mBottom, &applied.mLogo);
+		CHECK(compiled.Render() == applied.Render());
+	}
+}
+
+TEST(compiledProgramIsCompact){
+	DisplayCommand command;
+	CHECK(command.Compile(LONGEST_PRESET));
+	// init, leds, morph per ring and 4 logo LEDs
+	CHECK(command.GetLength() == 2 * (2 + 7 + 5) + 4 * 5);
+	CHECK(command.GetCode()[0] == DC_OP_INIT);
+	CHECK(command.Compile("/api?"));
+	CHECK(command.GetLength() == 0);
+}
+
+TEST(swapExchangesThePrograms){
+	DisplayCommand a, b;
+	CHECK(a.Compile("/api?logo_reset"));
+	const __uint8_t* pCode = a.GetCode();
+	a.Swap(b);
+	CHECK((a.GetLength() == 0) && (a.GetCode() == NULL));
+	CHECK((b.GetLength() == 1) && (b.GetCode() == pCode));
+	b.Swap(b);
+	CHECK((b.GetLength() == 1) && (b.GetCode() == pCode));
+}
+
+static std::vector<std::pair<std::string, std::vector<__uint8_t>>> ReadPackets(){
+	std::vector<std::pair<std::string, std::vector<__uint8_t>>> packets;
+	std::ifstream file(PACKET_FILE);
+	std::string sLine;
+	while (std::getline(file, sLine)){
+		size_t uTab = sLine.find('\t');
+		if (sLine.empty() || (sLine[0] == '#') || (uTab == std::string::npos))
+			continue;
+		std::vector<__uint8_t> packet;
+		for (size_t u = uTab + 1; u + 1 < sLine.size(); u += 2)
+			packet.push_back(strtol(sLine.substr(u, 2).c_str(), NULL, 16));
+		packets.push_back(std::make_pair(sLine.substr(0, uTab), packet));
+	}
+	return packets;
+}
+
+TEST(encodedPacketsShowTheSameAsTheirApiCall){
+	std::vector<std::pair<std::string, std::vector<__uint8_t>>> packets = ReadPackets();
+	CHECK(packets.size() >= 5);
+	for (auto& rPacket : packets){
+		const std::vector<__uint8_t>& rData = rPacket.second;
+		CHECK(DisplayCommand::ValidatePacket(rData.data(), rData.size()));
+		Scene sent, compiled;
+		DisplayCommand::ExecutePacket(rData.data(), rData.size(), &sent.mTop, &sent.mBottom, &sent.mLogo);
+		DisplayCommand command;
+		CHECK(command.Compile(rPacket.first.c_str()));
+		command.Execute(&compiled.mTop, &compiled.mBottom, &compiled.mLogo);
+		CHECK(sent.Render() == compiled.Render());
+	}
+}
+
+// a packet cut within an instruction or with any bad field is refused as a whole
+TEST(damagedPacketsAreRejected){
+	for (auto& rPacket : ReadPackets()){
+		std::vector<__uint8_t> data = rPacket.second;
+		size_t uBoundary = DC_HEADER_LENGTH;
+		for (size_t uLen = 0; uLen < data.size(); uLen++){
+			if (uLen == uBoundary){
+				CHECK(DisplayCommand::ValidatePacket(data.data(), uLen));
+				uBoundary += DisplayCommand::GetInstructionLength(data[uLen]);
+			}
+			else
+				CHECK(!DisplayCommand::ValidatePacket(data.data(), uLen));
+		}
+	}
+	const std::vector<std::vector<__uint8_t>> invalid = {
+		{ 0xDC, 0x02, DC_OP_LOGO_RESET },				// version
+		{ 0xCD, 0x01, DC_OP_LOGO_RESET },				// magic
+		{ 0xDC, 0x01, DC_OP_INIT, 2 },					// ring
+		{ 0xDC, 0x01, DC_OP_WHIRL, 0, 10, 2 },			// direction
+		{ 0xDC, 0x01, DC_OP_LOGO, 4, 1, 2, 3 },			// logo LED
+		{ 0xDC, 0x01, DC_OP_LOGO_RESET, 0x09 },			// opcode
+		{ 0xDC, 0x01, DC_OP_LOGO_RESET, 0x00 }
+	};
+	for (auto& rData : invalid)
+		CHECK(!DisplayCommand::ValidatePacket(rData.data(), rData.size()));
+	std::vector<__uint8_t> oversized(DC_MAX_PACKET + 1, DC_OP_LOGO_RESET);
+	oversized[0] = DC_MAGIC;
+	oversized[1] = DC_VERSION;
+	CHECK(!DisplayCommand::ValidatePacket(oversized.data(), oversized.size()));
+	CHECK(DisplayCommand::ValidatePacket(oversized.data(), DC_MAX_PACKET));
+}
+
+
+// /api?... from parsed params to the display state: the former compile+execute, the direct apply and a preset replay
+BENCH(apiCallPaths){
+	const int iRounds = 200000;
+	std::list<TParam> params;
+	Parse(LONGEST_PRESET, params);
+	Scene scene;
+
+	int64_t iStart = esp_timer_get_time();
+	for (int i = 0; i < iRounds; i++){
+		DisplayCommand command;
+		command.Compile(params);
+		command.Execute(&scene.mTop, &scene.mBottom, &scene.mLogo);
+	}
+	double dCompile = (esp_timer_get_time() - iStart) * 1000.0 / iRounds;
+
+	iStart = esp_timer_get_time();
+	for (int i = 0; i < iRounds; i++)
+		DisplayCommand::Apply(params, &scene.mTop, &scene.mBottom, &scene.mLogo);
+	double dApply = (esp_timer_get_time() - iStart) * 1000.0 / iRounds;
+
+	DisplayCommand preset;
+	preset.Compile(params);
+	iStart = esp_timer_get_time();
+	for (int i = 0; i < iRounds; i++)
+		preset.Execute(&scene.mTop, &scene.mBottom, &scene.mLogo);
+	double dReplay = (esp_timer_get_time() - iStart) * 1000.0 / iRounds;
+
+	printf("bench  longest preset: compile+execute %.0f ns, apply %.0f ns, replay %.0f ns\n", dCompile, dApply, dReplay);
+}
@@ -0,0 +1,194 @@
+#include "HostTest.h"
+#include "HostServer.h"
+#include "HostRtos.h"
+#include "HostUfo.h"
+#include "DynatraceIntegration.h"
+#include "DynatraceMonitoring.h"
+#include "DisplayCharter.h"
+#include "Config.h"
+#include "Wifi.h"
+#include "UrlParser.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STATUS		"{\"result\":{\"totalOpenProblemsCount\":1,\"openProblemCounts\":{\"APPLICATION\":1,\"SERVICE\":0}}}"
+#define EMPTY_FEED	"{\"result\":{\"problems\":[]}}"
+#define TOKEN		"webhook-token"
+
+static __uint64_t NowMs(){
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a Dynatrace tenant answering with the given body after the given delay, it keeps the times of the polls
+class Tenant {
+public:
+	Tenant(unsigned int uDelayMs, bool bStall = false, std::string sBody = STATUS) : mServer([this, uDelayMs, bStall, sBody](int s){
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mPolls.push_back(NowMs());
+			}
+			if (bStall)
+				return HostServer::WaitForClose(s);
+			std::this_thread::sleep_for(std::chrono::milliseconds(uDelayMs));
+			HostServer::Send(s, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(sBody.size()) + "\r\n\r\n" + sBody);
+		}) {}
+
+	std::vector<__uint64_t> GetPolls() { std::lock_guard<std::mutex> lock(mMutex); return mPolls; }
+
+	// the longest time between two polls
+	__uint64_t GetMaxGap() {
+		std::vector<__uint64_t> polls = GetPolls();
+		__uint64_t uMax = 0;
+		for (size_t u = 1; u < polls.size(); u++)
+			uMax = std::max(uMax, polls[u] - polls[u - 1]);
+		return uMax;
+	}
+
+	String Url() { return String(mServer.Url("http").substr(0, mServer.Url("http").size() - 5).c_str()); }
+
+private:
+	std::mutex mMutex;
+	std::vector<__uint64_t> mPolls;
+	HostServer mServer;
+};
+
+// the integration with Wifi connected, polling every second
+class Integration {
+public:
+	Integration() {
+		String sSsid = "ssid", sPass = "", sHostname = "ufo";
+		mWifi.StartSTAMode(sSsid, sPass, sHostname);
+		mMonitoring.Shutdown();
+		mConfig.mbDTEnabled = true;
+		mConfig.mbDTProblemDetails = false;
+		mConfig.miDTInterval = 1;
+		mConfig.msDTWebhookToken = "";
+		for (__uint8_t i = 0; i < DT_MAX_ENVIRONMENTS; i++)
+			mConfig.msDTEnvIdOrUrl[i] = "";
+		//the 5s start delay and the sleeps between the interval checks pass quickly, the interval is real time
+		HostRtosSetTimeScale(10);
+	}
+
+	~Integration() {
+		mConfig.mbDTEnabled = false;
+		mIntegration.ProcessConfigChange();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+		HostRtosSetTimeScale(100);
+	}
+
+	void Start(Tenant& rTenant, __uint8_t uEnvironment) {
+		mConfig.msDTEnvIdOrUrl[uEnvironment] = rTenant.Url();
+		mConfig.msDTApiToken[uEnvironment] = "token";
+	}
+
+	// the notification as go/src/webhooksender sends it
+	__uint16_t Notify(const char* sQuery, const char* sAuthorization, const char* sPid, const char* sState, const char* sImpact, const char* sSeverity) {
+		UrlParser parser;
+		std::list<TParam> params;
+		parser.ParseQuery(sQuery, strlen(sQuery), params);
+		String sAuth = sAuthorization;
+		String sBody;
+		sBody.printf("{\"PID\":\"%s\",\"ProblemID\":\"%s\",\"State\":\"%s\",\"ProblemImpact\":\"%s\",\"ProblemSeverity\":\"%s\"}",
+			sPid, sPid, sState, sImpact, sSeverity);
+		return mIntegration.HandleWebhook(params, sAuth, sBody);
+	}
+
+	void Run(unsigned int uMs) {
+		mIntegration.Init(&mMonitoring, &mConfig, &mWifi, &mLowerRing, &mUpperRing);
+		std::this_thread::sleep_for(std::chrono::milliseconds(uMs));
+	}
+
+	Config mConfig;
+	Wifi mWifi;
+	DynatraceMonitoring mMonitoring;
+	DisplayCharter mLowerRing;
+	DisplayCharter mUpperRing;
+	DynatraceIntegration mIntegration;
+};
+
+
+// the colors a ring shows right now
+static std::vector<__uint32_t> Colors(DisplayCharter& rRing){
+	DotstarStripe stripe(RING_LEDCOUNT, GPIO_NUM_0, GPIO_NUM_0);
+	rRing.Display(stripe, true);
+	std::vector<__uint32_t> colors;
+	for (__uint8_t i = 0; i < RING_LEDCOUNT; i++)
+		colors.push_back((stripe.getRed(i) << 16) | (stripe.getGreen(i) << 8) | stripe.getBlue(i));
+	return colors;
+}
+
+static size_t Count(const std::vector<__uint32_t>& rColors, __uint32_t uColor){
+	return std::count(rColors.begin(), rColors.end(), uColor);
+}
+
+
+TEST(stalledTenantDoesNotDelayTheOthers){
+	Tenant slow(0, true);
+	Tenant fast(0);
+	{
+		Integration integration;
+		integration.Start(slow, 0);
+		integration.Start(fast, 1);
+		integration.Run(4500);
+	}
+	CHECK(slow.GetPolls().size() == 1);
+	CHECK(fast.GetPolls().size() >= 3);
+	CHECK(fast.GetMaxGap() < 1500);
+}
+
+TEST(slowAnswersDoNotStretchTheInterval){
+	Tenant tenant(400);
+	{
+		Integration integration;
+		integration.Start(tenant, 0);
+		integration.Run(5000);
+	}
+	std::vector<__uint64_t> polls = tenant.GetPolls();
+	CHECK(polls.size() >= 4);
+	//counting down once per loop made every cycle last the interval plus the poll
+	CHECK((polls.back() - polls.front()) / (polls.size() - 1) < 1200);
+}
+
+TEST(webhookUpdatesTheProblemsAndRings){
+	Tenant tenant(0, false, EMPTY_FEED);
+	Integration integration;
+	integration.mConfig.mbDTProblemDetails = true;
+	integration.mConfig.msDTWebhookToken = TOKEN;
+	integration.Start(tenant, 0);
+	integration.Run(1500);
+	CHECK(tenant.GetPolls().size() == 1);
+	CHECK(Count(Colors(integration.mUpperRing), 0x00ff00) == RING_LEDCOUNT);
+
+	CHECK(integration.Notify("", "", "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 401);
+	CHECK(integration.Notify("", "Bearer " TOKEN "x", "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 401);
+	CHECK(integration.Notify("", "Bearer webhook-tokeN", "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 401);
+	CHECK(integration.Notify("token=x", "", "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 401);
+	CHECK(!integration.mIntegration.HasProblem(0, "-1000_1"));
+
+	CHECK(integration.Notify("env=2", "Bearer " TOKEN, "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 404);
+	CHECK(integration.Notify("env=4", "Bearer " TOKEN, "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 404);
+	CHECK(integration.Notify("env=0", "Bearer " TOKEN, "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 404);
+	CHECK(integration.Notify("", "Bearer " TOKEN, "", "OPEN", "APPLICATION", "AVAILABILITY") == 400);
+	CHECK(!integration.mIntegration.HasProblem(0, "-1000_1"));
+
+	CHECK(integration.Notify("env=1", "Bearer " TOKEN, "-1000_1", "OPEN", "APPLICATION", "AVAILABILITY") == 200);
+	CHECK(integration.Notify("token=" TOKEN, "", "-1000_2", "OPEN", "INFRASTRUCTURE", "RESOURCE_CONTENTION") == 200);
+	CHECK(integration.mIntegration.HasProblem(0, "-1000_1") && integration.mIntegration.HasProblem(0, "-1000_2"));
+	std::vector<__uint32_t> upper = Colors(integration.mUpperRing);
+	std::vector<__uint32_t> lower = Colors(integration.mLowerRing);
+	CHECK((Count(upper, 0xff0000) == 1) && (Count(upper, 0xffaa00) == 1) && (Count(upper, 0) == RING_LEDCOUNT - 2));
+	CHECK((Count(lower, 0xff0000) == 1) && (Count(lower, 0xffff00) == 1) && (Count(lower, 0) == RING_LEDCOUNT - 2));
+
+	CHECK(integration.Notify("", "Bearer " TOKEN, "-1000_1", "RESOLVED", "APPLICATION", "AVAILABILITY") == 200);
+	CHECK(!integration.mIntegration.HasProblem(0, "-1000_1") && integration.mIntegration.HasProblem(0, "-1000_2"));
+	upper = Colors(integration.mUpperRing);
+	CHECK((Count(upper, 0xff0000) == 0) && (Count(upper, 0xffaa00) == 1));
+	CHECK(integration.Notify("", "Bearer " TOKEN, "-1000_2", "RESOLVED", "INFRASTRUCTURE", "RESOURCE_CONTENTION") == 200);
+	CHECK(!integration.mIntegration.HasProblem(0, "-1000_2"));
+	CHECK(Count(Colors(integration.mUpperRing), 0x00ff00) == RING_LEDCOUNT);
+	CHECK(tenant.GetPolls().size() == 1);
+}
@@ -0,0 +1,454 @@
+#include "HostTest.h"
+#include "HostSystem.h"
+#include "HostUfo.h"
+#include "HostRtos.h"
+#include "DynatraceMonitoring.h"
+#include "MonitoringClock.h"
+#include "AWSIntegration.h"
+#include "Wifi.h"
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// decodes the CBOR items the monitoring payload uses into diagnostic notation, e.g. [1, -2, "x", {"k": 3}]
+static std::string Cbor(const char*& p, const char* pEnd){
+	if (p >= pEnd)
+		return "<truncated>";
+	__uint8_t uHead = *p++;
+	__uint8_t uMajor = uHead >> 5;
+	__uint8_t uInfo = uHead & 0x1f;
+	if (uHead == 0x9f){
+		std::string s = "[_ ";
+		for (bool bFirst = true; (p < pEnd) && ((__uint8_t)*p != 0xff); bFirst = false)
+			s += (bFirst ? "" : ", ") + Cbor(p, pEnd);
+		p++;
+		return s + "]";
+	}
+	__uint64_t uValue = uInfo;
+	if (uInfo >= 24){
+		int iBytes = 1 << (uInfo - 24);
+		uValue = 0;
+		for (int i = 0; (i < iBytes) && (p < pEnd); i++)
+			uValue = (uValue << 8) | (__uint8_t)*p++;
+	}
+	std::string s;
+	switch (uMajor){
+		case 0:
+			return std::to_string(uValue);
+		case 1:
+			return std::to_string(-1 - (__int64_t)uValue);
+		case 3:
+			s = "\"" + std::string(p, uValue) + "\"";
+			p += uValue;
+			return s;
+		case 4:
+			s = "[";
+			for (__uint64_t u = 0; u < uValue; u++)
+				s += (u ? ", " : "") + Cbor(p, pEnd);
+			return s + "]";
+		case 5:
+			s = "{";
+			for (__uint64_t u = 0; u < uValue; u++){
+				s += (u ? ", " : "") + Cbor(p, pEnd);
+				s += ": " + Cbor(p, pEnd);
+			}
+			return s + "}";
+	}
+	return "<unsupported>";
+}
+
+static std::string Cbor(PayloadWriter& rWriter){
+	const char* p = rWriter.GetData();
+	std::string s = Cbor(p, p + rWriter.GetLength());
+	return (p == rWriter.GetData() + rWriter.GetLength()) ? s : s + " <trailing bytes>";
+}
+
+static std::string Json(PayloadWriter& rWriter){
+	return std::string(rWriter.GetData(), rWriter.GetLength());
+}
+
+// value of a quoted number in the JSON of an action
+static __uint64_t JsonNumber(const std::string& sJson, const char* sKey){
+	size_t uPos = sJson.find(std::string("\"") + sKey + "\":\"");
+	return (uPos == std::string::npos) ? ~0ull : strtoull(sJson.c_str() + uPos + strlen(sKey) + 4, NULL, 10);
+}
+
+// the action as it was serialized before the writer, with one String::printf per field
+static String PrintfPayload(DynatraceAction* pAction, std::vector<__uint64_t>& rValues){
+	String sPayload = "{";
+	sPayload.printf("\"name\":\"%s\",", pAction->getName());
+	sPayload.printf("\"type\":\"%u\",", (unsigned int)rValues[1]);
+	sPayload.printf("\"id\":\"%u\",", (unsigned int)rValues[2]);
+	sPayload.printf("\"parent\":\"%u\",", (unsigned int)rValues[3]);
+	sPayload.printf("\"s0\":\"%u\",", (unsigned int)rValues[4]);
+	sPayload.printf("\"start\":\"%llu\",", (unsigned long long)rValues[5]);
+	sPayload.printf("\"t0\":\"%llu\",", (unsigned long long)rValues[5]);
+	sPayload.printf("\"s1\":\"%u\",", (unsigned int)rValues[6]);
+	sPayload.printf("\"end\":\"%llu\",", (unsigned long long)rValues[7]);
+	sPayload.printf("\"t1\":\"%llu\"", (unsigned long long)rValues[7]);
+	if (rValues.size() > 8){
+		sPayload.printf(",\"network\": {");
+		sPayload.printf("\"responseCode\":\"%u\",", (unsigned int)rValues[8]);
+		sPayload.printf("\"bytesSent\":\"%u\",", 0);
+		sPayload.printf("\"bytesReceived\":\"%u\"", (unsigned int)rValues[9]);
+		sPayload.printf("}");
+	}
+	sPayload.printf("}");
+	return sPayload;
+}
+
+// the elements of the "batches" array of the ring log
+static std::vector<std::string> RingLogBatches(RingLogExporter& rRingLog){
+	String sBody;
+	rRingLog.WriteJson(sBody);
+	std::string sJson = sBody.c_str();
+	std::vector<std::string> batches;
+	size_t uStart = sJson.find("\"batches\":[") + 11;
+	int iDepth = 0;
+	bool bString = false;
+	for (size_t u = uStart; u < sJson.size(); u++){
+		char c = sJson[u];
+		if (bString)
+			bString = (c != '"') || (sJson[u - 1] == '\\');
+		else if (c == '"')
+			bString = true;
+		else if (c == '{')
+			iDepth++;
+		else if ((c == '}') && !--iDepth){
+			batches.push_back(sJson.substr(uStart, u + 1 - uStart));
+			uStart = u + 2;
+		}
+	}
+	return batches;
+}
+
+static DynatraceAction* WebRequest(DynatraceMonitoring& rMon, const char* sUrl){
+	DynatraceAction* pAction = rMon.enterAction("Dynatrace poll", WEBREQUEST);
+	HostSystemAdvanceTime(1500);
+	String sHost = sUrl;
+	rMon.leaveAction(pAction, &sHost, 200, 1234);
+	return pAction;
+}
+
+
+TEST(writerEscapesJsonStrings){
+	PayloadWriter writer;
+	writer.AppendJsonString("a\"b\\c\nd\x01");
+	CHECK(Json(writer) == "\"a\\\"b\\\\c\\u000ad\\u0001\"");
+	writer.Reset();
+	writer.AppendQuotedUint(4294967296ull);
+	writer.Append(',');
+	writer.AppendQuotedInt(-57);
+	CHECK(Json(writer) == "\"4294967296\",\"-57\"");
+}
+
+TEST(writerEncodesCborHeads){
+	PayloadWriter writer;
+	__uint64_t uValues[] = { 0, 23, 24, 255, 256, 65535, 65536, 4294967295ull, 4294967296ull };
+	size_t uSizes[] = { 1, 1, 2, 2, 3, 3, 5, 5, 9 };
+	for (size_t i = 0; i < sizeof(uValues) / sizeof(uValues[0]); i++){
+		writer.Reset();
+		writer.CborUint(uValues[i]);
+		CHECK(writer.GetLength() == uSizes[i]);
+		CHECK(Cbor(writer) == std::to_string(uValues[i]));
+	}
+	writer.Reset();
+	writer.CborMap(2);
+	writer.CborText("rssi");
+	writer.CborInt(-57);
+	writer.CborText("actions");
+	writer.CborArrayBegin();
+	writer.CborArray(2);
+	writer.CborInt(-500);
+	writer.CborText("");
+	writer.CborBreak();
+	CHECK(Cbor(writer) == "{\"rssi\": -57, \"actions\": [_ [-500, \"\"]]}");
+}
+
+TEST(writerKeepsItsMemory){
+	PayloadWriter writer;
+	CHECK(writer.Reserve(4096));
+	const char* pBuffer = writer.GetData();
+	for (int i = 0; i < 100; i++)
+		writer.Append("0123456789012345678901234567890123456789");
+	CHECK((writer.GetLength() == 4000) && (writer.GetData() == pBuffer));
+	writer.Truncate(10);
+	CHECK(writer.GetLength() == 10);
+	writer.Reset();
+	CHECK((writer.GetLength() == 0) && (writer.GetCapacity() == 4096));
+}
+
+// a write that does not fit fails before it copies anything, the buffer is neither grown nor moved
+TEST(writerStopsAtItsLimit){
+	PayloadWriter writer;
+	writer.SetLimit(64);
+	CHECK(writer.Reserve(64));
+	const char* pBuffer = writer.GetData();
+	CHECK(writer.Append("0123456789012345678901234567890123456789"));
+	CHECK(!writer.AppendJsonString("\x01\x02\x03\x04\x05"));
+	CHECK(!writer.IsValid());
+	CHECK((writer.GetCapacity() == 64) && (writer.GetData() == pBuffer));
+	writer.Truncate(40);
+	CHECK(writer.IsValid() && (writer.GetLength() == 40));
+	CHECK(writer.AppendQuotedUint(4294967296ull));
+	writer.SetLimit(80);
+	CHECK(writer.Append("0123456789012345678901234567"));
+	CHECK((writer.GetLength() == 80) && (writer.GetCapacity() == 80));
+
+	// growing on demand stops at the limit as well
+	PayloadWriter grown;
+	grown.SetLimit(1500);
+	for (int i = 0; i < 37; i++)
+		grown.Append("0123456789012345678901234567890123456789");
+	CHECK(grown.IsValid() && (grown.GetCapacity() == 1500));
+	CHECK(!grown.Append("0123456789012345678901234567890123456789"));
+	CHECK(grown.GetCapacity() == 1500);
+}
+
+// both formats carry the same values, JSON as quoted numbers in ms, CBOR as integers in us
+TEST(actionJsonAndCborAgree){
+	DynatraceMonitoring mon;
+	DynatraceAction* pAction = WebRequest(mon, "collector.example.com");
+	PayloadWriter json, cbor;
+	pAction->writeJson(json);
+	pAction->writeCbor(cbor);
+	std::string sJson = Json(json);
+
+	CHECK(sJson.find("{\"name\":\"collector.example.com\",\"type\":\"30\",") == 0);
+	CHECK(sJson.find(",\"network\":{\"responseCode\":\"200\",\"bytesSent\":\"0\",\"bytesReceived\":\"1234\"}}") != std::string::npos);
+	CHECK(JsonNumber(sJson, "t1us") >= 1500);
+	// start and end are truncated to ms separately
+	CHECK(JsonNumber(sJson, "end") - JsonNumber(sJson, "start") - JsonNumber(sJson, "t1") <= 1);
+
+	char sExpected[128];
+	sprintf(sExpected, "[%u, 30, %u, 0, %u, ", pAction->getNameId(), (unsigned int)JsonNumber(sJson, "id"), (unsigned int)JsonNumber(sJson, "s0"));
+	std::string sCbor = Cbor(cbor);
+	CHECK(sCbor.find(sExpected) == 0);
+	sprintf(sExpected, ", %u, %u, 200, 1234]", (unsigned int)JsonNumber(sJson, "s1"), (unsigned int)JsonNumber(sJson, "t1us"));
+	CHECK(sCbor.find(sExpected) == sCbor.size() - strlen(sExpected));
+	CHECK(!strcmp(mon.getActionName(pAction->getNameId()), "collector.example.com"));
+}
+
+static __uint64_t uTestBoot;
+
+static __uint64_t TestNow(){
+	return uTestBoot;
+}
+
+static __int64_t TestWallClock(){
+	return 1577836800000000ll + uTestBoot;	// 2020-01-01, synchronized from the start
+}
+
+// with a clock under control of the test the values are exact, also below 1 ms
+TEST(actionTimesUseTheClock){
+	uTestBoot = 1000000;
+	MonitoringClock::SetSources(TestNow, TestWallClock);
+	DynatraceMonitoring mon;
+	uTestBoot += 2500;
+	DynatraceAction* pAction = mon.enterAction("Display");
+	uTestBoot += 700;
+	mon.leaveAction(pAction);
+	CHECK(MonitoringClock::Align());
+
+	PayloadWriter json, cbor;
+	pAction->writeJson(json);
+	pAction->writeCbor(cbor);
+	std::string sJson = Json(json);
+	CHECK(JsonNumber(sJson, "start") == 1577836800000ull + 1002);
+	CHECK(JsonNumber(sJson, "end") == 1577836800000ull + 1003);
+	CHECK(JsonNumber(sJson, "t0") == 1002);	// relative to boot, Init() has not started a session
+	CHECK(JsonNumber(sJson, "t1") == 0);
+	CHECK(JsonNumber(sJson, "t1us") == 700);
+	std::string sCbor = Cbor(cbor);
+	CHECK(sCbor.find(", 1002500, ") != std::string::npos);
+	CHECK(sCbor.find(", 700]") == sCbor.size() - strlen(", 700]"));
+	MonitoringClock::SetSources(NULL, NULL);
+}
+
+TEST(actionNamesAreInterned){
+	DynatraceMonitoring mon;
+	DynatraceAction* p1 = mon.enterAction("Display");
+	DynatraceAction* p2 = mon.enterAction("Display");
+	DynatraceAction* p3 = WebRequest(mon, "Display");
+	CHECK((p1->getNameId() == p2->getNameId()) && (p1->getNameId() == p3->getNameId()));
+	for (int i = 0; i < DT_MAX_ACTION_NAMES + 5; i++){
+		char sName[16];
+		sprintf(sName, "host%d", i);
+		String sHost = sName;
+		DynatraceAction* p = mon.enterAction("poll", WEBREQUEST);
+		mon.leaveAction(p, &sHost, 200, 0);
+		// the table is full at some point, further names are reported as unknown
+		CHECK((p->getNameId() < DT_MAX_ACTION_NAMES) ? !strcmp(mon.getActionName(p->getNameId()), sName) : !strcmp(p->getName(), "unknown"));
+		mon.releaseAction(p);
+	}
+}
+
+// the monitoring task against the ring log: all actions get processed, no batch exceeds the max. payload of the exporter
+TEST(monitoringTaskExportsBatches){
+	// the task is not stopped, everything it uses lives until the process ends
+	Config* pConfig = new Config();
+	pConfig->mbDTMonitoring = true;
+	pConfig->muDTMonitoringExporter = DT_EXPORTER_RINGLOG;
+	pConfig->mbDTPublicIpLookup = false;
+	Wifi* pWifi = new Wifi();
+	String sSsid = "ssid", sPass = "", sHostname = "ufo";
+	pWifi->StartSTAMode(sSsid, sPass, sHostname);
+	TExporterContext context = { pConfig, pWifi, new AWSIntegration(), new String("ufo-1234") };
+	DynatraceMonitoring* pMon = new DynatraceMonitoring();
+	CHECK(pMon->Init(context));
+	for (int i = 0; (i < 500) && strcmp(pMon->getExporterName(), "ringlog"); i++)
+		usleep(10000);
+	CHECK(!strcmp(pMon->getExporterName(), "ringlog"));
+
+	for (int i = 0; i < 300; i++){
+		DynatraceAction* pAction;
+		while (!(pAction = pMon->enterAction("Dynatrace poll", WEBREQUEST)))
+			std::this_thread::yield();
+		char sHost[48];
+		sprintf(sHost, "environment-%02d.live.dynatrace.com", i % 40);
+		String sUrl = sHost;
+		pMon->leaveAction(pAction, &sUrl, 200, i);
+	}
+	pMon->ProcessConfigChange();	// wakes the task, the last actions don't wait for the max. age
+	for (int i = 0; (i < 500) && pMon->getPoolInUse(); i++)
+		usleep(10000);
+	CHECK(pMon->getPoolInUse() == 0);
+	CHECK(pMon->getBatchesDropped() == 0);
+
+	std::vector<std::string> batches = RingLogBatches(pMon->getRingLog());
+	CHECK(batches.size() == RINGLOG_BATCHES);
+	for (auto& sBatch : batches){
+		CHECK(sBatch.size() <= pMon->getRingLog().GetSettings().uMaxPayload);
+		CHECK(sBatch.find("\"id\":\"ufo-1234\"") != std::string::npos);
+		CHECK(sBatch.find("\"actions\":[{\"name\":\"environment-") != std::string::npos);
+		CHECK(sBatch.find("}]}") == sBatch.size() - 3);
+	}
+	pConfig->mbDTMonitoring = false;
+}
+
+static bool WaitFor(std::function<bool()> condition){
+	for (int i = 0; (i < 500) && !condition(); i++)
+		usleep(10000);
+	return condition();
+}
+
+// disabling hands the shutdown to the monitoring task, which owns the retry queue - also with MQTT, where the exporter stays active
+TEST(disablingStopsTheTaskWithQueuedRetries){
+	// the task is not stopped, everything it uses lives until the process ends
+	Config* pConfig = new Config();
+	pConfig->mbDTMonitoring = true;
+	pConfig->muDTMonitoringExporter = DT_EXPORTER_MQTT;
+	pConfig->mbDTPublicIpLookup = false;
+	Wifi* pWifi = new Wifi();
+	String sSsid = "ssid", sPass = "", sHostname = "ufo";
+	pWifi->StartSTAMode(sSsid, sPass, sHostname);
+	AWSIntegration* pAws = new AWSIntegration();
+	pAws->mActive = true;
+	HostAwsFailPublish(true);
+	HostRtosSetTimeScale(1);	// the task wakes up every 300ms instead of 30s
+	TExporterContext context = { pConfig, pWifi, pAws, new String("ufo-1234") };
+	DynatraceMonitoring* pMon = new DynatraceMonitoring();
+	CHECK(pMon->Init(context));
+
+	for (int iRound = 0; iRound < 10; iRound++){
+		if (iRound){
+			pConfig->mbDTMonitoring = true;
+			pMon->ProcessConfigChange();
+		}
+		CHECK(WaitFor([pMon](){ return pMon->mActive && !strcmp(pMon->getExporterName(), "mqtt"); }));
+		// every wake up publishes a batch, which fails and waits for a retry
+		for (int i = 0; i < 3; i++){
+			pMon->leaveAction(pMon->enterAction("Display"));
+			pMon->ProcessConfigChange();
+			usleep(5000);
+		}
+		CHECK(WaitFor([pMon](){ return pMon->getBatchesWaiting() > 0; }));
+
+		pConfig->mbDTMonitoring = false;
+		pMon->ProcessConfigChange();
+		pMon->ProcessConfigChange();
+		CHECK(WaitFor([pMon](){ return !pMon->mActive && !pMon->getBatchesWaiting(); }));
+		usleep(20000);	// the task clears its handle after the shutdown
+	}
+	// a disabled task used to activate the monitoring again with its next batch
+	usleep(1000000);
+	CHECK(!pMon->mActive);
+	CHECK(pMon->enterAction("Display") == NULL);
+	CHECK(pMon->getBatchesWaiting() == 0);
+	CHECK(pMon->getPoolInUse() == 0);
+	HostAwsFailPublish(false);
+	HostRtosSetTimeScale(100);
+}
+
+
+BENCH(serializeActions){
+	DynatraceMonitoring mon;
+	std::vector<DynatraceAction*> actions;
+	for (int i = 0; i < 32; i++){
+		if (i % 2)
+			actions.push_back(WebRequest(mon, "abc12345.live.dynatrace.com"));
+		else {
+			DynatraceAction* p = mon.enterAction("Display");
+			mon.leaveAction(p);
+			actions.push_back(p);
+		}
+	}
+	// the values for the String::printf variant, taken from the CBOR encoding
+	std::vector< std::vector<__uint64_t> > values;
+	for (auto p : actions){
+		PayloadWriter cbor;
+		p->writeCbor(cbor);
+		std::vector<__uint64_t> v;
+		std::string s = Cbor(cbor);
+		for (const char* pNumber = s.c_str() + 1; *pNumber; pNumber = strchr(pNumber, ',') ? strchr(pNumber, ',') + 1 : "")
+			v.push_back(strtoull(pNumber, NULL, 10));
+		values.push_back(v);
+	}
+
+	const int iRounds = 2000;
+	size_t uBytes[3] = { 0, 0, 0 };
+	int64_t iTime[3];
+	PayloadWriter writer;
+	writer.Reserve(16384);
+
+	int64_t iStart = esp_timer_get_time();
+	for (int r = 0; r < iRounds; r++){
+		String sBatch;
+		for (size_t i = 0; i < actions.size(); i++){
+			if (i)
+				sBatch += ',';
+			sBatch += PrintfPayload(actions[i], values[i]);
+		}
+		uBytes[0] = sBatch.length();
+	}
+	iTime[0] = esp_timer_get_time() - iStart;
+
+	iStart = esp_timer_get_time();
+	for (int r = 0; r < iRounds; r++){
+		writer.Reset();
+		for (size_t i = 0; i < actions.size(); i++){
+			if (i)
+				writer.Append(',');
+			actions[i]->writeJson(writer);
+		}
+		uBytes[1] = writer.GetLength();
+	}
+	iTime[1] = esp_timer_get_time() - iStart;
+
+	iStart = esp_timer_get_time();
+	for (int r = 0; r < iRounds; r++){
+		writer.Reset();
+		writer.CborArrayBegin();
+		for (auto p : actions)
+			p->writeCbor(writer);
+		writer.CborBreak();
+		uBytes[2] = writer.GetLength();
+	}
+	iTime[2] = esp_timer_get_time() - iStart;
+
+	const char* sNames[] = { "String::printf JSON", "PayloadWriter JSON", "PayloadWriter CBOR" };
+	for (int i = 0; i < 3; i++)
+		printf("bench  %-20s %6.0f ns per action, %4u bytes per action\n", sNames[i],
+			iTime[i] * 1000.0 / (iRounds * actions.size()), (unsigned int)(uBytes[i] / actions.size()));
+}
@@ -0,0 +1,198 @@
+#include "HostTest.h"
+#include "DynatraceProblems.h"
+#include <string>
+
+static const char* FEED =
+	"{\"result\":{\"problems\":["
+	"{\"id\":\"-1_1500\",\"displayName\":\"P1\",\"impactLevel\":\"APPLICATION\",\"status\":\"OPEN\",\"severityLevel\":\"ERROR\","
+		"\"startTime\":1500000000000,\"rankedImpacts\":[{\"id\":\"nested\",\"impactLevel\":\"SERVICE\",\"status\":\"CLOSED\"}],\"tags\":[]},"
+	"{\"id\":\"-2_1501\",\"impactLevel\":\"SERVICE\",\"status\":\"CLOSED\",\"severityLevel\":\"AVAILABILITY\"},"
+	"{\"displayName\":\"with \\\"quotes\\\" and \\\\ [brackets] {braces}\",\"id\":\"-3_1502\",\"impactLevel\":\"INFRASTRUCTURE\","
+		"\"severityLevel\":\"AVAILABILITY\",\"status\":\"OPEN\",\"x\":null,\"y\":true,\"z\":-1.5E+3}"
+	"],\"monitored\":{\"problems\":[{\"id\":\"other\",\"status\":\"OPEN\"}]}}}";
+
+
+static void Feed(DynatraceProblemFeedParser& rParser, const std::string& sFeed, size_t uChunk){
+	rParser.OnReceiveBegin(200, false, 0);
+	for (size_t u = 0; u < sFeed.size(); u += uChunk){
+		std::string sPart = sFeed.substr(u, uChunk);
+		rParser.OnReceiveData((char*)sPart.data(), sPart.size());
+	}
+	rParser.OnReceiveEnd();
+}
+
+static bool CheckFeed(DynatraceProblemFeedParser& rParser){
+	TDtProblem* p = rParser.GetProblems();
+	return rParser.IsValid() && (rParser.GetCount() == 2) && (rParser.GetTotalCount() == 2)
+		&& !strcmp(p[0].sId, "-1_1500") && (p[0].uImpact == DT_IMPACT_APPLICATION) && (p[0].uSeverity == DT_SEVERITY_ERROR) && (p[0].uStartTime == 1500000000)
+		&& !strcmp(p[1].sId, "-3_1502") && (p[1].uImpact == DT_IMPACT_INFRASTRUCTURE) && (p[1].uSeverity == DT_SEVERITY_AVAILABILITY);
+}
+
+static TDtProblem Problem(const char* sId, __uint8_t uImpact){
+	TDtProblem problem;
+	memset(&problem, 0, sizeof(problem));
+	strcpy(problem.sId, sId);
+	problem.uImpact = uImpact;
+	problem.uSeverity = DT_SEVERITY_ERROR;
+	return problem;
+}
+
+
+TEST(feedInOneChunk){
+	DynatraceProblemFeedParser parser;
+	Feed(parser, FEED, strlen(FEED));
+	CHECK(CheckFeed(parser));
+}
+
+TEST(feedSplitAtEveryPosition){
+	std::string sFeed = FEED;
+	for (size_t uSplit = 1; uSplit < sFeed.size(); uSplit++){
+		DynatraceProblemFeedParser parser;
+		parser.OnReceiveBegin(200, true, sFeed.size());
+		parser.OnReceiveData((char*)sFeed.data(), uSplit);
+		parser.OnReceiveData((char*)sFeed.data() + uSplit, sFeed.size() - uSplit);
+		parser.OnReceiveEnd();
+		if (!CheckFeed(parser)){
+			printf("split at %u\n", (unsigned int)uSplit);
+			CHECK(false);
+			break;
+		}
+	}
+}
+
+TEST(feedInSmallChunks){
+	for (size_t uChunk = 1; uChunk <= 17; uChunk++){
+		DynatraceProblemFeedParser parser;
+		Feed(parser, FEED, uChunk);
+		CHECK(CheckFeed(parser));
+	}
+}
+
+TEST(parserIsReusable){
+	DynatraceProblemFeedParser parser;
+	Feed(parser, "{\"result\":{\"problems\":[]}}", 5);
+	CHECK(parser.IsValid());
+	CHECK(parser.GetCount() == 0);
+	Feed(parser, FEED, 3);
+	CHECK(CheckFeed(parser));
+}
+
+TEST(feedWithMoreProblemsThanSegments){
+	std::string sFeed = "{\"result\":{\"problems\":[";
+	for (int i = 0; i < DT_MAX_PROBLEMS + 5; i++){
+		char sProblem[128];
+		sprintf(sProblem, "%s{\"id\":\"p%d\",\"status\":\"OPEN\",\"impactLevel\":\"%s\"}", i ? "," : "", i, (i == DT_MAX_PROBLEMS + 2) ? "APPLICATION" : "INFRASTRUCTURE");
+		sFeed += sProblem;
+	}
+	sFeed += "]}}";
+	DynatraceProblemFeedParser parser;
+	Feed(parser, sFeed, 7);
+	CHECK(parser.IsValid());
+	CHECK(parser.GetCount() == DT_MAX_PROBLEMS);
+	CHECK(parser.GetTotalCount() == DT_MAX_PROBLEMS + 5);
+	// the application problem beyond the table replaced an infrastructure problem
+	bool bApplication = false;
+	for (int i = 0; i < parser.GetCount(); i++)
+		bApplication |= (parser.GetProblems()[i].uImpact == DT_IMPACT_APPLICATION);
+	CHECK(bApplication);
+}
+
+TEST(feedIdIsTruncated){
+	std::string sId(DT_PROBLEM_ID_LENGTH + 10, 'x');
+	std::string sFeed = "{\"result\":{\"problems\":[{\"id\":\"" + sId + "\",\"status\":\"OPEN\"}]}}";
+	DynatraceProblemFeedParser parser;
+	Feed(parser, sFeed, 4);
+	CHECK(parser.GetCount() == 1);
+	CHECK(strlen(parser.GetProblems()[0].sId) == DT_PROBLEM_ID_LENGTH - 1);
+}
+
+TEST(invalidFeeds){
+	DynatraceProblemFeedParser parser;
+	Feed(parser, "{\"result\":{\"totalOpenProblemsCount\":3}}", 4);
+	CHECK(!parser.IsValid());
+
+	parser.OnReceiveBegin(401, false, 0);
+	parser.OnReceiveData((char*)FEED, strlen(FEED));
+	parser.OnReceiveEnd();
+	CHECK(!parser.IsValid());
+
+	// a feed that was cut off is not finished
+	parser.OnReceiveBegin(200, false, 0);
+	parser.OnReceiveData((char*)FEED, 40);
+	CHECK(!parser.IsValid());
+}
+
+
+TEST(tableKeepsSlotsStable){
+	DynatraceProblemTable table;
+	TDtProblem problems[3] = { Problem("a", DT_IMPACT_APPLICATION), Problem("b", DT_IMPACT_SERVICE), Problem("c", DT_IMPACT_INFRASTRUCTURE) };
+	CHECK(table.Apply(0, problems, 3));
+	CHECK(!table.Apply(0, problems, 3));
+	CHECK(table.Find(0, "b")->uSlot == 1);
+
+	// a closes, b and c keep their segments, d takes the free one
+	TDtProblem next[3] = { problems[1], problems[2], Problem("d", DT_IMPACT_SERVICE) };
+	CHECK(table.Apply(0, next, 3));
+	CHECK(!table.Find(0, "a"));
+	CHECK(table.Find(0, "b")->uSlot == 1);
+	CHECK(table.Find(0, "c")->uSlot == 2);
+	CHECK(table.Find(0, "d")->uSlot == 0);
+	CHECK(table.GetSlot(0) == table.Find(0, "d"));
+
+	int iApplication, iService, iInfrastructure;
+	CHECK(table.GetCount(&iApplication, &iService, &iInfrastructure) == 3);
+	CHECK((iApplication == 0) && (iService == 2) && (iInfrastructure == 1));
+}
+
+TEST(tableSeparatesEnvironments){
+	DynatraceProblemTable table;
+	TDtProblem problem = Problem("same", DT_IMPACT_SERVICE);
+	CHECK(table.Apply(0, &problem, 1));
+	CHECK(table.Apply(1, &problem, 1));
+	CHECK(table.Find(0, "same") != table.Find(1, "same"));
+
+	// an empty poll of one environment does not touch the other
+	CHECK(table.Apply(0, NULL, 0));
+	CHECK(!table.Find(0, "same"));
+	CHECK(table.Find(1, "same"));
+	CHECK(table.RemoveEnvironment(1));
+	CHECK(!table.RemoveEnvironment(1));
+}
+
+TEST(tableUpsertAndRemove){
+	DynatraceProblemTable table;
+	TDtProblem problem = Problem("n", DT_IMPACT_SERVICE);
+	CHECK(table.Upsert(2, problem));
+	CHECK(!table.Upsert(2, problem));
+	problem.uImpact = DT_IMPACT_APPLICATION;
+	CHECK(table.Upsert(2, problem));
+	CHECK(table.Find(2, "n")->uImpact == DT_IMPACT_APPLICATION);
+	CHECK(table.Remove(2, "n"));
+	CHECK(!table.Remove(2, "n"));
+
+	for (int i = 0; i < DT_MAX_PROBLEMS; i++){
+		char sId[8];
+		sprintf(sId, "%d", i);
+		TDtProblem p = Problem(sId, DT_IMPACT_SERVICE);
+		CHECK(table.Upsert(0, p));
+	}
+	TDtProblem full = Problem("full", DT_IMPACT_SERVICE);
+	CHECK(!table.Upsert(0, full));
+}
+
+TEST(tableFullReplacesClosedProblem){
+	DynatraceProblemTable table;
+	TDtProblem problems[DT_MAX_PROBLEMS];
+	for (int i = 0; i < DT_MAX_PROBLEMS; i++){
+		char sId[8];
+		sprintf(sId, "%d", i);
+		problems[i] = Problem(sId, DT_IMPACT_SERVICE);
+	}
+	CHECK(table.Apply(0, problems, DT_MAX_PROBLEMS));
+
+	// problem 4 closes and a new one opens within the same poll - it takes segment 4 right away
+	problems[4] = Problem("new", DT_IMPACT_APPLICATION);
+	CHECK(table.Apply(0, problems, DT_MAX_PROBLEMS));
+	CHECK(!table.Find(0, "4"));
+	CHECK(table.Find(0, "new") && (table.Find(0, "new")->uSlot == 4));
+}
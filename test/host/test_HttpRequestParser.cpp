@@ -0,0 +1,106 @@
+#include "HostTest.h"
+#include "HttpRequestParser.h"
+#include <string>
+
+static const char* WEBHOOK =
+	"POST /dynatracewebhook?env=2 HTTP/1.1\r\n"
+	"Host: ufo\r\n"
+	"Authorization: Bearer s3cr3t-token\r\n"
+	"Content-Type: application/json\r\n"
+	"Content-Length: 34\r\n"
+	"\r\n"
+	"{\"PID\":\"-1_1\",\"State\":\"RESOLVED\"}\n";
+
+
+static void Parse(HttpRequestParser& rParser, const std::string& sRequest, size_t uSplit){
+	rParser.Init(NULL);
+	rParser.ParseRequest((char*)sRequest.data(), uSplit);
+	rParser.ParseRequest((char*)sRequest.data() + uSplit, sRequest.size() - uSplit);
+}
+
+static String Param(HttpRequestParser& rParser, const char* sName){
+	for (std::list<TParam>::iterator it = rParser.GetParams().begin(); it != rParser.GetParams().end(); it++){
+		if ((*it).paramName == sName)
+			return (*it).paramValue;
+	}
+	return String();
+}
+
+
+TEST(webhookSplitAtEveryPosition){
+	std::string sRequest = WEBHOOK;
+	for (size_t uSplit = 1; uSplit < sRequest.size(); uSplit++){
+		HttpRequestParser parser(0);
+		Parse(parser, sRequest, uSplit);
+		bool bOk = parser.RequestFinished() && !parser.GetError() && !parser.IsGet()
+			&& parser.GetUrl().equals("/dynatracewebhook") && (Param(parser, "env") == "2")
+			&& parser.GetAuthorization().equals("Bearer s3cr3t-token")
+			&& parser.GetBody().startsWith("{\"PID\":\"-1_1\"");
+		if (!bOk){
+			printf("split at %u\n", (unsigned int)uSplit);
+			CHECK(false);
+			break;
+		}
+	}
+}
+
+TEST(authorizationOnGet){
+	HttpRequestParser parser(0);
+	std::string sRequest = "GET /info HTTP/1.1\r\nauthorization:Bearer x\r\nConnection: keep-alive\r\n\r\n";
+	Parse(parser, sRequest, 5);
+	CHECK(parser.RequestFinished());
+	CHECK(parser.GetAuthorization().equals("Bearer x"));
+	CHECK(!parser.IsConnectionClose());
+}
+
+TEST(noAuthorization){
+	HttpRequestParser parser(0);
+	std::string sRequest = "GET /dynatracewebhook?token=abc HTTP/1.1\r\nHost: ufo\r\n\r\n";
+	Parse(parser, sRequest, 10);
+	CHECK(parser.RequestFinished());
+	CHECK(!parser.GetAuthorization().length());
+	CHECK(Param(parser, "token") == "abc");
+}
+
+TEST(authorizationIsLimited){
+	HttpRequestParser parser(0);
+	std::string sRequest = "GET / HTTP/1.1\r\nAuthorization: Bearer " + std::string(500, 'a') + "\r\n\r\n";
+	Parse(parser, sRequest, 100);
+	CHECK(parser.RequestFinished());
+	CHECK(parser.GetAuthorization().length() == MAX_AUTHORIZATION_LENGTH);
+}
+
+TEST(formBody){
+	HttpRequestParser parser(0);
+	std::string sRequest = "POST /dynatraceintegration HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: 23\r\n\r\ndtenabled=on&dtenvid=a1";
+	for (size_t uSplit = 1; uSplit < sRequest.size(); uSplit += 7){
+		Parse(parser, sRequest, uSplit);
+		CHECK(parser.RequestFinished());
+		CHECK(Param(parser, "dtenabled") == "on");
+		CHECK(Param(parser, "dtenvid") == "a1");
+	}
+}
+
+// MQTT commands use the same parser on a bare query
+TEST(bareQuery){
+	UrlParser parser;
+	std::list<TParam> params;
+	const char* sQuery = "/api?top=0|5|ff0000&logo=on";
+	parser.ParseQuery(sQuery, strlen(sQuery), params);
+	std::list<TParam>::iterator it = params.begin();
+	CHECK((it->paramName == "top") && (it->paramValue == "0|5|ff0000"));
+	it++;
+	CHECK((it->paramName == "logo") && (it->paramValue == "on"));
+}
+
+// the length is not cut to 16 bit, the last parameter behind 64k is still found
+TEST(bareQueryLongerThan64k){
+	UrlParser parser;
+	std::list<TParam> params;
+	std::string sQuery = "pad=" + std::string(70000, 'x') + "&last=1";
+	parser.ParseQuery(sQuery.data(), sQuery.size(), params);
+	std::list<TParam>::iterator it = params.begin();
+	CHECK((it->paramName == "pad") && (it->paramValue.length() == 70000));
+	it++;
+	CHECK((it != params.end()) && (it->paramName == "last") && (it->paramValue == "1"));
+}
@@ -0,0 +1,162 @@
+#include "HostTest.h"
+#include "HttpResponseParser.h"
+#include <string>
+
+class CollectingHandler : public DownAndUploadHandler {
+public:
+	bool OnReceiveBegin(unsigned short int httpStatusCode, bool isContentLength, unsigned int contentLength) {
+		uStatus = httpStatusCode;
+		uBegins++;
+		return true;
+	}
+	bool OnReceiveBegin(String& sUrl, unsigned int contentLength) { return false; }
+	bool OnReceiveEnd() { uEnds++; return !bEndFails; }
+	bool OnReceiveData(char* buf, int len) { sData.append(buf, len); return true; }
+
+	std::string sData;
+	unsigned short uStatus = 0;
+	unsigned int uBegins = 0;
+	unsigned int uEnds = 0;
+	bool bEndFails = false;
+};
+
+static std::string Response(const std::string& sBody, bool bContentLength){
+	std::string s = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: \"v1\"\r\n";
+	if (bContentLength)
+		s += "Content-Length: " + std::to_string(sBody.size()) + "\r\n";
+	return s + "\r\n" + sBody;
+}
+
+static std::string Body(size_t uLength){
+	std::string s;
+	for (size_t u = 0; u < uLength; u++)
+		s += (char)('a' + u % 26);
+	return s;
+}
+
+// feeds the response in chunks and counts how often the body buffer really moved
+static unsigned int Feed(HttpResponseParser& rParser, const std::string& sResponse, size_t uChunk, bool bClose){
+	unsigned int uMoves = 0;
+	const char* pBuffer = NULL;
+	unsigned int uCapacity = 0;
+	for (size_t u = 0; (u < sResponse.size()) && !rParser.ResponseFinished(); u += uChunk){
+		std::string sPart = sResponse.substr(u, uChunk);
+		CHECK(rParser.ParseResponse((char*)sPart.data(), sPart.size()));
+		if ((rParser.GetBody().getCapacity() != uCapacity) || (rParser.GetBody().length() && (rParser.GetBody().c_str() != pBuffer))){
+			uMoves++;
+			uCapacity = rParser.GetBody().getCapacity();
+			pBuffer = rParser.GetBody().c_str();
+		}
+	}
+	if (bClose)
+		rParser.ParseResponse(NULL, 0);
+	return uMoves;
+}
+
+
+TEST(bodyWithContentLengthIsAllocatedOnce){
+	std::string sBody = Body(5000);
+	for (size_t uChunk = 1; uChunk < 1500; uChunk += 97){
+		HttpResponseParser parser;
+		parser.Init(NULL);
+		unsigned int uMoves = Feed(parser, Response(sBody, true), uChunk, false);
+		CHECK(parser.ResponseFinished());
+		CHECK(parser.GetStatusCode() == 200);
+		String sContentType = parser.GetContentType();
+		sContentType.trim();
+		CHECK(sContentType == "application/json");
+		CHECK(parser.GetETag() == "\"v1\"");
+		CHECK(std::string(parser.GetBody().c_str()) == sBody);
+		CHECK(parser.GetBytesCopied() == sBody.size());
+		CHECK(parser.GetAllocations() == 1);
+		CHECK(uMoves == 1);
+	}
+}
+
+TEST(bodyWithoutContentLengthDoubles){
+	std::string sBody = Body(10000);
+	HttpResponseParser parser;
+	parser.Init(NULL);
+	unsigned int uMoves = Feed(parser, Response(sBody, false), 100, true);
+	CHECK(parser.ResponseFinished());
+	CHECK(std::string(parser.GetBody().c_str()) == sBody);
+	// the counter matches what really happened, and doubling keeps it logarithmic
+	CHECK(parser.GetAllocations() == uMoves);
+	CHECK(parser.GetAllocations() <= 10);
+}
+
+TEST(reusedParserCountsOnlyRealAllocations){
+	HttpResponseParser parser;
+	for (int i = 0; i < 3; i++){
+		parser.Init(NULL);
+		Feed(parser, Response(Body(300), true), 50, false);
+		CHECK(parser.GetAllocations() == 1);
+		parser.Clear();
+		CHECK(parser.GetBody().getCapacity() == 0);
+	}
+}
+
+TEST(bodyIsLimited){
+	HttpResponseParser parser;
+	parser.Init(NULL, 1000);
+	Feed(parser, Response(Body(3000), true), 700, false);
+	CHECK(parser.GetBody().length() == 1000);
+	CHECK(parser.GetBody().getCapacity() < 1100);
+}
+
+TEST(handlerGetsTheBodyOnly){
+	std::string sBody = Body(3000);
+	std::string sResponse = Response(sBody, true);
+	for (size_t uSplit = 1; uSplit < sResponse.size(); uSplit += 13){
+		CollectingHandler handler;
+		HttpResponseParser parser;
+		parser.Init(&handler);
+		parser.ParseResponse((char*)sResponse.data(), uSplit);
+		parser.ParseResponse((char*)sResponse.data() + uSplit, sResponse.size() - uSplit);
+		CHECK(parser.ResponseFinished());
+		CHECK(handler.sData == sBody);
+		CHECK((handler.uBegins == 1) && (handler.uEnds == 1) && (handler.uStatus == 200));
+		CHECK(parser.GetBytesCopied() == 0);
+		CHECK(parser.GetAllocations() == 0);
+	}
+}
+
+// the handler rejects the complete body (e.g. its hash does not match), with or without a Content-Length
+TEST(failedEndFailsTheResponse){
+	for (bool bContentLength : { true, false }){
+		CollectingHandler handler;
+		handler.bEndFails = true;
+		HttpResponseParser parser;
+		parser.Init(&handler);
+		std::string sResponse = Response(Body(100), bContentLength);
+		bool bOk = parser.ParseResponse((char*)sResponse.data(), sResponse.size());
+		if (!bContentLength)
+			bOk = parser.ParseResponse(NULL, 0);
+		CHECK(!bOk && (parser.GetError() != 0));
+		CHECK(handler.uEnds == 1);
+	}
+}
+
+TEST(contentRange){
+	HttpResponseParser parser;
+	parser.Init(NULL);
+	std::string sResponse = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes 1024-4095/4096\r\nContent-Length: 3072\r\n\r\n";
+	parser.ParseResponse((char*)sResponse.data(), sResponse.size());
+	unsigned int uStart = 0, uTotal = 0;
+	CHECK(parser.GetStatusCode() == 206);
+	CHECK(parser.GetContentRange(uStart, uTotal));
+	CHECK((uStart == 1024) && (uTotal == 4096));
+
+	parser.Init(NULL);
+	sResponse = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes 4095-1024/4096\r\n\r\n";
+	parser.ParseResponse((char*)sResponse.data(), sResponse.size());
+	CHECK(!parser.GetContentRange(uStart, uTotal));
+}
+
+TEST(invalidStatusLine){
+	HttpResponseParser parser;
+	parser.Init(NULL);
+	std::string sResponse = "SMTP/1.1 200 OK\r\n\r\n";
+	CHECK(!parser.ParseResponse((char*)sResponse.data(), sResponse.size()));
+	CHECK(parser.GetError() != 0);
+}
@@ -0,0 +1,82 @@
+#include "HostTest.h"
+#include "MonitoringClock.h"
+#include "LatencyHistogram.h"
+
+#define EPOCH_2020		1577836800000000ll	// us
+
+// clocks under the control of the test
+static __uint64_t uBoot;
+static __int64_t iWall;
+
+static __uint64_t TestNow(){
+	return uBoot;
+}
+
+static __int64_t TestWallClock(){
+	return iWall;
+}
+
+static void Reset(__uint64_t uBootTime, __int64_t iWallClock){
+	uBoot = uBootTime;
+	iWall = iWallClock;
+	MonitoringClock::SetSources(TestNow, TestWallClock);
+}
+
+
+TEST(nowFollowsTheSource){
+	Reset(1234, 0);
+	CHECK(MonitoringClock::Now() == 1234);
+	uBoot += 1;
+	CHECK(MonitoringClock::Now() == 1235);
+	MonitoringClock::SetSources(NULL, NULL);
+}
+
+TEST(unsetWallClockKeepsBootRelativeTime){
+	Reset(5000000, 1000000);	// 1970, SNTP has not delivered yet
+	CHECK(!MonitoringClock::Align());
+	CHECK(!MonitoringClock::IsSynced());
+	CHECK(MonitoringClock::ToEpochMs(MonitoringClock::Now()) == 5000);
+	MonitoringClock::SetSources(NULL, NULL);
+}
+
+TEST(alignMapsToEpochAndFollowsAdjustments){
+	Reset(5000000, EPOCH_2020);
+	CHECK(MonitoringClock::Align());
+	CHECK(MonitoringClock::IsSynced());
+	CHECK(MonitoringClock::ToEpochMs(5000000) == EPOCH_2020 / 1000);
+	CHECK(MonitoringClock::ToEpochMs(5250000) == EPOCH_2020 / 1000 + 250);
+	// earlier timestamps (taken before the sync) are converted as well
+	CHECK(MonitoringClock::ToEpochMs(1000000) == EPOCH_2020 / 1000 - 4000);
+
+	// SNTP moves the wall clock back by 2s, the next alignment follows without reporting a new sync
+	uBoot += 10000000;
+	iWall += 10000000 - 2000000;
+	CHECK(!MonitoringClock::Align());
+	CHECK(MonitoringClock::ToEpochMs(MonitoringClock::Now()) == (EPOCH_2020 + 8000000) / 1000);
+	MonitoringClock::SetSources(NULL, NULL);
+}
+
+TEST(setSourcesForgetsTheAlignment){
+	Reset(0, EPOCH_2020);
+	CHECK(MonitoringClock::Align());
+	MonitoringClock::SetSources(NULL, NULL);
+	CHECK(!MonitoringClock::IsSynced());
+	__uint64_t uStart = esp_timer_get_time();
+	CHECK(MonitoringClock::Now() - uStart < 1000000);
+	CHECK(MonitoringClock::ToEpochMs(1000) == 1);
+}
+
+TEST(histogramMeasuresWithTheClock){
+	static LatencyHistogram histogram("test_latency", "latency with the test clock");
+	Reset(1000, 0);
+	__uint64_t uStart = LatencyHistogram::Start();
+	uBoot += 3;
+	histogram.RecordSince(uStart);
+	uStart = LatencyHistogram::Start();
+	uBoot += 70000;
+	histogram.RecordSince(uStart);
+	CHECK(histogram.GetCount() == 2);
+	CHECK(histogram.GetMax() == 70000);
+	CHECK(histogram.GetPercentile(50) == 3);
+	MonitoringClock::SetSources(NULL, NULL);
+}
@@ -0,0 +1,630 @@
+#include "HostTest.h"
+#include "HostFlash.h"
+#include "HostNvs.h"
+#include "HostRtos.h"
+#include "HostServer.h"
+#include "Ota.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// an app image as esptool writes it: header, one segment, padded to 16 bytes - enough for the image length and the magic checks
+// @param bText - the segment consists of words that repeat like the strings and code of a real image, so it compresses
+static std::string Image(size_t uSegment, unsigned int uSeed, bool bText = false){
+	static const char* sWords[] = { "ufo ", "dynatrace ", "ring ", "logo ", "whirl ", "morph ", "\x00\x01\x02", "\xff\xff\xff\xff", "api " };
+	std::string sImage(24, '\0');
+	sImage[0] = (char)0xE9;
+	sImage[1] = 1;
+	std::string sSegment(8, '\0');
+	for (int i = 0; i < 4; i++)
+		sSegment[4 + i] = (char)(uSegment >> (8 * i));
+	sImage += sSegment;
+	size_t uEnd = sImage.size() + uSegment;
+	while (sImage.size() < uEnd){
+		uSeed = uSeed * 1103515245 + 12345;
+		if (bText)
+			sImage += sWords[(uSeed >> 16) % (sizeof(sWords) / sizeof(sWords[0]))];
+		else
+			sImage += (char)(uSeed >> 16);
+	}
+	sImage.resize(uEnd);
+	sImage.resize((sImage.size() | 15) + 1, '\0');
+	return sImage;
+}
+
+// an upload via POST /update, in chunks as they come from the socket
+static bool Upload(Ota& rOta, const std::string& sData, size_t uChunk){
+	String sUrl = "/update";
+	if (!rOta.OnReceiveBegin(sUrl, sData.size()))
+		return false;
+	for (size_t uPos = 0; uPos < sData.size(); uPos += uChunk){
+		std::string sPart = sData.substr(uPos, uChunk);
+		if (!rOta.OnReceiveData(&sPart[0], sPart.size()))
+			return false;
+	}
+	return rOta.OnReceiveEnd();
+}
+
+// the running image stays the same in all tests, FirmwarePatch hashes it only once
+static const std::string& Running(){
+	static const std::string sRunning = Image(200000, 1);
+	return sRunning;
+}
+
+static void Reset(){
+	HostNvsReset();
+	HostFlashReset(Running());
+}
+
+static std::string U32(__uint32_t u){
+	std::string s;
+	for (int i = 0; i < 4; i++)
+		s += (char)(u >> (8 * i));
+	return s;
+}
+
+static std::string Sha256(const std::string& sData){
+	unsigned char sha[FIRMWARE_SHA256_LENGTH];
+	mbedtls_sha256((const unsigned char*)sData.data(), sData.size(), sha, 0);
+	return std::string((const char*)sha, sizeof(sha));
+}
+
+// the instructions of a delta, as go/src/firmwarediff writes them
+static std::string Copy(__uint32_t uOffset, __uint32_t uLen){
+	return (char)FIRMWARE_PATCH_OP_COPY + U32(uOffset) + U32(uLen);
+}
+
+static std::string Insert(const std::string& sData){
+	return (char)FIRMWARE_PATCH_OP_INSERT + U32(sData.size()) + sData;
+}
+
+static std::string PatchHeader(const std::string& sSource, const std::string& sTarget){
+	return FIRMWARE_PATCH_MAGIC + U32(sSource.size()) + Sha256(sSource) + U32(sTarget.size()) + Sha256(sTarget);
+}
+
+// the running image with a changed block in the middle and a longer end
+static std::string Target(){
+	const std::string& sRunning = Running();
+	return sRunning.substr(0, 50000) + std::string(3000, 'x') + sRunning.substr(53000, 100000) + sRunning.substr(0, 40000) + std::string(16, 'e');
+}
+
+static std::string Patch(const std::string& sTarget){
+	return PatchHeader(Running(), sTarget) + Copy(0, 50000) + Insert(std::string(3000, 'x')) + Copy(53000, 100000) + Copy(0, 40000)
+		+ Insert(std::string(16, 'e'));
+}
+
+/*
+ * LZSS as go/src/firmwarecompress writes it: header, then a flag byte for every eight tokens (a set bit is a
+ * literal) and matches of two bytes. Only the last position of every 3 byte sequence is searched, which is
+ * good enough for matches of every distance and length.
+ */
+static std::string Compress(const std::string& sData){
+	std::string sOut = std::string(FIRMWARE_COMPRESSED_MAGIC) + (char)FIRMWARE_COMPRESSED_VERSION + (char)FIRMWARE_WINDOW_BITS
+		+ (char)FIRMWARE_LENGTH_BITS + '\0' + U32(sData.size()) + Sha256(sData);
+	const size_t uWindow = 1 << FIRMWARE_WINDOW_BITS;
+	const size_t uMaxMatch = (1 << FIRMWARE_LENGTH_BITS) + FIRMWARE_MIN_MATCH - 1;
+	std::vector<size_t> last(1 << 16, std::string::npos);
+	auto remember = [&](size_t uPos){
+		if (uPos + FIRMWARE_MIN_MATCH <= sData.size())
+			last[((__uint8_t)sData[uPos] << 8 ^ (__uint8_t)sData[uPos + 1] << 4 ^ (__uint8_t)sData[uPos + 2]) & 0xffff] = uPos;
+	};
+	size_t uPos = 0;
+	while (uPos < sData.size()){
+		size_t uFlags = sOut.size();
+		sOut += '\0';
+		for (int iBit = 0; (iBit < 8) && (uPos < sData.size()); iBit++){
+			size_t uMatch = 0;
+			size_t uCandidate = std::string::npos;
+			if (uPos + FIRMWARE_MIN_MATCH <= sData.size())
+				uCandidate = last[((__uint8_t)sData[uPos] << 8 ^ (__uint8_t)sData[uPos + 1] << 4 ^ (__uint8_t)sData[uPos + 2]) & 0xffff];
+			if ((uCandidate != std::string::npos) && (uPos - uCandidate <= uWindow))
+				while ((uMatch < uMaxMatch) && (uPos + uMatch < sData.size()) && (sData[uCandidate + uMatch] == sData[uPos + uMatch]))
+					uMatch++;
+			if (uMatch >= FIRMWARE_MIN_MATCH){
+				__uint16_t uToken = ((uPos - uCandidate - 1) << FIRMWARE_LENGTH_BITS) | (uMatch - FIRMWARE_MIN_MATCH);
+				sOut += (char)uToken;
+				sOut += (char)(uToken >> 8);
+			}
+			else{
+				uMatch = 1;
+				sOut[uFlags] |= 1 << iBit;
+				sOut += sData[uPos];
+			}
+			for (size_t u = 0; u < uMatch; u++)
+				remember(uPos++);
+		}
+	}
+	return sOut;
+}
+
+// a web server with the delta for the running image and the full image for everybody else
+static void Serve(int s, const std::string& sRequest, const std::string& sPatch, const std::string& sImage){
+	const std::string& sBody = (sRequest.find("X-Ufo-Image-Sha256: ") != std::string::npos) ? sPatch : sImage;
+	HostServer::Send(s, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(sBody.size()) + "\r\n\r\n" + sBody);
+}
+
+/*
+ * Serves the data like go/src/firmwareserver: the ETag is the SHA256 of the data, range requests with a
+ * matching If-Range are answered with 206. The connection breaks off once at every cut (a byte of the data).
+ */
+class FirmwareServer {
+public:
+	FirmwareServer(const std::string& sData, const std::vector<size_t>& cuts)
+		: msData(sData), mCuts(cuts), mServer([this](int s, const std::string& sRequest){ Respond(s, sRequest); }) {}
+
+	// the image on the server gets replaced as soon as a connection broke off
+	void SetDataAfterCut(const std::string& sData) { std::lock_guard<std::mutex> lock(mMutex); msNextData = sData; }
+	// no response gets beyond that byte (npos = online)
+	void SetOffline(size_t uPos) { std::lock_guard<std::mutex> lock(mMutex); muOffline = uPos; }
+	std::string Url() { return mServer.Url("http"); }
+	std::string GetRequest() { return mServer.GetRequest(); }
+	unsigned int GetRanges() { return muRanges; }
+	unsigned int GetRequests() { return muRequests; }
+
+private:
+	void Respond(int s, const std::string& sRequest) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		muRequests++;
+		std::string sETag = "\"" + ToHex(Sha256(msData)) + "\"";
+		size_t uStart = 0;
+		size_t uRange = sRequest.find("Range: bytes=");
+		if ((uRange != std::string::npos) && (sRequest.find("If-Range: " + sETag + "\r\n") != std::string::npos)){
+			uStart = atoi(sRequest.c_str() + uRange + 13);
+			muRanges++;
+		}
+		std::string sResponse = uStart ? "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(uStart) + "-"
+				+ std::to_string(msData.size() - 1) + "/" + std::to_string(msData.size()) + "\r\n" : "HTTP/1.1 200 OK\r\n";
+		HostServer::Send(s, sResponse + "Content-Length: " + std::to_string(msData.size() - uStart) + "\r\nETag: " + sETag + "\r\n\r\n");
+		size_t uEnd = msData.size();
+		auto cut = std::find_if(mCuts.begin(), mCuts.end(), [&](size_t uCut){ return (uCut > uStart) && (uCut < uEnd); });
+		if (cut != mCuts.end()){
+			uEnd = *cut;
+			mCuts.erase(cut);
+		}
+		uEnd = std::max(uStart, std::min(uEnd, muOffline));
+		HostServer::Send(s, msData.substr(uStart, uEnd - uStart));
+		if ((uEnd < msData.size()) && !msNextData.empty()){
+			msData = msNextData;
+			msNextData.clear();
+		}
+	}
+
+	static std::string ToHex(const std::string& sSha256){
+		char sHex[2 * FIRMWARE_SHA256_LENGTH + 1];
+		FirmwarePatch::ToHex((const __uint8_t*)sSha256.data(), sHex);
+		return sHex;
+	}
+
+	std::mutex mMutex;
+	std::string msData;
+	std::string msNextData;
+	std::vector<size_t> mCuts;
+	size_t muOffline = std::string::npos;
+	std::atomic<unsigned int> muRanges { 0 };
+	std::atomic<unsigned int> muRequests { 0 };
+	HostServer mServer;
+};
+
+class CollectingWriter : public FirmwareWriter {
+public:
+	bool WriteFirmware(const char* pData, unsigned int uLen) { msData.append(pData, uLen); return true; }
+	std::string msData;
+};
+
+
+TEST(uploadIsFlashedThroughTheBuffers){
+	Reset();
+	std::string sImage = Image(3 * OTA_BUFFER_SIZE + 1234, 2);
+	{
+		Ota ota;
+		CHECK(Upload(ota, sImage, 1460));
+		CHECK(Ota::GetProgress() == OTA_PROGRESS_FINISHEDSUCCESS);
+	}
+	CHECK(HostFlashGetOtaLength() == sImage.size());
+	CHECK(HostFlashGetUpdate(sImage.size()) == sImage);
+	CHECK(HostFlashIsUpdateBooted());
+	TOtaStats& stats = Ota::GetStats();
+	CHECK((stats.uBytesReceived == sImage.size()) && (stats.uBytesWritten == sImage.size()));
+	CHECK((stats.uBuffers == OTA_BUFFER_COUNT) && stats.uEnd && !stats.bCompressed && !stats.bDelta);
+}
+
+// chunks larger than a buffer and exactly on the buffer boundaries
+TEST(chunkSizesDoNotMatter){
+	const size_t uChunks[] = { 1, OTA_BUFFER_SIZE, OTA_BUFFER_SIZE + 1, 5 * OTA_BUFFER_SIZE };
+	for (size_t uChunk : uChunks){
+		Reset();
+		std::string sImage = Image(2 * OTA_BUFFER_SIZE - 32, uChunk);
+		Ota ota;
+		CHECK(Upload(ota, sImage, uChunk));
+		CHECK(HostFlashGetUpdate(sImage.size()) == sImage);
+	}
+}
+
+// the receiver must not block on the buffers the failed writer still holds
+TEST(writeErrorStopsTheUpload){
+	Reset();
+	HostFlashFailWritesAfter(2 * OTA_BUFFER_SIZE);
+	std::string sImage = Image(20 * OTA_BUFFER_SIZE, 3);
+	{
+		Ota ota;
+		CHECK(!Upload(ota, sImage, 4096));
+		CHECK(Ota::GetProgress() == OTA_PROGRESS_FLASHERROR);
+	}
+	CHECK(!HostFlashIsUpdateBooted());
+	CHECK(Ota::GetStats().uBytesReceived < sImage.size());
+}
+
+TEST(invalidImageIsNotBooted){
+	Reset();
+	std::string sImage = Image(OTA_BUFFER_SIZE, 4);
+	sImage[0] = 0;
+	Ota ota;
+	CHECK(!Upload(ota, sImage, 1460));
+	CHECK(Ota::GetProgress() == OTA_PROGRESS_FLASHERROR);
+	CHECK(!HostFlashIsUpdateBooted());
+}
+
+// the patch gets applied while it is received, no matter where the chunks end
+TEST(patchIsAppliedAgainstTheRunningImage){
+	std::string sTarget = Target();
+	std::string sPatch = Patch(sTarget);
+	srand(48);
+	for (int iRound = 0; iRound < 20; iRound++){
+		Reset();
+		Ota ota;
+		String sUrl = "/update";
+		CHECK(ota.OnReceiveBegin(sUrl, sPatch.size()));
+		for (size_t uPos = 0; uPos < sPatch.size(); ){
+			size_t uChunk = 1 + rand() % ((iRound < 10) ? 100 : 5000);
+			std::string sPart = sPatch.substr(uPos, uChunk);
+			CHECK(ota.OnReceiveData(&sPart[0], sPart.size()));
+			uPos += sPart.size();
+		}
+		CHECK(ota.OnReceiveEnd());
+		CHECK(HostFlashGetUpdate(sTarget.size()) == sTarget);
+		CHECK(HostFlashIsUpdateBooted());
+		CHECK(Ota::GetStats().bDelta && (Ota::GetStats().uBytesWritten == sTarget.size()));
+	}
+}
+
+TEST(patchWithAnotherResultIsNotBooted){
+	std::string sTarget = Target();
+	std::string sPatch = Patch(sTarget);
+	sPatch[FIRMWARE_PATCH_HEADER - 1] ^= 1;		// hash of the new image
+	Reset();
+	{
+		Ota ota;
+		CHECK(!Upload(ota, sPatch, 1460));
+		CHECK(Ota::GetProgress() != OTA_PROGRESS_FINISHEDSUCCESS);
+	}
+	CHECK(!HostFlashIsUpdateBooted());
+	CHECK(HostFlashGetUpdate(1)[0] != (char)0xE9);
+}
+
+TEST(damagedPatchesAreRejected){
+	std::string sTarget = Target();
+	const std::string sDamaged[] = {
+		PatchHeader(Running(), sTarget) + Copy(Running().size() - 10, 11),				// beyond the running image
+		PatchHeader(Running(), sTarget) + Insert(sTarget) + Insert("x"),				// beyond the new image
+		PatchHeader(Running(), sTarget) + (char)0x03,									// instruction
+		PatchHeader(Running() + "x", sTarget) + Copy(0, 10),							// for another image
+		Patch(sTarget).substr(0, Patch(sTarget).size() - 5)								// incomplete
+	};
+	for (const std::string& sPatch : sDamaged){
+		CollectingWriter writer;
+		FirmwarePatch patch;
+		CHECK(patch.Begin(&writer));
+		bool bOk = patch.WriteFirmware(sPatch.data(), sPatch.size()) && patch.End();
+		CHECK(!bOk && patch.IsPatch());
+	}
+	CollectingWriter writer;
+	FirmwarePatch patch;
+	std::string sPatch = Patch(sTarget);
+	CHECK(patch.Begin(&writer) && patch.WriteFirmware(sPatch.data(), sPatch.size()) && patch.End());
+	CHECK((writer.msData == sTarget) && (patch.GetBytesInserted() == 3016));
+	// anything else is passed through
+	CHECK(patch.Begin(&writer) && patch.WriteFirmware("UFODIFX", 7) && patch.End() && !patch.IsPatch());
+}
+
+// the server sends a delta that does not fit (or does not result in the announced image), the full image is retrieved then
+TEST(failedPatchFallsBackToTheFullImage){
+	std::string sImage = Image(300000, 6);
+	std::string sWrongSource = PatchHeader(Running() + "x", sImage) + Copy(0, 1000);
+	std::string sWrongResult = Patch(Target());
+	sWrongResult.replace(FIRMWARE_PATCH_MAGIC_LENGTH + 4 + FIRMWARE_SHA256_LENGTH, 4 + FIRMWARE_SHA256_LENGTH, U32(Target().size()) + Sha256(sImage));
+	for (const std::string& sPatch : { sWrongSource, sWrongResult }){
+		Reset();
+		HostServer server([&](int s, const std::string& sRequest){ Serve(s, sRequest, sPatch, sImage); });
+		Ota ota;
+		CHECK(ota.UpdateFirmware(server.Url("http").c_str()));
+		CHECK(Ota::GetProgress() == OTA_PROGRESS_FINISHEDSUCCESS);
+		CHECK(server.GetRequest().find("X-Ufo-Image-Sha256: ") == std::string::npos);
+		CHECK(HostFlashGetUpdate(sImage.size()) == sImage);
+		CHECK(HostFlashIsUpdateBooted() && !Ota::GetStats().bDelta);
+	}
+}
+
+// decompressed in pieces of the window, whatever the chunks of the download are
+TEST(compressedImageIsDecompressedAtAnyChunkBoundary){
+	std::string sImage = Image(100000, 7, true);
+	std::string sCompressed = Compress(sImage);
+	CHECK(sCompressed.size() < sImage.size() / 2);
+	srand(49);
+	for (int iRound = 0; iRound < 50; iRound++){
+		CollectingWriter writer;
+		FirmwareDecompressor decompressor;
+		CHECK(decompressor.Begin(&writer));
+		for (size_t uPos = 0; uPos < sCompressed.size(); ){
+			size_t uChunk = 1 + rand() % ((iRound < 25) ? 64 : 8192);
+			std::string sPart = sCompressed.substr(uPos, uChunk);
+			CHECK(decompressor.WriteFirmware(sPart.data(), sPart.size()));
+			uPos += sPart.size();
+		}
+		CHECK(decompressor.End());
+		CHECK(decompressor.IsCompressed() && (decompressor.GetLength() == sImage.size()));
+		CHECK(writer.msData == sImage);
+	}
+}
+
+static bool Decompress(const std::string& sCompressed, std::string& rsOut){
+	CollectingWriter writer;
+	FirmwareDecompressor decompressor;
+	bool bOk = decompressor.Begin(&writer) && decompressor.WriteFirmware(sCompressed.data(), sCompressed.size()) && decompressor.End();
+	rsOut = writer.msData;
+	return bOk;
+}
+
+TEST(truncatedCompressedDataIsRejected){
+	std::string sImage = Image(20000, 8, true);
+	std::string sCompressed = Compress(sImage);
+	std::string sOut;
+	// shorter than the magic it is just data
+	for (size_t uLen = FIRMWARE_COMPRESSED_MAGIC_LENGTH; uLen < sCompressed.size(); uLen += (uLen < 200) ? 1 : 97)
+		CHECK(!Decompress(sCompressed.substr(0, uLen), sOut));
+	CHECK(Decompress(sCompressed.substr(0, 3), sOut) && (sOut == "UFO"));
+	CHECK(Decompress(sCompressed, sOut) && (sOut == sImage));
+}
+
+// a damaged byte either breaks the data or the hash - unless a match still refers to the same bytes
+TEST(corruptedCompressedDataIsRejected){
+	std::string sImage = Image(20000, 9, true);
+	std::string sCompressed = Compress(sImage);
+	std::string sOut;
+	srand(490);
+	unsigned int uRejected = 0;
+	for (int iRound = 0; iRound < 500; iRound++){
+		std::string sDamaged = sCompressed;
+		size_t uPos = FIRMWARE_COMPRESSED_MAGIC_LENGTH + rand() % (sDamaged.size() - FIRMWARE_COMPRESSED_MAGIC_LENGTH);
+		sDamaged[uPos] ^= 1 << (rand() % 8);
+		if (Decompress(sDamaged, sOut))
+			CHECK(sOut == sImage);
+		else
+			uRejected++;
+	}
+	CHECK(uRejected > 450);
+	const size_t uHeader[] = { 4, 5, 6, 8, 12 };		// version, window bits, length bits, length, hash
+	for (size_t uPos : uHeader){
+		std::string sDamaged = sCompressed;
+		sDamaged[uPos] ^= 1;
+		CHECK(!Decompress(sDamaged, sOut));
+	}
+}
+
+// compressed images and compressed patches through UpdateFirmware - a broken one is reported as failed, not as done
+TEST(compressedDownloadsAreVerified){
+	std::string sImage = Image(300000, 10, true);
+	std::string sTarget = Target();
+	const std::pair<std::string, std::string> downloads[] = {
+		std::make_pair(Compress(sImage), sImage),
+		std::make_pair(Compress(Patch(sTarget)), sTarget)
+	};
+	for (auto& rDownload : downloads){
+		Reset();
+		HostServer server([&](int s, const std::string& sRequest){ Serve(s, sRequest, rDownload.first, rDownload.first); });
+		Ota ota;
+		CHECK(ota.UpdateFirmware(server.Url("http").c_str()));
+		CHECK(HostFlashGetUpdate(rDownload.second.size()) == rDownload.second);
+		CHECK(HostFlashIsUpdateBooted() && Ota::GetStats().bCompressed);
+	}
+
+	std::string sDamaged = Compress(sImage);
+	sDamaged[FIRMWARE_COMPRESSED_HEADER - 1] ^= 1;		// hash of the image
+	Reset();
+	HostServer server([&](int s, const std::string& sRequest){ Serve(s, sRequest, sDamaged, sDamaged); });
+	Ota ota;
+	CHECK(!ota.UpdateFirmware(server.Url("http").c_str()));
+	CHECK(Ota::GetProgress() == OTA_PROGRESS_CONNECTIONERROR);
+	CHECK(!HostFlashIsUpdateBooted());
+}
+
+// every kind of download continues where the connection broke off, the result is the same as without the cuts
+TEST(interruptedDownloadsContinue){
+	HostRtosSetTimeScale(0);
+	std::string sImage = Image(300000, 11, true);
+	std::string sTarget = Target();
+	const std::pair<std::string, std::string> downloads[] = {
+		std::make_pair(Image(300000, 12), Image(300000, 12)),
+		std::make_pair(Compress(sImage), sImage),
+		std::make_pair(Patch(sTarget), sTarget),
+		std::make_pair(Compress(Patch(sTarget)), sTarget)
+	};
+	srand(50);
+	for (auto& rDownload : downloads){
+		for (int iRound = 0; iRound < 10; iRound++){
+			std::vector<size_t> cuts;
+			for (int i = rand() % OTA_RESUME_ATTEMPTS; i >= 0; i--)
+				cuts.push_back(1 + rand() % (rDownload.first.size() - 1));
+			std::sort(cuts.begin(), cuts.end());
+			cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+			Reset();
+			FirmwareServer server(rDownload.first, cuts);
+			Ota ota;
+			CHECK(ota.UpdateFirmware(server.Url().c_str()));
+			CHECK(HostFlashGetUpdate(rDownload.second.size()) == rDownload.second);
+			CHECK(HostFlashIsUpdateBooted());
+			CHECK((server.GetRanges() == cuts.size()) && (Ota::GetStats().uResumes == cuts.size()));
+		}
+	}
+	HostRtosSetTimeScale(100);
+}
+
+// the image on the server changed in between, the If-Range does not match and the download starts over
+TEST(changedImageStartsOver){
+	HostRtosSetTimeScale(0);
+	Reset();
+	std::string sNewImage = Image(300000, 14);
+	FirmwareServer server(Image(300000, 13), { 100000 });
+	server.SetDataAfterCut(sNewImage);
+	Ota ota;
+	CHECK(ota.UpdateFirmware(server.Url().c_str()));
+	CHECK(HostFlashGetUpdate(sNewImage.size()) == sNewImage);
+	CHECK(HostFlashIsUpdateBooted());
+	CHECK((server.GetRanges() == 0) && (Ota::GetStats().uResumes == 0));
+	HostRtosSetTimeScale(100);
+}
+
+/*
+ * A plain image continues after a reboot at the last checkpoint, the flashed part is verified against it.
+ * Compressed data has no checkpoint and starts over.
+ */
+TEST(plainImageContinuesAfterReboot){
+	HostRtosSetTimeScale(0);
+	for (bool bCompressed : { false, true }){
+		std::string sImage = Image(300000, 15, bCompressed);
+		std::string sData = bCompressed ? Compress(sImage) : sImage;
+		Reset();
+		FirmwareServer server(sData, {});
+		server.SetOffline(sData.size() * 2 / 3);
+		{
+			Ota ota;
+			CHECK(!ota.UpdateFirmware(server.Url().c_str()));
+			CHECK(Ota::GetProgress() == OTA_PROGRESS_CONNECTIONERROR);
+		}
+		CHECK(!HostFlashIsUpdateBooted());
+		CHECK(HostNvsExists("Ota", "Checkpoint") != bCompressed);
+
+		// the UFO rebooted and the connection is back
+		server.SetOffline(std::string::npos);
+		unsigned int uRanges = server.GetRanges();
+		Ota ota;
+		CHECK(ota.UpdateFirmware(server.Url().c_str()));
+		CHECK(HostFlashGetUpdate(sImage.size()) == sImage);
+		CHECK(HostFlashIsUpdateBooted());
+		CHECK((server.GetRanges() == uRanges + (bCompressed ? 0 : 1)) && !HostNvsExists("Ota", "Checkpoint"));
+		if (!bCompressed)
+			CHECK(server.GetRequest().find("Range: bytes=" + std::to_string(sData.size() * 2 / 3 / OTA_CHECKPOINT_INTERVAL * OTA_CHECKPOINT_INTERVAL) + "-") != std::string::npos);
+	}
+	HostRtosSetTimeScale(100);
+}
+
+
+
+// the reboots the stored checkpoint counts, -1 without checkpoint
+static int CheckpointBoots(){
+	nvs_handle h;
+	TOtaCheckpoint checkpoint;
+	__uint32_t uLen = sizeof(checkpoint);
+	if (nvs_open("Ota", NVS_READONLY, &h) != ESP_OK)
+		return -1;
+	esp_err_t err = nvs_get_blob(h, "Checkpoint", &checkpoint, &uLen);
+	nvs_close(h);
+	return (err == ESP_OK) ? checkpoint.uBoots : -1;
+}
+
+/*
+ * An update that keeps getting interrupted (or crashing the UFO) continues after OTA_RESUME_BOOTS reboots at most.
+ * Continued after a reboot it never starts over, that would begin the count again.
+ */
+TEST(resumeAfterRebootsIsLimited){
+	HostRtosSetTimeScale(0);
+	std::string sImage = Image(300000, 16);
+	Reset();
+	FirmwareServer server(sImage, {});
+	server.SetOffline(sImage.size() / 3);
+	{
+		Ota ota;
+		CHECK(!ota.UpdateFirmware(server.Url().c_str()));
+	}
+	CHECK(CheckpointBoots() == 0);
+
+	// a started over update keeps the count
+	server.SetDataAfterCut(Image(300000, 17));
+	{
+		Ota ota;
+		CHECK(!ota.UpdateFirmware(server.Url().c_str()));
+	}
+	CHECK(CheckpointBoots() == 1);
+
+	for (int iBoot = 2; iBoot <= OTA_RESUME_BOOTS; iBoot++){
+		server.SetOffline(sImage.size() / 3 + iBoot * OTA_CHECKPOINT_INTERVAL);
+		unsigned int uRanges = server.GetRanges();
+		Ota ota;
+		CHECK(!ota.UpdateFirmware(server.Url().c_str(), true));
+		CHECK(server.GetRanges() > uRanges);
+		CHECK(CheckpointBoots() == iBoot);
+	}
+
+	server.SetOffline(std::string::npos);
+	unsigned int uRequests = server.GetRequests();
+	{
+		Ota ota;
+		CHECK(!ota.UpdateFirmware(server.Url().c_str(), true));
+	}
+	CHECK((server.GetRequests() == uRequests) && !HostNvsExists("Ota", "Url") && !HostFlashIsUpdateBooted());
+
+	// the image changes while the update continues
+	Reset();
+	FirmwareServer changed(sImage, {});
+	changed.SetOffline(sImage.size() / 2);
+	{
+		Ota ota;
+		CHECK(!ota.UpdateFirmware(changed.Url().c_str()));
+	}
+	CHECK(CheckpointBoots() == 0);
+	changed.SetDataAfterCut(Image(300000, 18));
+	uRequests = changed.GetRequests();
+	{
+		Ota ota;
+		CHECK(!ota.UpdateFirmware(changed.Url().c_str(), true));
+	}
+	CHECK((changed.GetRequests() == uRequests + 2) && (CheckpointBoots() == -1) && !HostFlashIsUpdateBooted());
+	HostRtosSetTimeScale(100);
+}
+
+/*
+ * The network delivers 1460 byte segments at about 400kB/s, the flash takes about 250kB/s (erase + write
+ * on the target). Without the writer task both would add up, with it the update runs at the flash rate.
+ * Reports what /checkfirmware shows in its "ota" object.
+ */
+BENCH(pipelinedUpdateThroughput){
+	const size_t uNetworkRate = 400 * 1024;
+	const size_t uFlashRate = 250 * 1024;
+	const size_t uSegment = 1460;
+	Reset();
+	HostFlashSetWriteRate(uFlashRate);
+	std::string sImage = Image(768 * 1024, 5);
+	{
+		Ota ota;
+		String sUrl = "/update";
+		CHECK(ota.OnReceiveBegin(sUrl, sImage.size()));
+		for (size_t uPos = 0; uPos < sImage.size(); uPos += uSegment){
+			usleep(uSegment * 1000000ull / uNetworkRate);
+			std::string sPart = sImage.substr(uPos, uSegment);
+			CHECK(ota.OnReceiveData(&sPart[0], sPart.size()));
+		}
+		CHECK(ota.OnReceiveEnd());
+	}
+	HostFlashSetWriteRate(0);
+	CHECK(HostFlashGetUpdate(sImage.size()) == sImage);
+
+	TOtaStats& stats = Ota::GetStats();
+	__uint64_t uDuration = stats.uEnd - stats.uStart;
+	double dSerial = (double)sImage.size() / uNetworkRate + (double)sImage.size() / uFlashRate;
+	printf("bench  %u kB, %u x %u kB buffers: %u ms, %u bytes/s (receive then write: %.0f ms)\n", (unsigned int)(sImage.size() / 1024),
+		stats.uBuffers, OTA_BUFFER_SIZE / 1024, (unsigned int)(uDuration / 1000), (unsigned int)((__uint64_t)stats.uBytesWritten * 1000000 / uDuration), dSerial * 1000);
+	printf("bench  receivestallms %u, flashidlems %u, flashbusyms %u\n", (unsigned int)(stats.uReceiveStall / 1000),
+		(unsigned int)(stats.uFlashIdle / 1000), (unsigned int)(stats.uFlashWrite / 1000));
+}
@@ -0,0 +1,127 @@
+#include "HostTest.h"
+#include "HostServer.h"
+#include "HostUfo.h"
+#include "MqttExporter.h"
+#include "HttpExporter.h"
+#include "RingLogExporter.h"
+#include "AWSIntegration.h"
+#include "Config.h"
+#include "Wifi.h"
+#include <string>
+
+// the device as the exporters see it, Wifi connected and the AWS connection up
+class Device {
+public:
+	Device() {
+		msId = "ufo-1234";
+		String sSsid = "ssid", sPass = "", sHostname = "ufo";
+		mWifi.StartSTAMode(sSsid, sPass, sHostname);
+		mAws.mActive = true;
+		mConfig.mbDTMonitoring = true;
+		mContext.pConfig = &mConfig;
+		mContext.pWifi = &mWifi;
+		mContext.pAws = &mAws;
+		mContext.pId = &msId;
+		HostAwsGetPublished().clear();
+		HostAwsFailPublish(false);
+	}
+
+	Config mConfig;
+	Wifi mWifi;
+	AWSIntegration mAws;
+	String msId;
+	TExporterContext mContext;
+};
+
+
+TEST(exporterTypeIsValidated){
+	__uint8_t uType = 7;
+	CHECK(TelemetryExporter::ParseType("0", uType) && (uType == DT_EXPORTER_MQTT));
+	CHECK(TelemetryExporter::ParseType("1", uType) && (uType == DT_EXPORTER_HTTP));
+	CHECK(TelemetryExporter::ParseType("2", uType) && (uType == DT_EXPORTER_RINGLOG));
+	const char* sInvalid[] = { "", "3", "-1", "1x", "http", " 1", "256" };
+	for (const char* s : sInvalid){
+		uType = 7;
+		CHECK(!TelemetryExporter::ParseType(s, uType) && (uType == 7));
+	}
+}
+
+TEST(mqttPublishesToTheTopicsOfTheUfo){
+	Device device;
+	MqttExporter exporter;
+	CHECK(!exporter.IsActive());
+	device.mAws.mActive = false;
+	CHECK(!exporter.Start(device.mContext));
+	device.mAws.mActive = true;
+	CHECK(exporter.Start(device.mContext) && exporter.IsActive());
+
+	CHECK(exporter.Export("{\"a\":1}", 7, false));
+	CHECK(exporter.Export("\xa0", 1, true));
+	std::vector<THostPublished>& rPublished = HostAwsGetPublished();
+	CHECK(rPublished.size() == 2);
+	CHECK((rPublished[0].sTopic == "/dynatraceufo/monitoring/ufo-1234") && (rPublished[0].sPayload == "{\"a\":1}"));
+	CHECK((rPublished[1].sTopic == "/dynatraceufo/monitoring/cbor/ufo-1234") && (rPublished[1].sPayload == "\xa0"));
+
+	HostAwsFailPublish(true);
+	CHECK(!exporter.Export("{}", 2, false));
+	device.mAws.mActive = false;
+	CHECK(!exporter.IsActive());
+}
+
+TEST(httpPostsToTheCollector){
+	HostServer server([](int s){ HostServer::Send(s, "HTTP/1.0 202 Accepted\r\nContent-Length: 0\r\n\r\n"); });
+	Device device;
+	HttpExporter exporter;
+	CHECK(!exporter.Start(device.mContext));		// no URL configured
+	device.mConfig.msDTMonitoringUrl = server.Url("http").c_str();
+	String sSsid = "ssid", sPass = "", sHostname = "ufo";
+	device.mWifi.StartAPMode(sSsid, sPass, sHostname);
+	CHECK(!exporter.Start(device.mContext));		// no connection
+	device.mWifi.StartSTAMode(sSsid, sPass, sHostname);
+	CHECK(exporter.Start(device.mContext) && exporter.IsActive());
+
+	CHECK(exporter.Export("{\"a\":1}", 7, false));
+	std::string sRequest = server.GetRequest();
+	CHECK(sRequest.find("POST /test HTTP/1.") == 0);
+	CHECK(sRequest.find("Content-Type: application/json\r\n") != std::string::npos);
+	CHECK(sRequest.find("\r\n\r\n{\"a\":1}") == sRequest.size() - 11);
+
+	CHECK(exporter.Export("\xa0", 1, true));
+	sRequest = server.GetRequest();
+	CHECK(sRequest.find("Content-Type: application/cbor\r\n") != std::string::npos);
+	CHECK(sRequest.find("\r\n\r\n\xa0") == sRequest.size() - 5);
+
+	device.mConfig.mbDTMonitoring = false;
+	CHECK(!exporter.IsActive());
+}
+
+TEST(httpFailsOnErrorStatus){
+	HostServer server([](int s){ HostServer::Send(s, "HTTP/1.0 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n"); });
+	Device device;
+	device.mConfig.msDTMonitoringUrl = server.Url("http").c_str();
+	HttpExporter exporter;
+	CHECK(exporter.Start(device.mContext));
+	CHECK(!exporter.Export("{}", 2, false));
+}
+
+TEST(ringLogKeepsTheLastBatches){
+	Device device;
+	RingLogExporter exporter;
+	CHECK(exporter.Start(device.mContext) && exporter.IsActive());
+	for (int i = 0; i < RINGLOG_BATCHES + 2; i++){
+		std::string sBatch = "{\"n\":" + std::to_string(i) + "}";
+		CHECK(exporter.Export(sBatch.data(), sBatch.size(), false));
+	}
+	CHECK(exporter.Export("\x9f\xff", 2, true));
+
+	String sBody;
+	exporter.WriteJson(sBody);
+	std::string sJson = sBody.c_str();
+	CHECK(sJson.find("{\"exported\":11,\"overwritten\":3,\"batches\":[{\"n\":3},{\"n\":4},") == 0);
+	CHECK(sJson.find(",{\"n\":9},\"9fff\"]}") == sJson.size() - 17);
+
+	exporter.Clear();
+	sBody = "";
+	exporter.WriteJson(sBody);
+	CHECK(sBody == "{\"exported\":11,\"overwritten\":3,\"batches\":[]}");
+}
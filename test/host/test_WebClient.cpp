@@ -0,0 +1,116 @@
+#include "HostTest.h"
+#include "HostServer.h"
+#include "WebClient.h"
+#include <sys/resource.h>
+#include <string>
+#include <thread>
+
+static std::string Body(size_t uLength){
+	std::string s;
+	for (size_t u = 0; u < uLength; u++)
+		s += (char)('a' + u % 26);
+	return s;
+}
+
+// fetches the url, returns the status and the elapsed time
+static unsigned short Get(WebClient& rClient, const std::string& sUrl, __uint32_t& ruElapsedMs){
+	Url url;
+	url.Parse(sUrl.c_str());
+	rClient.Prepare(&url);
+	__uint32_t uStart = esp_log_timestamp();
+	unsigned short uStatus = rClient.HttpGet();
+	ruElapsedMs = esp_log_timestamp() - uStart;
+	return uStatus;
+}
+
+static const char* SCHEMES[] = { "http", "https" };
+
+
+TEST(responseWithoutContentLengthEndsWithTheConnection){
+	std::string sBody = Body(5000);
+	HostServer server([&](int s){ HostServer::Send(s, "HTTP/1.0 200 OK\r\n\r\n" + sBody); });
+	for (const char* sScheme : SCHEMES){
+		WebClient client;
+		__uint32_t uElapsed;
+		CHECK(Get(client, server.Url(sScheme), uElapsed) == 200);
+		CHECK(std::string(client.GetResponseData().c_str()) == sBody);
+	}
+}
+
+TEST(stalledServerHitsTheReadTimeout){
+	HostServer server([](int s){ HostServer::Send(s, "HTTP/1.0 200 OK\r\n"); HostServer::WaitForClose(s); });
+	for (const char* sScheme : SCHEMES){
+		WebClient client;
+		client.SetTimeouts(1000, 400, 0);
+		__uint32_t uElapsed;
+		CHECK(Get(client, server.Url(sScheme), uElapsed) == 1011);
+		CHECK((uElapsed >= 400) && (uElapsed < 1000));
+	}
+}
+
+TEST(tricklingServerHitsTheRequestDeadline){
+	HostServer server([](int s){
+		HostServer::Send(s, "HTTP/1.0 200 OK\r\n\r\n");
+		for (int i = 0; i < 100; i++){
+			if (write(s, "x", 1) < 0)
+				break;
+			usleep(50000);
+		}
+	});
+	for (const char* sScheme : SCHEMES){
+		WebClient client;
+		client.SetTimeouts(1000, 300, 800);
+		__uint32_t uElapsed;
+		CHECK(Get(client, server.Url(sScheme), uElapsed) == 1011);
+		CHECK((uElapsed >= 800) && (uElapsed < 1500));
+	}
+}
+
+TEST(changedTokenCancelsTheRequest){
+	HostServer server([](int s){ HostServer::WaitForClose(s); });
+	for (const char* sScheme : SCHEMES){
+		volatile __uint8_t uToken = 1;
+		WebClient client;
+		client.SetTimeouts(1000, 5000, 0);
+		client.SetCancelToken(&uToken);
+		std::thread cancel([&](){ usleep(300000); uToken = 2; });
+		__uint32_t uElapsed;
+		CHECK(Get(client, server.Url(sScheme), uElapsed) == 1012);
+		CHECK(uElapsed < 300 + 2 * 250);
+		cancel.join();
+	}
+}
+
+TEST(refusedConnection){
+	unsigned short uPort;
+	{
+		HostServer server([](int s){});
+		uPort = atoi(server.Url("http").c_str() + strlen("http://127.0.0.1:"));
+	}
+	WebClient client;
+	__uint32_t uElapsed;
+	CHECK(Get(client, "http://127.0.0.1:" + std::to_string(uPort) + "/", uElapsed) == 1005);
+}
+
+TEST(receiveBufferAllocationFailureIsTheSameForHttpAndHttps){
+	HostServer server([](int s){ HostServer::Send(s, "HTTP/1.0 200 OK\r\nContent-Length: 2\r\n\r\nok"); });
+	struct rlimit limit;
+	getrlimit(RLIMIT_AS, &limit);
+	for (const char* sScheme : SCHEMES){
+		WebClient client;
+		__uint32_t uElapsed;
+		// the address space limit makes the 2GB receive buffer fail, the buffer is allocated per request
+		client.SetReceiveBufferSize(0x80000000);
+		struct rlimit low = limit;
+		low.rlim_cur = 1024 * 1024 * 1024;
+		setrlimit(RLIMIT_AS, &low);
+		unsigned short uStatus = Get(client, server.Url(sScheme), uElapsed);
+		setrlimit(RLIMIT_AS, &limit);
+		CHECK(uStatus == 1009);
+
+		client.SetReceiveBufferSize(2048);
+		CHECK(Get(client, server.Url(sScheme), uElapsed) == 200);
+		CHECK(client.GetResponseData() == "ok");
+		CHECK(client.GetAllocations() == 2);
+	}
+}